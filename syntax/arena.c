@@ -0,0 +1,49 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Arena astArena;
+Arena irArena;
+Arena backendArena;
+
+// blocks come from malloc, so an offset aligned to alignment gives an aligned address
+static char* allocate(Arena* arena, size_t size, size_t alignment) {
+    size_t offset = (arena->blockUsed + alignment - 1) & ~(alignment - 1);
+    if (arena->blockNum == 0 || offset + size > arena->blockSize) {
+        // the rest of the last block is given up, requests larger than a block get a block of their own
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        arena->blocks = (char**)realloc(arena->blocks, (arena->blockNum + 1) * sizeof(char*));
+        if (arena->blocks == NULL || (arena->blocks[arena->blockNum] = (char*)malloc(blockSize)) == NULL) {
+            fprintf(stderr, "Failed to allocate memory for arena\n");
+            exit(1);
+        }
+        arena->blockNum++;
+        arena->blockSize = blockSize;
+        offset = 0;
+    }
+    arena->blockUsed = offset + size;
+    return arena->blocks[arena->blockNum - 1] + offset;
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    return allocate(arena, size, _Alignof(max_align_t));
+}
+
+char* arenaStrdup(Arena* arena, const char* text) {
+    size_t length = strlen(text) + 1;
+    char* copy = allocate(arena, length, 1);
+    memcpy(copy, text, length);
+    return copy;
+}
+
+void freeArena(Arena* arena) {
+    for (unsigned int i = 0; i < arena->blockNum; ++i) {
+        free(arena->blocks[i]);
+    }
+    free(arena->blocks);
+    arena->blocks = NULL;
+    arena->blockNum = 0;
+    arena->blockUsed = 0;
+    arena->blockSize = 0;
+}
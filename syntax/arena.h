@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* bump allocators for the data of one compiler phase.
+ * objects are carved out of blocks of ARENA_BLOCK_SIZE bytes and never freed one by one;
+ * freeArena() releases the whole arena when the phase is over.
+ * - astArena: AST nodes, released after parsing
+ * - irArena: TACs, their list nodes and the temps, labels and constants made for them, released
+ *   after the .ir file is written
+ * - backendArena: strings of the code generator, released after the .asm file is written
+ * a zero-initialized Arena is empty and ready to use.
+ */
+typedef struct Arena {
+    char** blocks;
+    unsigned int blockNum;
+    size_t blockUsed;       // bytes used in the last block
+    size_t blockSize;       // size of the last block
+} Arena;
+
+#define ARENA_BLOCK_SIZE 65536
+
+extern Arena astArena;
+extern Arena irArena;
+extern Arena backendArena;
+
+// size bytes aligned for any object, not initialized
+void* arenaAlloc(Arena* arena, size_t size);
+
+// a copy of text in the arena
+char* arenaStrdup(Arena* arena, const char* text);
+
+// release all blocks; the arena can be used again afterwards
+void freeArena(Arena* arena);
+
+#endif
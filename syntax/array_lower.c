@@ -0,0 +1,37 @@
+#include "opt.h"
+#include <string.h>
+
+/* make the address arithmetic of array accesses visible to the other passes:
+ *   (=[], arr, i, t)   ->  (&[], arr, i, a) (=*, a, , t)
+ *   ([]=, i, v, arr)   ->  (&[], arr, i, a) (*=, a, , v)
+ * &[] scales the index and adds the base address, so two accesses to arr[i] share one &[] after
+ * value numbering, and loops can step the address instead of the index.
+ */
+void lowerArrayAccesses(CFG* cfg, FILE* report) {
+    int lowered = 0;
+    TACList* cur = cfg->funcLabel->next;
+    while (cur != NULL && cur != cfg->endLabel) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_LOAD_ELEM) {
+            char* addr = generateTemp();
+            char* res = tac->res;
+            tac->op = TAC_ELEM_ADDR;
+            tac->res = addr;
+            cur = insertTACAfter(cur, createTAC(TAC_LOAD, addr, NULL, res));
+            ++lowered;
+        } else if (tac->op == TAC_STORE_ELEM) {
+            char* addr = generateTemp();
+            char* arr = tac->res;
+            char* index = tac->arg1;
+            char* val = tac->arg2;
+            tac->op = TAC_ELEM_ADDR;
+            tac->arg1 = arr;
+            tac->arg2 = index;
+            tac->res = addr;
+            cur = insertTACAfter(cur, createTAC(TAC_STORE, addr, NULL, val));
+            ++lowered;
+        }
+        cur = cur->next;
+    }
+    fprintf(report, "%s: %d array accesses lowered\n", cfg->funcName, lowered);
+}
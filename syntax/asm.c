@@ -3,11 +3,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <ctype.h>
 #include "symbol_table.h"
 #include "tac.h"
+#include "liveness.h"
+#include "regalloc.h"
+#include "muldiv.h"
+#include "arena.h"
 
 int indexAddrDesc = 0;
 int indexStackFrameInfos = 0;
+int currentFrameIndex = 0; // 正在生成代码的函数在 stackFrameInfos 里的下标
+static char* pendingLocalArgs[MAX_CALL_ARGS]; // param 收集的实参，在 call 时统一传递
+static int pendingLocalArgNum = 0;
+static bool lastLocalWasReturn = false; // 上一条四元式是 return，end_func 不用再返回
 // 定义寄存器数组
 const char* all_regs[] = {
     "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7",
@@ -16,9 +25,10 @@ const char* all_regs[] = {
     "x24", "x25", "x26", "x27", "x28", "x29", "x30", "x31"
 };
 
+// 逐语句分配使用的寄存器：调用者保存的 t0-t4。调用之前变量都写回内存，用不到被调用者保存寄存器，
+// x30、x31 留给生成代码的指令序列
 const char* UsefulRegs[] = {
-  "x5", "x6", "x7", "x28", "x29", "x30", "x31",
-  "x8", "x9", "x18", "x19", "x20", "x21", "x22", "x23"
+  "x5", "x6", "x7", "x28", "x29"
 };
 
 /* Set start */
@@ -76,44 +86,14 @@ void setFree(Set* set) {
 
 /* Set end */
 
-int mapRegDesc(char* key) {
-    int index = -1;
-
-    if (strcmp(key, "x5") == 0) {
-        index = 0;
-    } else if (strcmp(key, "x6") == 0) {
-        index = 1;
-    } else if (strcmp(key, "x7") == 0) {
-        index = 2;
-    } else if (strcmp(key, "x28") == 0) {
-        index = 3;
-    } else if (strcmp(key, "x29") == 0) {
-        index = 4;
-    } else if (strcmp(key, "x30") == 0) {
-        index = 5;
-    } else if (strcmp(key, "x31") == 0) {
-        index = 6;
-    } else if (strcmp(key, "x18") == 0) {
-        index = 7;
-    } else if (strcmp(key, "x19") == 0) {
-        index = 8;
-    } else if (strcmp(key, "x20") == 0) {
-        index = 9;
-    } else if (strcmp(key, "x21") == 0) {
-        index = 10;
-    } else if (strcmp(key, "x22") == 0) {
-        index = 11;
-    } else if (strcmp(key, "x23") == 0) {
-        index = 12;
-    } else if (strcmp(key, "x8") == 0) {
-        index = 13;
-    } else if (strcmp(key, "x9") == 0) {
-        index = 14;
-    } else {
-        index = -1;
+// 寄存器在 registerDescriptors 里的下标，内存地址和其他寄存器返回 -1
+int mapRegDesc(const char* key) {
+    for (int i = 0; i < MAX_REGISTERS; i++) {
+        if (strcmp(UsefulRegs[i], key) == 0) {
+            return i;
+        }
     }
-
-    return index;
+    return -1;
 }
 int mapAddrDesc(char* key) {
     int index = -1;
@@ -150,9 +130,6 @@ void init_registers() {
             fprintf(stderr, "Failed to allocate memory for registers[%d].variables\n", i);
             exit(EXIT_FAILURE);
         }
-        for (int j = 0; j < MAX_VARIABLES; j++) {
-            setAdd(registerDescriptors[i].variables, NULL);  // 初始为空指针
-        }
         reg_allocated[i] = 0;
     }
 }
@@ -168,7 +145,7 @@ void free_registers() {
 
 // 释放单个寄存器描述符
 void release_register(int reg) {
-    if (reg >= 0 && reg < 32) {
+    if (reg >= 0 && reg < MAX_REGISTERS) {
         reg_allocated[reg] = 0;
         // 清空寄存器中的变量
         setClear(registerDescriptors[reg].variables);
@@ -185,6 +162,9 @@ void initAsm() {
     for (int i = 0; i < MAX_VARS; i++) {
         addressDescriptors[i].currentAddresses = createSet();  // 动态分配或默认空指针
         addressDescriptors[i].boundMemAddress = NULL;  // 暂时null
+        addressDescriptors[i].size = WORD_LENGTH_BYTE;
+        addressDescriptors[i].isArray = false;
+        addressDescriptors[i].isGlobal = false;
     }
 
     // 初始化栈帧信息
@@ -195,6 +175,10 @@ void initAsm() {
         stackFrameInfos[i].localData = 0;  // 默认没有局部数据
         stackFrameInfos[i].numGPRs2Save = 0;  // 默认无需保存寄存器
         stackFrameInfos[i].numReturnAdd = 0;  // 默认没有返回地址
+        stackFrameInfos[i].spillSlots = 0;  // 默认没有溢出区
+        stackFrameInfos[i].savedRegMask = 0;
+        stackFrameInfos[i].locals = NULL;
+        stackFrameInfos[i].localNum = 0;
     }
 }
 
@@ -209,33 +193,33 @@ void freeAsm() {
         }
     }
 
-    // 释放栈帧信息中可能使用的动态内存（如果有）
-    // 在目前的设计中，栈帧信息没有动态分配的内容，但如果未来需要，可以在这里释放
-    // 例如，如果栈帧信息包含动态分配的字符串数组或其他结构体
+    // 释放栈帧信息中局部变量的位置
+    for (int i = 0; i < MAX_FUNCTIONS; i++) {
+        free(stackFrameInfos[i].locals);
+        stackFrameInfos[i].locals = NULL;
+        stackFrameInfos[i].localNum = 0;
+    }
 }
 
 // 初始化 AsmContainer
 void initAsmContainer(AsmContainer* container) {
-    container->asmLines = (char**)malloc(INITIAL_ASM_SIZE * sizeof(char*));
-    if (container->asmLines == NULL) {
+    container->instrs = (Instr*)malloc(INITIAL_ASM_SIZE * sizeof(Instr));
+    if (container->instrs == NULL) {
         // 检查 malloc 是否成功
-        fprintf(stderr, "Failed to allocate memory for asmLines\n");
+        fprintf(stderr, "Failed to allocate memory for instrs\n");
         exit(EXIT_FAILURE);
     }
     container->size = 0;
     container->capacity = INITIAL_ASM_SIZE;
+    initSymbolPool(&container->symbols);
 }
 
-// 释放 AsmContainer 内存
+// 释放 AsmContainer 内存，指令中的符号随符号池一起释放
 void freeAsmContainer(AsmContainer* container) {
-    for (size_t i = 0; i < container->size; i++) {
-        if (container->asmLines[i] != NULL) {  // 检查指针是否为 NULL
-            free(container->asmLines[i]);  // 释放每一行的内存
-            container->asmLines[i] = NULL;  // 防止双重释放
-        }
-    }
-    free(container->asmLines);  // 释放数组本身
-    container->asmLines = NULL;  // 防止双重释放
+    free(container->instrs);
+    container->instrs = NULL;  // 防止双重释放
+    container->size = 0;
+    freeSymbolPool(&container->symbols);
 }
 
 // 加载变量到寄存器
@@ -254,10 +238,10 @@ void loadVar(const char* varId, const char* registerName, AsmContainer* asmConta
         return;
     }
 
-    // 生成 lw 指令
+    // 按变量的大小生成 lw、lh 或 lbu 指令
     char line[256];
-    snprintf(line, sizeof(line), "lw %s, %s", registerName, varLoc);
-    newAsm(asmContainer, line);
+    snprintf(line, sizeof(line), "%s %s, %s", getLoadOp(addressDescriptors[indexAddrDesc].size), registerName, varLoc);
+    emitLoad(asmContainer, line);
 
     // 更新寄存器描述符，清除原有变量，添加新变量
     for (int i = 0; i < MAX_REGISTERS; i++) {
@@ -286,13 +270,15 @@ void storeVar(const char* varId, const char* registerName, AsmContainer* asmCont
     // 如果未找到绑定地址，抛出错误
     assert(varLoc != NULL && "Cannot get the bound address for this variable");
 
-    // 生成 sw 指令，将寄存器内容写入内存
+    // 生成 sw、sh 或 sb 指令，将寄存器内容写入内存
     char line[256];
-    snprintf(line, sizeof(line), "sw %s, %s", registerName, varLoc);
+    snprintf(line, sizeof(line), "%s %s, %s", getStoreOp(addressDescriptors[indexAddrDesc].size), registerName, varLoc);
     newAsm(asmContainer, line);  // 将汇编指令添加到 asmContainer
 
     // 更新地址描述符，增加 varLoc 到 currentAddresses
-    setAdd(addressDescriptors[indexAddrDesc].currentAddresses, (char*)varLoc);
+    if (!setHas(addressDescriptors[indexAddrDesc].currentAddresses, varLoc)) {
+        setAdd(addressDescriptors[indexAddrDesc].currentAddresses, varLoc);
+    }
 }
 
 // 将空格替换为制表符(\t)（可用可不用，目前不使用）
@@ -305,54 +291,44 @@ void replaceSpacesWithTabs(char* line) {
 }
 
 // 生成汇编代码的函数
-char* toAssembly(AsmContainer* container) {
-    // 用于存储生成的汇编代码
-    static char result[65536];  // 假设最大能容纳的汇编代码大小
-
-    result[0] = '\0';  // 初始化为空字符串
-
+void writeAssembly(AsmContainer* container, FILE* output) {
+    // 逐行写入 output，不在内存中拼接整个文件
     for (size_t i = 0; i < container->size; i++) {
-        char* line = container->asmLines[i];
-
-        // 检查行是否以 '.'开头 或 存在':'
-        if (!(line[0] == '.' || strchr(line, ':') != NULL)) {
-            // 如果不是以 . '.'开头 或 存在':'，给行前添加制表符
-            char formattedLine[MAX_LINE_LENGTH];
-            snprintf(formattedLine, sizeof(formattedLine), "\t%s", line);
+        Instr* instr = &container->instrs[i];
+        char line[MAX_LINE_LENGTH];
+        formatInstr(instr, line, sizeof(line));
 
-            // 替换空格为制表符
-            //replaceSpacesWithTabs(formattedLine);
-
-            // 将格式化后的行添加到最终结果中
-            strcat(result, formattedLine);
-        }
-        else {
-            // 否则，直接将行添加到最终结果中
-            strcat(result, line);
+        // 标号和伪指令顶格，其余指令前添加制表符
+        if (instr->op != INSTR_LABEL && instr->op != INSTR_DIRECTIVE) {
+            fputc('\t', output);
         }
-
-        // 添加换行符
-        strcat(result, "\n");
-
-        //printf("%s", result);
+        fputs(line, output);
+        fputc('\n', output);
     }
-
-    return result;
 }
 
-// 添加一行汇编代码
-void newAsm(AsmContainer* container, const char* line) {
+// 添加一条结构化指令
+void newInstr(AsmContainer* container, const Instr* instr) {
     // 如果当前数组已满，扩展数组
     if (container->size >= container->capacity) {
         container->capacity *= 2;  // 扩展为原来的两倍
-        container->asmLines = (char**)realloc(container->asmLines, container->capacity * sizeof(char*));
+        container->instrs = (Instr*)realloc(container->instrs, container->capacity * sizeof(Instr));
+        if (container->instrs == NULL) {
+            fprintf(stderr, "Failed to allocate memory for instrs\n");
+            exit(EXIT_FAILURE);
+        }
     }
-
-    // 复制新行的汇编代码到数组
-    container->asmLines[container->size] = _strdup(line);
+    container->instrs[container->size] = *instr;
     container->size++;
 }
 
+// 添加一行汇编代码
+void newAsm(AsmContainer* container, const char* line) {
+    Instr instr;
+    parseInstr(line, &instr, &container->symbols);
+    newInstr(container, &instr);
+}
+
 // 生成声明全局变量代码
 void initializeGlobalVars(AsmContainer* container) {
     if (container == NULL) {
@@ -376,7 +352,8 @@ void initializeGlobalVars(AsmContainer* container) {
                     if (entry->isArray == 1) {
                         // 声明数组
                         char line[256];
-                        snprintf(line, sizeof(line), "%s: .space %d", entry->id, entry->size);
+                        // 数组元素按字寻址，每个元素占一个字
+                        snprintf(line, sizeof(line), "%s: .space %d", entry->id, entry->size / getTypeSize(entry->type) * WORD_LENGTH_BYTE);
                         newAsm(container, line);
                     } else {
                         // 声明单个变量
@@ -393,7 +370,108 @@ void initializeGlobalVars(AsmContainer* container) {
 
 /*+++++++++++++++++++++++++++++++++++++++++++ 有问题*/
 
-// 计算函数的栈帧信息（未测试，有问题，局部变量相关上层还在调试）
+int getTypeSize(const char* type) {
+    if (strcmp(type, "CHAR") == 0) return 1;
+    if (strcmp(type, "SHORT") == 0) return 2;
+    return WORD_LENGTH_BYTE;
+}
+
+// 先放按字对齐的位置，再放 short 和 char，这样每个位置都自然对齐，中间没有填充
+int layoutFrameSlots(FrameSlot* slots, int num) {
+    int bytes = 0;
+    for (int align = WORD_LENGTH_BYTE; align >= 1; align /= 2) {
+        for (int i = 0; i < num; ++i) {
+            int slotAlign = slots[i].size >= WORD_LENGTH_BYTE ? WORD_LENGTH_BYTE : slots[i].size;
+            if (slotAlign != align) continue;
+            slots[i].offset = bytes;
+            bytes += slots[i].size;
+        }
+    }
+    return (bytes + WORD_LENGTH_BYTE - 1) / WORD_LENGTH_BYTE * WORD_LENGTH_BYTE;
+}
+
+const char* getLoadOp(int size) {
+    return size == 1 ? "lbu" : size == 2 ? "lh" : "lw";
+}
+
+const char* getStoreOp(int size) {
+    return size == 1 ? "sb" : size == 2 ? "sh" : "sw";
+}
+
+static FrameSlot* addFrameSlot(FrameSlot* slots, int* num, int* capacity, char* var, int size) {
+    if (*num >= *capacity) {
+        *capacity = *capacity == 0 ? 8 : *capacity * 2;
+        slots = (FrameSlot*)realloc(slots, *capacity * sizeof(FrameSlot));
+        if (slots == NULL) {
+            fprintf(stderr, "Failed to allocate memory for local variables\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    slots[*num].var = var;
+    slots[*num].size = size;
+    slots[*num].offset = 0;
+    (*num)++;
+    return slots;
+}
+
+static bool hasFrameSlot(FrameSlot* slots, int num, const char* var) {
+    for (int i = 0; i < num; ++i) {
+        if (strcmp(slots[i].var, var) == 0) return true;
+    }
+    return false;
+}
+
+// 函数的局部变量：用寄存器传入的参数在局部数据区中各占一个字，
+// 然后是 func_<name> 和 end_func 之间的 alloc 四元式，(alloc, 类型, 字节数, 变量名)
+static FrameSlot* collectLocals(const char* funcName, int* num) {
+    *num = 0;
+    int capacity = 0;
+    FrameSlot* slots = NULL;
+    SymbolTableEntry* func = findSymbol((char*)funcName);
+    int regParamNum = func == NULL ? 0 : func->paramNum < ARG_REG_NUM ? func->paramNum : ARG_REG_NUM;
+    if (regParamNum > 0) {
+        capacity = regParamNum;
+        slots = (FrameSlot*)malloc(capacity * sizeof(FrameSlot));
+        if (slots == NULL) {
+            fprintf(stderr, "Failed to allocate memory for local variables\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < regParamNum; ++i) {
+            slots[i].var = func->params[i]->id;
+            slots[i].size = WORD_LENGTH_BYTE;
+            slots[i].offset = 0;
+        }
+        *num = regParamNum;
+    }
+    bool inFunc = false;
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_LABEL && strncmp(tac->arg1, "func_", 5) == 0) {
+            inFunc = strcmp(tac->arg1 + 5, funcName) == 0;
+            continue;
+        }
+        if (!inFunc) continue;
+        if (tac->op == TAC_ALLOC) {
+            int typeSize = getTypeSize(tac->arg1);
+            int size = atoi(tac->arg2);
+            // 数组元素按字寻址（下标乘 4），所以每个元素占一个字
+            slots = addFrameSlot(slots, num, &capacity, tac->res, size > typeSize ? size / typeSize * WORD_LENGTH_BYTE : typeSize);
+        }
+        if (regAllocMode != REG_ALLOC_LOCAL) continue;
+        // 逐语句分配时临时变量也各占一个字，跨基本块的临时变量通过它传递
+        char* operands[3];
+        getTACVarOperands(tac, operands);
+        for (int i = 0; i < 3; ++i) {
+            if (operands[i] != NULL && isTemp(operands[i]) && !hasFrameSlot(slots, *num, operands[i])) {
+                slots = addFrameSlot(slots, num, &capacity, operands[i], WORD_LENGTH_BYTE);
+            }
+        }
+    }
+    return slots;
+}
+
+// 计算函数的栈帧信息：局部数据区由参数和 alloc 四元式排列得到，第 9 个以后的参数在调用者的出栈参数区中
+// 全局寄存器分配时由 allocateRegisters 按分配结果重新计算
 void calcFrameInfo(AsmContainer* container) {
     int funcPoolCount = 0; // for 循环计算函数个数
     char* funcName[MAX_FUNCTIONS]; 
@@ -409,375 +487,261 @@ void calcFrameInfo(AsmContainer* container) {
             }
         }
     }
-    // printf("funcPoolCount: %d\n", funcPoolCount);
-
 
+    // 叶函数和出栈参数的个数由调用图决定
+    CallGraph* callGraph = buildCallGraph();
     for (int funcIdx = 0; funcIdx < funcPoolCount; funcIdx++) {
         // 计算函数的栈帧大小
-        int isLeaf = true; // outer->childFuncsCount == 0，我们不做子函数相关的，默认是叶函数
-        int maxArgs = 0;
-        // for (int innerIdx = 0; innerIdx < funcPoolCount; innerIdx++) {
-        //     SymbolTableEntry* inner = funcPool[innerIdx];
-        //     for (int childIdx = 0; childIdx < outer->childFuncsCount; childIdx++) {
-        //         if (!strcmp(inner->id, outer->childFuncs[childIdx]->funcName)) {
-        //             maxArgs = inner->paramNum > maxArgs ? inner->paramNum : maxArgs;
-        //         }
-        //     }
-        // }
-        int outgoingSlots = isLeaf ? 0 : maxArgs > 4 ? maxArgs : 4;
-        int localData = 4;
-        
-        // for (int localVarIdx = 0; localVarIdx < scopeStack[0]->table[funcIdx]->entry->paramNum; localVarIdx++) { // 不能遍利paramnum，应该是遍利所有局部变量而非参数
-        //     FuncParam* localVar = scopeStack[0]->table[funcIdx]->entry->params[localVarIdx];
-        //     if (!strcmp(localVar->type, "int")) {
-        //         int isParam = 0;
-        //         for (int paramIdx = 0; paramIdx < scopeStack[0]->table[funcIdx]->entry->paramNum; paramIdx++) {
-        //             if (strcmp(localVar->id, scopeStack[0]->table[funcIdx]->entry->params[paramIdx]->id) == 0) {
-        //                 isParam = 1;
-        //                 break;
-        //             }
-        //         }
-        //         if (!isParam) localData++;
-        //     } else {
-        //         printf("Error: localVar is not an instance of IRVar\n");
-        //     }
-        // }
-        int numGPRs2Save = !strcmp(funcName[funcIdx], "main") ? 0 : localData > 10 ? (localData > 18 ? 8 : localData - 8) : 0;
-        // printf("%d", numGPRs2Save);
+        int node = findCallGraphNode(callGraph, funcName[funcIdx]);
+        int isLeaf = node == -1 || callGraph->nodes[node].isLeaf;
+        int maxArgs = node == -1 ? 0 : callGraph->nodes[node].maxArgs;
+        int outgoingSlots = maxArgs > ARG_REG_NUM ? maxArgs - ARG_REG_NUM : 0;
+
+        int localNum = 0;
+        FrameSlot* locals = collectLocals(funcName[funcIdx], &localNum);
+        int localData = layoutFrameSlots(locals, localNum) / WORD_LENGTH_BYTE;
+        // 逐语句分配只用调用者保存的寄存器，不需要保存 s 寄存器
+        int numGPRs2Save = 0;
         
-        int wordSize = (isLeaf ? 0 : 1) + localData + numGPRs2Save + outgoingSlots + numGPRs2Save;
+        int wordSize = (isLeaf ? 0 : 1) + localData + numGPRs2Save + outgoingSlots;
         if (wordSize % 2 != 0) wordSize++; // padding
         stackFrameInfos[indexStackFrameInfos].isLeaf = isLeaf;
         stackFrameInfos[indexStackFrameInfos].wordSize = wordSize;  // 默认字节大小
         stackFrameInfos[indexStackFrameInfos].outgoingSlots = outgoingSlots;  
         stackFrameInfos[indexStackFrameInfos].localData = localData;  
         stackFrameInfos[indexStackFrameInfos].numGPRs2Save = numGPRs2Save;  
+        stackFrameInfos[indexStackFrameInfos].savedRegMask = (1u << numGPRs2Save) - 1;
         stackFrameInfos[indexStackFrameInfos].numReturnAdd = isLeaf ? 0 : 1;
+        stackFrameInfos[indexStackFrameInfos].locals = locals;
+        stackFrameInfos[indexStackFrameInfos].localNum = localNum;
         funcPairs[indexStackFrameInfos] = funcName[funcIdx];
         indexStackFrameInfos++;
-        // printf("funcName: %s, isLeaf: %d, wordSize: %d, outgoingSlots: %d, localData: %d, numGPRs2Save: %d, numReturnAdd: %d\n", funcPairs[indexStackFrameInfos-1], stackFrameInfos[indexStackFrameInfos-1].isLeaf, stackFrameInfos[indexStackFrameInfos-1].wordSize, stackFrameInfos[indexStackFrameInfos-1].outgoingSlots, stackFrameInfos[indexStackFrameInfos-1].localData, stackFrameInfos[indexStackFrameInfos-1].numGPRs2Save, stackFrameInfos[indexStackFrameInfos-1].numReturnAdd);
-    }
-    // printf("funcPairs:\n%s", funcPairs[1]);
-
-    // printf("stackFrameInfos:\n");
-    // for (int i = 0; i < indexStackFrameInfos; i++) {
-    //     printf("funcName: %s, isLeaf: %d, wordSize: %d, outgoingSlots: %d, localData: %d, numGPRs2Save: %d, numReturnAdd: %d\n", funcPairs[i], stackFrameInfos[i].isLeaf, stackFrameInfos[i].wordSize, stackFrameInfos[i].outgoingSlots, stackFrameInfos[i].localData, stackFrameInfos[i].numGPRs2Save, stackFrameInfos[i].numReturnAdd);
-    // }
-
-    // for (int i = 0; i < SYMBOL_TABLE_SIZE; ++i) { 
-    //     if (scopeStack[0]->table[i] != NULL) {
-    //         HashNode* temp = scopeStack[0]->table[i];
-    //         while (temp != NULL) {
-    //             SymbolTableEntry* entry = temp->entry;
-    //             if (entry->isFunction == 1) {  // 检查是否是函数
-    //                 // 固态分配大小
-    //                 stackFrameInfos[indexStackFrameInfos].isLeaf = true;  // 默认是叶函数
-    //                 stackFrameInfos[indexStackFrameInfos].wordSize = wordSize;  // 默认字节大小
-    //                 stackFrameInfos[indexStackFrameInfos].outgoingSlots = 0;  // 默认无出栈参数
-    //                 stackFrameInfos[indexStackFrameInfos].localData = 4;  // 默认4个局部数据
-    //                 stackFrameInfos[indexStackFrameInfos].numGPRs2Save = 0;  // 默认无需保存寄存器
-    //                 stackFrameInfos[indexStackFrameInfos].numReturnAdd = 0;  // 默认没有返回地址
-    //                 indexStackFrameInfos++;
-    //             }
-    //             temp = temp->next;
-    //         }
-    //     }
-    // }
-}
-
-// 辅助函数，检查寄存器中是否有指定变量
-bool checkRegisterForVariable(const char* regName, const char* varId) {
-    bool flag = false;
-    for (int i = 0; i < MAX_REGISTERS; i++) {
-        if (strcmp(UsefulRegs[i], regName) == 0) {
-            flag = setHas(registerDescriptors[i].variables, (char*)varId);
-        }
     }
-    return flag == 1;
+    freeCallGraph(callGraph);
 }
 
-// 为一条四元式获取每个变量可用的寄存器（龙书8.6.3）
-char** getRegs(TAC* ir, int irIndex, AsmContainer* asmContainer) {
-    char* op = ir->op;
-    char* arg1 = ir->arg1;
-    char* arg2 = ir->arg2;
-    char* res = ir->res;
-
-    int binaryOp = (arg1 != NULL && *arg1 != '\0') && (arg2 != NULL && *arg2 != '\0');
-    int unaryOp = (arg1 != NULL && *arg1 != '\0') ^ (arg2 != NULL && *arg2 != '\0');
-
-    char** regs = (char**)malloc(3 * sizeof(char*));
-    if (regs == NULL) {
-        fprintf(stderr, "Failed to allocate memory for regs\n");
-        exit(EXIT_FAILURE);
+// 变量当前所在的一个寄存器，不在寄存器中时返回 NULL
+static const char* findVarReg(int indexAddrDesc) {
+    Set* currentAddresses = addressDescriptors[indexAddrDesc].currentAddresses;
+    for (int i = 0; i < currentAddresses->size; i++) {
+        int indexRegDesc = mapRegDesc(currentAddresses->elements[i]);
+        if (indexRegDesc != -1) {
+            return UsefulRegs[indexRegDesc];
+        }
     }
+    return NULL;
+}
 
-    for (int i = 0; i < 3; i++) {
-        regs[i] = "";
+// param 收集的实参到 call 时才读取，中间可能隔着短路求值的基本块
+static bool isPendingArg(const char* var) {
+    for (int i = 0; i < pendingLocalArgNum; i++) {
+        if (strcmp(pendingLocalArgs[i], var) == 0) {
+            return true;
+        }
     }
+    return false;
+}
 
-    if (strcmp(op, "=$") == 0 || strcmp(op, "call") == 0 || strcmp(op, "ifFalseGoto") == 0 || strcmp(op, "=") == 0 || strcmp(op, "[]=") == 0 || strcmp(op, "=[]") == 0) {
-        if (strcmp(op, "=$") == 0) { // 赋值操作
-            char* regY = allocateReg(irIndex, arg1, arg2, res, asmContainer);
-            if (regY != NULL && !checkRegisterForVariable(regY, arg1)) {
-                loadVar(arg1, regY, asmContainer);
-            }
-            char* regZ = allocateReg(irIndex, arg2, arg1, res, asmContainer);
-            if (regZ != NULL && !checkRegisterForVariable(regZ, arg2)) {
-                loadVar(arg2, regZ, asmContainer);
-            }
-            regs[0] = regY;
-            regs[1] = regZ;
-        } else if (strcmp(op, "call") == 0) {
-            char* regX = allocateReg(irIndex, res, arg1, arg2, asmContainer);
-            regs[0] = regX;
-        } else if (strcmp(op, "ifFalseGoto") == 0) {
-            char* regY = allocateReg(irIndex, arg1, arg2, res, asmContainer);
-            if (regY != NULL && !checkRegisterForVariable(regY, arg1)) {
-                loadVar(arg1, regY, asmContainer);
-            }
-            // 生成 beqz 指令
-            char line[256];
-            snprintf(line, sizeof(line), "beq %s, %s, 0", regY, res);
-            newAsm(asmContainer, line);
-            regs[0] = regY;
-        } else if (strcmp(op, "=") == 0) {
-            char* regY = allocateReg(irIndex, arg1, arg2, res, asmContainer);
-            // if (regY != NULL) {
-            //     printf("Warning: %s is assigned to %s, but it is not used later.\n", arg1, res);
-            // }
-            if (regY != NULL && !checkRegisterForVariable(regY, arg1)) {
-                loadVar(arg1, regY, asmContainer);
-            }
-            char* regX = regY;  // always choose RegX = RegY
-            regs[0] = regY;
-            regs[1] = regX;
-        } else if (strcmp(op, "[]=") == 0) { // 数组赋值
-            char* regY = allocateReg(irIndex, arg1, arg2, res, asmContainer);
-            if (regY != NULL && !checkRegisterForVariable(regY, arg1)) {
-                loadVar(arg1, regY, asmContainer);
-            }
-            char* regZ = allocateReg(irIndex, arg2, arg1, res, asmContainer);
-            if (regZ != NULL && !checkRegisterForVariable(regZ, arg2)) {
-                loadVar(arg2, regZ, asmContainer);
-            }
-            regs[0] = regY;
-            regs[1] = regZ;
-        } else if (strcmp(op, "=[]") == 0) { // 数组取值
-            char* regZ = allocateReg(irIndex, arg2, arg1, res, asmContainer);
-            if (regZ != NULL && !checkRegisterForVariable(regZ, arg2)) {
-                loadVar(arg2, regZ, asmContainer);
-            }
-            char* regX = allocateReg(irIndex, res, arg1, arg2, asmContainer);
-            regs[0] = regZ;
-            regs[1] = regX;
-        }
-    } else if (binaryOp) {
-        char* regY = allocateReg(irIndex, arg1, arg2, res, asmContainer);
-        // if (regY != NULL) {printf(regY);}
-        if (regY != NULL && !checkRegisterForVariable(regY, arg1)) {
-            loadVar(arg1, regY, asmContainer);
-        }
-        char* regZ = allocateReg(irIndex, arg2, arg1, res, asmContainer);
-        if (regZ != NULL && !checkRegisterForVariable(regZ, arg2)) {
-            loadVar(arg2, regZ, asmContainer);
-        }
+// 变量的值不在内存中，而且之后还会用到时，要写回内存。全局变量总是写回，被调用者和下一个基本块都可能读它
+static bool needsStore(int indexAddrDesc) {
+    AddressDescriptor* ad = &addressDescriptors[indexAddrDesc];
+    if (ad->isArray || setHas(ad->currentAddresses, ad->boundMemAddress)) {
+        return false;
+    }
+    char* var = addrDescPairs[indexAddrDesc];
+    return ad->isGlobal || isLiveAfter(var) || isPendingArg(var);
+}
 
-        // if res is either of arg1 or arg2, then simply use the same register
-        char* regX = "";
-        if (res != NULL && strcmp(res, arg1) == 0) {
-            regX = regY;
-        } else if (res != NULL && strcmp(res, arg2) == 0) {
-            regX = regZ;
-        } else {
-            regX = allocateReg(irIndex, res, arg1, arg2, asmContainer);
+// 把寄存器中的变量移出：只在这个寄存器中、之后还会用到的变量先写回内存。
+// res 的值马上会被改写，不用写回
+static void spillReg(int indexRegDesc, const char* res, AsmContainer* asmContainer) {
+    const char* reg = UsefulRegs[indexRegDesc];
+    Set* variables = registerDescriptors[indexRegDesc].variables;
+    for (int j = 0; j < variables->size; j++) {
+        char* var = variables->elements[j];
+        int indexAddrDesc = mapAddrDesc(var);
+        Set* currentAddresses = addressDescriptors[indexAddrDesc].currentAddresses;
+        bool overwritten = res != NULL && strcmp(var, res) == 0;
+        if (!overwritten && currentAddresses->size == 1 && needsStore(indexAddrDesc)) {
+            storeVar(var, reg, asmContainer);
         }
-        regs[0] = regY;
-        regs[1] = regZ;
-        regs[2] = regX;
-    } else if (unaryOp) {
-        char* regY = allocateReg(irIndex, arg1, arg2, res, asmContainer);
-        if (regY != NULL && !checkRegisterForVariable(regY, arg1)) {
-            loadVar(arg1, regY, asmContainer);
-        }
-
-        char* regX = res != NULL && strcmp(res, arg1) == 0 ? regY : allocateReg(irIndex, res, arg1, arg2, asmContainer);
-        regs[0] = regY;
-        regs[1] = regX;
-    } else {
-        assert(false && "Illegal op.");
+        setDelete(currentAddresses, (char*)reg);
     }
-
-    return regs;
+    setClear(variables);
 }
 
-// 寄存器分配函数（龙书8.6.3）
-char* allocateReg(int irIndex, const char* thisArg, const char* otherArg, const char* res, AsmContainer* asmContainer) {
-    // 如果已经在寄存器里，则直接返回
+// 调用会改写 t 寄存器，基本块开头也可能从别处跳来：寄存器中的值都不再可用
+static void clearRegisters() {
     for (int i = 0; i < MAX_REGISTERS; i++) {
-        if (setHas(registerDescriptors[i].variables, (char*)thisArg)) {
-            return (char*)UsefulRegs[i];
+        Set* variables = registerDescriptors[i].variables;
+        for (int j = 0; j < variables->size; j++) {
+            int indexAddrDesc = mapAddrDesc(variables->elements[j]);
+            setDelete(addressDescriptors[indexAddrDesc].currentAddresses, (char*)UsefulRegs[i]);
         }
+        setClear(variables);
+    }
+}
+
+// 寄存器分配函数（龙书8.6.3）：变量已经在寄存器中时直接使用，其次选择空闲的寄存器，
+// 否则选择要写回的变量最少的寄存器并把其中的变量移出。avoid1、avoid2 是这条四元式其他操作数所在的寄存器
+const char* allocateReg(const char* var, const char* avoid1, const char* avoid2, AsmContainer* asmContainer) {
+    int indexAddrDesc = mapAddrDesc((char*)var);
+    const char* reg = indexAddrDesc == -1 ? NULL : findVarReg(indexAddrDesc);
+    if (reg != NULL) {
+        return reg;
     }
 
-    // 如果没在寄存器里，则先寻找空闲的寄存器
     for (int i = 0; i < MAX_REGISTERS; i++) {
-        if (registerDescriptors[i].usable && registerDescriptors[i].variables->size == 0) { // 寻找第一个空闲的寄存器
-            // registerDescriptors[i].usable = 1; 
-            setAdd(registerDescriptors[i].variables, (char*)thisArg);
-            return (char*)UsefulRegs[i];
+        if (registerDescriptors[i].variables->size == 0) {
+            return UsefulRegs[i];
         }
     }
 
-    // 如果没有空闲寄存器，选择一个寄存器进行替换
-    int minScore = 256;
-    char* minKey = NULL; // 记录最小得分的寄存器
-    int scores[MAX_REGISTERS] = {0}; // 记录index号寄存器的得分
+    int minKey = -1; // 记录最小得分的寄存器
+    int minScore = 0;
     for (int i = 0; i < MAX_REGISTERS; i++) {
-        if (!registerDescriptors[i].usable) {
-            scores[i] = 256; // 对于不可用的寄存器，得分设为256
-            continue;
+        bool avoided = (avoid1 != NULL && strcmp(UsefulRegs[i], avoid1) == 0) || (avoid2 != NULL && strcmp(UsefulRegs[i], avoid2) == 0);
+        if (avoided) continue;
+        // 得分是要生成的 store 指令数
+        int score = 0;
+        Set* variables = registerDescriptors[i].variables;
+        for (int j = 0; j < variables->size; j++) {
+            int index = mapAddrDesc(variables->elements[j]);
+            if (addressDescriptors[index].currentAddresses->size == 1 && needsStore(index)) {
+                score++;
+            }
         }
+        if (minKey == -1 || score < minScore) {
+            minKey = i;
+            minScore = score;
+        }
+    }
+    spillReg(minKey, NULL, asmContainer);
+    return UsefulRegs[minKey];
+}
 
-        int scoreValue = 0;
-        Set* currentVariables = registerDescriptors[i].variables;
-        for (int j = 0; j < currentVariables->size; j++) {
-            const char* currentVar = registerDescriptors[i].variables->elements[j]; // 当前寄存器里的变量
-
-            // 它是结果操作数，而不是另一个参数操作数，可以替换，因为这个值永远不会再使用
-            if (res != NULL && strcmp(currentVar, res) == 0 && strcmp(currentVar, otherArg) != 0) {
-                continue;
-            }
+// 结果写到哪个寄存器：和 allocateReg 一样选择，寄存器中的其他变量在被改写之前写回
+static const char* allocateResultReg(const char* res, const char* avoid1, const char* avoid2, AsmContainer* asmContainer) {
+    const char* reg = allocateReg(res, avoid1, avoid2, asmContainer);
+    spillReg(mapRegDesc(reg), res, asmContainer);
+    return reg;
+}
 
-            // 查找当前变量是否在后续指令中使用
-            bool reused = false;
-            int tempIndex = irIndex + 1;  // 从下一个指令开始检查
-            bool procedureEnd = false;
-            TACList* tempTAC = tacHead;
-            while (tempTAC != NULL) { // 先定位到当前指令
-                if (tempIndex == tempTAC->tac->index) {
-                    break;
-                }
-                tempTAC = tempTAC->next;
-            }
-            while (!procedureEnd && !reused) {
-                if (strcmp(currentVar, tempTAC->tac->arg1) == 0 || strcmp(currentVar, tempTAC->tac->arg2) == 0 || strcmp(currentVar, tempTAC->tac->res) == 0) {
-                    reused = true;
-                    break;
-                }
-                if (tempTAC->tac->op == "return") procedureEnd = true;
-            }
+// 数组变量的值是首地址：局部数组在局部数据区中，全局数组用标号
+static void emitArrayAddress(AsmContainer* asmContainer, int indexAddrDesc, const char* regX) {
+    char buffer[100];
+    if (addressDescriptors[indexAddrDesc].isGlobal) {
+        snprintf(buffer, sizeof(buffer), "addi %s, zero, %s", regX, addrDescPairs[indexAddrDesc]);
+    } else {
+        snprintf(buffer, sizeof(buffer), "addi %s, sp, %d", regX, atoi(addressDescriptors[indexAddrDesc].boundMemAddress));
+    }
+    newAsm(asmContainer, buffer);
+}
 
-            if (!reused) { // 此变量将永远不会再用作该过程后续指令中的参数
-                continue;
-            } else {
-                int index = mapAddrDesc((char*)currentVar);
-                if (addressDescriptors[index].boundMemAddress != NULL) {
-                    Set *currAddresses = addressDescriptors[index].currentAddresses;
-                    if (currAddresses != NULL && currAddresses->size > 1) {
-                        // 它有另一个当前地址，可以直接替换此地址而不生成存储指令
-                        continue;
-                    } else {
-                        // 可以替换，但需要额外的存储指令
-                        scoreValue += 1;
-                    }
-                } else {
-                    // 这临时变量，没有内存地址，因此无法替换
-                    scoreValue = 256;
-                }
-            }
-            scores[i] = scoreValue;
+// 取操作数的值所在的寄存器：不在寄存器中的变量先加载，常量和数组首地址放在 scratch 中，常量 0 使用 zero。
+// avoid 是这条四元式已经取好的操作数所在的寄存器
+static const char* useLocalOperand(AsmContainer* asmContainer, const char* operand, const char* scratch, const char* avoid) {
+    int indexAddrDesc = mapAddrDesc((char*)operand);
+    if (indexAddrDesc == -1) {
+        // 常量：整数，字符常量也写成整数
+        if (!isConstant(operand)) {
+            fprintf(stderr, "Unknown operand %s in function %s\n", operand, funcPairs[currentFrameIndex]);
+            exit(1);
         }
-
-        if (scoreValue < minScore) {
-            minScore = scoreValue;
-            minKey = (char*)UsefulRegs[i];
+        int value = (int)strtol(operand, NULL, 0);
+        if (value == 0) {
+            return "zero";
         }
+        emitLoadImmediate(asmContainer, scratch, value);
+        return scratch;
+    }
+    if (addressDescriptors[indexAddrDesc].isArray) {
+        emitArrayAddress(asmContainer, indexAddrDesc, scratch);
+        return scratch;
+    }
+    const char* reg = findVarReg(indexAddrDesc);
+    if (reg == NULL) {
+        reg = allocateReg(operand, avoid, NULL, asmContainer);
+        loadVar(operand, reg, asmContainer);
     }
+    return reg;
+}
 
-    // assert(minScore != 256 && "Cannot find a register to replace.");
-
-    char* finalReg = minKey;
-    if (minScore > 0) {
-        // 需要生成store指令
-        int indexRegDesc = mapRegDesc(finalReg);
-        Set* currentVariables = registerDescriptors[indexRegDesc].variables;
-        for (int j = 0; j < currentVariables->size; j++) {
-            char* currentVar = currentVariables->elements[j]; // 当前寄存器里的变量
-            int indexAddrDesc = mapAddrDesc(currentVar);
-            char* boundMemAddress = addressDescriptors[indexAddrDesc].boundMemAddress;
-            if (!setHas(addressDescriptors[indexAddrDesc].currentAddresses, boundMemAddress)) {
-                storeVar(currentVar, finalReg, asmContainer);
-                setDelete(registerDescriptors[indexRegDesc].variables, currentVar);
-                setDelete(addressDescriptors[indexAddrDesc].currentAddresses, finalReg);
-            }
-        }
+// 把操作数的值放到指定的寄存器中，regX 不是 UsefulRegs 中的寄存器
+static void loadLocalOperand(AsmContainer* asmContainer, const char* operand, const char* regX) {
+    const char* reg = useLocalOperand(asmContainer, operand, regX, NULL);
+    if (strcmp(reg, regX) != 0) {
+        char buffer[100];
+        snprintf(buffer, sizeof(buffer), "mv %s, %s", regX, reg);
+        newAsm(asmContainer, buffer);
     }
+}
 
-    return finalReg;
+// 登记变量的地址描述符，变量的值一开始只在绑定的内存位置中
+static int addAddrDesc(char* var, char* boundMemAddress, int size) {
+    if (indexAddrDesc >= MAX_VARS) {
+        fprintf(stderr, "Too many variables in function %s.\n", funcPairs[currentFrameIndex]);
+        exit(1);
+    }
+    AddressDescriptor* ad = &addressDescriptors[indexAddrDesc];
+    ad->boundMemAddress = boundMemAddress;
+    ad->size = size;
+    ad->isArray = false;
+    ad->isGlobal = false;
+    setClear(ad->currentAddresses);
+    setAdd(ad->currentAddresses, boundMemAddress);
+    addrDescPairs[indexAddrDesc] = var;
+    return indexAddrDesc++;
 }
 
 void allocateProcMemory(AsmContainer* asmContainer, int index, char* funcName) {
     StackFrameInfo frameInfo = stackFrameInfos[index];
 
-    // Save args passed by register to memory
-    for (int idx = 0; idx < findSymbol(funcName)->paramNum; idx++) { // 固态分
+    // 上一个函数的描述符不再使用
+    clearRegisters();
+    indexAddrDesc = 0;
+
+    // 第 9 个以后的参数在调用者的出栈参数区中，前 8 个在局部数据区中，由下面的循环绑定
+    SymbolTableEntry* func = findSymbol(funcName);
+    for (int idx = ARG_REG_NUM; idx < func->paramNum; idx++) {
         char memLoc[32];
-        snprintf(memLoc, sizeof(memLoc), "%d(sp)", WORD_LENGTH_BYTE * (frameInfo.wordSize + idx));
-        if (idx < 4) {
-            char asmLine[32];
-            snprintf(asmLine, sizeof(asmLine), "sw x%d, %s", idx, memLoc);
-            newAsm(asmContainer, asmLine);
-        }
-        
-        addressDescriptors[indexAddrDesc].boundMemAddress = memLoc;
-        setAdd(addressDescriptors[indexAddrDesc].currentAddresses, memLoc);
-        addrDescPairs[indexAddrDesc] = findSymbol(funcName)->params[idx]->id;
-        indexAddrDesc++;
-    }
-    
-    /***************没有办法拿到局部变量，没法给局部变量分配内存，和地址描述符 */
-    int remainingLVSlots = frameInfo.localData;
-    char memLoc[32];
-    int offset = WORD_LENGTH_BYTE * (frameInfo.wordSize - (frameInfo.isLeaf ? 0 : 1) - frameInfo.numGPRs2Save - remainingLVSlots);
-    snprintf(memLoc, sizeof(memLoc), "%d(sp)", offset);
-    remainingLVSlots--;
-
-    addressDescriptors[indexAddrDesc].boundMemAddress = memLoc;
-    setAdd(addressDescriptors[indexAddrDesc].currentAddresses, memLoc);
-    addrDescPairs[indexAddrDesc] = "a";
-    indexAddrDesc++;
-    /***************没有办法拿到局部变量，没法给局部变量分配内存 */
-
-    // Allocate s2 ~ s11
-    int availableRSs = strcmp(funcName, "main") == 0 ? 8 : frameInfo.numGPRs2Save;
-    for (int index = 2; index < 12; index++) {
-        registerDescriptors[index].usable = index < availableRSs;
-        setAdd(registerDescriptors[index].variables, (char*)"");
-    }
-
-    // printf("%d", findSymbol(funcName)->paramNum);
+        snprintf(memLoc, sizeof(memLoc), "%d(sp)", WORD_LENGTH_BYTE * (frameInfo.wordSize + idx - ARG_REG_NUM));
+        addAddrDesc(func->params[idx]->id, arenaStrdup(&backendArena, memLoc), WORD_LENGTH_BYTE);
+    }
+
+    // 局部变量和临时变量绑定到局部数据区中由 calcFrameInfo 排好的位置，比一个字大的是数组
+    int localBase = WORD_LENGTH_BYTE * (frameInfo.wordSize - frameInfo.numReturnAdd - frameInfo.numGPRs2Save - frameInfo.localData);
+    for (int idx = 0; idx < frameInfo.localNum; idx++) {
+        char memLoc[32];
+        FrameSlot* slot = &frameInfo.locals[idx];
+        snprintf(memLoc, sizeof(memLoc), "%d(sp)", localBase + slot->offset);
+        int indexAddrDesc = addAddrDesc(slot->var, arenaStrdup(&backendArena, memLoc), slot->size > WORD_LENGTH_BYTE ? WORD_LENGTH_BYTE : slot->size);
+        addressDescriptors[indexAddrDesc].isArray = slot->size > WORD_LENGTH_BYTE;
+    }
+
+    // 把 a0-a7 中的参数存到局部数据区，collectLocals 把它们排在 locals 的最前面
+    for (int idx = 0; idx < func->paramNum && idx < ARG_REG_NUM; idx++) {
+        char asmLine[32];
+        snprintf(asmLine, sizeof(asmLine), "sw a%d, %d(sp)", idx, localBase + frameInfo.locals[idx].offset);
+        newAsm(asmContainer, asmLine);
+    }
+
     allocateGlobalMemory(asmContainer);
 }
 
+// 全局变量的地址描述符：标量在 name(zero)，数组的值是标号。和局部变量同名的全局变量被局部变量隐藏
 void allocateGlobalMemory(AsmContainer* asmContainer) {
     for (int i = 0; i < SYMBOL_TABLE_SIZE; ++i) {
         if (scopeStack[0]->table[i] != NULL) {
             HashNode* temp = scopeStack[0]->table[i];
             while (temp != NULL) {
                 SymbolTableEntry* entry = temp->entry;
-                if (entry->isFunction == 0) {  // 检查是否是全局变量
-                    if (entry->isArray == 1) {
-                        int index = mapAddrDesc(entry->id);
-                        addressDescriptors[index].boundMemAddress = entry->id;
-                        setAdd(addressDescriptors[index].currentAddresses, entry->id);
-                    } else {
-                        int index = mapAddrDesc(entry->id);
-                        addressDescriptors[index].boundMemAddress = entry->id;
-                        char buffer[100];
-                        snprintf(buffer, sizeof(buffer), "%s(zero)", entry->id);
-                        setAdd(addressDescriptors[index].currentAddresses, buffer);
-                    }
+                if (entry->isFunction == 0 && mapAddrDesc(entry->id) == -1) {  // 检查是否是全局变量
+                    char memLoc[100];
+                    snprintf(memLoc, sizeof(memLoc), "%s(zero)", entry->id);
+                    int index = addAddrDesc(entry->id, entry->isArray == 1 ? entry->id : arenaStrdup(&backendArena, memLoc), WORD_LENGTH_BYTE);
+                    addressDescriptors[index].isArray = entry->isArray == 1;
+                    addressDescriptors[index].isGlobal = true;
                 }
                 temp = temp->next;
             }
@@ -785,590 +749,564 @@ void allocateGlobalMemory(AsmContainer* asmContainer) {
     }
 }
 
+// 基本块结束和调用之前，把只在寄存器中、之后还会用到的变量写回内存。寄存器中的值仍然有效
 void deallocateProcMemory(AsmContainer* asmContainer) {
     for (int i = 0; i < indexAddrDesc; i++) {
-        char* boundMemAddress = addressDescriptors[i].boundMemAddress;
-        Set* currentAddresses = addressDescriptors[i].currentAddresses;
-        if (boundMemAddress != NULL && !setHas(currentAddresses, boundMemAddress)) {
-            // need to write this back to its bound memory location
-            if (currentAddresses->size > 0) {
-                for (int j = 0; j < currentAddresses->size; j++) {
-                    char* addr = currentAddresses->elements[j];
-                    if (strcmp(addr, "x") == 0) {
-                        storeVar(addrDescPairs[i], boundMemAddress, asmContainer);
-                        break;
-                    }
-                }
-            } else {
-                printf("Warning: Attempted to store a ghost variable.\n");
-            }
+        const char* reg = findVarReg(i);
+        if (reg != NULL && needsStore(i)) {
+            storeVar(addrDescPairs[i], reg, asmContainer);
         }
     }
+}
 
+// 返回之前只有全局变量需要写回
+static void storeGlobalVars(AsmContainer* asmContainer) {
     for (int i = 0; i < indexAddrDesc; i++) {
-        addrDescPairs[i] = NULL;
-        addressDescriptors[i].boundMemAddress = NULL;
-        setClear(addressDescriptors[i].currentAddresses);
-    }
-    indexAddrDesc = 0;
-    for (int i = 0; i < MAX_REGISTERS; i++) {
-        setClear(registerDescriptors[i].variables);
+        const char* reg = findVarReg(i);
+        if (reg != NULL && addressDescriptors[i].isGlobal && needsStore(i)) {
+            storeVar(addrDescPairs[i], reg, asmContainer);
+        }
     }
-    
 }
 
-void manageResDescriptors(char* regX, char* res, AsmContainer* asmContainer) {
-    // 将寄存器 regX 的寄存器描述符更改为仅保存 res 
+// res 的值只在寄存器 regX 中。copy 为真时是 res = y，regX 中的 y 仍然有效（龙书8.6.2）
+static void bindResToReg(const char* regX, const char* res, bool copy) {
     int indexRegDesc = mapRegDesc(regX);
-    setClear(registerDescriptors[indexRegDesc].variables);
-    setAdd(registerDescriptors[indexRegDesc].variables, res);
-
-    int index = mapAddrDesc(res);
-    if (index != -1) {
-        // 从除 res 以外的任何变量的地址描述符中移除 regX
-        for (int i = 0; i < indexAddrDesc; i++) {
-            if(setHas(addressDescriptors[i].currentAddresses, regX)) {
-                setDelete(addressDescriptors[i].currentAddresses, regX);
-            }
+    if (!copy) {
+        setClear(registerDescriptors[indexRegDesc].variables);
+    }
+    // 从 res 原来所在的其他寄存器中移除 res
+    int index = mapAddrDesc((char*)res);
+    Set* currentAddresses = addressDescriptors[index].currentAddresses;
+    for (int i = 0; i < currentAddresses->size; i++) {
+        int other = mapRegDesc(currentAddresses->elements[i]);
+        if (other != -1 && other != indexRegDesc) {
+            setDelete(registerDescriptors[other].variables, (char*)res);
         }
-        // 更改 res 的地址描述符，使其唯一的存储位置为 regX
-        // 注意 res 的内存位置现在不在 res 的地址描述符中！
-        setClear(addressDescriptors[index].currentAddresses);
-        setAdd(addressDescriptors[index].currentAddresses, regX);
-    } else {
-        // 说明res是局部变量，需要分配内存
-        addressDescriptors[indexAddrDesc].boundMemAddress = res;
-        addressDescriptors[indexAddrDesc].currentAddresses = createSet();
-        setAdd(addressDescriptors[indexAddrDesc].currentAddresses, res);
-        addrDescPairs[indexAddrDesc] = res;
-        indexAddrDesc++;
-    }
-}
-
-void removePrefix(const char* input, char** labelType, char** funcName) {
-    // 查找第一个 '_' 字符
-    char* underscorePos = strchr(input, '_');
-    
-    if (underscorePos != NULL) {
-        // 计算前缀长度
-        size_t labelLength = underscorePos - input;
-        
-        // 为前缀分配内存并复制前缀部分
-        *labelType = (char*)malloc(labelLength + 1);  // +1 for null terminator
-        strncpy(*labelType, input, labelLength);
-        (*labelType)[labelLength] = '\0';  // 确保以 null 结尾
-        
-        // 将剩余部分作为 funcName
-        *funcName = strdup(underscorePos + 1);  // 复制下划线之后的部分
-    } else {
-        // 如果没有找到下划线，则 labelType 为 NULL，整个输入就是 funcName
-        *labelType = "";
-        *funcName = strdup(input);  // 复制整个字符串
+    }
+    // 更改 res 的地址描述符，使其唯一的存储位置为 regX
+    // 注意 res 的内存位置现在不在 res 的地址描述符中！
+    setClear(currentAddresses);
+    setAdd(currentAddresses, (char*)regX);
+    if (!setHas(registerDescriptors[indexRegDesc].variables, (char*)res)) {
+        setAdd(registerDescriptors[indexRegDesc].variables, (char*)res);
     }
 }
 
-// 根据中间代码生成RISC-V汇编代码
-void generateASM(AsmContainer *asmContainer) {
-    TACList* temp = tacHead;
-    while (temp) {
-        char* op = temp->tac->op;
-        char* arg1 = temp->tac->arg1;
-        char* arg2 = temp->tac->arg2;
-        char* res = temp->tac->res;
-
-        int binaryOp = (arg1 != NULL && *arg1 != '\0') && (arg2 != NULL && *arg2 != '\0');
-        int unaryOp = (arg1 != NULL && *arg1 != '\0') ^ (arg2 != NULL && *arg2 != '\0');
-
-        int irIndex = temp->tac->index;
-        // printf("IR%d: %s %s, %s, %s\n", irIndex, op, arg1, arg2, res);
-        if (strcmp(op, "call") == 0) {
-            // 分析函数名
-            char* funcName = arg1;
-            int funcIndex = mapStackInfo(funcName);
-            // printf("Calling function %s\n", funcName);
-            int paramNum = findSymbol(funcName)->paramNum;
-
-            for (int argNum = 0; argNum < paramNum; argNum++) {
-                char* actualArg = findSymbol(funcName)->params[argNum]->id;
-                AddressDescriptor ad = addressDescriptors[mapAddrDesc(actualArg)];
-                if (ad.currentAddresses == NULL || ad.currentAddresses->size == 0) {
-                    assert("Actual argument does not have current address");
-                } else {
-                    char* regLoc = NULL;
-                    char* memLoc = NULL;
-                    for (int i = 0; i < ad.currentAddresses->size; i++) {
-                        char* addr = ad.currentAddresses->elements[i];
-                        if (*addr == 'x') {
-                            // register has higher priority
-                            regLoc = strdup(addr);
-                            break;
-                        } else {
-                            memLoc = strdup(addr);
-                        }
-                    }
+void manageResDescriptors(const char* regX, const char* res) {
+    // 将寄存器 regX 的寄存器描述符更改为仅保存 res
+    bindResToReg(regX, res, false);
+}
 
-                    if (regLoc != NULL) {
-                        if (argNum < 4) {
-                            char buffer[100];
-                            snprintf(buffer, sizeof(buffer), "mv a%d, %s", argNum, regLoc);
-                            newAsm(asmContainer, buffer);
-                        } else {
-                            char buffer[100];
-                            snprintf(buffer, sizeof(buffer), "sw %s, %d(sp)", regLoc, 4 * argNum);
-                            newAsm(asmContainer, buffer);
-                        }
-                        free(regLoc);
-                    } else {
-                        if (argNum < 4) {
-                            char buffer[100];
-                            snprintf(buffer, sizeof(buffer), "lw a%d, %s", argNum, memLoc);
-                            newAsm(asmContainer, buffer);
-                            newAsm(asmContainer, "nop");
-                            newAsm(asmContainer, "nop");
-                        } else {
-                            char buffer[100];
-                            snprintf(buffer, sizeof(buffer), "lw a1, %s", memLoc);
-                            newAsm(asmContainer, buffer);
-                            newAsm(asmContainer, "nop");
-                            newAsm(asmContainer, "nop");
-                            snprintf(buffer, sizeof(buffer), "sw a1, %d(sp)", 4 * argNum);
-                            newAsm(asmContainer, buffer);
-                        }
-                        free(memLoc);
-                    }
-                }
-            }
+// 生成函数序言：分配栈帧，保存 ra 和需要保存的 s 寄存器
+// 栈帧从高到低依次为 ra、保存的 s 寄存器、局部数据、溢出区、出栈参数
+void emitPrologue(AsmContainer* asmContainer, StackFrameInfo* frameInfo) {
+    char buffer[100];
+    int savedBase = frameInfo->wordSize - (frameInfo->isLeaf ? 0 : 1) - frameInfo->numGPRs2Save;
+    // 不需要栈的叶函数没有栈帧
+    if (frameInfo->wordSize == 0) return;
+    snprintf(buffer, sizeof(buffer), "addi sp, sp, -%d", 4 * frameInfo->wordSize);
+    newAsm(asmContainer, buffer);
+
+    if (!frameInfo->isLeaf) {
+        snprintf(buffer, sizeof(buffer), "sw ra, %d(sp)", 4 * (frameInfo->wordSize - 1));
+        newAsm(asmContainer, buffer);
+    }
 
-            for (int i = 0; i < indexAddrDesc; i++) {
-                char* key = addrDescPairs[i];
-                AddressDescriptor ad = addressDescriptors[i];
-                char* boundMemAddress = ad.boundMemAddress;
-                Set* currentAddresses = ad.currentAddresses;
-                if (boundMemAddress != NULL && !setHas(currentAddresses, boundMemAddress)) {
-                    // need to write this back to its bound memory location
-                    if (currentAddresses->size > 0) {
-                        for (int j = 0; j < currentAddresses->size; j++) {
-                            char* addr = currentAddresses->elements[j];
-                            if (*addr == 'x') {
-                                char buffer[100];
-                                snprintf(buffer, sizeof(buffer), "sw %s, %s", addr, boundMemAddress);
-                                newAsm(asmContainer, buffer);
-                                break;
-                            }
-                        }
-                    } else {
-                        assert("Attempted to store a ghost variable");
-                    }
-                }
-            }
+    // 只保存 savedRegMask 中的 s 寄存器，依次放在保存区中
+    int saved = 0;
+    for (int index = 0; index < 32; index++) {
+        if (!(frameInfo->savedRegMask & (1u << index))) continue;
+        snprintf(buffer, sizeof(buffer), "sw s%d, %d(sp)", index, 4 * (savedBase + saved));
+        newAsm(asmContainer, buffer);
+        saved++;
+    }
+}
 
-            char buffer[100];
-            snprintf(buffer, sizeof(buffer), "jal %s", arg1);
-            newAsm(asmContainer, buffer);
-            newAsm(asmContainer, "nop");
-
-            // 清除临时变量
-            for (int i = 0; i < indexAddrDesc; i++) {
-                char* key = addrDescPairs[i];
-                AddressDescriptor ad = addressDescriptors[i];
-                for (int j = 0; j < ad.currentAddresses->size; j++) {
-                    char* addr = ad.currentAddresses->elements[j];
-                    if (*addr == 'x') {
-                        setDelete(ad.currentAddresses, addr);
-                        RegisterDescriptor rd = registerDescriptors[mapRegDesc(addr)];
-                        if (rd.variables != NULL) {
-                            setDelete(rd.variables, key);
-                        }
-                    }
-                }
-            }
+// 恢复 s 寄存器和 ra，释放栈帧
+static void emitFrameTeardown(AsmContainer* asmContainer, StackFrameInfo* frameInfo) {
+    char buffer[100];
+    int savedBase = frameInfo->wordSize - (frameInfo->isLeaf ? 0 : 1) - frameInfo->numGPRs2Save;
+    int saved = 0;
+    for (int index = 0; index < 32; index++) {
+        if (!(frameInfo->savedRegMask & (1u << index))) continue;
+        snprintf(buffer, sizeof(buffer), "lw s%d, %d(sp)", index, 4 * (savedBase + saved));
+        newAsm(asmContainer, buffer);
+        newAsm(asmContainer, "nop");
+        newAsm(asmContainer, "nop");
+        saved++;
+    }
 
-            if (res != NULL && *res != '\0') {
-                char* regX;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regX = regs[0];
-                sprintf(buffer, "mv %s, a0", regX);
-                newAsm(asmContainer, buffer);
-                manageResDescriptors(regX, res, asmContainer);
-                free(regX);
-            }
-        } else if (binaryOp) {
-            if (strcmp(op, "=[]") == 0) {
-                char* regY, *regZ;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regY = regs[0];
-                regZ = regs[1];
-                char buffer[100];
-                sprintf(buffer, "move a1, %s", regY);
-                newAsm(asmContainer, buffer);
-                newAsm(asmContainer, "sll a1, a1, 2");
-                int index = mapAddrDesc(arg1);
-                char* baseAddr = addressDescriptors[index].boundMemAddress;
-                char buffer2[100];
-                snprintf(buffer, sizeof(buffer2), "sw %s, %s(a1)", regZ, baseAddr);
-                newAsm(asmContainer, buffer2);
-                free(regY);
-                free(regZ);
-            } else if (strcmp(op, "[]=") == 0) {
-                char* regZ, *regX;
-                char buffer[100];
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regZ = regs[0];
-                regX = regs[1];
-                newAsm(asmContainer, "move $v1, regZ");
-                newAsm(asmContainer, "sll $v1, $v1, 2");
-                int index = mapAddrDesc(arg1);
-                char* baseAddr = addressDescriptors[index].boundMemAddress;
-                snprintf(buffer, sizeof(buffer), "lw %s, %s($v1)", regX, baseAddr);
-                newAsm(asmContainer, buffer);
-                newAsm(asmContainer, "nop");
-                newAsm(asmContainer, "nop");
-                manageResDescriptors(regX, res, asmContainer);
-                free(regZ);
-                free(regX);
-            } else if (strcmp(op, "=$") == 0) {
-                char* regY, *regZ;
-                char buffer[100];
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regs[0] = regY;
-                regs[1] = regZ;
-                snprintf(buffer, sizeof(buffer), "sw %s, 0(%s)", regZ, regY);
-                newAsm(asmContainer, buffer);
-                free(regY);
-                free(regZ);
-            } else if (strcmp(op, "$=") == 0) {
-                char* regY;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                char buffer[100];
-                regY = regs[0];
-                // Add res to the register descriptor for regY
-                int index = mapRegDesc(regY);
-                if (registerDescriptors[index].variables != NULL) {
-                    setAdd(registerDescriptors[index].variables, res);
-                }
+    if (!frameInfo->isLeaf) {
+        snprintf(buffer, sizeof(buffer), "lw ra, %d(sp)", 4 * (frameInfo->wordSize - 1));
+        newAsm(asmContainer, buffer);
+        newAsm(asmContainer, "nop");
+        newAsm(asmContainer, "nop");
+    }
 
-                // Change the address descriptor for res so that its only location is regY
-                int index2 = mapAddrDesc(res);
-                if (addressDescriptors[index2].currentAddresses->size != 0) {
-                    setClear(addressDescriptors[index2].currentAddresses);
-                    setAdd(addressDescriptors[index2].currentAddresses, regY);
-                } else {
-                    // temporary variable
-                    addressDescriptors[indexAddrDesc].boundMemAddress = NULL;
-                    addressDescriptors[indexAddrDesc].currentAddresses = createSet();
-                    setAdd(addressDescriptors[indexAddrDesc].currentAddresses, regY);
-                    addrDescPairs[indexAddrDesc] = res;
-                    indexAddrDesc++;
-                }
-                free(regY);
-            } else if (strcmp(op, "alloc_global") == 0) {
-                // printf("Warning: alloc_global is not implemented.\n");
-            } else if (strcmp(op, "alloc") == 0) {
-                char* regX;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regX = regs[0];
-                char buffer[100];
-                
-                // 从 arg1 解析出变量类型大小
-                int size = atoi(arg1);  // 获取变量大小，单位字节
-                int numWords = (size + WORD_LENGTH_BYTE - 1) / WORD_LENGTH_BYTE;  // 计算需要的字数
-                
-                // 计算栈空间偏移量
-                int offset = WORD_LENGTH_BYTE * 1;
-                
-                // 生成 RISC-V 汇编代码：调整栈指针并为局部变量分配内存
-                snprintf(buffer, sizeof(buffer), "addi %s, sp, %d", regX, offset);
-                
-                // 将生成的汇编代码存储到适当的位置
-                newAsm(asmContainer, buffer);
-            } else {
-                char* regY, *regZ, *regX;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regY = regs[0];
-                regZ = regs[1];
-                regX = regs[2];
-                if (strcmp(op, "or") == 0 || strcmp(op, "and") == 0 || strcmp(op, "<") == 0 ||
-                    strcmp(op, "+") == 0 || strcmp(op, "-") == 0 || strcmp(op, "&") == 0 ||
-                    strcmp(op, "|") == 0 || strcmp(op, "^") == 0 || strcmp(op, "<<") == 0 ||
-                    strcmp(op, ">>") == 0 || strcmp(op, "==") == 0 || strcmp(op, "!=") == 0 ||
-                    strcmp(op, ">") == 0 || strcmp(op, ">=") == 0 || strcmp(op, "<=") == 0 ||
-                    strcmp(op, "*") == 0 || strcmp(op, "/") == 0 || strcmp(op, "%%") == 0) {
-                    char buffer[100];
-                    if (strcmp(op, "|") == 0 || strcmp(op, "or") == 0) {
-                        snprintf(buffer, sizeof(buffer), "or %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "&") == 0 || strcmp(op, "and") == 0) {
-                        snprintf(buffer, sizeof(buffer), "and %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "^") == 0) {
-                        snprintf(buffer, sizeof(buffer), "xor %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "+") == 0) {
-                        snprintf(buffer, sizeof(buffer), "add %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "-") == 0) {
-                        snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "<<") == 0) {
-                        snprintf(buffer, sizeof(buffer), "sllv %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, ">>") == 0) {
-                        snprintf(buffer, sizeof(buffer), "srlv %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "==") == 0) {
-                        snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                        snprintf(buffer, sizeof(buffer), "sltu %s, $zero, %s", regX, regX);
-                        newAsm(asmContainer, buffer);
-                        snprintf(buffer, sizeof(buffer), "xori %s, %s, 1", regX, regX);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "!=") == 0) {
-                        snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "<") == 0) {
-                        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, ">") == 0) {
-                        // if (regY != NULL) {printf("Error: regX is NULL in > operation.\n");}
-                        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regX, regZ, regY);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, ">=") == 0) {
-                        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regX, regY, regZ);
-                        newAsm(asmContainer, buffer);
-                        snprintf(buffer, sizeof(buffer), "xori %s, %s, 1", regX, regX);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "<=") == 0) {
-                        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regX, regZ, regY);
-                        newAsm(asmContainer, buffer);
-                        snprintf(buffer, sizeof(buffer), "xori %s, %s, 1", regX, regX);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "*") == 0) {
-                        snprintf(buffer, sizeof(buffer), "mult %s, %s", regY, regZ);
-                        newAsm(asmContainer, buffer);
-                        snprintf(buffer, sizeof(buffer), "mflo %s", regX);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "/") == 0) {
-                        snprintf(buffer, sizeof(buffer), "div %s, %s", regY, regZ);
-                        newAsm(asmContainer, buffer);
-                        snprintf(buffer, sizeof(buffer), "mflo %s", regX);
-                        newAsm(asmContainer, buffer);
-                    } else if (strcmp(op, "%%") == 0) {
-                        snprintf(buffer, sizeof(buffer), "div %s, %s", regY, regZ);
-                        newAsm(asmContainer, buffer);
-                        snprintf(buffer, sizeof(buffer), "mfhi %s", regX);
-                        newAsm(asmContainer, buffer);
-                    }
-                    manageResDescriptors(regX, res, asmContainer);
-                    free(regY);
-                    free(regZ);
-                    free(regX);
-                }
-            }
-        } else if (unaryOp) {
-            if (strcmp(op, "ifFalseGoto") == 0) {
-                char* regY;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regY = regs[0];
-                char buffer[100];
-                deallocateProcMemory(asmContainer);
-                snprintf(buffer, sizeof(buffer), "beq %s, zero, %s", regY, res);
-                newAsm(asmContainer, buffer);
-                newAsm(asmContainer, "nop"); // delay-slot
-                free(regY);
-            } else if (strcmp(op, "ifGoto") == 0) {
-                char* regY;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regY = regs[0];
-                char buffer[100];
-                deallocateProcMemory(asmContainer);
-                snprintf(buffer, sizeof(buffer), "bne %s, zero, %s", regY, res);
-                newAsm(asmContainer, buffer);
-                newAsm(asmContainer, "nop"); // delay-slot
-                free(regY);
-            } else if (strcmp(op, "=") == 0) {
-                // printf("111");
-                char* regX;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regX = regs[0];
-                char buffer[100];
-                int immediateNum = atoi(arg1);
-                if (immediateNum <= 32767 && immediateNum >= -32768) {
-                    snprintf(buffer, sizeof(buffer), "addi %s, zero, %d", regX, immediateNum);
-                    newAsm(asmContainer, buffer);
-                } else {
-                    int lowerHalf = immediateNum & 0x0000ffff;
-                    int higherHalf = immediateNum >> 16;
-                    snprintf(buffer, sizeof(buffer), "lui %s, %d", regX, higherHalf);
-                    newAsm(asmContainer, buffer);
-                    snprintf(buffer, sizeof(buffer), "ori %s, %s, %d", regX, regX, lowerHalf);
-                    newAsm(asmContainer, buffer);
-                }
-                manageResDescriptors(regX, res, asmContainer);
-                free(regX);
-            } else if (strcmp(op, "label") == 0) {
-                char buffer[100];
-                // parse the label to identify type
-                char* labelType = NULL; // func_{funcName} or end_func
-                char* funcName = NULL; // funcName
-                removePrefix(arg1, &labelType, &funcName);
-                int index = mapStackInfo(funcName);
-                // printf("labeltype: %s, funcName: %s, index: %d\n", labelType, funcName, index);
-                if (strcmp(labelType, "func") == 0) {
-                    StackFrameInfo currFrameInfo = stackFrameInfos[index];
-                    snprintf(buffer, sizeof(buffer), "%s:", funcName);
-                    newAsm(asmContainer, buffer);
-                    snprintf(buffer, sizeof(buffer), "addi sp, sp, -%d", 4 * currFrameInfo.wordSize);
-                    newAsm(asmContainer, buffer);
-
-                    if (!currFrameInfo.isLeaf) {
-                        newAsm(asmContainer, "sw ra, -4(sp)");
-                    }
+    if (frameInfo->wordSize != 0) {
+        snprintf(buffer, sizeof(buffer), "addi sp, sp, %d", 4 * frameInfo->wordSize);
+        newAsm(asmContainer, buffer);
+    }
+}
 
-                    for (int index = 0; index < currFrameInfo.numGPRs2Save; index++) {
-                        snprintf(buffer, sizeof(buffer), "sw s%d, %d(sp)", index, 4 * (currFrameInfo.wordSize - currFrameInfo.numGPRs2Save + index));
-                        newAsm(asmContainer, buffer);
-                    }
+// 生成函数尾声：恢复 s 寄存器和 ra，释放栈帧并返回
+void emitEpilogue(AsmContainer* asmContainer, StackFrameInfo* frameInfo) {
+    emitFrameTeardown(asmContainer, frameInfo);
+    newAsm(asmContainer, "jr ra");
+    newAsm(asmContainer, "nop");
+}
 
-                    allocateProcMemory(asmContainer, index, funcName);
-                } else if (strcmp(labelType, "end") == 0) {
-                    deallocateProcMemory(asmContainer);
-                } else {
-                    char buffer[100];
-                    snprintf(buffer, sizeof(buffer), "%s:", arg1);
-                    newAsm(asmContainer, buffer);
-                }
-            } else if (strcmp(op, "param") == 0) { // 还没写
-                // char* regX;
-                // char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                // regX = regs[0];
-                // char buffer[100];
-                // int index = mapRegDesc(regX);
-                // if (regX != NULL && !setHas(registerDescriptors[index].variables, arg1)) {
-                //     loadVar(arg1, regX, asmContainer);
-                // }
-                // manageResDescriptors(regX, res, asmContainer);
-                // free(regX);
-            } else if (strcmp(op, "~") == 0 || strcmp(op, "-") == 0 || strcmp(op, "+") == 0) {
-                char* regY, *regX;
-                char** regs = getRegs(temp->tac, irIndex, asmContainer);
-                regY = regs[0];
-                regX = regs[1];
-                char buffer[100];
-                int index = mapRegDesc(regY);
-                if (regY != NULL && !setHas(registerDescriptors[index].variables, arg1)) {
-                    loadVar(arg1, regY, asmContainer);
-                }
+// 尾调用：先释放自己的栈帧再跳到被调用者，被调用者直接返回到调用者的调用者
+void emitTailCall(AsmContainer* asmContainer, StackFrameInfo* frameInfo, const char* funcName) {
+    char buffer[100];
+    emitFrameTeardown(asmContainer, frameInfo);
+    snprintf(buffer, sizeof(buffer), "j %s", funcName);
+    newAsm(asmContainer, buffer);
+    newAsm(asmContainer, "nop");
+}
 
-                if (strcmp(op, "NOT_OP") == 0) {
-                    snprintf(buffer, sizeof(buffer), "xor %s, $zero, %s", regX, regY);
-                    newAsm(asmContainer, buffer);
-                } else if (strcmp(op, "MINUS") == 0) {
-                    snprintf(buffer, sizeof(buffer), "sub %s, $zero, %s", regX, regY);
-                    newAsm(asmContainer, buffer);
-                } else if (strcmp(op, "PLUS") == 0) {
-                    snprintf(buffer, sizeof(buffer), "move %s, %s", regX, regY);
-                    newAsm(asmContainer, buffer);
-                } else if (strcmp(op, "BITINV_OP") == 0) {
-                    snprintf(buffer, sizeof(buffer), "nor %s, %s, %s", regX, regY, regY);
-                    newAsm(asmContainer, buffer);
-                }
+// 访存指令的结果在之后 LOAD_DELAY 条指令中还不能读。-O0 不做调度，这里先放 nop，scheduleDelaySlots 会删掉它们重新排列
+void emitLoad(AsmContainer* asmContainer, const char* instr) {
+    newAsm(asmContainer, instr);
+    for (int i = 0; i < LOAD_DELAY; ++i) {
+        newAsm(asmContainer, "nop");
+    }
+}
 
-                manageResDescriptors(regX, res, asmContainer);
-                free(regY);
-                free(regX);
-            }       
-        } else {
-            if (strcmp(op, "return") == 0) {  
-                if (res != NULL) { // 存疑
-                    int index2 = mapAddrDesc(res);
-                    addressDescriptors[index2].boundMemAddress = NULL;
-                    if (addressDescriptors[index2].currentAddresses == NULL || addressDescriptors[index2].currentAddresses->size == 0) {
-                        assert("Return value does not have current address");
-                    } else {
-                        char* regLoc = NULL;
-                        char* memLoc = NULL;
-                        for (int i = 0; i < addressDescriptors[index2].currentAddresses->size; i++) {
-                            char* addr = addressDescriptors[index2].currentAddresses->elements[i];
-                            if (addr[0] == 'x') {
-                                // register has higher priority
-                                regLoc = strdup(addr);
-                                break;
-                            } else {
-                                memLoc = strdup(addr);
-                            }
-                        }
-
-                        char buffer[100];
-                        if (regLoc != NULL) {
-                            snprintf(buffer, sizeof(buffer), "mv a0, %s", regLoc);
-                            newAsm(asmContainer, buffer);
-                            free(regLoc);
-                        } else {
-                            snprintf(buffer, sizeof(buffer), "lw a0, %s", memLoc);
-                            newAsm(asmContainer, buffer);
-                            newAsm(asmContainer, "nop");
-                            newAsm(asmContainer, "nop");
-                            free(memLoc);
-                        }
-                    }
+// regX = value，超出 16 位的立即数用 lui + ori
+void emitLoadImmediate(AsmContainer* asmContainer, const char* regX, int value) {
+    char buffer[100];
+    if (value <= 32767 && value >= -32768) {
+        snprintf(buffer, sizeof(buffer), "addi %s, zero, %d", regX, value);
+        newAsm(asmContainer, buffer);
+    } else {
+        int lowerHalf = value & 0x0000ffff;
+        int higherHalf = (value >> 16) & 0x0000ffff;
+        snprintf(buffer, sizeof(buffer), "lui %s, %d", regX, higherHalf);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "ori %s, %s, %d", regX, regX, lowerHalf);
+        newAsm(asmContainer, buffer);
+    }
+}
 
-                    deallocateProcMemory(asmContainer);
+// regX = regY op regZ。regX 可以和 regY 或 regZ 相同，因此每条指令序列都先读完源操作数再写 regX
+void emitBinaryOp(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY, const char* regZ) {
+    char buffer[100];
+    switch (op) {
+    case TAC_BIT_OR:
+        snprintf(buffer, sizeof(buffer), "or %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_BIT_AND:
+        snprintf(buffer, sizeof(buffer), "and %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_BIT_XOR:
+        snprintf(buffer, sizeof(buffer), "xor %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_ADD:
+        snprintf(buffer, sizeof(buffer), "add %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_SUB:
+        snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_SHL:
+        snprintf(buffer, sizeof(buffer), "sllv %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_SHR:
+        snprintf(buffer, sizeof(buffer), "srlv %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_EQ:
+        snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "sltu %s, zero, %s", regX, regX);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "xori %s, %s, 1", regX, regX);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_NE:
+        snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "sltu %s, zero, %s", regX, regX);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_LT:
+        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_GT:
+        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regX, regZ, regY);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_GE:
+        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "xori %s, %s, 1", regX, regX);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_LE:
+        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regX, regZ, regY);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "xori %s, %s, 1", regX, regX);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_AND:
+        // a1 只在传参时使用，这里用作临时寄存器
+        snprintf(buffer, sizeof(buffer), "sltu a1, zero, %s", regY);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "sltu %s, zero, %s", regX, regZ);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "and %s, %s, a1", regX, regX);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_OR:
+        snprintf(buffer, sizeof(buffer), "or %s, %s, %s", regX, regY, regZ);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "sltu %s, zero, %s", regX, regX);
+        newAsm(asmContainer, buffer);
+        break;
+    case TAC_MUL: case TAC_DIV: case TAC_MOD:
+        // 没有乘除法指令，调用运行时子程序，见 muldiv.c
+        emitMulDivCall(asmContainer, op, regX, regY, regZ);
+        break;
+    default:
+        fprintf(stderr, "Unknown binary operator: %s\n", getTACOpName(op));
+    }
+}
 
-                    char buffer[100];
-                    // assert(currentFrameInfo != NULL, "Undefined frame info");
-                    for (int index = 0; index < stackFrameInfos[indexStackFrameInfos].numGPRs2Save; index++) {
-                        snprintf(buffer, sizeof(buffer), "lw s%d, %d(sp)", index, 4 * (stackFrameInfos[indexStackFrameInfos].wordSize - stackFrameInfos[indexStackFrameInfos].numGPRs2Save + index));
-                        newAsm(asmContainer, buffer);
-                        newAsm(asmContainer, "nop");
-                        newAsm(asmContainer, "nop");
-                    }
+// if== 等比较转移四元式：相等比较直接用 beq/bne，大小比较先用 slt 算到 regTmp 再和 zero 比较。
+// regTmp 可以和 regY 或 regZ 相同
+void emitCompareBranch(AsmContainer* asmContainer, TACOpcode op, const char* regY, const char* regZ, const char* regTmp, const char* label) {
+    char buffer[100];
+    if (op == TAC_IF_EQ || op == TAC_IF_NE) {
+        snprintf(buffer, sizeof(buffer), "%s %s, %s, %s", op == TAC_IF_EQ ? "beq" : "bne", regY, regZ, label);
+        newAsm(asmContainer, buffer);
+    } else {
+        // a > b 即 b < a，a >= b 即 !(a < b)，a <= b 即 !(b < a)
+        bool swap = op == TAC_IF_GT || op == TAC_IF_LE;
+        bool negate = op == TAC_IF_GE || op == TAC_IF_LE;
+        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", regTmp, swap ? regZ : regY, swap ? regY : regZ);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "%s %s, zero, %s", negate ? "beq" : "bne", regTmp, label);
+        newAsm(asmContainer, buffer);
+    }
+    newAsm(asmContainer, "nop"); // delay-slot
+}
 
-                    if (!stackFrameInfos[indexStackFrameInfos].isLeaf) {
-                        newAsm(asmContainer, "lw ra, -4(sp)");
-                        newAsm(asmContainer, "nop");
-                        newAsm(asmContainer, "nop");
-                    }
+// regX = op regY
+void emitUnaryOp(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY) {
+    char buffer[100];
+    switch (op) {
+    case TAC_NOT:
+        snprintf(buffer, sizeof(buffer), "sltiu %s, %s, 1", regX, regY);
+        break;
+    case TAC_SUB:
+        snprintf(buffer, sizeof(buffer), "sub %s, zero, %s", regX, regY);
+        break;
+    case TAC_ADD:
+        snprintf(buffer, sizeof(buffer), "move %s, %s", regX, regY);
+        break;
+    case TAC_BIT_NOT:
+        snprintf(buffer, sizeof(buffer), "nor %s, %s, %s", regX, regY, regY);
+        break;
+    default:
+        fprintf(stderr, "Unknown unary operator: %s\n", getTACOpName(op));
+        return;
+    }
+    newAsm(asmContainer, buffer);
+}
 
-                    snprintf(buffer, sizeof(buffer), "addi sp, sp, %d", 4 * stackFrameInfos[indexStackFrameInfos].wordSize);
-                    newAsm(asmContainer, buffer);
-                    newAsm(asmContainer, "jr ra");
-                    newAsm(asmContainer, "nop");
-                } else {
-                    for (int index = 0; index < stackFrameInfos[indexStackFrameInfos].numGPRs2Save; index++) {
-                        char buffer[100];
-                        snprintf(buffer, sizeof(buffer), "lw s%d, %d(sp)", index, 4 * (stackFrameInfos[indexStackFrameInfos].wordSize - stackFrameInfos[indexStackFrameInfos].numGPRs2Save + index));
-                        newAsm(asmContainer, buffer);
-                        newAsm(asmContainer, "nop");
-                        newAsm(asmContainer, "nop");
-                    }
+// 计算 arr[idx] 的地址，把访存操作数（如 8(x31)）写入 memLoc。会用到两个临时寄存器
+static void emitLocalElementAddress(AsmContainer* asmContainer, const char* arr, const char* idx, char* memLoc, size_t size) {
+    char buffer[100];
+    const char* regIdx = useLocalOperand(asmContainer, idx, SCRATCH_REG2, NULL);
+    snprintf(buffer, sizeof(buffer), "sll %s, %s, 2", SCRATCH_REG2, regIdx);
+    newAsm(asmContainer, buffer);
+
+    int index = mapAddrDesc((char*)arr);
+    if (addressDescriptors[index].isArray && addressDescriptors[index].isGlobal) {
+        snprintf(memLoc, size, "%s(%s)", arr, SCRATCH_REG2);
+    } else if (addressDescriptors[index].isArray) {
+        snprintf(buffer, sizeof(buffer), "add %s, %s, sp", SCRATCH_REG2, SCRATCH_REG2);
+        newAsm(asmContainer, buffer);
+        snprintf(memLoc, size, "%d(%s)", atoi(addressDescriptors[index].boundMemAddress), SCRATCH_REG2);
+    } else {
+        // 数组参数，变量的值是数组首地址
+        const char* regBase = useLocalOperand(asmContainer, arr, SCRATCH_REG1, NULL);
+        snprintf(buffer, sizeof(buffer), "add %s, %s, %s", SCRATCH_REG2, SCRATCH_REG2, regBase);
+        newAsm(asmContainer, buffer);
+        snprintf(memLoc, size, "0(%s)", SCRATCH_REG2);
+    }
+}
 
-                    if (!stackFrameInfos[indexStackFrameInfos].isLeaf) {
-                        char buffer[100];
-                        snprintf(buffer, sizeof(buffer), "lw ra, %d(sp)", 4 * (stackFrameInfos[indexStackFrameInfos].wordSize - 1));
-                        newAsm(asmContainer, "nop");
-                        newAsm(asmContainer, "nop");
-                    }
-                    char buffer[100];
-                    snprintf(buffer, sizeof(buffer), "addi sp, sp, %d", 4 * stackFrameInfos[indexStackFrameInfos].wordSize);
-                    newAsm(asmContainer, buffer);
-                    newAsm(asmContainer, "jr ra");
-                    newAsm(asmContainer, "nop");
-                }
+// (&[], arr, idx, res)：res = arr 的首地址 + idx * 4
+static void emitLocalElementPointer(AsmContainer* asmContainer, TAC* tac) {
+    char buffer[100];
+    const char* regIdx = useLocalOperand(asmContainer, tac->arg2, SCRATCH_REG2, NULL);
+    snprintf(buffer, sizeof(buffer), "sll %s, %s, 2", SCRATCH_REG2, regIdx);
+    newAsm(asmContainer, buffer);
+
+    int index = mapAddrDesc(tac->arg1);
+    const char* regX;
+    if (addressDescriptors[index].isArray && addressDescriptors[index].isGlobal) {
+        regX = allocateResultReg(tac->res, NULL, NULL, asmContainer);
+        snprintf(buffer, sizeof(buffer), "addi %s, %s, %s", regX, SCRATCH_REG2, tac->arg1);
+    } else if (addressDescriptors[index].isArray) {
+        regX = allocateResultReg(tac->res, NULL, NULL, asmContainer);
+        snprintf(buffer, sizeof(buffer), "add %s, %s, sp", regX, SCRATCH_REG2);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "addi %s, %s, %d", regX, regX, atoi(addressDescriptors[index].boundMemAddress));
+    } else {
+        // 数组参数，变量的值是数组首地址
+        const char* regBase = useLocalOperand(asmContainer, tac->arg1, SCRATCH_REG1, NULL);
+        regX = allocateResultReg(tac->res, regBase, NULL, asmContainer);
+        snprintf(buffer, sizeof(buffer), "add %s, %s, %s", regX, SCRATCH_REG2, regBase);
+    }
+    newAsm(asmContainer, buffer);
+    manageResDescriptors(regX, tac->res);
+}
 
-            } else if (strcmp(op, "goto") == 0) {
-                deallocateProcMemory(asmContainer);
-                char buffer[100];
-                snprintf(buffer, sizeof(buffer), "jal %s", res);
-                newAsm(asmContainer, buffer);
-                newAsm(asmContainer, "nop"); // delay-slot
-            }
+// 乘除法：有常数操作数时尽量用移位和加减，否则调用运行时子程序，见 muldiv.c
+static void emitLocalMulDiv(AsmContainer* asmContainer, TAC* tac) {
+    const char* var = tac->arg1;
+    const char* constant = tac->arg2;
+    if (!isConstant(constant) && tac->op == TAC_MUL && isConstant(tac->arg1)) {
+        var = tac->arg2;
+        constant = tac->arg1;
+    }
+    const char* regX;
+    if (isConstant(constant)) {
+        // 变量放在 x30 中，x31 留给转换后的指令序列
+        const char* regY = useLocalOperand(asmContainer, var, SCRATCH_REG1, NULL);
+        regX = allocateResultReg(tac->res, regY, NULL, asmContainer);
+        if (!emitMulDivConst(asmContainer, tac->op, regX, regY, (int)strtol(constant, NULL, 0))) {
+            // 展开比调用更长，只有乘法会这样，交换操作数不影响结果
+            const char* regZ = useLocalOperand(asmContainer, constant, SCRATCH_REG2, regY);
+            emitMulDivCall(asmContainer, tac->op, regX, regY, regZ);
         }
+    } else {
+        const char* regY = useLocalOperand(asmContainer, tac->arg1, SCRATCH_REG1, NULL);
+        const char* regZ = useLocalOperand(asmContainer, tac->arg2, SCRATCH_REG2, regY);
+        regX = allocateResultReg(tac->res, regY, regZ, asmContainer);
+        emitMulDivCall(asmContainer, tac->op, regX, regY, regZ);
+    }
+    manageResDescriptors(regX, tac->res);
+}
 
-        if (strcmp(op, "label") != 0 && strcmp(op, "goto") != 0 && strcmp(op, "ifFalseGoto") != 0) {
-            deallocateProcMemory(asmContainer);
+static void emitLocalCall(AsmContainer* asmContainer, TAC* tac) {
+    char buffer[100];
+    // 实参由前面的 param 收集，见 docs/quaternary.md 的调用约定
+    // 先把多出的参数写到出栈参数区，再把前 8 个参数放到 a0-a7 中
+    for (int argNum = ARG_REG_NUM; argNum < pendingLocalArgNum; argNum++) {
+        const char* reg = useLocalOperand(asmContainer, pendingLocalArgs[argNum], SCRATCH_REG1, NULL);
+        snprintf(buffer, sizeof(buffer), "sw %s, %d(sp)", reg, WORD_LENGTH_BYTE * (argNum - ARG_REG_NUM));
+        newAsm(asmContainer, buffer);
+    }
+    for (int argNum = 0; argNum < pendingLocalArgNum && argNum < ARG_REG_NUM; argNum++) {
+        char argReg[4];
+        snprintf(argReg, sizeof(argReg), "a%d", argNum);
+        loadLocalOperand(asmContainer, pendingLocalArgs[argNum], argReg);
+    }
+    pendingLocalArgNum = 0;
+
+    // 被调用者可能读写全局变量，还会改写 t 寄存器：之后还会用到的变量都写回，调用之后从内存重新加载
+    deallocateProcMemory(asmContainer);
+    snprintf(buffer, sizeof(buffer), "jal %s", tac->arg1);
+    newAsm(asmContainer, buffer);
+    newAsm(asmContainer, "nop");
+    clearRegisters();
+
+    if (tac->res != NULL && *tac->res != '\0') {
+        const char* regX = allocateResultReg(tac->res, NULL, NULL, asmContainer);
+        snprintf(buffer, sizeof(buffer), "mv %s, a0", regX);
+        newAsm(asmContainer, buffer);
+        manageResDescriptors(regX, tac->res);
+    }
+}
+
+static void emitLocalLabel(AsmContainer* asmContainer, TAC* tac) {
+    char buffer[100];
+    if (strncmp(tac->arg1, "func_", 5) == 0) {
+        char* funcName = tac->arg1 + 5;
+        currentFrameIndex = mapStackInfo(funcName);
+        snprintf(buffer, sizeof(buffer), "%s:", funcName);
+        newAsm(asmContainer, buffer);
+        emitPrologue(asmContainer, &stackFrameInfos[currentFrameIndex]);
+        allocateProcMemory(asmContainer, currentFrameIndex, funcName);
+    } else if (strcmp(tac->arg1, "end_func") == 0) {
+        // 没有 return 的函数在结尾返回
+        if (!lastLocalWasReturn) {
+            storeGlobalVars(asmContainer);
+            emitEpilogue(asmContainer, &stackFrameInfos[currentFrameIndex]);
         }
+    } else {
+        // 上一个基本块落到这里，之后的值可能来自别的前驱
+        deallocateProcMemory(asmContainer);
+        clearRegisters();
+        snprintf(buffer, sizeof(buffer), "%s:", tac->arg1);
+        newAsm(asmContainer, buffer);
+    }
+}
 
-        // printf("111");
+// 逐语句分配（龙书8.6）：寄存器描述符和地址描述符记录每个变量的值在哪里，寄存器中的值只在基本块内有效
+static void generateTACLocal(AsmContainer* asmContainer, TAC* tac) {
+    // 数组元素的访存要放下指令名、寄存器和整个 memLoc
+    char buffer[128];
+    TACOpcode op = tac->op;
+    char* arg1 = tac->arg1;
+    char* arg2 = tac->arg2;
+    char* res = tac->res;
+    bool hasArg1 = arg1 != NULL && *arg1 != '\0';
+    bool hasArg2 = arg2 != NULL && *arg2 != '\0';
+
+    // 更新操作数的下次使用信息，供 allocateReg 判断变量之后是否还会被使用
+    advanceNextUse(tac);
+    switch (op) {
+    case TAC_LABEL:
+        emitLocalLabel(asmContainer, tac);
+        break;
+    case TAC_ALLOC:
+    case TAC_ALLOC_GLOBAL:
+        // 位置由 calcFrameInfo 和 allocateProcMemory 确定
+        break;
+    case TAC_PARAM:
+        // 实参在 call 时才放到 a0-a7 和出栈参数区中
+        if (pendingLocalArgNum >= MAX_CALL_ARGS) {
+            fprintf(stderr, "Too many arguments in a call.\n");
+            exit(1);
+        }
+        pendingLocalArgs[pendingLocalArgNum++] = arg1;
+        break;
+    case TAC_CALL:
+        emitLocalCall(asmContainer, tac);
+        break;
+    case TAC_RETURN:
+        if (res != NULL && *res != '\0') {
+            loadLocalOperand(asmContainer, res, "a0");
+        }
+        storeGlobalVars(asmContainer);
+        emitEpilogue(asmContainer, &stackFrameInfos[currentFrameIndex]);
+        clearRegisters();
+        break;
+    case TAC_GOTO:
+        deallocateProcMemory(asmContainer);
+        snprintf(buffer, sizeof(buffer), "j %s", res);
+        newAsm(asmContainer, buffer);
+        newAsm(asmContainer, "nop"); // delay-slot
+        break;
+    case TAC_IF_GOTO:
+    case TAC_IF_FALSE_GOTO: {
+        const char* regY = useLocalOperand(asmContainer, arg1, SCRATCH_REG1, NULL);
+        deallocateProcMemory(asmContainer);
+        snprintf(buffer, sizeof(buffer), "%s %s, zero, %s", op == TAC_IF_GOTO ? "bne" : "beq", regY, res);
+        newAsm(asmContainer, buffer);
+        newAsm(asmContainer, "nop"); // delay-slot
+        break;
+    }
+    case TAC_IF_EQ: case TAC_IF_NE: case TAC_IF_LT: case TAC_IF_LE: case TAC_IF_GT: case TAC_IF_GE: {
+        const char* regY = useLocalOperand(asmContainer, arg1, SCRATCH_REG1, NULL);
+        const char* regZ = useLocalOperand(asmContainer, arg2, SCRATCH_REG2, regY);
+        deallocateProcMemory(asmContainer);
+        emitCompareBranch(asmContainer, op, regY, regZ, SCRATCH_REG1, res);
+        break;
+    }
+    case TAC_ASSIGN: {
+        int index = mapAddrDesc(res);
+        if (addressDescriptors[index].isArray) {
+            // 数组初始化的赋值还没有按元素生成，忽略
+            break;
+        }
+        int indexArg = mapAddrDesc(arg1);
+        if (indexArg != -1 && !addressDescriptors[indexArg].isArray) {
+            // res 和 arg1 共用 arg1 所在的寄存器
+            const char* regY = useLocalOperand(asmContainer, arg1, SCRATCH_REG1, NULL);
+            if (strcmp(arg1, res) != 0) {
+                bindResToReg(regY, res, true);
+            }
+            break;
+        }
+        const char* regX = allocateResultReg(res, NULL, NULL, asmContainer);
+        loadLocalOperand(asmContainer, arg1, regX);
+        manageResDescriptors(regX, res);
+        break;
+    }
+    case TAC_READ_ADDR:
+    case TAC_LOAD: {
+        const char* regY = useLocalOperand(asmContainer, arg1, SCRATCH_REG2, NULL);
+        const char* regX = allocateResultReg(res, regY, NULL, asmContainer);
+        snprintf(buffer, sizeof(buffer), "lw %s, 0(%s)", regX, regY);
+        emitLoad(asmContainer, buffer);
+        manageResDescriptors(regX, res);
+        break;
+    }
+    case TAC_WRITE_ADDR:
+    case TAC_STORE: {
+        const char* regY = useLocalOperand(asmContainer, arg1, SCRATCH_REG1, NULL);
+        const char* regZ = useLocalOperand(asmContainer, res, SCRATCH_REG2, regY);
+        snprintf(buffer, sizeof(buffer), "sw %s, 0(%s)", regZ, regY);
+        newAsm(asmContainer, buffer);
+        break;
+    }
+    case TAC_LOAD_ELEM: {
+        char memLoc[100];
+        emitLocalElementAddress(asmContainer, arg1, arg2, memLoc, sizeof(memLoc));
+        const char* regX = allocateResultReg(res, NULL, NULL, asmContainer);
+        snprintf(buffer, sizeof(buffer), "lw %s, %s", regX, memLoc);
+        emitLoad(asmContainer, buffer);
+        manageResDescriptors(regX, res);
+        break;
+    }
+    case TAC_ELEM_ADDR:
+        emitLocalElementPointer(asmContainer, tac);
+        break;
+    case TAC_STORE_ELEM: {
+        char memLoc[100];
+        emitLocalElementAddress(asmContainer, res, arg1, memLoc, sizeof(memLoc));
+        const char* regZ = useLocalOperand(asmContainer, arg2, SCRATCH_REG1, NULL);
+        snprintf(buffer, sizeof(buffer), "sw %s, %s", regZ, memLoc);
+        newAsm(asmContainer, buffer);
+        break;
+    }
+    default:
+        if (hasArg1 && hasArg2 && isMulDivOp(op)) {
+            emitLocalMulDiv(asmContainer, tac);
+        } else if (hasArg1 && hasArg2) {
+            const char* regY = useLocalOperand(asmContainer, arg1, SCRATCH_REG1, NULL);
+            const char* regZ = useLocalOperand(asmContainer, arg2, SCRATCH_REG2, regY);
+            const char* regX = allocateResultReg(res, regY, regZ, asmContainer);
+            emitBinaryOp(asmContainer, op, regX, regY, regZ);
+            manageResDescriptors(regX, res);
+        } else if (hasArg1 || hasArg2) {
+            // 一元运算，负号的操作数在 arg2 中
+            const char* regY = useLocalOperand(asmContainer, hasArg1 ? arg1 : arg2, SCRATCH_REG1, NULL);
+            const char* regX = allocateResultReg(res, regY, NULL, asmContainer);
+            emitUnaryOp(asmContainer, op, regX, regY);
+            manageResDescriptors(regX, res);
+        } else {
+            fprintf(stderr, "Unknown TAC: ");
+            writeTAC(stderr, tac);
+            fputc('\n', stderr);
+        }
+    }
+    lastLocalWasReturn = op == TAC_RETURN;
+}
+
+// 根据中间代码生成RISC-V汇编代码
+void generateASM(AsmContainer *asmContainer) {
+    TACList* temp = tacHead;
+    while (temp) {
+        if (regAllocMode != REG_ALLOC_LOCAL) {
+            // 全局寄存器分配：变量在整个函数内位置固定，不需要寄存器描述符和地址描述符
+            generateTACGlobal(asmContainer, temp->tac);
+        } else {
+            generateTACLocal(asmContainer, temp->tac);
+        }
         temp = temp->next;
     }
 }
@@ -1377,8 +1315,10 @@ void generateASM(AsmContainer *asmContainer) {
 
 // 打印所有汇编代码
 void printAsm(AsmContainer* container) {
+    char line[MAX_LINE_LENGTH];
     for (size_t i = 0; i < container->size; i++) {
-        printf("%s\n", container->asmLines[i]);
+        formatInstr(&container->instrs[i], line, sizeof(line));
+        printf("%s\n", line);
     }
 }
 
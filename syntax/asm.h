@@ -2,7 +2,9 @@
 #define ASM_H
 
 #include <stdbool.h> // For 'bool', 'true', 'false'
+#include <stdio.h> // For 'FILE'
 #include "tac.h" // For 'TAC'
+#include "instr.h" // For 'Instr'
 
 /* Set start */
 typedef struct Set {
@@ -26,6 +28,7 @@ void setFree(Set* set);
 #define RAM_SIZE 65536 // bytes
 #define ROM_SIZE 65536 // bytes
 #define IO_MAX_ADDR 0xffffffff
+#define ARG_REG_NUM 8 // 用寄存器传递的参数个数，见下面的调用约定
 
 
 // 寄存器定义（根据提供的寄存器列表）
@@ -43,6 +46,15 @@ void setFree(Set* set);
     x12-x17 (a2-a7)：函数参数。
     x18-x27 (s2-s11)：保存寄存器。
     x28-x31 (t3-t6)：临时寄存器。
+
+    调用约定：
+    - 前 8 个参数依次放在 a0-a7 中，其余参数放在调用者栈帧底部的出栈参数区，第 i 个参数（i >= 8）
+      在调用者的 4*(i-8)(sp)，即被调用者的 4*(wordSize+i-8)(sp)。出栈参数区的大小由 calcFrameInfo 计算
+    - 返回值在 a0 中
+    - 调用者保存：t0-t2、t3-t4（x5-x7、x28-x29）和 a0-a7，调用之后仍然需要的值由调用者保存和恢复
+    - 被调用者保存：s0-s11（x8、x9、x18-x27）和 sp，非叶函数还要保存 ra
+    - x30、x31 是生成代码用的临时寄存器，不跨越任何指令序列保存值
+    - 乘除法运行时子程序是例外，见 muldiv.h
  */
 // #define REG_ZERO "x0"
 // #define REG_RA "x1"
@@ -91,9 +103,19 @@ typedef struct {
 // 地址描述符：描述内存地址以及绑定的内存地址
 typedef struct {
     Set* currentAddresses;  // 变量当前存储的所有位置，可以是寄存器也可以是内存地址
-    char* boundMemAddress;  // 绑定的内存地址（临时变量没有内存地址），例如0x10000000
+    char* boundMemAddress;  // 绑定的内存地址，例如 8(sp) 或 g(zero)，临时变量也在局部数据区中有位置
+    int size;               // 绑定的内存位置的字节数，决定用 lw/sw、lh/sh 还是 lbu/sb
+    bool isArray;           // 数组：变量的值是首地址，不放在寄存器中
+    bool isGlobal;          // 全局变量：被调用者也会读写，调用和返回之前总是写回
 } AddressDescriptor;
 
+// 栈帧中的一个位置：局部变量或溢出的变量
+typedef struct {
+    char* var;
+    int size;               // 字节数：char 为 1，short 为 2，int 和地址为 4，数组每个元素占一个字
+    int offset;             // 在所在区域中的字节偏移，由 layoutFrameSlots 填写
+} FrameSlot;
+
 // 栈帧信息：描述函数的栈帧大小和结构
 typedef struct {
     bool isLeaf;            // 是否为叶函数（不调用其他函数的函数）
@@ -102,22 +124,26 @@ typedef struct {
     int localData;          // 局部数据的栈空间
     int numGPRs2Save;       // 需要保存的通用寄存器数量
     int numReturnAdd;       // 返回地址的数量
+    int spillSlots;         // 溢出区的字数（全局寄存器分配时使用，位于出栈参数之上）
+    unsigned int savedRegMask; // 需要保存的被调用者保存寄存器，第 i 位对应 s_i，共 numGPRs2Save 位
+    FrameSlot* locals;      // 局部变量在局部数据区中的位置（局部寄存器分配时使用）
+    int localNum;
 } StackFrameInfo;
 
-// 汇编代码容器
+// 汇编代码容器：连续存放的结构化指令，文本只在 writeAssembly 中生成
 typedef struct {
-    char** asmLines;  // 存储汇编代码的字符串数组
-    unsigned int size;      // 当前数组中存储的行数
+    Instr* instrs;          // 指令数组，标号和伪指令也各占一项
+    unsigned int size;      // 当前数组中存储的指令数
     unsigned int capacity;  // 数组的容量
+    SymbolPool symbols;     // 指令引用的标号、变量名和伪指令文本
 } AsmContainer;
 
 // 寄存器描述符的集合
-#define MAX_REGISTERS 15
-#define MAX_VARIABLES 10
+#define MAX_REGISTERS 5
 RegisterDescriptor registerDescriptors[MAX_REGISTERS];
 
 // 地址描述符的集合
-#define MAX_VARS 128
+#define MAX_VARS 1024
 char* addrDescPairs[MAX_VARS]; // 变量名和addressDescriptors里下标的映射
 AddressDescriptor addressDescriptors[MAX_VARS];
 
@@ -138,21 +164,34 @@ void initAsmContainer(AsmContainer* container); // 初始化 AsmContainer
 void freeAsmContainer(AsmContainer* container); // 释放 AsmContainer 内存
 void loadVar(const char* varId, const char* registerName, AsmContainer* asmContainer);
 void storeVar(const char* varId, const char* registerName, AsmContainer* asmContainer);
-char* toAssembly(AsmContainer* container); // 生成汇编代码的函数
+void writeAssembly(AsmContainer* container, FILE* output); // 按行把汇编代码写入 output
 void initializeGlobalVars(AsmContainer* container); // 生成声明全局变量代码
-void newAsm(AsmContainer* container, const char* line); // 添加一行汇编代码
+void newAsm(AsmContainer* container, const char* line); // 添加一行汇编代码，解析成结构化指令
+void newInstr(AsmContainer* container, const Instr* instr); // 添加一条结构化指令
 void calcFrameInfo(AsmContainer* container); // 计算函数的栈帧信息
 void generateASM(AsmContainer *container); // 根据中间代码生成RISC-V汇编代码
 void allocateProcMemory(AsmContainer* asmContainer, int index, char* funcName); // 为函数分配内存空间
 void allocateGlobalMemory(AsmContainer* asmContainer); // 为全局变量分配内存空间
-void deallocateProcMemory(AsmContainer* asmContainer); // 释放函数的内存空间
-void manageResDescriptors(char* regX, char* res, AsmContainer* asmContainer); // 管理寄存器描述符
+void deallocateProcMemory(AsmContainer* asmContainer); // 把只在寄存器中、之后还会用到的变量写回内存
+void manageResDescriptors(const char* regX, const char* res); // 四元式的结果只在 regX 中
+int mapStackInfo(char* key); // 函数名到 stackFrameInfos 下标的映射
+int getTypeSize(const char* type); // CHAR、SHORT、INT 的字节数
+int layoutFrameSlots(FrameSlot* slots, int num); // 按对齐排列栈帧中的位置，返回总字节数（按字对齐）
+const char* getLoadOp(int size); // 按字节数选择 lw、lh 或 lbu
+const char* getStoreOp(int size); // 按字节数选择 sw、sh 或 sb
+
+// 指令生成辅助函数，局部和全局寄存器分配共用
+void emitPrologue(AsmContainer* asmContainer, StackFrameInfo* frameInfo); // 函数序言
+void emitEpilogue(AsmContainer* asmContainer, StackFrameInfo* frameInfo); // 函数尾声并返回
+void emitTailCall(AsmContainer* asmContainer, StackFrameInfo* frameInfo, const char* funcName); // 释放栈帧后跳到 funcName
+void emitLoadImmediate(AsmContainer* asmContainer, const char* regX, int value); // regX = value
+void emitLoad(AsmContainer* asmContainer, const char* instr); // 访存指令，之后放 LOAD_DELAY 个 nop
+void emitBinaryOp(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY, const char* regZ); // regX = regY op regZ
+void emitUnaryOp(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY); // regX = op regY
+void emitCompareBranch(AsmContainer* asmContainer, TACOpcode op, const char* regY, const char* regZ, const char* regTmp, const char* label); // if (regY op regZ) goto label
 
 // 寄存器分配相关函数
-char** getRegs(TAC* ir, int irIndex, AsmContainer* asmContainer); // 为一条四元式获取每个变量可用的寄存器
-bool checkRegisterForVariable(const char* regName, const char* varId); // 辅助函数：检查寄存器中是否有指定变量
-char* allocateReg(int irIndex, const char* thisArg, const char* otherArg, 
-                 const char* res, AsmContainer* asmContainer);
+const char* allocateReg(const char* var, const char* avoid1, const char* avoid2, AsmContainer* asmContainer); // 为变量选择寄存器，avoid1、avoid2 不能选
 
 // 调试相关函数
 void printAsm(AsmContainer* container);
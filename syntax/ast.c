@@ -1,16 +1,14 @@
 #include "ast.h"
+#include "arena.h"
 
 ASTNode* createASTNode(char* id, int childNum, ...) {
-    ASTNode* cur = (ASTNode*)malloc(sizeof(ASTNode));
-    if (cur == NULL) {
-        perror("create ast node failed.");
-        exit(1);
-    }
+    ASTNode* cur = (ASTNode*)arenaAlloc(&astArena, sizeof(ASTNode));
 
     cur->id = id;
     cur->childNum = childNum;
     cur->isConst = 1;
     cur->symbol = NULL;
+    cur->jumpCode = NULL;
     for (int i=0;i<MAX_CHILD_NUM;++i) {
         cur->children[i] = NULL;
     }
@@ -29,16 +27,13 @@ ASTNode* createASTNode(char* id, int childNum, ...) {
 }
 
 ASTNode* createASTNodeForInt(int val) {
-    ASTNode* cur = (ASTNode*)malloc(sizeof(ASTNode));
-    if (cur == NULL) {
-        perror("create ast node failed.");
-        exit(1);
-    }
+    ASTNode* cur = (ASTNode*)arenaAlloc(&astArena, sizeof(ASTNode));
 
     cur->id = "INT_CONSTANT";
     cur->int_val = val;
     cur->isConst = 1;
     cur->symbol = NULL;
+    cur->jumpCode = NULL;
     cur->childNum = 0;
     for (int i=0;i<MAX_CHILD_NUM;++i) {
         cur->children[i] = NULL;
@@ -48,16 +43,13 @@ ASTNode* createASTNodeForInt(int val) {
 }
 
 ASTNode* createASTNodeForChar(char val) {
-    ASTNode* cur = (ASTNode*)malloc(sizeof(ASTNode));
-    if (cur == NULL) {
-        perror("create ast node failed.");
-        exit(1);
-    }
+    ASTNode* cur = (ASTNode*)arenaAlloc(&astArena, sizeof(ASTNode));
 
     cur->id = "CHAR_CONSTANT";
     cur->char_val = val;
     cur->isConst = 1;
     cur->symbol = NULL;
+    cur->jumpCode = NULL;
     cur->childNum = 0;
     for (int i=0;i<MAX_CHILD_NUM;++i) {
         cur->children[i] = NULL;
@@ -67,16 +59,13 @@ ASTNode* createASTNodeForChar(char val) {
 }
 
 ASTNode* createASTNodeForStr(char* val) {
-    ASTNode* cur = (ASTNode*)malloc(sizeof(ASTNode));
-    if (cur == NULL) {
-        perror("create ast node failed.");
-        exit(1);
-    }
+    ASTNode* cur = (ASTNode*)arenaAlloc(&astArena, sizeof(ASTNode));
 
     cur->id = "STRING_LITERAL";
     cur->str_val = strdup(val);
     cur->isConst = 1;
     cur->symbol = NULL;
+    cur->jumpCode = NULL;
     cur->childNum = 0;
     for (int i=0;i<MAX_CHILD_NUM;++i) {
         cur->children[i] = NULL;
@@ -24,6 +24,9 @@ typedef struct ASTNode {
     // the res symbol for intermediate code. for most nodes, it is NULL and have no use.
     // for expressions, this will be res for TACs and will be parsed to its parent.
     char* symbol;
+    // for && and ||: the first TAC of the jumps deciding the value. the code of the expression
+    // ends with six TACs storing 0/1 into symbol, which conditions drop (see minic.y).
+    struct TACList* jumpCode;
 } ASTNode;
 
 /* create an AST node for identifiers or keywords.
@@ -0,0 +1,117 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+
+/* fused compare-and-branch TACs. a relational TAC whose temp is only read by the conditional
+ * jump right after it is merged into the jump:
+ *   (<, a, b, t) (ifGoto, t, , L)                    ->  (if<, a, b, L)
+ * the conditions of if/while/for in minic.y jump to the body and then over it, so when the body
+ * label follows the goto the condition is inverted and the goto is dropped:
+ *   (<, a, b, t) (ifGoto, t, , L1) (goto, , , L2) (label, L1)  ->  (if>=, a, b, L2) (label, L1)
+ * L1 is removed too when nothing else jumps to it. ifGoto and ifFalseGoto on other conditions
+ * are inverted the same way without fusing. the code generator emits beq/bne on the
+ * operands, or slt and bne/beq, instead of computing t with sub/sltu/xori and testing it. runs
+ * after dead code elimination, whose jump threading turns the exits of && and || in conditions
+ * into this form.
+ */
+typedef struct CompareOp {
+    TACOpcode op;
+    TACOpcode branch; // jump if a op b
+    TACOpcode inverse; // jump if !(a op b)
+} CompareOp;
+
+static const CompareOp compareOps[] = {
+    { TAC_EQ, TAC_IF_EQ, TAC_IF_NE },
+    { TAC_NE, TAC_IF_NE, TAC_IF_EQ },
+    { TAC_LT, TAC_IF_LT, TAC_IF_GE },
+    { TAC_LE, TAC_IF_LE, TAC_IF_GT },
+    { TAC_GT, TAC_IF_GT, TAC_IF_LE },
+    { TAC_GE, TAC_IF_GE, TAC_IF_LT },
+};
+
+static const CompareOp* findCompareOp(TACOpcode op) {
+    for (int i = 0; i < (int)(sizeof(compareOps) / sizeof(compareOps[0])); ++i) {
+        if (compareOps[i].op == op) return &compareOps[i];
+    }
+    return NULL;
+}
+
+// number of TACs of the function reading each temp, indexed by the number after 't'
+static int* countTempUses(CFG* cfg) {
+    int* uses = (int*)calloc(tempCnt + 1, sizeof(int));
+    for (TACList* cur = cfg->funcLabel->next; cur != NULL && cur != cfg->endLabel; cur = cur->next) {
+        int roles = getTACRoles(cur->tac);
+        char* operands[3];
+        getTACVarOperands(cur->tac, operands);
+        if (!(roles & TAC_USE_RES)) operands[2] = NULL;
+        for (int i = 0; i < 3; ++i) {
+            if (operands[i] == NULL || !isTemp(operands[i])) continue;
+            int num = atoi(operands[i] + 1);
+            if (num <= tempCnt) uses[num]++;
+        }
+    }
+    return uses;
+}
+
+static bool isJumpTarget(CFG* cfg, char* label) {
+    for (TACList* cur = cfg->funcLabel->next; cur != NULL && cur != cfg->endLabel; cur = cur->next) {
+        TAC* tac = cur->tac;
+        bool jump = tac->op == TAC_GOTO || tac->op == TAC_IF_GOTO ||
+                    tac->op == TAC_IF_FALSE_GOTO || isCompareBranch(tac);
+        if (jump && strcmp(tac->res, label) == 0) return true;
+    }
+    return false;
+}
+
+// the conditional jump is followed by a goto and the label it jumps to
+static bool jumpsOverGoto(TACList* jump) {
+    TACList* after = jump->next;
+    return after != NULL && after->tac->op == TAC_GOTO && after->next != NULL &&
+           after->next->tac->op == TAC_LABEL && strcmp(after->next->tac->arg1, jump->tac->res) == 0;
+}
+
+// the condition of jump has been inverted: it takes over the target of the goto after it, and
+// the goto and the label after it, if nothing else jumps there, are removed
+static void dropGoto(CFG* cfg, TACList* jump) {
+    jump->tac->res = jump->next->tac->res;
+    removeTAC(jump, jump->next);
+    if (!isJumpTarget(cfg, jump->next->tac->arg1)) {
+        removeTAC(jump, jump->next);
+    }
+}
+
+void fuseCompareBranches(CFG* cfg, FILE* report) {
+    int* uses = countTempUses(cfg);
+    int fused = 0;
+    int inverted = 0;
+    for (TACList* cur = cfg->funcLabel->next; cur != NULL && cur != cfg->endLabel; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_IF_GOTO || tac->op == TAC_IF_FALSE_GOTO) {
+            if (jumpsOverGoto(cur)) {
+                tac->op = tac->op == TAC_IF_GOTO ? TAC_IF_FALSE_GOTO : TAC_IF_GOTO;
+                dropGoto(cfg, cur);
+                ++inverted;
+            }
+            continue;
+        }
+        const CompareOp* compare = findCompareOp(tac->op);
+        if (compare == NULL || !isTemp(tac->res) || cur->next == NULL) continue;
+        TAC* jump = cur->next->tac;
+        bool ifTrue = jump->op == TAC_IF_GOTO;
+        if (!ifTrue && jump->op != TAC_IF_FALSE_GOTO) continue;
+        if (strcmp(jump->arg1, tac->res) != 0 || uses[atoi(tac->res + 1)] != 1) continue;
+
+        bool invert = jumpsOverGoto(cur->next);
+        tac->op = ifTrue != invert ? compare->branch : compare->inverse;
+        tac->res = jump->res;
+        removeTAC(cur, cur->next);
+        if (invert) {
+            // jump over the fall-through label when the condition fails
+            dropGoto(cfg, cur);
+            ++inverted;
+        }
+        ++fused;
+    }
+    free(uses);
+    fprintf(report, "%s: %d branches fused, %d jumps inverted\n", cfg->funcName, fused, inverted);
+}
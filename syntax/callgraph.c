@@ -0,0 +1,76 @@
+#include "callgraph.h"
+#include <string.h>
+
+static void* callGraphAlloc(size_t size) {
+    void* ptr = calloc(1, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Failed to allocate memory for call graph.\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+int findCallGraphNode(CallGraph* graph, const char* funcName) {
+    for (int i = 0; i < graph->nodeNum; ++i) {
+        if (strcmp(graph->nodes[i].funcName, funcName) == 0) return i;
+    }
+    return -1;
+}
+
+static void addCallee(CallGraphNode* node, int callee) {
+    for (int i = 0; i < node->calleeNum; ++i) {
+        if (node->callees[i] == callee) return;
+    }
+    if (node->calleeNum >= node->calleeCapacity) {
+        node->calleeCapacity = node->calleeCapacity == 0 ? 4 : node->calleeCapacity * 2;
+        node->callees = (int*)realloc(node->callees, node->calleeCapacity * sizeof(int));
+    }
+    node->callees[node->calleeNum++] = callee;
+}
+
+CallGraph* buildCallGraph() {
+    CallGraph* graph = (CallGraph*)callGraphAlloc(sizeof(CallGraph));
+    int capacity = 0;
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op != TAC_LABEL || strncmp(tac->arg1, "func_", 5) != 0) continue;
+        if (graph->nodeNum >= capacity) {
+            capacity = capacity == 0 ? 8 : capacity * 2;
+            graph->nodes = (CallGraphNode*)realloc(graph->nodes, capacity * sizeof(CallGraphNode));
+        }
+        CallGraphNode* node = &graph->nodes[graph->nodeNum++];
+        memset(node, 0, sizeof(CallGraphNode));
+        node->funcName = tac->arg1 + 5;
+        node->funcLabel = cur;
+    }
+
+    // a function may call one defined after it, so the edges are added once all nodes exist
+    for (int i = 0; i < graph->nodeNum; ++i) {
+        CallGraphNode* node = &graph->nodes[i];
+        int argNum = 0;
+        for (TACList* cur = node->funcLabel->next; cur != NULL; cur = cur->next) {
+            TAC* tac = cur->tac;
+            if (tac->op == TAC_LABEL && strcmp(tac->arg1, "end_func") == 0) break;
+            if (tac->op == TAC_PARAM) {
+                argNum++;
+            } else if (tac->op == TAC_CALL) {
+                node->callSiteNum++;
+                if (argNum > node->maxArgs) node->maxArgs = argNum;
+                argNum = 0;
+                int callee = findCallGraphNode(graph, tac->arg1);
+                if (callee != -1) addCallee(node, callee);
+            }
+        }
+        node->isLeaf = node->callSiteNum == 0;
+    }
+    return graph;
+}
+
+void freeCallGraph(CallGraph* graph) {
+    if (graph == NULL) return;
+    for (int i = 0; i < graph->nodeNum; ++i) {
+        free(graph->nodes[i].callees);
+    }
+    free(graph->nodes);
+    free(graph);
+}
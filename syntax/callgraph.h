@@ -0,0 +1,37 @@
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include <stdbool.h>
+#include "tac.h"
+
+/* call graph over the TAC list.
+ * a node is a function between (label, func_xxx) and (label, end_func). an edge f -> g is added for
+ * every (call, g, , res) in f. the mul/div runtime routines are not functions of the program and
+ * never appear here: their callers keep ra in a7 (see muldiv.h), so they do not make a function
+ * a non-leaf.
+ */
+typedef struct CallGraphNode {
+    char* funcName;
+    TACList* funcLabel;          // (label, func_xxx)
+    int* callees;                // indices of the called functions, each at most once
+    int calleeNum;
+    int calleeCapacity;
+    int callSiteNum;             // number of call tacs, counting repeated callees
+    int maxArgs;                 // most params passed by one call
+    bool isLeaf;                 // no call tac at all
+} CallGraphNode;
+
+typedef struct CallGraph {
+    CallGraphNode* nodes;        // in code order
+    int nodeNum;
+} CallGraph;
+
+// build the call graph of the code in tacHead
+CallGraph* buildCallGraph();
+
+void freeCallGraph(CallGraph* graph);
+
+// returns the index of the function's node, or -1
+int findCallGraphNode(CallGraph* graph, const char* funcName);
+
+#endif
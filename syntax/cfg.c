@@ -0,0 +1,363 @@
+#include "cfg.h"
+#include <string.h>
+
+static void* cfgAlloc(size_t size) {
+    void* ptr = calloc(1, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Failed to allocate memory for control flow graph.\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static BasicBlock* createBlock(int id) {
+    BasicBlock* block = (BasicBlock*)cfgAlloc(sizeof(BasicBlock));
+    block->id = id;
+    return block;
+}
+
+static void addBlockTo(BasicBlock*** arr, int* num, int* capacity, BasicBlock* block) {
+    for (int i = 0; i < *num; ++i) {
+        if ((*arr)[i] == block) return;
+    }
+    if (*num >= *capacity) {
+        *capacity = *capacity == 0 ? 2 : *capacity * 2;
+        *arr = (BasicBlock**)realloc(*arr, *capacity * sizeof(BasicBlock*));
+    }
+    (*arr)[(*num)++] = block;
+}
+
+static void addEdge(BasicBlock* from, BasicBlock* to) {
+    addBlockTo(&from->succs, &from->succNum, &from->succCapacity, to);
+    addBlockTo(&to->preds, &to->predNum, &to->predCapacity, from);
+}
+
+static unsigned int hashLabel(const char* label) {
+    unsigned int hash = 5381;
+    while (*label) {
+        hash = (hash << 5) + hash + (unsigned char)*label;
+        label++;
+    }
+    return hash;
+}
+
+static void buildLabelTable(CFG* cfg) {
+    cfg->labelTableSize = 16;
+    while (cfg->labelTableSize < (unsigned int)cfg->blockNum * 2) {
+        cfg->labelTableSize *= 2;
+    }
+    cfg->labelTable = (BasicBlock**)cfgAlloc(cfg->labelTableSize * sizeof(BasicBlock*));
+    // open addressing, there are fewer labels than blocks
+    for (int i = 0; i < cfg->blockNum; ++i) {
+        char* label = getBlockLabel(cfg->blocks[i]);
+        if (label == NULL) continue;
+        unsigned int index = hashLabel(label) & (cfg->labelTableSize - 1);
+        while (cfg->labelTable[index] != NULL) {
+            index = (index + 1) & (cfg->labelTableSize - 1);
+        }
+        cfg->labelTable[index] = cfg->blocks[i];
+    }
+}
+
+static int isFuncLabel(TAC* tac) {
+    return tac->op == TAC_LABEL && tac->arg1 != NULL && strncmp(tac->arg1, "func_", 5) == 0;
+}
+
+static int isEndLabel(TAC* tac) {
+    return tac->op == TAC_LABEL && tac->arg1 != NULL && strcmp(tac->arg1, "end_func") == 0;
+}
+
+CFG* buildCFG(TACList* funcLabel) {
+    CFG* cfg = (CFG*)cfgAlloc(sizeof(CFG));
+    cfg->funcName = funcLabel->tac->arg1 + 5; // skip "func_"
+    cfg->funcLabel = funcLabel;
+    cfg->exit = createBlock(-1);
+
+    // 1. partition the code into blocks
+    int capacity = 16;
+    cfg->blocks = (BasicBlock**)cfgAlloc(capacity * sizeof(BasicBlock*));
+    BasicBlock* cur = NULL;
+    TACList* node = funcLabel->next;
+    while (node != NULL && !isEndLabel(node->tac)) {
+        if (cur == NULL || startsBlock(node->tac)) {
+            if (cfg->blockNum >= capacity) {
+                capacity *= 2;
+                cfg->blocks = (BasicBlock**)realloc(cfg->blocks, capacity * sizeof(BasicBlock*));
+            }
+            cur = createBlock(cfg->blockNum);
+            cur->first = node;
+            cfg->blocks[cfg->blockNum++] = cur;
+        }
+        cur->last = node;
+        ++cur->tacNum;
+        if (endsBlock(node->tac)) {
+            cur = NULL;
+        }
+        node = node->next;
+    }
+    cfg->endLabel = node;
+    buildLabelTable(cfg);
+
+    // 2. connect the blocks
+    for (int i = 0; i < cfg->blockNum; ++i) {
+        BasicBlock* block = cfg->blocks[i];
+        BasicBlock* fallthrough = i + 1 < cfg->blockNum ? cfg->blocks[i + 1] : cfg->exit;
+        TAC* tac = block->last->tac;
+        if (tac->op == TAC_RETURN) {
+            addEdge(block, cfg->exit);
+        } else if (tac->op == TAC_GOTO || tac->op == TAC_IF_GOTO || tac->op == TAC_IF_FALSE_GOTO ||
+                   isCompareBranch(tac)) {
+            BasicBlock* target = findBlockByLabel(cfg, tac->res);
+            if (target == NULL) {
+                fprintf(stderr, "Cannot find the target of jump to %s in function %s.\n", tac->res, cfg->funcName);
+                target = cfg->exit;
+            }
+            addEdge(block, target);
+            if (tac->op != TAC_GOTO) {
+                addEdge(block, fallthrough);
+            }
+        } else {
+            addEdge(block, fallthrough);
+        }
+    }
+
+    return cfg;
+}
+
+CFG** buildCFGs(int* cfgNum) {
+    int capacity = 8;
+    CFG** cfgs = (CFG**)cfgAlloc(capacity * sizeof(CFG*));
+    *cfgNum = 0;
+    for (TACList* node = tacHead; node != NULL; node = node->next) {
+        if (isFuncLabel(node->tac)) {
+            if (*cfgNum >= capacity) {
+                capacity *= 2;
+                cfgs = (CFG**)realloc(cfgs, capacity * sizeof(CFG*));
+            }
+            CFG* cfg = buildCFG(node);
+            cfgs[(*cfgNum)++] = cfg;
+            if (cfg->endLabel == NULL) break;
+            node = cfg->endLabel;
+        }
+    }
+    return cfgs;
+}
+
+static void freeBlock(BasicBlock* block) {
+    free(block->preds);
+    free(block->succs);
+    free(block);
+}
+
+void freeCFG(CFG* cfg) {
+    for (int i = 0; i < cfg->blockNum; ++i) {
+        freeBlock(cfg->blocks[i]);
+    }
+    freeBlock(cfg->exit);
+    free(cfg->blocks);
+    free(cfg->labelTable);
+    free(cfg);
+}
+
+void freeCFGs(CFG** cfgs, int cfgNum) {
+    for (int i = 0; i < cfgNum; ++i) {
+        freeCFG(cfgs[i]);
+    }
+    free(cfgs);
+}
+
+char* getBlockLabel(BasicBlock* block) {
+    if (block->first == NULL || !startsBlock(block->first->tac)) {
+        return NULL;
+    }
+    return block->first->tac->arg1;
+}
+
+BasicBlock* findBlockByLabel(CFG* cfg, char* label) {
+    if (label == NULL || cfg->labelTable == NULL) return NULL;
+    unsigned int index = hashLabel(label) & (cfg->labelTableSize - 1);
+    while (cfg->labelTable[index] != NULL) {
+        if (strcmp(getBlockLabel(cfg->labelTable[index]), label) == 0) {
+            return cfg->labelTable[index];
+        }
+        index = (index + 1) & (cfg->labelTableSize - 1);
+    }
+    return NULL;
+}
+
+BasicBlock** getReversePostorder(CFG* cfg, int* num) {
+    BasicBlock** order = (BasicBlock**)cfgAlloc((cfg->blockNum + 1) * sizeof(BasicBlock*));
+    *num = 0;
+    if (cfg->blockNum == 0) return order;
+
+    // iterative dfs, nextSucc[id] is the next successor to visit
+    int* nextSucc = (int*)cfgAlloc(cfg->blockNum * sizeof(int));
+    char* visited = (char*)cfgAlloc(cfg->blockNum);
+    BasicBlock** stack = (BasicBlock**)cfgAlloc(cfg->blockNum * sizeof(BasicBlock*));
+    int top = 0;
+    stack[top++] = cfg->blocks[0];
+    visited[0] = 1;
+    while (top > 0) {
+        BasicBlock* block = stack[top - 1];
+        if (nextSucc[block->id] < block->succNum) {
+            BasicBlock* succ = block->succs[nextSucc[block->id]++];
+            if (succ != cfg->exit && !visited[succ->id]) {
+                visited[succ->id] = 1;
+                stack[top++] = succ;
+            }
+        } else {
+            order[(*num)++] = block;
+            --top;
+        }
+    }
+    // reverse the postorder
+    for (int i = 0; i < *num / 2; ++i) {
+        BasicBlock* temp = order[i];
+        order[i] = order[*num - 1 - i];
+        order[*num - 1 - i] = temp;
+    }
+
+    free(nextSucc);
+    free(visited);
+    free(stack);
+    return order;
+}
+
+int* computeDominators(CFG* cfg) {
+    int* idom = (int*)cfgAlloc((cfg->blockNum + 1) * sizeof(int));
+    for (int i = 0; i < cfg->blockNum; ++i) {
+        idom[i] = -1;
+    }
+    if (cfg->blockNum == 0) return idom;
+
+    int orderNum = 0;
+    BasicBlock** order = getReversePostorder(cfg, &orderNum);
+    int* rpoIndex = (int*)cfgAlloc(cfg->blockNum * sizeof(int));
+    for (int i = 0; i < cfg->blockNum; ++i) {
+        rpoIndex[i] = -1;
+    }
+    for (int i = 0; i < orderNum; ++i) {
+        rpoIndex[order[i]->id] = i;
+    }
+
+    // the entry is its own dominator while iterating, so that intersect() stops there
+    idom[0] = 0;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < orderNum; ++i) {
+            BasicBlock* block = order[i];
+            int newIdom = -1;
+            for (int j = 0; j < block->predNum; ++j) {
+                int pred = block->preds[j]->id;
+                if (idom[pred] == -1) continue; // not processed yet or unreachable
+                if (newIdom == -1) {
+                    newIdom = pred;
+                    continue;
+                }
+                // intersect: walk up from both blocks until they meet
+                int a = pred, b = newIdom;
+                while (a != b) {
+                    while (rpoIndex[a] > rpoIndex[b]) a = idom[a];
+                    while (rpoIndex[b] > rpoIndex[a]) b = idom[b];
+                }
+                newIdom = a;
+            }
+            if (idom[block->id] != newIdom) {
+                idom[block->id] = newIdom;
+                changed = 1;
+            }
+        }
+    }
+    idom[0] = -1;
+
+    free(rpoIndex);
+    free(order);
+    return idom;
+}
+
+int dominates(int* idom, int a, int b) {
+    while (b != -1) {
+        if (a == b) return 1;
+        b = idom[b];
+    }
+    return 0;
+}
+
+static int compareLoopSize(const void* a, const void* b) {
+    return ((const Loop*)a)->blockNum - ((const Loop*)b)->blockNum;
+}
+
+Loop* findLoops(CFG* cfg, int* idom, int* loopNum) {
+    Loop* loops = (Loop*)malloc((cfg->blockNum + 1) * sizeof(Loop));
+    int* stack = (int*)malloc((cfg->blockNum + 1) * sizeof(int));
+    if (loops == NULL || stack == NULL) {
+        fprintf(stderr, "Failed to allocate memory for loops.\n");
+        exit(1);
+    }
+    *loopNum = 0;
+    for (int h = 0; h < cfg->blockNum; ++h) {
+        BasicBlock* header = cfg->blocks[h];
+        Loop* loop = NULL;
+        for (int i = 0; i < header->predNum; ++i) {
+            int n = header->preds[i]->id;
+            if (!dominates(idom, h, n)) continue;
+            // a back edge n -> h. walk backwards from n, the header stops the walk
+            if (loop == NULL) {
+                loop = &loops[(*loopNum)++];
+                loop->header = h;
+                loop->body = (int*)calloc(cfg->blockNum, sizeof(int));
+                loop->body[h] = 1;
+                loop->blockNum = 1;
+            }
+            int top = 0;
+            if (!loop->body[n]) {
+                loop->body[n] = 1;
+                loop->blockNum++;
+                stack[top++] = n;
+            }
+            while (top > 0) {
+                BasicBlock* block = cfg->blocks[stack[--top]];
+                for (int j = 0; j < block->predNum; ++j) {
+                    int pred = block->preds[j]->id;
+                    if (!loop->body[pred]) {
+                        loop->body[pred] = 1;
+                        loop->blockNum++;
+                        stack[top++] = pred;
+                    }
+                }
+            }
+        }
+    }
+    free(stack);
+    // a loop has fewer blocks than the loops containing it
+    qsort(loops, *loopNum, sizeof(Loop), compareLoopSize);
+    return loops;
+}
+
+void freeLoops(Loop* loops, int loopNum) {
+    for (int i = 0; i < loopNum; ++i) {
+        free(loops[i].body);
+    }
+    free(loops);
+}
+
+void printCFG(CFG* cfg) {
+    printf("function %s:\n", cfg->funcName);
+    for (int i = 0; i < cfg->blockNum; ++i) {
+        BasicBlock* block = cfg->blocks[i];
+        printf("  B%d [%d, %d] preds:", block->id, block->first->tac->index, block->last->tac->index);
+        for (int j = 0; j < block->predNum; ++j) {
+            printf(" B%d", block->preds[j]->id);
+        }
+        printf(" succs:");
+        for (int j = 0; j < block->succNum; ++j) {
+            if (block->succs[j] == cfg->exit) {
+                printf(" EXIT");
+            } else {
+                printf(" B%d", block->succs[j]->id);
+            }
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include "tac.h"
+
+/* basic blocks and control flow graphs over the TAC list.
+ * a function is the code between (label, func_xxx) and (label, end_func). its code is cut into
+ * basic blocks before every label and after every goto, ifGoto, ifFalseGoto, call and return.
+ * blocks do not own their tacs: first/last point into the global list (tacHead), so a CFG should
+ * be rebuilt after the code is changed.
+ */
+typedef struct BasicBlock {
+    int id;                      // index in CFG.blocks, blocks are stored in code order
+    TACList* first;              // first tac of the block, NULL for the exit block
+    TACList* last;               // last tac of the block (inclusive)
+    int tacNum;
+    struct BasicBlock** preds;
+    int predNum;
+    int predCapacity;
+    struct BasicBlock** succs;
+    int succNum;
+    int succCapacity;
+} BasicBlock;
+
+typedef struct CFG {
+    char* funcName;
+    TACList* funcLabel;          // (label, func_xxx)
+    TACList* endLabel;           // (label, end_func)
+    BasicBlock** blocks;         // blocks[0] is the entry block
+    int blockNum;
+    BasicBlock* exit;            // empty block after every return, not stored in blocks
+    BasicBlock** labelTable;     // hash table from labels to blocks, see findBlockByLabel()
+    unsigned int labelTableSize;
+} CFG;
+
+// a natural loop: the header and every block that reaches a back edge to it without passing it.
+// loops with the same header are merged into one.
+typedef struct Loop {
+    int header;                  // block id
+    int* body;                   // indexed by block id, 1 for blocks of the loop
+    int blockNum;
+} Loop;
+
+// build the CFG of the function starting at funcLabel
+CFG* buildCFG(TACList* funcLabel);
+
+// build the CFGs of all functions in the code. the number of functions is stored in cfgNum
+CFG** buildCFGs(int* cfgNum);
+
+void freeCFG(CFG* cfg);
+
+void freeCFGs(CFG** cfgs, int cfgNum);
+
+// returns the label that starts the block, or NULL
+char* getBlockLabel(BasicBlock* block);
+
+// returns the block that starts with the label, or NULL
+BasicBlock* findBlockByLabel(CFG* cfg, char* label);
+
+// blocks in reverse postorder from the entry block. unreachable blocks are not included.
+// the caller should free the returned array.
+BasicBlock** getReversePostorder(CFG* cfg, int* num);
+
+// immediate dominators (Cooper, Harvey & Kennedy), indexed by block id. the entry block and
+// unreachable blocks have -1. the caller should free the returned array.
+int* computeDominators(CFG* cfg);
+
+// returns 1 if block a dominates block b according to idom
+int dominates(int* idom, int a, int b);
+
+// natural loops of the function, inner loops before the loops containing them. the number of
+// loops is stored in loopNum. free the result with freeLoops().
+Loop* findLoops(CFG* cfg, int* idom, int* loopNum);
+
+void freeLoops(Loop* loops, int loopNum);
+
+void printCFG(CFG* cfg);
+
+#endif
@@ -0,0 +1,328 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+#include "liveness.h"
+
+/* sparse conditional constant propagation (Wegman & Zadeck, 1991) without SSA.
+ * every variable of the function has a lattice value at the entry of every block:
+ *   TOP (no value reaches yet) > a constant > BOTTOM (not a constant).
+ * only blocks reached through executable edges are evaluated, and a branch on a constant makes
+ * only one of its edges executable, so values from dead paths never lower a merge.
+ * temps, scalar locals and parameters are tracked. globals may be changed by calls and $=, so
+ * they are always BOTTOM, like local arrays, char constants and string literals.
+ * after the analysis the executable blocks are rewritten: constant operands are substituted,
+ * expressions with a constant value become (=, c, , res), and ifGoto/ifFalseGoto on a constant
+ * become goto or disappear. unreachable blocks are left to the dead code pass.
+ */
+typedef enum LatticeKind {
+    LATTICE_TOP,
+    LATTICE_CONST,
+    LATTICE_BOTTOM,
+} LatticeKind;
+
+typedef struct LatticeValue {
+    LatticeKind kind;
+    int value;
+} LatticeValue;
+
+typedef struct ConstPropState {
+    CFG* cfg;
+    Liveness* liveness;       // only used to number the variables
+    bool* tracked;            // indexed by variable number
+    LatticeValue** in;        // indexed by block id, then variable number
+    bool* executable;         // indexed by block id
+    int* worklist;
+    bool* inWorklist;
+    int worklistNum;
+} ConstPropState;
+
+static const LatticeValue bottomValue = { LATTICE_BOTTOM, 0 };
+static const LatticeValue topValue = { LATTICE_TOP, 0 };
+
+static LatticeValue constValue(int value) {
+    LatticeValue res = { LATTICE_CONST, value };
+    return res;
+}
+
+static LatticeValue operandValue(ConstPropState* state, LatticeValue* values, char* operand) {
+    if (isConstant(operand)) {
+        return constValue((int)strtol(operand, NULL, 10));
+    }
+    if (!isVariable(operand)) {
+        return bottomValue; // string literals
+    }
+    int num = getLivenessVar(state->liveness, operand);
+    if (num == -1 || !state->tracked[num]) {
+        return bottomValue;
+    }
+    return values[num];
+}
+
+static void setValue(ConstPropState* state, LatticeValue* values, char* var, LatticeValue value) {
+    if (!isVariable(var)) return;
+    int num = getLivenessVar(state->liveness, var);
+    if (num != -1 && state->tracked[num]) {
+        values[num] = value;
+    }
+}
+
+// evaluate res = a op b on 32-bit values the way the generated code does
+static bool foldBinary(TACOpcode op, int a, int b, int* res) {
+    unsigned int ua = (unsigned int)a, ub = (unsigned int)b;
+    switch (op) {
+    case TAC_ADD: *res = (int)(ua + ub); break;
+    case TAC_SUB: *res = (int)(ua - ub); break;
+    case TAC_MUL: *res = (int)(ua * ub); break;
+    case TAC_DIV:
+    case TAC_MOD:
+        // division by zero traps at run time, INT_MIN / -1 overflows: leave both to the hardware
+        if (b == 0 || (a == (int)0x80000000 && b == -1)) return false;
+        *res = op == TAC_DIV ? a / b : a % b;
+        break;
+    case TAC_SHL: *res = (int)(ua << (ub & 31)); break;
+    case TAC_SHR: *res = (int)(ua >> (ub & 31)); break; // srlv
+    case TAC_BIT_AND: *res = a & b; break;
+    case TAC_BIT_OR: *res = a | b; break;
+    case TAC_BIT_XOR: *res = a ^ b; break;
+    case TAC_AND: *res = a != 0 && b != 0; break;
+    case TAC_OR: *res = a != 0 || b != 0; break;
+    case TAC_EQ: *res = a == b; break;
+    case TAC_NE: *res = a != b; break;
+    case TAC_LT: *res = a < b; break;
+    case TAC_GT: *res = a > b; break;
+    case TAC_LE: *res = a <= b; break;
+    case TAC_GE: *res = a >= b; break;
+    default: return false;
+    }
+    return true;
+}
+
+// results that one constant operand decides on its own, e.g. x * 0 and 1 || x
+static bool foldAbsorbing(TACOpcode op, LatticeValue x, int* res) {
+    if (x.kind != LATTICE_CONST) return false;
+    if ((op == TAC_MUL || op == TAC_BIT_AND || op == TAC_AND) && x.value == 0) {
+        *res = 0;
+        return true;
+    }
+    if (op == TAC_OR && x.value != 0) {
+        *res = 1;
+        return true;
+    }
+    return false;
+}
+
+static LatticeValue evaluateExpression(ConstPropState* state, LatticeValue* values, TAC* tac) {
+    TACOpcode op = tac->op;
+    if (op == TAC_ASSIGN) {
+        return operandValue(state, values, tac->arg1);
+    }
+    if (op == TAC_CALL || op == TAC_LOAD_ELEM || op == TAC_READ_ADDR ||
+        op == TAC_ELEM_ADDR || op == TAC_LOAD) {
+        return bottomValue;
+    }
+    // unary operators: (!, x, , res), (~, x, , res) and (-, , x, res)
+    bool unaryMinus = op == TAC_SUB && tac->arg1 == NULL;
+    if (unaryMinus || op == TAC_NOT || op == TAC_BIT_NOT) {
+        LatticeValue x = operandValue(state, values, unaryMinus ? tac->arg2 : tac->arg1);
+        if (x.kind != LATTICE_CONST) return x;
+        if (unaryMinus) return constValue((int)(0u - (unsigned int)x.value));
+        return constValue(op == TAC_NOT ? x.value == 0 : ~x.value);
+    }
+    LatticeValue a = operandValue(state, values, tac->arg1);
+    LatticeValue b = operandValue(state, values, tac->arg2);
+    int res;
+    // operands have no side effects, so either one may decide the result
+    if (foldAbsorbing(op, a, &res) || foldAbsorbing(op, b, &res)) {
+        return constValue(res);
+    }
+    if (a.kind == LATTICE_BOTTOM || b.kind == LATTICE_BOTTOM) return bottomValue;
+    if (a.kind == LATTICE_TOP || b.kind == LATTICE_TOP) return topValue;
+    if (!foldBinary(op, a.value, b.value, &res)) return bottomValue;
+    return constValue(res);
+}
+
+static void evaluateTAC(ConstPropState* state, LatticeValue* values, TAC* tac) {
+    if (getTACRoles(tac) & TAC_DEF_RES) {
+        setValue(state, values, tac->res, evaluateExpression(state, values, tac));
+    }
+}
+
+// meet values into the entry of block, returns whether it changed
+static bool meetInto(ConstPropState* state, BasicBlock* block, LatticeValue* values) {
+    bool changed = false;
+    LatticeValue* in = state->in[block->id];
+    for (int i = 0; i < state->liveness->varNum; ++i) {
+        LatticeValue merged = in[i];
+        if (values[i].kind == LATTICE_TOP || merged.kind == LATTICE_BOTTOM) continue;
+        if (merged.kind == LATTICE_TOP) {
+            merged = values[i];
+        } else if (values[i].kind == LATTICE_BOTTOM || values[i].value != merged.value) {
+            merged = bottomValue;
+        }
+        if (merged.kind != in[i].kind || merged.value != in[i].value) {
+            in[i] = merged;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static void visitEdge(ConstPropState* state, BasicBlock* to, LatticeValue* values) {
+    if (to == NULL || to->id < 0) return; // exit block
+    bool changed = meetInto(state, to, values);
+    if ((changed || !state->executable[to->id]) && !state->inWorklist[to->id]) {
+        state->worklist[state->worklistNum++] = to->id;
+        state->inWorklist[to->id] = true;
+    }
+    state->executable[to->id] = true;
+}
+
+// returns 1 if the branch is always taken, 0 if never, -1 if unknown. *top is set if the
+// condition has no value yet
+static int branchDirection(ConstPropState* state, LatticeValue* values, TAC* tac, bool* top) {
+    LatticeValue cond = operandValue(state, values, tac->arg1);
+    *top = cond.kind == LATTICE_TOP;
+    if (cond.kind != LATTICE_CONST) return -1;
+    bool taken = cond.value != 0;
+    if (tac->op == TAC_IF_FALSE_GOTO) taken = !taken;
+    return taken;
+}
+
+static void visitBlock(ConstPropState* state, BasicBlock* block, LatticeValue* values) {
+    int varNum = state->liveness->varNum;
+    memcpy(values, state->in[block->id], varNum * sizeof(LatticeValue));
+    TACList* cur = block->first;
+    for (int i = 0; i < block->tacNum; ++i, cur = cur->next) {
+        evaluateTAC(state, values, cur->tac);
+    }
+
+    TAC* last = block->last->tac;
+    BasicBlock* fallthrough = block->id + 1 < state->cfg->blockNum ? state->cfg->blocks[block->id + 1] : NULL;
+    if (last->op == TAC_RETURN) {
+        return;
+    }
+    if (last->op == TAC_GOTO) {
+        visitEdge(state, findBlockByLabel(state->cfg, last->res), values);
+    } else if (last->op == TAC_IF_GOTO || last->op == TAC_IF_FALSE_GOTO) {
+        bool top;
+        int direction = branchDirection(state, values, last, &top);
+        if (top) return;
+        if (direction != 0) visitEdge(state, findBlockByLabel(state->cfg, last->res), values);
+        if (direction != 1) visitEdge(state, fallthrough, values);
+    } else {
+        visitEdge(state, fallthrough, values);
+    }
+}
+
+static void substituteOperand(ConstPropState* state, LatticeValue* values, char** operand, int* replaced) {
+    if (!isVariable(*operand)) return;
+    LatticeValue value = operandValue(state, values, *operand);
+    if (value.kind == LATTICE_CONST) {
+        *operand = intToString(value.value);
+        ++*replaced;
+    }
+}
+
+void propagateConstants(CFG* cfg, FILE* report) {
+    int folded = 0, resolved = 0, replaced = 0;
+    if (cfg->blockNum == 0) {
+        fprintf(report, "%s: %d expressions folded, %d branches resolved, %d operands replaced\n",
+                cfg->funcName, folded, resolved, replaced);
+        return;
+    }
+
+    ConstPropState state;
+    state.cfg = cfg;
+    state.liveness = computeLiveness(cfg);
+    state.tracked = findLocalScalars(cfg, state.liveness);
+    int varNum = state.liveness->varNum;
+    state.in = (LatticeValue**)malloc(cfg->blockNum * sizeof(LatticeValue*));
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        state.in[b] = (LatticeValue*)malloc((varNum + 1) * sizeof(LatticeValue));
+        for (int i = 0; i < varNum; ++i) {
+            // nothing is known about parameters, globals and uninitialized locals at the entry
+            state.in[b][i] = b == 0 ? bottomValue : topValue;
+        }
+    }
+    state.executable = (bool*)calloc(cfg->blockNum, sizeof(bool));
+    state.inWorklist = (bool*)calloc(cfg->blockNum, sizeof(bool));
+    state.worklist = (int*)malloc(cfg->blockNum * sizeof(int));
+    state.worklistNum = 0;
+    LatticeValue* values = (LatticeValue*)malloc((varNum + 1) * sizeof(LatticeValue));
+
+    // 1. propagate along executable edges until no entry value changes
+    state.executable[0] = true;
+    state.worklist[state.worklistNum++] = 0;
+    state.inWorklist[0] = true;
+    while (state.worklistNum > 0) {
+        int id = state.worklist[--state.worklistNum];
+        state.inWorklist[id] = false;
+        visitBlock(&state, cfg->blocks[id], values);
+    }
+
+    // 2. rewrite the executable blocks. the list is edited in place, prev follows the last kept node
+    TACList* prev = cfg->funcLabel;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        BasicBlock* block = cfg->blocks[b];
+        TACList* cur = block->first;
+        int tacNum = block->tacNum;
+        if (!state.executable[b]) {
+            for (int i = 0; i < tacNum; ++i, cur = cur->next) prev = cur;
+            continue;
+        }
+        memcpy(values, state.in[b], varNum * sizeof(LatticeValue));
+        for (int i = 0; i < tacNum; ++i) {
+            TAC* tac = cur->tac;
+            TACList* next = cur->next;
+            if (tac->op == TAC_IF_GOTO || tac->op == TAC_IF_FALSE_GOTO) {
+                bool top;
+                int direction = branchDirection(&state, values, tac, &top);
+                if (direction == 1) {
+                    tac->op = TAC_GOTO;
+                    tac->arg1 = NULL;
+                    ++resolved;
+                } else if (direction == 0) {
+                    removeTAC(prev, cur);
+                    ++resolved;
+                    cur = next;
+                    continue;
+                }
+            }
+
+            int roles = getTACRoles(tac);
+            LatticeValue result = bottomValue;
+            if (roles & TAC_DEF_RES) {
+                result = evaluateExpression(&state, values, tac);
+            }
+            bool foldable = result.kind == LATTICE_CONST && tac->op != TAC_ASSIGN;
+            if (!foldable) {
+                if (roles & TAC_USE_ARG1) substituteOperand(&state, values, &tac->arg1, &replaced);
+                if (roles & TAC_USE_ARG2) substituteOperand(&state, values, &tac->arg2, &replaced);
+                if (roles & TAC_USE_RES) substituteOperand(&state, values, &tac->res, &replaced);
+            }
+            evaluateTAC(&state, values, tac);
+            if (foldable) {
+                tac->op = TAC_ASSIGN;
+                tac->arg1 = intToString(result.value);
+                tac->arg2 = NULL;
+                ++folded;
+            }
+            prev = cur;
+            cur = next;
+        }
+    }
+
+    fprintf(report, "%s: %d expressions folded, %d branches resolved, %d operands replaced\n",
+            cfg->funcName, folded, resolved, replaced);
+
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        free(state.in[b]);
+    }
+    free(state.in);
+    free(state.executable);
+    free(state.inWorklist);
+    free(state.worklist);
+    free(state.tracked);
+    free(values);
+    freeLiveness(state.liveness);
+}
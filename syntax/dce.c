@@ -0,0 +1,292 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+
+/* dead code elimination. the steps below are repeated until none of them changes the function,
+ * since each one exposes work for the others:
+ * 1. blocks not reachable from the entry (code after return, break, continue and goto) are removed.
+ *    their alloc TACs are kept because the variable may still be used elsewhere.
+ * 2. jumps to the label that follows them and labels that nothing jumps to are removed, which
+ *    merges the blocks the backpatching in minic.y leaves behind. jumps to a label followed by a
+ *    goto go to the target of the goto directly, e.g. the false exits of && in a condition.
+ * 3. TACs that only write a local scalar that is dead afterwards, and copies of a variable to
+ *    itself, are removed (Dragon Book 9.2.5). calls and =$ are kept for their side effects:
+ *    $addr may be a device register.
+ * 4. alloc TACs of locals that no other TAC refers to are removed.
+ */
+typedef struct NameSet {
+    char** names;
+    int num;
+    int capacity;
+} NameSet;
+
+static void addName(NameSet* set, char* name) {
+    if (set->num >= set->capacity) {
+        set->capacity = set->capacity == 0 ? 16 : set->capacity * 2;
+        set->names = (char**)realloc(set->names, set->capacity * sizeof(char*));
+        if (set->names == NULL) {
+            fprintf(stderr, "Failed to allocate memory for dead code elimination.\n");
+            exit(1);
+        }
+    }
+    set->names[set->num++] = name;
+}
+
+static int compareNames(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static bool hasName(NameSet* set, char* name) {
+    return set->num > 0 && bsearch(&name, set->names, set->num, sizeof(char*), compareNames) != NULL;
+}
+
+static bool isJump(TAC* tac) {
+    return tac->op == TAC_GOTO || tac->op == TAC_IF_GOTO || tac->op == TAC_IF_FALSE_GOTO ||
+           isCompareBranch(tac);
+}
+
+static bool isEndLabel(TAC* tac) {
+    return tac->op == TAC_LABEL && strcmp(tac->arg1, "end_func") == 0;
+}
+
+static int removeUnreachableBlocks(TACList* funcLabel) {
+    CFG* cfg = buildCFG(funcLabel);
+    int orderNum = 0;
+    BasicBlock** order = getReversePostorder(cfg, &orderNum);
+    bool* reachable = (bool*)calloc(cfg->blockNum + 1, sizeof(bool));
+    for (int i = 0; i < orderNum; ++i) {
+        reachable[order[i]->id] = true;
+    }
+
+    int removed = 0;
+    TACList* prev = funcLabel;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        TACList* cur = cfg->blocks[b]->first;
+        int tacNum = cfg->blocks[b]->tacNum;
+        for (int i = 0; i < tacNum; ++i) {
+            TACList* next = cur->next;
+            if (!reachable[b] && cur->tac->op != TAC_ALLOC) {
+                removeTAC(prev, cur);
+                ++removed;
+            } else {
+                prev = cur;
+            }
+            cur = next;
+        }
+    }
+
+    free(reachable);
+    free(order);
+    freeCFG(cfg);
+    return removed;
+}
+
+typedef struct JumpTarget {
+    char* label;
+    char* target; // of the goto after the label
+} JumpTarget;
+
+static int compareJumpTargets(const void* a, const void* b) {
+    return strcmp(((const JumpTarget*)a)->label, ((const JumpTarget*)b)->label);
+}
+
+// the end of the chain of gotos starting at label, or label itself if the gotos form a cycle
+static char* findFinalTarget(JumpTarget* targets, int num, char* label) {
+    char* target = label;
+    for (int hops = 0; hops <= num; ++hops) {
+        JumpTarget key = { target, NULL };
+        JumpTarget* entry = (JumpTarget*)bsearch(&key, targets, num, sizeof(JumpTarget), compareJumpTargets);
+        if (entry == NULL) return target;
+        target = entry->target;
+    }
+    return label;
+}
+
+static int threadJumps(TACList* funcLabel) {
+    int num = 0, capacity = 16;
+    JumpTarget* targets = (JumpTarget*)malloc(capacity * sizeof(JumpTarget));
+    for (TACList* cur = funcLabel->next; cur != NULL && !isEndLabel(cur->tac); cur = cur->next) {
+        if (cur->tac->op != TAC_LABEL) continue;
+        TACList* after = cur->next;
+        while (after != NULL && after->tac->op == TAC_LABEL) after = after->next;
+        if (after == NULL || after->tac->op != TAC_GOTO) continue;
+        if (num >= capacity) {
+            capacity *= 2;
+            targets = (JumpTarget*)realloc(targets, capacity * sizeof(JumpTarget));
+        }
+        targets[num].label = cur->tac->arg1;
+        targets[num].target = after->tac->res;
+        ++num;
+    }
+    qsort(targets, num, sizeof(JumpTarget), compareJumpTargets);
+
+    int threaded = 0;
+    for (TACList* cur = funcLabel->next; cur != NULL && !isEndLabel(cur->tac); cur = cur->next) {
+        if (!isJump(cur->tac)) continue;
+        char* target = findFinalTarget(targets, num, cur->tac->res);
+        if (strcmp(target, cur->tac->res) != 0) {
+            cur->tac->res = target;
+            ++threaded;
+        }
+    }
+    free(targets);
+    return threaded;
+}
+
+static int removeRedundantJumps(TACList* funcLabel) {
+    int removed = 0;
+    // jumps to one of the labels right after them
+    TACList* prev = funcLabel;
+    TACList* cur = funcLabel->next;
+    while (cur != NULL && !isEndLabel(cur->tac)) {
+        TACList* next = cur->next;
+        bool redundant = false;
+        if (isJump(cur->tac)) {
+            for (TACList* label = next; label != NULL && label->tac->op == TAC_LABEL; label = label->next) {
+                if (strcmp(label->tac->arg1, cur->tac->res) == 0) {
+                    redundant = true;
+                    break;
+                }
+            }
+        }
+        if (redundant) {
+            // the condition of ifGoto and the operands of if< etc. are variables, reading them has no side effect
+            removeTAC(prev, cur);
+            ++removed;
+        } else {
+            prev = cur;
+        }
+        cur = next;
+    }
+
+    // labels that are not the target of any jump
+    NameSet targets = { NULL, 0, 0 };
+    for (cur = funcLabel->next; cur != NULL && !isEndLabel(cur->tac); cur = cur->next) {
+        if (isJump(cur->tac)) addName(&targets, cur->tac->res);
+    }
+    if (targets.num > 0) qsort(targets.names, targets.num, sizeof(char*), compareNames);
+    prev = funcLabel;
+    cur = funcLabel->next;
+    while (cur != NULL && !isEndLabel(cur->tac)) {
+        TACList* next = cur->next;
+        if (cur->tac->op == TAC_LABEL && !hasName(&targets, cur->tac->arg1)) {
+            removeTAC(prev, cur);
+            ++removed;
+        } else {
+            prev = cur;
+        }
+        cur = next;
+    }
+    free(targets.names);
+    return removed;
+}
+
+static int removeDeadTACs(TACList* funcLabel) {
+    CFG* cfg = buildCFG(funcLabel);
+    Liveness* liveness = computeLiveness(cfg);
+    bool* local = findLocalScalars(cfg, liveness);
+    unsigned int* live = (unsigned int*)malloc(liveness->setWords * sizeof(unsigned int));
+    int capacity = 16;
+    TACList** nodes = (TACList**)malloc(capacity * sizeof(TACList*));
+
+    int removed = 0;
+    // blocks are visited backwards, so the node before a block has not been changed yet
+    for (int b = cfg->blockNum - 1; b >= 0; --b) {
+        BasicBlock* block = cfg->blocks[b];
+        if (block->tacNum + 1 > capacity) {
+            capacity = block->tacNum + 1;
+            nodes = (TACList**)realloc(nodes, capacity * sizeof(TACList*));
+        }
+        // nodes[0] is the node before the block
+        nodes[0] = b == 0 ? funcLabel : cfg->blocks[b - 1]->last;
+        TACList* cur = block->first;
+        for (int i = 1; i <= block->tacNum; ++i, cur = cur->next) {
+            nodes[i] = cur;
+        }
+
+        memcpy(live, liveness->liveOut[b], liveness->setWords * sizeof(unsigned int));
+        for (int i = block->tacNum; i >= 1; --i) {
+            TAC* tac = nodes[i]->tac;
+            int roles = getTACRoles(tac);
+            char* operands[3];
+            getTACVarOperands(tac, operands);
+            if (operands[2] != NULL && (roles & TAC_DEF_RES)) {
+                int num = getLivenessVar(liveness, operands[2]);
+                bool selfCopy = tac->op == TAC_ASSIGN && tac->arg1 != NULL && strcmp(tac->arg1, tac->res) == 0;
+                bool sideEffect = tac->op == TAC_CALL || tac->op == TAC_READ_ADDR;
+                if (selfCopy || (local[num] && !LIVE_SET_HAS(live, num) && !sideEffect)) {
+                    // nodes after i have been unlinked already, nodes[i - 1] is still its predecessor
+                    removeTAC(nodes[i - 1], nodes[i]);
+                    ++removed;
+                    continue;
+                }
+                LIVE_SET_DELETE(live, num);
+            }
+            for (int k = 0; k < 3; ++k) {
+                if (operands[k] == NULL || (k == 2 && !(roles & TAC_USE_RES))) continue;
+                LIVE_SET_ADD(live, getLivenessVar(liveness, operands[k]));
+            }
+        }
+    }
+
+    free(nodes);
+    free(live);
+    free(local);
+    freeLiveness(liveness);
+    freeCFG(cfg);
+    return removed;
+}
+
+static int removeUnusedAllocs(TACList* funcLabel) {
+    NameSet used = { NULL, 0, 0 };
+    TACList* cur;
+    for (cur = funcLabel->next; cur != NULL && !isEndLabel(cur->tac); cur = cur->next) {
+        if (cur->tac->op == TAC_ALLOC) continue;
+        char* operands[3];
+        getTACVarOperands(cur->tac, operands);
+        for (int k = 0; k < 3; ++k) {
+            if (operands[k] != NULL) addName(&used, operands[k]);
+        }
+    }
+    if (used.num > 0) qsort(used.names, used.num, sizeof(char*), compareNames);
+
+    int removed = 0;
+    TACList* prev = funcLabel;
+    cur = funcLabel->next;
+    while (cur != NULL && !isEndLabel(cur->tac)) {
+        TACList* next = cur->next;
+        if (cur->tac->op == TAC_ALLOC && !hasName(&used, cur->tac->res)) {
+            removeTAC(prev, cur);
+            ++removed;
+        } else {
+            prev = cur;
+        }
+        cur = next;
+    }
+    free(used.names);
+    return removed;
+}
+
+void eliminateDeadCode(CFG* cfg, FILE* report) {
+    // the steps rebuild their own CFGs, only the function label of cfg is used
+    TACList* funcLabel = cfg->funcLabel;
+    int unreachable = 0, jumps = 0, dead = 0, allocs = 0, threaded = 0;
+    bool changed = true;
+    while (changed) {
+        int removed = removeUnreachableBlocks(funcLabel);
+        unreachable += removed;
+        int threadedJumps = threadJumps(funcLabel);
+        threaded += threadedJumps;
+        int removedJumps = removeRedundantJumps(funcLabel);
+        jumps += removedJumps;
+        int removedDead = removeDeadTACs(funcLabel);
+        dead += removedDead;
+        // allocs kept from unreachable blocks may separate a jump from its label
+        int removedAllocs = removeUnusedAllocs(funcLabel);
+        allocs += removedAllocs;
+        changed = removed + threadedJumps + removedJumps + removedDead + removedAllocs > 0;
+    }
+
+    fprintf(report, "%s: %d TACs eliminated (%d unreachable, %d dead, %d jumps and labels, %d declarations), %d jumps threaded\n",
+            cfg->funcName, unreachable + jumps + dead + allocs, unreachable, dead, jumps, allocs, threaded);
+}
@@ -0,0 +1,366 @@
+#include "encode.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define ROM_WORDS (ROM_SIZE / WORD_LENGTH_BYTE)
+#define RAM_WORDS (RAM_SIZE / WORD_LENGTH_BYTE)
+
+// 符号到地址的哈希表，符号都在 AsmContainer 的符号池中，按指针比较
+typedef struct SymbolAddress {
+    const char* name;
+    unsigned int address;
+} SymbolAddress;
+
+typedef struct Layout {
+    AsmContainer* container;
+    SymbolAddress* symbols;
+    unsigned int symbolTableSize;
+    unsigned int* address;      // .text 中每条指令的字节地址
+    bool* relaxed;              // 改写为反向分支加 j 的 beq/bne
+    unsigned int textSize;      // 字节数
+    unsigned int dataSize;
+    int relaxedNum;
+} Layout;
+
+static void encodeError(const char* message, const char* detail) {
+    fprintf(stderr, "Machine code error: %s %s\n", message, detail == NULL ? "" : detail);
+    exit(1);
+}
+
+static SymbolAddress* findSymbolAddress(Layout* layout, const char* name, bool create) {
+    unsigned int mask = layout->symbolTableSize - 1;
+    unsigned int slot = (unsigned int)(((size_t)name >> 3) & mask);
+    while (layout->symbols[slot].name != NULL) {
+        if (layout->symbols[slot].name == name) return &layout->symbols[slot];
+        slot = (slot + 1) & mask;
+    }
+    if (!create) return NULL;
+    layout->symbols[slot].name = name;
+    return &layout->symbols[slot];
+}
+
+static void defineSymbol(Layout* layout, const char* name, unsigned int address) {
+    findSymbolAddress(layout, name, true)->address = address;
+}
+
+static unsigned int symbolAddress(Layout* layout, const char* name) {
+    SymbolAddress* symbol = findSymbolAddress(layout, name, false);
+    if (symbol == NULL) encodeError("undefined symbol", name);
+    return symbol->address;
+}
+
+// 数据定义 "name: .word 1, 2" 或 "name: .space 64"，label 返回 name 在符号池中的指针，没有时为 NULL
+static const char* parseDataLine(Layout* layout, const char* text, char* directive, size_t size, const char** rest) {
+    const char* label = NULL;
+    const char* colon = strchr(text, ':');
+    while (isspace((unsigned char)*text)) ++text;
+    if (colon != NULL) {
+        char name[MAX_LINE_LENGTH];
+        size_t length = (size_t)(colon - text);
+        if (length >= sizeof(name)) length = sizeof(name) - 1;
+        memcpy(name, text, length);
+        name[length] = '\0';
+        label = internSymbol(&layout->container->symbols, name);
+        text = colon + 1;
+    }
+    while (isspace((unsigned char)*text)) ++text;
+    size_t length = 0;
+    while (text[length] != '\0' && !isspace((unsigned char)text[length]) && length + 1 < size) {
+        directive[length] = text[length];
+        ++length;
+    }
+    directive[length] = '\0';
+    *rest = text + length;
+    return label;
+}
+
+static unsigned int wordCount(const char* values) {
+    unsigned int count = 1;
+    for (; *values != '\0'; ++values) {
+        if (*values == ',') ++count;
+    }
+    return count;
+}
+
+// 给 .data 中的符号分配 RAM 地址，可以写入 ram 时同时写入初值
+static void layoutData(Layout* layout, unsigned int* ram) {
+    AsmContainer* container = layout->container;
+    bool inData = false;
+    unsigned int address = 0;
+    for (unsigned int i = 0; i < container->size; ++i) {
+        Instr* instr = &container->instrs[i];
+        if (instr->op != INSTR_DIRECTIVE) continue;
+        char directive[32];
+        const char* rest;
+        const char* label = parseDataLine(layout, instr->symbol, directive, sizeof(directive), &rest);
+        if (strcmp(directive, ".data") == 0 || strcmp(directive, ".text") == 0) {
+            inData = strcmp(directive, ".data") == 0;
+            continue;
+        }
+        if (!inData) continue;
+        if (label != NULL) defineSymbol(layout, label, address);
+        if (strcmp(directive, ".word") == 0) {
+            unsigned int count = wordCount(rest);
+            if (address + count * WORD_LENGTH_BYTE > RAM_SIZE) encodeError("data exceeds RAM_SIZE at", label);
+            for (unsigned int k = 0; k < count; ++k) {
+                char* end;
+                long value = strtol(rest, &end, 0);
+                if (ram != NULL) ram[address / WORD_LENGTH_BYTE] = (unsigned int)value;
+                rest = strchr(end, ',') != NULL ? strchr(end, ',') + 1 : end;
+                address += WORD_LENGTH_BYTE;
+            }
+        } else if (strcmp(directive, ".space") == 0) {
+            unsigned int bytes = (unsigned int)strtoul(rest, NULL, 0);
+            // 下一个符号按字对齐
+            address += (bytes + WORD_LENGTH_BYTE - 1) / WORD_LENGTH_BYTE * WORD_LENGTH_BYTE;
+            if (address > RAM_SIZE) encodeError("data exceeds RAM_SIZE at", label);
+        }
+    }
+    layout->dataSize = address;
+}
+
+static bool isBranch(const Instr* instr) {
+    return instr->op == INSTR_BEQ || instr->op == INSTR_BNE;
+}
+
+// 给 .text 中的指令分配 ROM 地址，返回是否有新的分支需要松弛
+static bool layoutText(Layout* layout) {
+    AsmContainer* container = layout->container;
+    bool inText = false;
+    unsigned int address = 0;
+    for (unsigned int i = 0; i < container->size; ++i) {
+        Instr* instr = &container->instrs[i];
+        layout->address[i] = address;
+        if (instr->op == INSTR_DIRECTIVE) {
+            if (strncmp(instr->symbol, ".text", 5) == 0) inText = true;
+            if (strncmp(instr->symbol, ".data", 5) == 0) inText = false;
+            continue;
+        }
+        if (!inText) continue;
+        if (instr->op == INSTR_LABEL) {
+            defineSymbol(layout, instr->symbol, address);
+            continue;
+        }
+        if (instr->op == INSTR_UNKNOWN) encodeError("cannot encode", instr->symbol);
+        address += WORD_LENGTH_BYTE;
+        // 松弛后的分支在延迟槽之后多出 j 和它的延迟槽
+        if (i > 0 && layout->relaxed[i - 1]) address += 2 * WORD_LENGTH_BYTE;
+    }
+    layout->textSize = address;
+    if (address > ROM_SIZE) encodeError("code exceeds ROM_SIZE", NULL);
+
+    bool changed = false;
+    for (unsigned int i = 0; i < container->size; ++i) {
+        Instr* instr = &container->instrs[i];
+        if (!isBranch(instr) || layout->relaxed[i]) continue;
+        long offset = ((long)symbolAddress(layout, instr->symbol) - (long)(layout->address[i] + WORD_LENGTH_BYTE)) / WORD_LENGTH_BYTE;
+        if (offset < -32768 || offset > 32767) {
+            layout->relaxed[i] = true;
+            layout->relaxedNum++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/* Minisys 中的寄存器号：ra 与 x31 互换，其余不变 */
+static unsigned int physicalRegister(int reg) {
+    if (reg < 0) return 0;
+    if (reg == 1) return 31;
+    if (reg == 31) return 1;
+    return (unsigned int)reg;
+}
+
+static unsigned int encodeR(int rs, int rt, int rd, unsigned int shamt, unsigned int funct) {
+    return (physicalRegister(rs) << 21) | (physicalRegister(rt) << 16) | (physicalRegister(rd) << 11) |
+           ((shamt & 0x1f) << 6) | funct;
+}
+
+/* andi/ori/xori 的立即数零扩展，lui 装入高 16 位，其余 I 型指令（包括访存的偏移和分支的位移）符号扩展 */
+static bool immediateFits(InstrOp op, long imm) {
+    if (op == INSTR_ANDI || op == INSTR_ORI || op == INSTR_XORI || op == INSTR_LUI) {
+        return imm >= 0 && imm <= 65535;
+    }
+    return imm >= -32768 && imm <= 32767;
+}
+
+static unsigned int encodeI(unsigned int opcode, int rs, int rt, long imm, const Instr* instr) {
+    if (!immediateFits(instr->op, imm)) {
+        char text[MAX_LINE_LENGTH];
+        formatInstr(instr, text, sizeof(text));
+        encodeError("immediate out of range in", text);
+    }
+    return (opcode << 26) | (physicalRegister(rs) << 21) | (physicalRegister(rt) << 16) | ((unsigned int)imm & 0xffff);
+}
+
+static unsigned int encodeJ(unsigned int opcode, unsigned int target) {
+    return (opcode << 26) | ((target / WORD_LENGTH_BYTE) & 0x3ffffff);
+}
+
+static long immediateOf(Layout* layout, const Instr* instr) {
+    return instr->symbol != NULL ? (long)symbolAddress(layout, instr->symbol) + instr->imm : instr->imm;
+}
+
+static unsigned int encodeInstr(Layout* layout, const Instr* instr, unsigned int address, unsigned int target) {
+    long imm = immediateOf(layout, instr);
+    long offset = ((long)target - (long)(address + WORD_LENGTH_BYTE)) / WORD_LENGTH_BYTE;
+    switch (instr->op) {
+        case INSTR_ADD: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x20);
+        case INSTR_ADDU: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x21);
+        case INSTR_SUB: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x22);
+        case INSTR_SUBU: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x23);
+        case INSTR_AND: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x24);
+        case INSTR_OR: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x25);
+        case INSTR_XOR: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x26);
+        case INSTR_NOR: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x27);
+        case INSTR_SLT: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x2a);
+        case INSTR_SLTU: return encodeR(instr->rs, instr->rt, instr->rd, 0, 0x2b);
+        // sllv rd, rs, rt 表示 rd = rs << rt，MIPS 编码中被移位的数在 rt 字段，移位量在 rs 字段
+        case INSTR_SLLV: return encodeR(instr->rt, instr->rs, instr->rd, 0, 0x04);
+        case INSTR_SRLV: return encodeR(instr->rt, instr->rs, instr->rd, 0, 0x06);
+        case INSTR_SRAV: return encodeR(instr->rt, instr->rs, instr->rd, 0, 0x07);
+        case INSTR_SLL: return encodeR(0, instr->rs, instr->rd, (unsigned int)imm, 0x00);
+        case INSTR_SRL: return encodeR(0, instr->rs, instr->rd, (unsigned int)imm, 0x02);
+        case INSTR_SRA: return encodeR(0, instr->rs, instr->rd, (unsigned int)imm, 0x03);
+        case INSTR_JR: return encodeR(instr->rs, 0, 0, 0, 0x08);
+        case INSTR_MV: return encodeR(instr->rs, 0, instr->rd, 0, 0x21);
+        case INSTR_NOP: return 0;
+        case INSTR_ADDI: return encodeI(0x08, instr->rs, instr->rd, imm, instr);
+        case INSTR_ADDIU: return encodeI(0x09, instr->rs, instr->rd, imm, instr);
+        case INSTR_SLTI: return encodeI(0x0a, instr->rs, instr->rd, imm, instr);
+        case INSTR_SLTIU: return encodeI(0x0b, instr->rs, instr->rd, imm, instr);
+        case INSTR_ANDI: return encodeI(0x0c, instr->rs, instr->rd, imm, instr);
+        case INSTR_ORI: return encodeI(0x0d, instr->rs, instr->rd, imm, instr);
+        case INSTR_XORI: return encodeI(0x0e, instr->rs, instr->rd, imm, instr);
+        case INSTR_LUI: return encodeI(0x0f, 0, instr->rd, imm, instr);
+        case INSTR_LW: return encodeI(0x23, instr->rs, instr->rd, imm, instr);
+        case INSTR_LH: return encodeI(0x21, instr->rs, instr->rd, imm, instr);
+        case INSTR_LBU: return encodeI(0x24, instr->rs, instr->rd, imm, instr);
+        case INSTR_SW: return encodeI(0x2b, instr->rs, instr->rt, imm, instr);
+        case INSTR_SH: return encodeI(0x29, instr->rs, instr->rt, imm, instr);
+        case INSTR_SB: return encodeI(0x28, instr->rs, instr->rt, imm, instr);
+        case INSTR_BEQ: return encodeI(0x04, instr->rs, instr->rt, offset, instr);
+        case INSTR_BNE: return encodeI(0x05, instr->rs, instr->rt, offset, instr);
+        case INSTR_J: return encodeJ(0x02, target);
+        case INSTR_JAL: return encodeJ(0x03, target);
+        default: break;
+    }
+    encodeError("cannot encode", instr->symbol);
+    return 0;
+}
+
+static void encodeText(Layout* layout, unsigned int* rom) {
+    AsmContainer* container = layout->container;
+    bool inText = false;
+    for (unsigned int i = 0; i < container->size; ++i) {
+        Instr* instr = &container->instrs[i];
+        if (instr->op == INSTR_DIRECTIVE) {
+            if (strncmp(instr->symbol, ".text", 5) == 0) inText = true;
+            if (strncmp(instr->symbol, ".data", 5) == 0) inText = false;
+            continue;
+        }
+        if (!inText || instr->op == INSTR_LABEL) continue;
+        unsigned int address = layout->address[i];
+        bool jumps = isBranch(instr) || instr->op == INSTR_J || instr->op == INSTR_JAL;
+        unsigned int target = jumps ? symbolAddress(layout, instr->symbol) : 0;
+        if (layout->relaxed[i]) {
+            // beq a, b, L; slot => bne a, b, next; slot; j L; nop; next:
+            Instr inverted = *instr;
+            inverted.op = instr->op == INSTR_BEQ ? INSTR_BNE : INSTR_BEQ;
+            rom[address / WORD_LENGTH_BYTE] = encodeInstr(layout, &inverted, address, address + 4 * WORD_LENGTH_BYTE);
+            Instr jump = {INSTR_J, -1, -1, -1, 0, instr->symbol};
+            rom[address / WORD_LENGTH_BYTE + 2] = encodeInstr(layout, &jump, address + 2 * WORD_LENGTH_BYTE, target);
+            rom[address / WORD_LENGTH_BYTE + 3] = 0;
+            continue;
+        }
+        rom[address / WORD_LENGTH_BYTE] = encodeInstr(layout, instr, address, target);
+    }
+}
+
+static FILE* openImage(const char* baseName, const char* suffix) {
+    char* filename = (char*)malloc(strlen(baseName) + strlen(suffix) + 1);
+    strcpy(filename, baseName);
+    strcat(filename, suffix);
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        perror("Error opening file.\n");
+        exit(1);
+    }
+    free(filename);
+    return file;
+}
+
+static void writeImage(const char* baseName, const char* region, unsigned int* words, unsigned int wordNum) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_%s.bin", region);
+    FILE* bin = openImage(baseName, suffix);
+    for (unsigned int i = 0; i < wordNum; ++i) {
+        unsigned char bytes[4] = {
+            (unsigned char)(words[i] >> 24), (unsigned char)(words[i] >> 16),
+            (unsigned char)(words[i] >> 8), (unsigned char)words[i],
+        };
+        fwrite(bytes, 1, sizeof(bytes), bin);
+    }
+    fclose(bin);
+
+    snprintf(suffix, sizeof(suffix), "_%s.coe", region);
+    FILE* coe = openImage(baseName, suffix);
+    fprintf(coe, "memory_initialization_radix = 16;\nmemory_initialization_vector =\n");
+    for (unsigned int i = 0; i < wordNum; ++i) {
+        fprintf(coe, "%08x%s\n", words[i], i + 1 < wordNum ? "," : ";");
+    }
+    fclose(coe);
+
+    snprintf(suffix, sizeof(suffix), "_%s.mif", region);
+    FILE* mif = openImage(baseName, suffix);
+    fprintf(mif, "DEPTH = %u;\nWIDTH = %d;\nADDRESS_RADIX = HEX;\nDATA_RADIX = HEX;\nCONTENT\nBEGIN\n",
+            wordNum, WORD_LENGTH_BIT);
+    for (unsigned int i = 0; i < wordNum; ++i) {
+        fprintf(mif, "%04x : %08x;\n", i, words[i]);
+    }
+    fprintf(mif, "END;\n");
+    fclose(mif);
+}
+
+void emitStartup(AsmContainer* container) {
+    newAsm(container, "__start:");
+    emitLoadImmediate(container, "sp", RAM_SIZE);
+    newAsm(container, "jal main");
+    newAsm(container, "nop"); // delay-slot
+    newAsm(container, "__halt:");
+    newAsm(container, "j __halt");
+    newAsm(container, "nop"); // delay-slot
+}
+
+void writeMachineCode(AsmContainer* container, const char* baseName, FILE* report) {
+    Layout layout;
+    layout.container = container;
+    layout.symbolTableSize = 64;
+    while (layout.symbolTableSize < container->size * 2) layout.symbolTableSize *= 2;
+    layout.symbols = (SymbolAddress*)calloc(layout.symbolTableSize, sizeof(SymbolAddress));
+    layout.address = (unsigned int*)calloc(container->size + 1, sizeof(unsigned int));
+    layout.relaxed = (bool*)calloc(container->size + 1, sizeof(bool));
+    unsigned int* rom = (unsigned int*)calloc(ROM_WORDS, sizeof(unsigned int));
+    unsigned int* ram = (unsigned int*)calloc(RAM_WORDS, sizeof(unsigned int));
+    if (layout.symbols == NULL || layout.address == NULL || layout.relaxed == NULL || rom == NULL || ram == NULL) {
+        fprintf(stderr, "Failed to allocate memory for machine code\n");
+        exit(1);
+    }
+    layout.relaxedNum = 0;
+
+    layoutData(&layout, ram);
+    while (layoutText(&layout)) {
+    }
+    encodeText(&layout, rom);
+    writeImage(baseName, "rom", rom, ROM_WORDS);
+    writeImage(baseName, "ram", ram, RAM_WORDS);
+
+    fprintf(report, "[MACHINE CODE] %u bytes of code, %u bytes of data, %d branches relaxed\n",
+            layout.textSize, layout.dataSize, layout.relaxedNum);
+    free(rom);
+    free(ram);
+    free(layout.relaxed);
+    free(layout.address);
+    free(layout.symbols);
+}
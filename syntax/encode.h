@@ -0,0 +1,24 @@
+#ifndef ENCODE_H
+#define ENCODE_H
+
+#include <stdio.h>
+#include "asm.h"
+
+/* 机器码生成
+ * 把 AsmContainer 中的指令编码为 32 位 Minisys 指令字（MIPS32 的编码格式），生成 ROM 和 RAM 的初始化文件，
+ * 不再经过外部汇编器：
+ * - .text 从 ROM 地址 0 开始，标号为指令的字节地址；.data 从 RAM 地址 0 开始，符号为数据的字节地址
+ * - beq/bne 的偏移超出 16 位时改写为反向分支跳过一条 j（分支范围松弛），反复计算地址直到不再变化
+ * - 汇编中的 ra（x1）和 x31 在编码时互换：Minisys 的 jal 把返回地址写入 $31
+ * - mv 编码为 addu rd, rs, zero，nop 编码为全 0
+ * 每个区域写出 .bin（大端序的字）、Xilinx .coe 和 .mif 三种文件，深度为 ROM_SIZE/RAM_SIZE 个字节对应的字数。
+ * 编码失败（未定义的符号、立即数超出范围、超出 ROM/RAM 容量）时报错并退出。
+ */
+
+// 在 .text 的开头生成启动代码：sp 指向 RAM 末尾，调用 main，返回后原地循环
+void emitStartup(AsmContainer* container);
+
+// 编码并写出 <baseName>_rom.{bin,coe,mif} 和 <baseName>_ram.{bin,coe,mif}，统计写入 report
+void writeMachineCode(AsmContainer* container, const char* baseName, FILE* report);
+
+#endif // ENCODE_H
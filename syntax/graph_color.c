@@ -0,0 +1,526 @@
+#include "regalloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include "symbol_table.h"
+
+/* 图着色寄存器分配，迭代合并（George & Appel, 1996；虎书11.4）
+ * 冲突图的结点是可分配的变量，再加上每个可分配寄存器一个预着色结点。跨过 call 的变量与所有
+ * 调用者保存寄存器冲突，因此只能得到被调用者保存寄存器。(=, y, , x) 中 x 和 y 不冲突时合并，
+ * 这样语法分析为每个赋值生成的 t = a + b; x = t; 中的复制就不再生成指令。
+ * 溢出的变量由代码生成用临时寄存器 x30/x31 访问，不需要改写代码后重新着色。
+ */
+#define COLOR_NUM (CALLER_SAVED_REG_NUM + CALLEE_SAVED_REG_NUM)
+
+typedef enum NodeState {
+    NODE_PRECOLORED,
+    NODE_INITIAL,
+    NODE_SIMPLIFY,
+    NODE_FREEZE,
+    NODE_SPILL,
+    NODE_SPILLED,
+    NODE_COALESCED,
+    NODE_COLORED,
+    NODE_SELECT,
+} NodeState;
+
+typedef enum MoveState {
+    MOVE_WORKLIST,
+    MOVE_ACTIVE,
+    MOVE_COALESCED,
+    MOVE_CONSTRAINED,
+    MOVE_FROZEN,
+} MoveState;
+
+typedef struct Move {
+    int src;
+    int dst;
+    MoveState state;
+} Move;
+
+typedef struct NodeList {
+    int* nodes;
+    int num;
+    int capacity;
+} NodeList;
+
+typedef struct ColorGraph {
+    int nodeNum;              // 前 COLOR_NUM 个是预着色结点
+    unsigned char* adjSet;    // nodeNum * nodeNum 的位矩阵
+    NodeList* adjList;        // 预着色结点没有邻接表
+    int* degree;
+    int* alias;
+    int* color;
+    NodeState* state;
+    int* location;            // 结点 -> RegAssignment.locations 的下标
+    int* useCount;            // 溢出代价：出现的次数
+    NodeList* moveList;       // 结点相关的 move 下标
+    Move* moves;
+    int moveNum;
+    int moveCapacity;
+    int* selectStack;
+    int selectNum;
+} ColorGraph;
+
+static void listAdd(NodeList* list, int node) {
+    if (list->num >= list->capacity) {
+        list->capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+        list->nodes = (int*)realloc(list->nodes, list->capacity * sizeof(int));
+    }
+    list->nodes[list->num++] = node;
+}
+
+static int colorToReg(int color) {
+    return color < CALLER_SAVED_REG_NUM ? callerSavedRegs[color] : calleeSavedRegs[color - CALLER_SAVED_REG_NUM];
+}
+
+static bool isPrecolored(ColorGraph* graph, int node) {
+    return graph->state[node] == NODE_PRECOLORED;
+}
+
+static bool adjacentTo(ColorGraph* graph, int u, int v) {
+    int bit = u * graph->nodeNum + v;
+    return (graph->adjSet[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static void addEdge(ColorGraph* graph, int u, int v) {
+    if (u == v || adjacentTo(graph, u, v)) return;
+    int bit = u * graph->nodeNum + v;
+    graph->adjSet[bit >> 3] |= 1 << (bit & 7);
+    bit = v * graph->nodeNum + u;
+    graph->adjSet[bit >> 3] |= 1 << (bit & 7);
+    if (!isPrecolored(graph, u)) {
+        listAdd(&graph->adjList[u], v);
+        graph->degree[u]++;
+    }
+    if (!isPrecolored(graph, v)) {
+        listAdd(&graph->adjList[v], u);
+        graph->degree[v]++;
+    }
+}
+
+static void addMove(ColorGraph* graph, int src, int dst) {
+    if (graph->moveNum >= graph->moveCapacity) {
+        graph->moveCapacity = graph->moveCapacity == 0 ? 16 : graph->moveCapacity * 2;
+        graph->moves = (Move*)realloc(graph->moves, graph->moveCapacity * sizeof(Move));
+    }
+    graph->moves[graph->moveNum].src = src;
+    graph->moves[graph->moveNum].dst = dst;
+    graph->moves[graph->moveNum].state = MOVE_WORKLIST;
+    listAdd(&graph->moveList[src], graph->moveNum);
+    listAdd(&graph->moveList[dst], graph->moveNum);
+    graph->moveNum++;
+}
+
+static bool isMoveActive(ColorGraph* graph, int move) {
+    return graph->moves[move].state == MOVE_ACTIVE || graph->moves[move].state == MOVE_WORKLIST;
+}
+
+static bool moveRelated(ColorGraph* graph, int node) {
+    for (int i = 0; i < graph->moveList[node].num; ++i) {
+        if (isMoveActive(graph, graph->moveList[node].nodes[i])) return true;
+    }
+    return false;
+}
+
+// 邻接表中去掉已经入栈或被合并的结点
+static bool isAdjacentVisible(ColorGraph* graph, int node) {
+    return graph->state[node] != NODE_SELECT && graph->state[node] != NODE_COALESCED;
+}
+
+static int getAlias(ColorGraph* graph, int node) {
+    while (graph->state[node] == NODE_COALESCED) {
+        node = graph->alias[node];
+    }
+    return node;
+}
+
+static void enableMoves(ColorGraph* graph, int node) {
+    for (int i = 0; i < graph->moveList[node].num; ++i) {
+        int move = graph->moveList[node].nodes[i];
+        if (graph->moves[move].state == MOVE_ACTIVE) {
+            graph->moves[move].state = MOVE_WORKLIST;
+        }
+    }
+}
+
+static void decrementDegree(ColorGraph* graph, int node) {
+    if (isPrecolored(graph, node)) return;
+    int d = graph->degree[node]--;
+    if (d == COLOR_NUM) {
+        enableMoves(graph, node);
+        for (int i = 0; i < graph->adjList[node].num; ++i) {
+            int adj = graph->adjList[node].nodes[i];
+            if (isAdjacentVisible(graph, adj)) enableMoves(graph, adj);
+        }
+        if (graph->state[node] == NODE_SPILL) {
+            graph->state[node] = moveRelated(graph, node) ? NODE_FREEZE : NODE_SIMPLIFY;
+        }
+    }
+}
+
+static void addWorkList(ColorGraph* graph, int node) {
+    if (!isPrecolored(graph, node) && !moveRelated(graph, node) && graph->degree[node] < COLOR_NUM
+        && graph->state[node] == NODE_FREEZE) {
+        graph->state[node] = NODE_SIMPLIFY;
+    }
+}
+
+static bool ok(ColorGraph* graph, int t, int r) {
+    return graph->degree[t] < COLOR_NUM || isPrecolored(graph, t) || adjacentTo(graph, t, r);
+}
+
+// Briggs 条件：合并后高度数的邻居少于 K 个
+static bool conservative(ColorGraph* graph, int u, int v) {
+    int k = 0;
+    unsigned char* counted = (unsigned char*)calloc(graph->nodeNum, 1);
+    for (int pass = 0; pass < 2; ++pass) {
+        NodeList* list = &graph->adjList[pass == 0 ? u : v];
+        for (int i = 0; i < list->num; ++i) {
+            int node = list->nodes[i];
+            if (!isAdjacentVisible(graph, node) || counted[node]) continue;
+            counted[node] = 1;
+            if (isPrecolored(graph, node) || graph->degree[node] >= COLOR_NUM) k++;
+        }
+    }
+    free(counted);
+    return k < COLOR_NUM;
+}
+
+static void combine(ColorGraph* graph, int u, int v) {
+    graph->state[v] = NODE_COALESCED;
+    graph->alias[v] = u;
+    for (int i = 0; i < graph->moveList[v].num; ++i) {
+        listAdd(&graph->moveList[u], graph->moveList[v].nodes[i]);
+    }
+    enableMoves(graph, v);
+    for (int i = 0; i < graph->adjList[v].num; ++i) {
+        int t = graph->adjList[v].nodes[i];
+        if (!isAdjacentVisible(graph, t)) continue;
+        addEdge(graph, t, u);
+        decrementDegree(graph, t);
+    }
+    if (graph->degree[u] >= COLOR_NUM && graph->state[u] == NODE_FREEZE) {
+        graph->state[u] = NODE_SPILL;
+    }
+}
+
+static void coalesce(ColorGraph* graph, int move) {
+    int x = getAlias(graph, graph->moves[move].src);
+    int y = getAlias(graph, graph->moves[move].dst);
+    int u = x, v = y;
+    if (isPrecolored(graph, y)) {
+        u = y;
+        v = x;
+    }
+    if (u == v) {
+        graph->moves[move].state = MOVE_COALESCED;
+        addWorkList(graph, u);
+    } else if (isPrecolored(graph, v) || adjacentTo(graph, u, v)) {
+        graph->moves[move].state = MOVE_CONSTRAINED;
+        addWorkList(graph, u);
+        addWorkList(graph, v);
+    } else {
+        bool canCombine = true;
+        if (isPrecolored(graph, u)) {
+            // George 条件
+            for (int i = 0; i < graph->adjList[v].num && canCombine; ++i) {
+                int t = graph->adjList[v].nodes[i];
+                if (isAdjacentVisible(graph, t) && !ok(graph, t, u)) canCombine = false;
+            }
+        } else {
+            canCombine = conservative(graph, u, v);
+        }
+        if (canCombine) {
+            graph->moves[move].state = MOVE_COALESCED;
+            combine(graph, u, v);
+            addWorkList(graph, u);
+        } else {
+            graph->moves[move].state = MOVE_ACTIVE;
+        }
+    }
+}
+
+static void freezeMoves(ColorGraph* graph, int u) {
+    for (int i = 0; i < graph->moveList[u].num; ++i) {
+        int move = graph->moveList[u].nodes[i];
+        if (!isMoveActive(graph, move)) continue;
+        int x = graph->moves[move].src;
+        int y = graph->moves[move].dst;
+        int v = getAlias(graph, y) == getAlias(graph, u) ? getAlias(graph, x) : getAlias(graph, y);
+        graph->moves[move].state = MOVE_FROZEN;
+        if (graph->state[v] == NODE_FREEZE && !moveRelated(graph, v) && graph->degree[v] < COLOR_NUM) {
+            graph->state[v] = NODE_SIMPLIFY;
+        }
+    }
+}
+
+static void simplify(ColorGraph* graph, int node) {
+    graph->state[node] = NODE_SELECT;
+    graph->selectStack[graph->selectNum++] = node;
+    for (int i = 0; i < graph->adjList[node].num; ++i) {
+        int adj = graph->adjList[node].nodes[i];
+        if (isAdjacentVisible(graph, adj)) decrementDegree(graph, adj);
+    }
+}
+
+// 每一步按简化、合并、冻结、溢出的优先级处理一个结点或 move，没有可处理的返回 false
+static bool step(ColorGraph* graph) {
+    for (int i = COLOR_NUM; i < graph->nodeNum; ++i) {
+        if (graph->state[i] == NODE_SIMPLIFY) {
+            simplify(graph, i);
+            return true;
+        }
+    }
+    for (int i = 0; i < graph->moveNum; ++i) {
+        if (graph->moves[i].state == MOVE_WORKLIST) {
+            coalesce(graph, i);
+            return true;
+        }
+    }
+    for (int i = COLOR_NUM; i < graph->nodeNum; ++i) {
+        if (graph->state[i] == NODE_FREEZE) {
+            graph->state[i] = NODE_SIMPLIFY;
+            freezeMoves(graph, i);
+            return true;
+        }
+    }
+    // 选择 代价/度数 最小的结点作为潜在溢出
+    int best = -1;
+    for (int i = COLOR_NUM; i < graph->nodeNum; ++i) {
+        if (graph->state[i] != NODE_SPILL) continue;
+        if (best == -1 || (long)graph->useCount[i] * graph->degree[best] < (long)graph->useCount[best] * graph->degree[i]) {
+            best = i;
+        }
+    }
+    if (best != -1) {
+        graph->state[best] = NODE_SIMPLIFY;
+        freezeMoves(graph, best);
+        return true;
+    }
+    return false;
+}
+
+static void assignColors(ColorGraph* graph) {
+    while (graph->selectNum > 0) {
+        int node = graph->selectStack[--graph->selectNum];
+        bool okColors[COLOR_NUM];
+        for (int c = 0; c < COLOR_NUM; ++c) okColors[c] = true;
+        for (int i = 0; i < graph->adjList[node].num; ++i) {
+            int w = getAlias(graph, graph->adjList[node].nodes[i]);
+            if (graph->state[w] == NODE_COLORED || isPrecolored(graph, w)) {
+                okColors[graph->color[w]] = false;
+            }
+        }
+        graph->state[node] = NODE_SPILLED;
+        for (int c = 0; c < COLOR_NUM; ++c) {
+            if (okColors[c]) {
+                graph->state[node] = NODE_COLORED;
+                graph->color[node] = c;
+                break;
+            }
+        }
+    }
+}
+
+// 冲突图的结点编号：预着色结点在前，之后是 liveness 中可分配的变量
+static int nodeOf(int* nodeOfVar, Liveness* liveness, const char* var) {
+    int num = getLivenessVar(liveness, var);
+    return num == -1 ? -1 : nodeOfVar[num];
+}
+
+static bool isMove(TAC* tac) {
+    return tac->op == TAC_ASSIGN && tac->arg1 != NULL && tac->res != NULL;
+}
+
+static void buildGraph(ColorGraph* graph, RegAssignment* assignment, CFG* cfg, Liveness* liveness, int* nodeOfVar) {
+    int words = liveness->setWords;
+    unsigned int* live = (unsigned int*)malloc(words * sizeof(unsigned int));
+    int callerSavedNodes[CALLER_SAVED_REG_NUM];
+    for (int i = 0; i < CALLER_SAVED_REG_NUM; ++i) callerSavedNodes[i] = i;
+    // 实参在 call 时才传递，param 中的变量一直活跃到 call。实参中有 && 或 || 时 param 和 call 不在同一个块中，
+    // 因此按代码顺序记录还在等待 call 的 param，跨块传递（与 linear_scan.c 的 pendingParams 相同）
+    unsigned int* pendingIn = (unsigned int*)calloc(words, sizeof(unsigned int));
+
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        BasicBlock* block = cfg->blocks[b];
+        TAC** tacs = (TAC**)malloc((block->tacNum + 1) * sizeof(TAC*));
+        TACList* cur = block->first;
+        for (int j = 0; j < block->tacNum; ++j, cur = cur->next) {
+            tacs[j] = cur->tac;
+        }
+        // pending[j] 是第 j 条四元式之前等待 call 的 param 变量
+        unsigned int* pending = (unsigned int*)malloc((size_t)(block->tacNum + 1) * words * sizeof(unsigned int));
+        memcpy(pending, pendingIn, words * sizeof(unsigned int));
+        for (int j = 0; j < block->tacNum; ++j) {
+            unsigned int* next = pending + (size_t)(j + 1) * words;
+            if (tacs[j]->op == TAC_CALL) {
+                memset(next, 0, words * sizeof(unsigned int));
+                continue;
+            }
+            memcpy(next, pending + (size_t)j * words, words * sizeof(unsigned int));
+            int num = tacs[j]->op == TAC_PARAM ? getLivenessVar(liveness, tacs[j]->arg1) : -1;
+            if (num != -1 && nodeOfVar[num] != -1) LIVE_SET_ADD(next, num);
+        }
+        unsigned int* pendingOut = pending + (size_t)block->tacNum * words;
+        memcpy(pendingIn, pendingOut, words * sizeof(unsigned int));
+        for (int w = 0; w < words; ++w) {
+            live[w] = liveness->liveOut[b][w] | pendingOut[w];
+        }
+        for (int j = block->tacNum - 1; j >= 0; --j) {
+            TAC* tac = tacs[j];
+            int roles = getTACRoles(tac);
+            char* operands[3];
+            getTACVarOperands(tac, operands);
+            int def = operands[2] != NULL && (roles & TAC_DEF_RES) ? nodeOf(nodeOfVar, liveness, operands[2]) : -1;
+            int defVar = def == -1 ? -1 : getLivenessVar(liveness, operands[2]);
+
+            if (isMove(tac)) {
+                int src = nodeOf(nodeOfVar, liveness, tac->arg1);
+                if (src != -1 && def != -1) {
+                    LIVE_SET_DELETE(live, getLivenessVar(liveness, tac->arg1));
+                    addMove(graph, src, def);
+                }
+            }
+            if (tac->op == TAC_CALL) {
+                // 调用之后仍然活跃的变量不能放在调用者保存寄存器中
+                for (int v = 0; v < liveness->varNum; ++v) {
+                    if (!LIVE_SET_HAS(live, v) || nodeOfVar[v] == -1 || v == defVar) continue;
+                    for (int r = 0; r < CALLER_SAVED_REG_NUM; ++r) {
+                        addEdge(graph, nodeOfVar[v], callerSavedNodes[r]);
+                    }
+                }
+            }
+            if (def != -1) {
+                for (int v = 0; v < liveness->varNum; ++v) {
+                    if (LIVE_SET_HAS(live, v) && nodeOfVar[v] != -1) {
+                        addEdge(graph, def, nodeOfVar[v]);
+                    }
+                }
+                LIVE_SET_DELETE(live, defVar);
+                graph->useCount[def]++;
+            }
+            for (int k = 0; k < 3; ++k) {
+                if (operands[k] == NULL || (k == 2 && !(roles & TAC_USE_RES))) continue;
+                int num = getLivenessVar(liveness, operands[k]);
+                if (nodeOfVar[num] == -1) continue;
+                LIVE_SET_ADD(live, num);
+                graph->useCount[nodeOfVar[num]]++;
+            }
+            if (tac->op == TAC_CALL) {
+                for (int w = 0; w < words; ++w) {
+                    live[w] |= pending[(size_t)j * words + w];
+                }
+            }
+        }
+        // 参数在函数入口同时定义，彼此冲突，也和入口处活跃的变量冲突
+        if (b == 0) {
+            SymbolTableEntry* func = findSymbol(assignment->funcName);
+            for (int i = 0; func != NULL && i < func->paramNum; ++i) {
+                int param = nodeOf(nodeOfVar, liveness, func->params[i]->id);
+                if (param == -1) continue;
+                for (int v = 0; v < liveness->varNum; ++v) {
+                    if (LIVE_SET_HAS(live, v) && nodeOfVar[v] != -1) {
+                        addEdge(graph, param, nodeOfVar[v]);
+                    }
+                }
+                for (int k = 0; k < i; ++k) {
+                    int other = nodeOf(nodeOfVar, liveness, func->params[k]->id);
+                    if (other != -1) addEdge(graph, param, other);
+                }
+            }
+        }
+        free(pending);
+        free(tacs);
+    }
+    free(pendingIn);
+    free(live);
+}
+
+void colorGraph(RegAssignment* assignment, CFG* cfg, Liveness* liveness) {
+    // 1. 结点编号
+    int* nodeOfVar = (int*)malloc((liveness->varNum + 1) * sizeof(int));
+    int nodeNum = COLOR_NUM;
+    for (int i = 0; i < liveness->varNum; ++i) {
+        VarLocation* location = findVarLocation(assignment, liveness->vars[i]);
+        nodeOfVar[i] = location == NULL || location->isLocalArray ? -1 : nodeNum++;
+    }
+    ColorGraph graph;
+    memset(&graph, 0, sizeof(graph));
+    graph.nodeNum = nodeNum;
+    graph.adjSet = (unsigned char*)calloc(((size_t)nodeNum * nodeNum + 7) / 8, 1);
+    graph.adjList = (NodeList*)calloc(nodeNum, sizeof(NodeList));
+    graph.moveList = (NodeList*)calloc(nodeNum, sizeof(NodeList));
+    graph.degree = (int*)calloc(nodeNum, sizeof(int));
+    graph.alias = (int*)calloc(nodeNum, sizeof(int));
+    graph.color = (int*)calloc(nodeNum, sizeof(int));
+    graph.state = (NodeState*)calloc(nodeNum, sizeof(NodeState));
+    graph.location = (int*)calloc(nodeNum, sizeof(int));
+    graph.useCount = (int*)calloc(nodeNum, sizeof(int));
+    graph.selectStack = (int*)calloc(nodeNum, sizeof(int));
+    for (int i = 0; i < COLOR_NUM; ++i) {
+        graph.state[i] = NODE_PRECOLORED;
+        graph.color[i] = i;
+        graph.degree[i] = 1 << 20;
+    }
+    for (int i = 0; i < liveness->varNum; ++i) {
+        if (nodeOfVar[i] == -1) continue;
+        graph.state[nodeOfVar[i]] = NODE_INITIAL;
+        graph.location[nodeOfVar[i]] = (int)(findVarLocation(assignment, liveness->vars[i]) - assignment->locations);
+    }
+
+    // 2. 建立冲突图，初始化工作表
+    buildGraph(&graph, assignment, cfg, liveness, nodeOfVar);
+    for (int i = COLOR_NUM; i < nodeNum; ++i) {
+        if (graph.degree[i] >= COLOR_NUM) {
+            graph.state[i] = NODE_SPILL;
+        } else if (moveRelated(&graph, i)) {
+            graph.state[i] = NODE_FREEZE;
+        } else {
+            graph.state[i] = NODE_SIMPLIFY;
+        }
+    }
+
+    // 3. 简化、合并、冻结、溢出，然后着色
+    while (step(&graph)) {}
+    assignColors(&graph);
+
+    // 4. 写回分配结果，合并的结点和代表结点使用相同的寄存器或溢出位置
+    for (int i = COLOR_NUM; i < nodeNum; ++i) {
+        if (graph.state[i] == NODE_SPILLED) {
+            allocateSpillSlot(assignment, &assignment->locations[graph.location[i]]);
+            assignment->spillNum++;
+        }
+    }
+    for (int i = COLOR_NUM; i < nodeNum; ++i) {
+        VarLocation* location = &assignment->locations[graph.location[i]];
+        int root = getAlias(&graph, i);
+        if (graph.state[root] == NODE_COLORED || isPrecolored(&graph, root)) {
+            location->reg = colorToReg(graph.color[root]);
+            markRegisterUsed(assignment, location->reg);
+        } else {
+            location->reg = -1;
+            location->slot = assignment->locations[graph.location[root]].slot;
+        }
+    }
+    assignment->candidateNum = nodeNum - COLOR_NUM;
+    for (int i = 0; i < graph.moveNum; ++i) {
+        if (graph.moves[i].state == MOVE_COALESCED) assignment->coalescedMoves++;
+    }
+
+    for (int i = 0; i < nodeNum; ++i) {
+        free(graph.adjList[i].nodes);
+        free(graph.moveList[i].nodes);
+    }
+    free(graph.adjSet);
+    free(graph.adjList);
+    free(graph.moveList);
+    free(graph.degree);
+    free(graph.alias);
+    free(graph.color);
+    free(graph.state);
+    free(graph.location);
+    free(graph.useCount);
+    free(graph.selectStack);
+    free(graph.moves);
+    free(nodeOfVar);
+}
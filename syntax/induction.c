@@ -0,0 +1,423 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+
+/* strength reduction of array addresses and linear function test replacement (Dragon Book 9.6.6).
+ * a basic induction variable i of a loop is a local scalar whose only write in the loop is
+ *   (+, i, c, i)   or   (+, i, c, t) (=, t, , t') ... (=, t', , i)   (also c + i and i - c)
+ * where the temps are written earlier in the same block, as value numbering leaves them.
+ * for every (&[], arr, i + k, a) in the loop, where i + k is i itself or a temp computed from i in
+ * the same block, a pointer p = &arr[i + k] is set up in the preheader and stepped by 4c right
+ * after the write of i, so the access becomes (=, p, , a) and no longer shifts and adds. uses of
+ * a that follow in the same block read p directly.
+ * when i is then used only by its own increment and by one comparison with a loop-invariant n, and
+ * i is dead after the loop, the comparison is rewritten to compare p with &arr[n + k]. p grows
+ * with i whatever the sign of c, so the relation is kept. the increment of i is dropped.
+ */
+typedef struct InductionVar {
+    int num;                // liveness number
+    TACList* inc;           // the write of the variable in the loop
+    TACList* add;           // the TAC adding the step, may be inc
+    int incBlock, incPos;
+    int step;
+    TACList* compare;       // candidate for LFTR
+    bool otherUses;         // used by anything LFTR cannot replace
+    int firstAddress;       // the reduced address used for LFTR, -1 if none
+} InductionVar;
+
+typedef struct ReducedAddress {
+    char* arr;
+    int iv;                 // index in ivs
+    int offset;             // k
+    char* pointer;
+} ReducedAddress;
+
+typedef struct LoopScan {
+    CFG* cfg;
+    Liveness* liveness;
+    Loop* loop;
+    bool hasCall;           // call or $= in the loop
+    int* defNum;            // indexed by variable number: TACs in the loop writing it
+    TACList** defNode;      // indexed by variable number: the last of them
+    int* defBlock;
+    int* defPos;
+    int* ivOf;              // indexed by variable number: index in ivs, or -1
+    InductionVar* ivs;
+    int ivNum;
+    ReducedAddress* addresses;
+    int addressNum;
+    TACList** accesses;     // &[] TACs to rewrite
+    int* accessTarget;      // index in addresses
+    int accessNum;
+    int* derivedUses;       // indexed by variable number: uses as the index of a rewritten &[]
+    int* useNum;            // indexed by variable number: uses in the whole function
+} LoopScan;
+
+static bool isCompare(TACOpcode op) {
+    return op == TAC_LT || op == TAC_LE || op == TAC_GT ||
+           op == TAC_GE || op == TAC_EQ || op == TAC_NE;
+}
+
+static int varNumber(LoopScan* scan, char* operand) {
+    return isVariable(operand) ? getLivenessVar(scan->liveness, operand) : -1;
+}
+
+// matches (+, v, c, res), (+, c, v, res) and (-, v, c, res). stores v and c
+static bool matchAddConstant(TAC* tac, char** var, int* value) {
+    if (tac->op == TAC_ADD && tac->arg1 != NULL && tac->arg2 != NULL) {
+        if (isConstant(tac->arg2) && isVariable(tac->arg1)) {
+            *var = tac->arg1;
+            *value = atoi(tac->arg2);
+            return true;
+        }
+        if (isConstant(tac->arg1) && isVariable(tac->arg2)) {
+            *var = tac->arg2;
+            *value = atoi(tac->arg1);
+            return true;
+        }
+    } else if (tac->op == TAC_SUB && tac->arg1 != NULL && isVariable(tac->arg1) && isConstant(tac->arg2)) {
+        *var = tac->arg1;
+        *value = -atoi(tac->arg2);
+        return true;
+    }
+    return false;
+}
+
+static bool liveAfterLoop(LoopScan* scan, int num) {
+    for (int b = 0; b < scan->cfg->blockNum; ++b) {
+        if (!scan->loop->body[b]) continue;
+        BasicBlock* cur = scan->cfg->blocks[b];
+        for (int i = 0; i < cur->succNum; ++i) {
+            BasicBlock* succ = cur->succs[i];
+            if (succ != scan->cfg->exit && !scan->loop->body[succ->id] && LIVE_SET_HAS(scan->liveness->liveIn[succ->id], num)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool isInvariant(LoopScan* scan, char* operand, bool* local) {
+    if (isConstant(operand)) return true;
+    int num = varNumber(scan, operand);
+    if (num == -1) return false;
+    if (!local[num] && scan->hasCall) return false;
+    return scan->defNum[num] == 0;
+}
+
+static void collectDefs(LoopScan* scan) {
+    CFG* cfg = scan->cfg;
+    int varNum = scan->liveness->varNum;
+    scan->defNum = (int*)calloc(varNum + 1, sizeof(int));
+    scan->defNode = (TACList**)calloc(varNum + 1, sizeof(TACList*));
+    scan->defBlock = (int*)calloc(varNum + 1, sizeof(int));
+    scan->defPos = (int*)calloc(varNum + 1, sizeof(int));
+    scan->useNum = (int*)calloc(varNum + 1, sizeof(int));
+    scan->derivedUses = (int*)calloc(varNum + 1, sizeof(int));
+    scan->hasCall = false;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        TACList* cur = cfg->blocks[b]->first;
+        for (int i = 0; i < cfg->blocks[b]->tacNum; ++i, cur = cur->next) {
+            char* operands[3];
+            int roles = getTACRoles(cur->tac);
+            getTACVarOperands(cur->tac, operands);
+            for (int k = 0; k < 3; ++k) {
+                if (operands[k] == NULL || (k == 2 && !(roles & TAC_USE_RES))) continue;
+                scan->useNum[getLivenessVar(scan->liveness, operands[k])]++;
+            }
+            if (!scan->loop->body[b]) continue;
+            if (operands[2] != NULL && (roles & TAC_DEF_RES)) {
+                int num = getLivenessVar(scan->liveness, operands[2]);
+                scan->defNum[num]++;
+                scan->defNode[num] = cur;
+                scan->defBlock[num] = b;
+                scan->defPos[num] = i;
+            }
+            if (cur->tac->op == TAC_CALL || cur->tac->op == TAC_WRITE_ADDR) {
+                scan->hasCall = true;
+            }
+        }
+    }
+}
+
+static void findInductionVars(LoopScan* scan, bool* local) {
+    int varNum = scan->liveness->varNum;
+    scan->ivOf = (int*)malloc((varNum + 1) * sizeof(int));
+    scan->ivs = (InductionVar*)malloc((varNum + 1) * sizeof(InductionVar));
+    scan->ivNum = 0;
+    for (int num = 0; num < varNum; ++num) {
+        scan->ivOf[num] = -1;
+        if (!local[num] || scan->defNum[num] != 1) continue;
+        TACList* add = scan->defNode[num];
+        int pos = scan->defPos[num];
+        // follow the copies back to the sum, which is computed earlier in the same block
+        while (add->tac->op == TAC_ASSIGN && isTemp(add->tac->arg1)) {
+            int t = getLivenessVar(scan->liveness, add->tac->arg1);
+            if (scan->defNum[t] != 1 || scan->defBlock[t] != scan->defBlock[num] || scan->defPos[t] >= pos) break;
+            add = scan->defNode[t];
+            pos = scan->defPos[t];
+        }
+        char* var = NULL;
+        int step = 0;
+        if (!matchAddConstant(add->tac, &var, &step) || strcmp(var, scan->defNode[num]->tac->res) != 0 || step == 0) continue;
+        InductionVar* iv = &scan->ivs[scan->ivNum];
+        iv->num = num;
+        iv->inc = scan->defNode[num];
+        iv->add = add;
+        iv->incBlock = scan->defBlock[num];
+        iv->incPos = scan->defPos[num];
+        iv->step = step;
+        iv->compare = NULL;
+        iv->otherUses = false;
+        iv->firstAddress = -1;
+        scan->ivOf[num] = scan->ivNum++;
+    }
+}
+
+// the induction variable and the offset k of the index of an &[] at position pos of block b
+static bool matchIndex(LoopScan* scan, char* index, int b, int pos, int* ivIndex, int* offset) {
+    int num = varNumber(scan, index);
+    if (num == -1) return false;
+    if (scan->ivOf[num] != -1) {
+        *ivIndex = scan->ivOf[num];
+        *offset = 0;
+        return true;
+    }
+    // a temp i + k written in the same block, with no write of i in between
+    if (!isTemp(index) || scan->defNum[num] != 1 || scan->defBlock[num] != b || scan->defPos[num] >= pos) return false;
+    char* var = NULL;
+    int k = 0;
+    if (!matchAddConstant(scan->defNode[num]->tac, &var, &k)) return false;
+    int ivNum = varNumber(scan, var);
+    if (ivNum == -1 || scan->ivOf[ivNum] == -1) return false;
+    InductionVar* iv = &scan->ivs[scan->ivOf[ivNum]];
+    if (iv->incBlock == b && iv->incPos > scan->defPos[num] && iv->incPos < pos) return false;
+    *ivIndex = scan->ivOf[ivNum];
+    *offset = k;
+    return true;
+}
+
+static void findAddresses(LoopScan* scan) {
+    CFG* cfg = scan->cfg;
+    int tacNum = 0;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        if (scan->loop->body[b]) tacNum += cfg->blocks[b]->tacNum;
+    }
+    scan->addresses = (ReducedAddress*)malloc((tacNum + 1) * sizeof(ReducedAddress));
+    scan->accesses = (TACList**)malloc((tacNum + 1) * sizeof(TACList*));
+    scan->accessTarget = (int*)malloc((tacNum + 1) * sizeof(int));
+    scan->addressNum = 0;
+    scan->accessNum = 0;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        if (!scan->loop->body[b]) continue;
+        TACList* cur = cfg->blocks[b]->first;
+        for (int i = 0; i < cfg->blocks[b]->tacNum; ++i, cur = cur->next) {
+            TAC* tac = cur->tac;
+            int ivIndex, offset;
+            if (tac->op != TAC_ELEM_ADDR || !matchIndex(scan, tac->arg2, b, i, &ivIndex, &offset)) continue;
+            int target = 0;
+            while (target < scan->addressNum) {
+                ReducedAddress* address = &scan->addresses[target];
+                if (address->iv == ivIndex && address->offset == offset && strcmp(address->arr, tac->arg1) == 0) break;
+                ++target;
+            }
+            if (target == scan->addressNum) {
+                ReducedAddress* address = &scan->addresses[scan->addressNum++];
+                address->arr = tac->arg1;
+                address->iv = ivIndex;
+                address->offset = offset;
+                address->pointer = generateTemp();
+                if (scan->ivs[ivIndex].firstAddress == -1) scan->ivs[ivIndex].firstAddress = target;
+            }
+            scan->accesses[scan->accessNum] = cur;
+            scan->accessTarget[scan->accessNum++] = target;
+            if (offset != 0) scan->derivedUses[getLivenessVar(scan->liveness, tac->arg2)]++;
+        }
+    }
+}
+
+static bool isAccess(LoopScan* scan, TACList* node) {
+    for (int i = 0; i < scan->accessNum; ++i) {
+        if (scan->accesses[i] == node) return true;
+    }
+    return false;
+}
+
+// find the only comparison each induction variable is used by once its addresses are reduced
+static void findTests(LoopScan* scan, bool* local) {
+    CFG* cfg = scan->cfg;
+    // the temps between the sum and the write of i must not be read by anything else
+    for (int i = 0; i < scan->ivNum; ++i) {
+        InductionVar* iv = &scan->ivs[i];
+        for (TACList* node = iv->inc; node != iv->add; ) {
+            int t = getLivenessVar(scan->liveness, node->tac->arg1);
+            node = scan->defNode[t];
+            int uses = node == iv->add ? 1 + scan->derivedUses[t] : 1;
+            if (scan->useNum[t] != uses) iv->otherUses = true;
+        }
+    }
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        if (!scan->loop->body[b]) continue;
+        TACList* cur = cfg->blocks[b]->first;
+        for (int i = 0; i < cfg->blocks[b]->tacNum; ++i, cur = cur->next) {
+            TAC* tac = cur->tac;
+            int roles = getTACRoles(tac);
+            char* operands[3];
+            getTACVarOperands(tac, operands);
+            for (int k = 0; k < 3; ++k) {
+                if (operands[k] == NULL || (k == 2 && !(roles & TAC_USE_RES))) continue;
+                int num = getLivenessVar(scan->liveness, operands[k]);
+                if (scan->ivOf[num] == -1) continue;
+                InductionVar* iv = &scan->ivs[scan->ivOf[num]];
+                char* var = NULL;
+                int value;
+                if (cur == iv->add || isAccess(scan, cur)) continue;
+                // i + k only used as reduced indices, or temps nothing reads, such as the value of i++
+                if ((roles & TAC_DEF_RES) && isTemp(tac->res)) {
+                    int res = getLivenessVar(scan->liveness, tac->res);
+                    bool derived = matchAddConstant(tac, &var, &value) && scan->useNum[res] == scan->derivedUses[res];
+                    if (derived || scan->useNum[res] == 0) continue;
+                }
+                if (k != 2 && isCompare(tac->op) && iv->compare == NULL && isInvariant(scan, k == 0 ? tac->arg2 : tac->arg1, local)) {
+                    iv->compare = cur;
+                    continue;
+                }
+                iv->otherUses = true;
+            }
+        }
+    }
+}
+
+// (=, p, , a) is followed by the uses of a, read p there until p or a changes
+static void propagatePointer(TACList* copy) {
+    char* pointer = copy->tac->arg1;
+    char* addr = copy->tac->res;
+    for (TACList* cur = copy->next; cur != NULL; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (startsBlock(tac)) break;
+        int roles = getTACRoles(tac);
+        if ((roles & TAC_USE_ARG1) && tac->arg1 != NULL && strcmp(tac->arg1, addr) == 0) tac->arg1 = pointer;
+        if ((roles & TAC_USE_ARG2) && tac->arg2 != NULL && strcmp(tac->arg2, addr) == 0) tac->arg2 = pointer;
+        if ((roles & TAC_USE_RES) && tac->res != NULL && strcmp(tac->res, addr) == 0) tac->res = pointer;
+        if ((roles & TAC_DEF_RES) && (strcmp(tac->res, pointer) == 0 || strcmp(tac->res, addr) == 0)) break;
+        if (endsBlock(tac)) break;
+    }
+}
+
+static char* emitIndex(TACList** pos, char* index, int offset) {
+    if (offset == 0) return index;
+    if (isConstant(index)) return intToString(atoi(index) + offset);
+    char* sum = generateTemp();
+    *pos = insertTACAfter(*pos, createTAC(TAC_ADD, index, intToString(offset), sum));
+    return sum;
+}
+
+// rewrite the loop, returns the number of tests replaced
+static int reduceLoop(LoopScan* scan) {
+    // 1. set up the pointers before the loop
+    TACList* pos = insertPreheader(scan->cfg, scan->loop);
+    for (int i = 0; i < scan->addressNum; ++i) {
+        ReducedAddress* address = &scan->addresses[i];
+        char* iv = scan->ivs[address->iv].inc->tac->res;
+        char* index = emitIndex(&pos, iv, address->offset);
+        pos = insertTACAfter(pos, createTAC(TAC_ELEM_ADDR, address->arr, index, address->pointer));
+    }
+
+    // 2. replace the tests of counters that are only used for addressing
+    int tests = 0;
+    for (int i = 0; i < scan->ivNum; ++i) {
+        InductionVar* iv = &scan->ivs[i];
+        if (iv->compare == NULL || iv->otherUses || iv->firstAddress == -1 || liveAfterLoop(scan, iv->num)) continue;
+        ReducedAddress* address = &scan->addresses[iv->firstAddress];
+        TAC* tac = iv->compare->tac;
+        char* name = iv->inc->tac->res;
+        bool left = strcmp(tac->arg1, name) == 0;
+        char* limit = generateTemp();
+        char* index = emitIndex(&pos, left ? tac->arg2 : tac->arg1, address->offset);
+        pos = insertTACAfter(pos, createTAC(TAC_ELEM_ADDR, address->arr, index, limit));
+        if (left) {
+            tac->arg1 = address->pointer;
+            tac->arg2 = limit;
+        } else {
+            tac->arg1 = limit;
+            tac->arg2 = address->pointer;
+        }
+        // i is no longer read in the loop, but its increment still reads it. a copy of i to itself
+        // breaks the cycle, dead code elimination removes it and the sum
+        iv->inc->tac->op = TAC_ASSIGN;
+        iv->inc->tac->arg1 = iv->inc->tac->res;
+        iv->inc->tac->arg2 = NULL;
+        ++tests;
+    }
+
+    // 3. step the pointers with their induction variables
+    for (int i = 0; i < scan->addressNum; ++i) {
+        ReducedAddress* address = &scan->addresses[i];
+        InductionVar* iv = &scan->ivs[address->iv];
+        char* step = intToString(iv->step * 4);
+        insertTACAfter(iv->inc, createTAC(TAC_ADD, address->pointer, step, address->pointer));
+    }
+
+    // 4. the accesses copy the pointers
+    for (int i = 0; i < scan->accessNum; ++i) {
+        TAC* tac = scan->accesses[i]->tac;
+        tac->op = TAC_ASSIGN;
+        tac->arg1 = scan->addresses[scan->accessTarget[i]].pointer;
+        tac->arg2 = NULL;
+        propagatePointer(scan->accesses[i]);
+    }
+    return tests;
+}
+
+static void freeLoopScan(LoopScan* scan) {
+    free(scan->defNum);
+    free(scan->defNode);
+    free(scan->defBlock);
+    free(scan->defPos);
+    free(scan->useNum);
+    free(scan->derivedUses);
+    free(scan->ivOf);
+    free(scan->ivs);
+    free(scan->addresses);
+    free(scan->accesses);
+    free(scan->accessTarget);
+}
+
+void reduceInductionVariables(CFG* cfg, FILE* report) {
+    TACList* funcLabel = cfg->funcLabel;
+    int reduced = 0, pointers = 0, tests = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        CFG* cur = buildCFG(funcLabel);
+        Liveness* liveness = computeLiveness(cur);
+        bool* local = findLocalScalars(cur, liveness);
+        int* idom = computeDominators(cur);
+        int loopNum = 0;
+        Loop* loops = findLoops(cur, idom, &loopNum);
+        for (int i = 0; i < loopNum && !changed; ++i) {
+            if (getBlockLabel(cur->blocks[loops[i].header]) == NULL) continue;
+            LoopScan scan;
+            scan.cfg = cur;
+            scan.liveness = liveness;
+            scan.loop = &loops[i];
+            collectDefs(&scan);
+            findInductionVars(&scan, local);
+            findAddresses(&scan);
+            if (scan.accessNum > 0) {
+                findTests(&scan, local);
+                tests += reduceLoop(&scan);
+                reduced += scan.accessNum;
+                pointers += scan.addressNum;
+                changed = true;
+            }
+            freeLoopScan(&scan);
+        }
+        freeLoops(loops, loopNum);
+        free(idom);
+        free(local);
+        freeLiveness(liveness);
+        freeCFG(cur);
+    }
+    fprintf(report, "%s: %d addresses reduced to %d pointers, %d loop tests replaced\n", cfg->funcName, reduced, pointers, tests);
+}
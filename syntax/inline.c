@@ -0,0 +1,364 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+#include "callgraph.h"
+#include "symbol_table.h"
+
+/* function inlining.
+ * a call (param a1) ... (param an) (call, g, , r) is replaced with a copy of the body of g:
+ * - every parameter p of g gets a fresh local p.k, declared with the parameter's type, and the
+ *   param TACs become (=, ai, , pi.k). locals become x.k, temps get new numbers from
+ *   generateTemp() and labels from generateLabel(). globals keep their names.
+ * - (return, , , v) becomes (=, v, , r) followed by a jump to a new label after the copy.
+ * a call is inlined when the callee has at most inlineThreshold TACs (labels and allocs are not
+ * counted), or INLINE_LOOP_FACTOR times as many when the call is inside a loop of the caller,
+ * since it runs more often there. recursive functions (the callee reaches itself in the call
+ * graph) and functions with array parameters or local arrays are never inlined. a function
+ * whose calls were all inlined is removed. the calls are chosen on the code as it was before the
+ * pass, so the calls inside a copied body are not inlined again. a body is copied as it is when
+ * the call is reached: a callee that comes earlier in the code may already contain inlined calls.
+ * since globals keep their names, a call is not inlined when the copy would use a global that a
+ * local or parameter of the caller hides.
+ */
+int inlineThreshold = 12;
+
+typedef struct RenamePair {
+    char* from;
+    char* to;
+} RenamePair;
+
+typedef struct Renaming {
+    RenamePair* pairs;
+    int num;
+    int capacity;
+    int suffix;                  // k in x.k, one number per inlined call
+} Renaming;
+
+static void* inlineAlloc(size_t size) {
+    void* ptr = calloc(1, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Failed to allocate memory for inlining.\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static char* findRename(Renaming* renaming, char* name) {
+    for (int i = 0; i < renaming->num; ++i) {
+        if (strcmp(renaming->pairs[i].from, name) == 0) return renaming->pairs[i].to;
+    }
+    return NULL;
+}
+
+static char* addRename(Renaming* renaming, char* from, char* to) {
+    if (renaming->num >= renaming->capacity) {
+        renaming->capacity = renaming->capacity == 0 ? 16 : renaming->capacity * 2;
+        renaming->pairs = (RenamePair*)realloc(renaming->pairs, renaming->capacity * sizeof(RenamePair));
+        if (renaming->pairs == NULL) {
+            fprintf(stderr, "Failed to allocate memory for inlining.\n");
+            exit(1);
+        }
+    }
+    renaming->pairs[renaming->num].from = from;
+    renaming->pairs[renaming->num].to = to;
+    renaming->num++;
+    return to;
+}
+
+static char* localName(Renaming* renaming, char* name) {
+    char* renamed = (char*)inlineAlloc(strlen(name) + 12);
+    sprintf(renamed, "%s.%d", name, renaming->suffix);
+    return addRename(renaming, name, renamed);
+}
+
+// the new name of an operand of the copied body. labels, temps and locals of the callee are
+// renamed on first sight; everything else (globals, constants) is kept
+static char* renameOperand(Renaming* renaming, char* operand) {
+    if (!isVariable(operand)) return operand;
+    char* renamed = findRename(renaming, operand);
+    if (renamed != NULL) return renamed;
+    if (isTemp(operand)) return addRename(renaming, operand, generateTemp());
+    return operand;
+}
+
+static bool isLabelOp(TAC* tac) {
+    return tac->op == TAC_GOTO || tac->op == TAC_IF_GOTO || tac->op == TAC_IF_FALSE_GOTO;
+}
+
+static bool isEndLabel(TAC* tac) {
+    return tac->op == TAC_LABEL && strcmp(tac->arg1, "end_func") == 0;
+}
+
+// the number of TACs that generate code, or -1 if the function cannot be inlined
+static int inlineSize(CallGraphNode* node) {
+    SymbolTableEntry* func = findSymbol(node->funcName);
+    if (func == NULL || strcmp(node->funcName, "main") == 0) return -1;
+    for (int i = 0; i < func->paramNum; ++i) {
+        if (func->params[i]->isArray) return -1;
+    }
+    int size = 0;
+    for (TACList* cur = node->funcLabel->next; cur != NULL && !isEndLabel(cur->tac); cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_ALLOC) {
+            int typeSize = strcmp(tac->arg1, "CHAR") == 0 ? 1 : strcmp(tac->arg1, "SHORT") == 0 ? 2 : 4;
+            if (atoi(tac->arg2) > typeSize) return -1;
+        } else if (tac->op != TAC_LABEL) {
+            size++;
+        }
+    }
+    return size;
+}
+
+// name is a parameter of the function or declared by an alloc in its body
+static bool declares(CallGraphNode* node, char* name) {
+    SymbolTableEntry* func = findSymbol(node->funcName);
+    for (int i = 0; i < func->paramNum; ++i) {
+        if (strcmp(func->params[i]->id, name) == 0) return true;
+    }
+    for (TACList* cur = node->funcLabel->next; !isEndLabel(cur->tac); cur = cur->next) {
+        if (cur->tac->op == TAC_ALLOC && strcmp(cur->tac->res, name) == 0) return true;
+    }
+    return false;
+}
+
+// the callee uses a global with the name of a local or parameter of the caller
+static bool hidesGlobal(CallGraphNode* caller, CallGraphNode* callee) {
+    for (TACList* cur = callee->funcLabel->next; !isEndLabel(cur->tac); cur = cur->next) {
+        char* operands[3];
+        getTACVarOperands(cur->tac, operands);
+        for (int k = 0; k < 3; ++k) {
+            char* name = operands[k];
+            if (name == NULL || isTemp(name) || declares(callee, name)) continue;
+            if (declares(caller, name)) return true;
+        }
+    }
+    return false;
+}
+
+static bool reaches(CallGraph* graph, int from, int to, bool* visited) {
+    if (visited[from]) return false;
+    visited[from] = true;
+    CallGraphNode* node = &graph->nodes[from];
+    for (int i = 0; i < node->calleeNum; ++i) {
+        if (node->callees[i] == to || reaches(graph, node->callees[i], to, visited)) return true;
+    }
+    return false;
+}
+
+// marks the call TACs of the function that are inside a loop
+static int findCallsInLoops(TACList* funcLabel, TAC** calls, int capacity) {
+    CFG* cfg = buildCFG(funcLabel);
+    int* idom = computeDominators(cfg);
+    int loopNum = 0;
+    Loop* loops = findLoops(cfg, idom, &loopNum);
+    int num = 0;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        bool inLoop = false;
+        for (int l = 0; l < loopNum && !inLoop; ++l) {
+            inLoop = loops[l].body[b];
+        }
+        if (!inLoop) continue;
+        TACList* cur = cfg->blocks[b]->first;
+        for (int i = 0; i < cfg->blocks[b]->tacNum; ++i, cur = cur->next) {
+            if (cur->tac->op == TAC_CALL && num < capacity) calls[num++] = cur->tac;
+        }
+    }
+    freeLoops(loops, loopNum);
+    free(idom);
+    freeCFG(cfg);
+    return num;
+}
+
+// copy the body of callee after pos. params are the param TACs of the call, which become copies
+// into the renamed parameters. returns the last inserted node
+static TACList* cloneBody(TACList* pos, CallGraphNode* callee, TACList** params, char* result, int suffix) {
+    Renaming renaming = { NULL, 0, 0, suffix };
+    SymbolTableEntry* func = findSymbol(callee->funcName);
+    for (int i = 0; i < func->paramNum; ++i) {
+        char* param = localName(&renaming, func->params[i]->id);
+        pos = insertTACAfter(pos, createTAC(TAC_ALLOC, func->params[i]->type, intToString(func->params[i]->size), param));
+        TAC* tac = params[i]->tac;
+        tac->op = TAC_ASSIGN;
+        tac->res = param;
+    }
+    // labels and locals first, so that a jump before its label and a local used before its
+    // alloc get the same name
+    for (TACList* cur = callee->funcLabel->next; !isEndLabel(cur->tac); cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_LABEL) {
+            addRename(&renaming, tac->arg1, generateLabel());
+        } else if (tac->op == TAC_ALLOC && findRename(&renaming, tac->res) == NULL) {
+            localName(&renaming, tac->res);
+        }
+    }
+
+    char* endLabel = generateLabel();
+    for (TACList* cur = callee->funcLabel->next; !isEndLabel(cur->tac); cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_LABEL) {
+            pos = insertTACAfter(pos, createTAC(TAC_LABEL, findRename(&renaming, tac->arg1), NULL, NULL));
+        } else if (isLabelOp(tac)) {
+            char* arg1 = tac->op == TAC_GOTO ? tac->arg1 : renameOperand(&renaming, tac->arg1);
+            pos = insertTACAfter(pos, createTAC(tac->op, arg1, tac->arg2, findRename(&renaming, tac->res)));
+        } else if (tac->op == TAC_ALLOC) {
+            pos = insertTACAfter(pos, createTAC(TAC_ALLOC, tac->arg1, tac->arg2, findRename(&renaming, tac->res)));
+        } else if (tac->op == TAC_RETURN) {
+            if (result != NULL && *result != '\0' && tac->res != NULL && *tac->res != '\0') {
+                pos = insertTACAfter(pos, createTAC(TAC_ASSIGN, renameOperand(&renaming, tac->res), NULL, result));
+            }
+            pos = insertTACAfter(pos, createTAC(TAC_GOTO, NULL, NULL, endLabel));
+        } else if (tac->op == TAC_CALL) {
+            pos = insertTACAfter(pos, createTAC(TAC_CALL, tac->arg1, NULL, renameOperand(&renaming, tac->res)));
+        } else {
+            int roles = getTACRoles(tac);
+            char* arg1 = roles & TAC_USE_ARG1 ? renameOperand(&renaming, tac->arg1) : tac->arg1;
+            char* arg2 = roles & TAC_USE_ARG2 ? renameOperand(&renaming, tac->arg2) : tac->arg2;
+            char* res = roles & (TAC_USE_RES | TAC_DEF_RES) ? renameOperand(&renaming, tac->res) : tac->res;
+            pos = insertTACAfter(pos, createTAC(tac->op, arg1, arg2, res));
+        }
+    }
+    pos = insertTACAfter(pos, createTAC(TAC_LABEL, endLabel, NULL, NULL));
+    free(renaming.pairs);
+    return pos;
+}
+
+static void markCalled(CallGraph* graph, bool* called) {
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        if (cur->tac->op != TAC_CALL) continue;
+        int callee = findCallGraphNode(graph, cur->tac->arg1);
+        if (callee != -1) called[callee] = true;
+    }
+}
+
+static int countTACs() {
+    int num = 0;
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        num++;
+    }
+    return num;
+}
+
+// remove the function from (label, func_xxx) to (label, end_func)
+static void removeFunction(TACList* funcLabel) {
+    TACList* prev = NULL;
+    for (TACList* cur = tacHead; cur != funcLabel; cur = cur->next) {
+        prev = cur;
+    }
+    bool last = false;
+    while (!last) {
+        TACList* cur = prev == NULL ? tacHead : prev->next;
+        last = isEndLabel(cur->tac);
+        removeTAC(prev, cur);
+    }
+}
+
+void inlineCalls(FILE* report) {
+    fprintf(report, "[OPTIMIZATION] inlining\n");
+    int sizeBefore = countTACs();
+    CallGraph* graph = buildCallGraph();
+    int* sizes = (int*)inlineAlloc((graph->nodeNum + 1) * sizeof(int));
+    bool* visited = (bool*)inlineAlloc((graph->nodeNum + 1) * sizeof(bool));
+    for (int i = 0; i < graph->nodeNum; ++i) {
+        memset(visited, 0, graph->nodeNum * sizeof(bool));
+        sizes[i] = reaches(graph, i, i, visited) ? -1 : inlineSize(&graph->nodes[i]);
+    }
+    bool* called = (bool*)inlineAlloc((graph->nodeNum + 1) * sizeof(bool));
+    markCalled(graph, called);
+
+    // choose every call first, so that the calls copied with a body are not considered
+    int siteCapacity = 16;
+    int siteNum = 0;
+    TAC** sites = (TAC**)inlineAlloc(siteCapacity * sizeof(TAC*));
+    bool* siteInLoop = (bool*)inlineAlloc(siteCapacity * sizeof(bool));
+    for (int i = 0; i < graph->nodeNum; ++i) {
+        CallGraphNode* caller = &graph->nodes[i];
+        TAC* loopCalls[256];
+        int loopCallNum = caller->callSiteNum == 0 ? 0 : findCallsInLoops(caller->funcLabel, loopCalls, 256);
+        int argNum = 0;
+        for (TACList* cur = caller->funcLabel->next; !isEndLabel(cur->tac); cur = cur->next) {
+            TAC* tac = cur->tac;
+            if (tac->op == TAC_PARAM) {
+                argNum++;
+                continue;
+            }
+            if (tac->op != TAC_CALL) continue;
+            int callee = findCallGraphNode(graph, tac->arg1);
+            int args = argNum;
+            argNum = 0;
+            if (callee == -1 || callee == i || sizes[callee] < 0) continue;
+            if (args != findSymbol(graph->nodes[callee].funcName)->paramNum) continue;
+            bool inLoop = false;
+            for (int k = 0; k < loopCallNum; ++k) {
+                if (loopCalls[k] == tac) inLoop = true;
+            }
+            int threshold = inLoop ? inlineThreshold * INLINE_LOOP_FACTOR : inlineThreshold;
+            if (sizes[callee] > threshold) continue;
+            if (siteNum >= siteCapacity) {
+                siteCapacity *= 2;
+                sites = (TAC**)realloc(sites, siteCapacity * sizeof(TAC*));
+                siteInLoop = (bool*)realloc(siteInLoop, siteCapacity * sizeof(bool));
+            }
+            sites[siteNum] = tac;
+            siteInLoop[siteNum++] = inLoop;
+        }
+    }
+
+    // copying a callee does not change the nodes of the callee, so funcLabel stays valid
+    int inlined = 0;
+    for (int i = 0; i < graph->nodeNum; ++i) {
+        CallGraphNode* caller = &graph->nodes[i];
+        TACList* params[MAX_INLINE_ARGS];
+        int paramNum = 0;
+        TACList* prev = caller->funcLabel;
+        TACList* cur = prev->next;
+        while (!isEndLabel(cur->tac)) {
+            TAC* tac = cur->tac;
+            if (tac->op == TAC_PARAM) {
+                if (paramNum < MAX_INLINE_ARGS) params[paramNum] = cur;
+                paramNum++;
+            }
+            int site = -1;
+            for (int k = 0; k < siteNum && tac->op == TAC_CALL; ++k) {
+                if (sites[k] == tac) site = k;
+            }
+            if (tac->op == TAC_CALL) {
+                int count = paramNum;
+                paramNum = 0;
+                int callee = site != -1 ? findCallGraphNode(graph, tac->arg1) : -1;
+                // checked on the body as it is now, which may contain globals from inlined calls
+                if (callee != -1 && count <= MAX_INLINE_ARGS && !hidesGlobal(caller, &graph->nodes[callee])) {
+                    fprintf(report, "%s: %s inlined (%d TACs%s)\n", caller->funcName, tac->arg1, sizes[callee],
+                            siteInLoop[site] ? ", in a loop" : "");
+                    TACList* last = cloneBody(cur, &graph->nodes[callee], params, tac->res, ++inlined);
+                    removeTAC(prev, cur);
+                    cur = last;
+                }
+            }
+            prev = cur;
+            cur = cur->next;
+        }
+    }
+
+    // a copied body may call other functions, so the calls are counted again
+    int removed = 0;
+    bool* stillCalled = (bool*)inlineAlloc((graph->nodeNum + 1) * sizeof(bool));
+    markCalled(graph, stillCalled);
+    for (int i = 0; i < graph->nodeNum; ++i) {
+        if (called[i] && !stillCalled[i] && strcmp(graph->nodes[i].funcName, "main") != 0) {
+            fprintf(report, "%s: removed, every call was inlined\n", graph->nodes[i].funcName);
+            removeFunction(graph->nodes[i].funcLabel);
+            removed++;
+        }
+    }
+    int sizeAfter = countTACs();
+    fprintf(report, "%d calls inlined, %d functions removed, %d TACs -> %d TACs (%+d)\n",
+            inlined, removed, sizeBefore, sizeAfter, sizeAfter - sizeBefore);
+
+    free(sites);
+    free(siteInLoop);
+    free(called);
+    free(stillCalled);
+    free(visited);
+    free(sizes);
+    freeCallGraph(graph);
+}
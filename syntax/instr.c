@@ -0,0 +1,403 @@
+#include "instr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// 操作数的写法
+typedef enum InstrFormat {
+    FORMAT_NONE,        // nop
+    FORMAT_REG3,        // rd, rs, rt
+    FORMAT_REG2_IMM,    // rd, rs, imm
+    FORMAT_REG_IMM,     // rd, imm
+    FORMAT_LOAD,        // rd, imm(rs)
+    FORMAT_STORE,       // rt, imm(rs)
+    FORMAT_BRANCH,      // rs, rt, symbol
+    FORMAT_JUMP,        // symbol
+    FORMAT_JUMP_REG,    // rs
+    FORMAT_MOVE,        // rd, rs
+} InstrFormat;
+
+typedef struct InstrInfo {
+    const char* name;
+    InstrOp op;
+    InstrFormat format;
+} InstrInfo;
+
+static const InstrInfo instrInfos[] = {
+    {"add", INSTR_ADD, FORMAT_REG3},
+    {"addu", INSTR_ADDU, FORMAT_REG3},
+    {"sub", INSTR_SUB, FORMAT_REG3},
+    {"subu", INSTR_SUBU, FORMAT_REG3},
+    {"and", INSTR_AND, FORMAT_REG3},
+    {"or", INSTR_OR, FORMAT_REG3},
+    {"xor", INSTR_XOR, FORMAT_REG3},
+    {"nor", INSTR_NOR, FORMAT_REG3},
+    {"slt", INSTR_SLT, FORMAT_REG3},
+    {"sltu", INSTR_SLTU, FORMAT_REG3},
+    {"sllv", INSTR_SLLV, FORMAT_REG3},
+    {"srlv", INSTR_SRLV, FORMAT_REG3},
+    {"srav", INSTR_SRAV, FORMAT_REG3},
+    {"sll", INSTR_SLL, FORMAT_REG2_IMM},
+    {"srl", INSTR_SRL, FORMAT_REG2_IMM},
+    {"sra", INSTR_SRA, FORMAT_REG2_IMM},
+    {"addi", INSTR_ADDI, FORMAT_REG2_IMM},
+    {"addiu", INSTR_ADDIU, FORMAT_REG2_IMM},
+    {"andi", INSTR_ANDI, FORMAT_REG2_IMM},
+    {"ori", INSTR_ORI, FORMAT_REG2_IMM},
+    {"xori", INSTR_XORI, FORMAT_REG2_IMM},
+    {"slti", INSTR_SLTI, FORMAT_REG2_IMM},
+    {"sltiu", INSTR_SLTIU, FORMAT_REG2_IMM},
+    {"lui", INSTR_LUI, FORMAT_REG_IMM},
+    {"lw", INSTR_LW, FORMAT_LOAD},
+    {"lh", INSTR_LH, FORMAT_LOAD},
+    {"lbu", INSTR_LBU, FORMAT_LOAD},
+    {"sw", INSTR_SW, FORMAT_STORE},
+    {"sh", INSTR_SH, FORMAT_STORE},
+    {"sb", INSTR_SB, FORMAT_STORE},
+    {"beq", INSTR_BEQ, FORMAT_BRANCH},
+    {"bne", INSTR_BNE, FORMAT_BRANCH},
+    {"j", INSTR_J, FORMAT_JUMP},
+    {"jal", INSTR_JAL, FORMAT_JUMP},
+    {"jr", INSTR_JR, FORMAT_JUMP_REG},
+    {"mv", INSTR_MV, FORMAT_MOVE},
+    {"move", INSTR_MV, FORMAT_MOVE},
+    {"nop", INSTR_NOP, FORMAT_NONE},
+};
+
+void initSymbolPool(SymbolPool* pool) {
+    pool->tableSize = 256;
+    pool->count = 0;
+    pool->table = (const char**)calloc(pool->tableSize, sizeof(char*));
+    pool->blocks = NULL;
+    pool->blockNum = 0;
+    pool->blockUsed = SYMBOL_BLOCK_SIZE;
+    if (pool->table == NULL) {
+        fprintf(stderr, "Failed to allocate memory for symbol pool\n");
+        exit(1);
+    }
+}
+
+void freeSymbolPool(SymbolPool* pool) {
+    for (unsigned int i = 0; i < pool->blockNum; ++i) {
+        free(pool->blocks[i]);
+    }
+    free(pool->blocks);
+    free(pool->table);
+    pool->blocks = NULL;
+    pool->table = NULL;
+}
+
+static unsigned int hashSymbol(const char* text) {
+    unsigned int hash = 5381;
+    for (; *text != '\0'; ++text) {
+        hash = hash * 33 + (unsigned char)*text;
+    }
+    return hash;
+}
+
+// 把字符串复制到当前块中，放不下时开新的一块；比块还长的字符串单独占一块
+static const char* copySymbol(SymbolPool* pool, const char* text) {
+    size_t length = strlen(text) + 1;
+    if (pool->blockUsed + length > SYMBOL_BLOCK_SIZE) {
+        size_t blockSize = length > SYMBOL_BLOCK_SIZE ? length : SYMBOL_BLOCK_SIZE;
+        pool->blocks = (char**)realloc(pool->blocks, (pool->blockNum + 1) * sizeof(char*));
+        if (pool->blocks == NULL || (pool->blocks[pool->blockNum] = (char*)malloc(blockSize)) == NULL) {
+            fprintf(stderr, "Failed to allocate memory for symbol pool\n");
+            exit(1);
+        }
+        pool->blockNum++;
+        pool->blockUsed = 0;
+    }
+    char* copy = pool->blocks[pool->blockNum - 1] + pool->blockUsed;
+    memcpy(copy, text, length);
+    pool->blockUsed += length;
+    return copy;
+}
+
+const char* internSymbol(SymbolPool* pool, const char* text) {
+    if (pool->count * 2 >= pool->tableSize) {
+        unsigned int oldSize = pool->tableSize;
+        const char** oldTable = pool->table;
+        pool->tableSize *= 2;
+        pool->table = (const char**)calloc(pool->tableSize, sizeof(char*));
+        if (pool->table == NULL) {
+            fprintf(stderr, "Failed to allocate memory for symbol pool\n");
+            exit(1);
+        }
+        for (unsigned int i = 0; i < oldSize; ++i) {
+            if (oldTable[i] == NULL) continue;
+            unsigned int slot = hashSymbol(oldTable[i]) & (pool->tableSize - 1);
+            while (pool->table[slot] != NULL) slot = (slot + 1) & (pool->tableSize - 1);
+            pool->table[slot] = oldTable[i];
+        }
+        free(oldTable);
+    }
+    unsigned int slot = hashSymbol(text) & (pool->tableSize - 1);
+    while (pool->table[slot] != NULL) {
+        if (strcmp(pool->table[slot], text) == 0) return pool->table[slot];
+        slot = (slot + 1) & (pool->tableSize - 1);
+    }
+    pool->table[slot] = copySymbol(pool, text);
+    pool->count++;
+    return pool->table[slot];
+}
+
+int parseRegister(const char* name) {
+    static const char* abiNames[] = {
+        "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+        "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+    };
+    if (name[0] == 'x' && isdigit((unsigned char)name[1])) {
+        char* end;
+        long num = strtol(name + 1, &end, 10);
+        return *end == '\0' && num < 32 ? (int)num : -1;
+    }
+    if (strcmp(name, "fp") == 0) return 8;
+    for (int i = 0; i < 32; ++i) {
+        if (strcmp(name, abiNames[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static const InstrInfo* findInstrInfo(InstrOp op) {
+    for (size_t i = 0; i < sizeof(instrInfos) / sizeof(instrInfos[0]); ++i) {
+        if (instrInfos[i].op == op) return &instrInfos[i];
+    }
+    return NULL;
+}
+
+// 分配器使用的寄存器写作 x%d，有固定用途的寄存器写 ABI 名
+static void formatRegister(int reg, char* buffer, size_t size) {
+    static const char* fixedNames[] = {"zero", "ra", "sp", "gp", "tp"};
+    if (reg < 5) {
+        snprintf(buffer, size, "%s", fixedNames[reg]);
+    } else if (reg >= 10 && reg <= 17) {
+        snprintf(buffer, size, "a%d", reg - 10);
+    } else {
+        snprintf(buffer, size, "x%d", reg);
+    }
+}
+
+// 立即数或全局变量名
+static bool parseImmediate(const char* text, Instr* instr, SymbolPool* pool) {
+    if (isdigit((unsigned char)text[0]) || text[0] == '-') {
+        char* end;
+        instr->imm = (int)strtol(text, &end, 0);
+        return *end == '\0';
+    }
+    if (!isalpha((unsigned char)text[0]) && text[0] != '_') return false;
+    instr->imm = 0;
+    instr->symbol = internSymbol(pool, text);
+    return true;
+}
+
+// imm(rs) 形式的内存操作数
+static bool parseAddress(char* text, Instr* instr, SymbolPool* pool) {
+    char* open = strchr(text, '(');
+    char* close = strchr(text, ')');
+    if (open == NULL || close == NULL || close[1] != '\0') return false;
+    *open = '\0';
+    *close = '\0';
+    instr->rs = parseRegister(open + 1);
+    if (instr->rs == -1) return false;
+    if (text[0] == '\0') {
+        instr->imm = 0;
+        return true;
+    }
+    return parseImmediate(text, instr, pool);
+}
+
+static bool parseOperands(InstrFormat format, char** operands, int operandNum, Instr* instr, SymbolPool* pool) {
+    switch (format) {
+        case FORMAT_NONE:
+            return operandNum == 0;
+        case FORMAT_REG3:
+            if (operandNum != 3) return false;
+            instr->rd = parseRegister(operands[0]);
+            instr->rs = parseRegister(operands[1]);
+            instr->rt = parseRegister(operands[2]);
+            return instr->rd != -1 && instr->rs != -1 && instr->rt != -1;
+        case FORMAT_REG2_IMM:
+            if (operandNum != 3) return false;
+            instr->rd = parseRegister(operands[0]);
+            instr->rs = parseRegister(operands[1]);
+            return instr->rd != -1 && instr->rs != -1 && parseImmediate(operands[2], instr, pool);
+        case FORMAT_REG_IMM:
+            if (operandNum != 2) return false;
+            instr->rd = parseRegister(operands[0]);
+            return instr->rd != -1 && parseImmediate(operands[1], instr, pool);
+        case FORMAT_LOAD:
+            if (operandNum != 2) return false;
+            instr->rd = parseRegister(operands[0]);
+            return instr->rd != -1 && parseAddress(operands[1], instr, pool);
+        case FORMAT_STORE:
+            if (operandNum != 2) return false;
+            instr->rt = parseRegister(operands[0]);
+            return instr->rt != -1 && parseAddress(operands[1], instr, pool);
+        case FORMAT_BRANCH:
+            if (operandNum != 3) return false;
+            instr->rs = parseRegister(operands[0]);
+            instr->rt = parseRegister(operands[1]);
+            instr->symbol = internSymbol(pool, operands[2]);
+            return instr->rs != -1 && instr->rt != -1;
+        case FORMAT_JUMP:
+            if (operandNum != 1) return false;
+            instr->symbol = internSymbol(pool, operands[0]);
+            return true;
+        case FORMAT_JUMP_REG:
+            if (operandNum != 1) return false;
+            instr->rs = parseRegister(operands[0]);
+            return instr->rs != -1;
+        case FORMAT_MOVE:
+            if (operandNum != 2) return false;
+            instr->rd = parseRegister(operands[0]);
+            instr->rs = parseRegister(operands[1]);
+            return instr->rd != -1 && instr->rs != -1;
+    }
+    return false;
+}
+
+static char* trim(char* text) {
+    while (isspace((unsigned char)*text)) ++text;
+    char* end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) --end;
+    *end = '\0';
+    return text;
+}
+
+void parseInstr(const char* line, Instr* instr, SymbolPool* pool) {
+    instr->rd = instr->rs = instr->rt = -1;
+    instr->imm = 0;
+    instr->symbol = NULL;
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", line);
+    char* comment = strstr(buffer, "//");
+    if (comment != NULL) *comment = '\0';
+    comment = strchr(buffer, '#');
+    if (comment != NULL) *comment = '\0';
+    char* text = trim(buffer);
+
+    size_t length = strlen(text);
+    if (text[0] == '.' || strchr(text, ':') != NULL) {
+        bool isLabel = length > 1 && text[length - 1] == ':' && strchr(text, ' ') == NULL;
+        if (isLabel) {
+            text[length - 1] = '\0';
+            instr->op = INSTR_LABEL;
+            instr->symbol = internSymbol(pool, text);
+        } else {
+            instr->op = INSTR_DIRECTIVE;
+            instr->symbol = internSymbol(pool, line);
+        }
+        return;
+    }
+
+    char* name = text;
+    char* rest = text;
+    while (*rest != '\0' && !isspace((unsigned char)*rest)) ++rest;
+    if (*rest != '\0') *rest++ = '\0';
+    char* operands[4];
+    int operandNum = 0;
+    rest = trim(rest);
+    while (*rest != '\0' && operandNum < 4) {
+        char* comma = strchr(rest, ',');
+        if (comma != NULL) *comma = '\0';
+        operands[operandNum++] = trim(rest);
+        if (comma == NULL) break;
+        rest = comma + 1;
+    }
+
+    for (size_t i = 0; i < sizeof(instrInfos) / sizeof(instrInfos[0]); ++i) {
+        if (strcmp(name, instrInfos[i].name) != 0) continue;
+        instr->op = instrInfos[i].op;
+        if (parseOperands(instrInfos[i].format, operands, operandNum, instr, pool)) return;
+        break;
+    }
+    instr->rd = instr->rs = instr->rt = -1;
+    instr->op = INSTR_UNKNOWN;
+    instr->symbol = internSymbol(pool, line);
+}
+
+void formatInstr(const Instr* instr, char* buffer, size_t size) {
+    if (instr->op == INSTR_LABEL) {
+        snprintf(buffer, size, "%s:", instr->symbol);
+        return;
+    }
+    const InstrInfo* info = findInstrInfo(instr->op);
+    if (info == NULL) {
+        snprintf(buffer, size, "%s", instr->symbol);
+        return;
+    }
+    char rd[12], rs[12], rt[12], imm[64];
+    formatRegister(instr->rd < 0 ? 0 : instr->rd, rd, sizeof(rd));
+    formatRegister(instr->rs < 0 ? 0 : instr->rs, rs, sizeof(rs));
+    formatRegister(instr->rt < 0 ? 0 : instr->rt, rt, sizeof(rt));
+    if (instr->symbol != NULL) {
+        snprintf(imm, sizeof(imm), "%s", instr->symbol);
+    } else {
+        snprintf(imm, sizeof(imm), "%d", instr->imm);
+    }
+    switch (info->format) {
+        case FORMAT_NONE:
+            snprintf(buffer, size, "%s", info->name);
+            break;
+        case FORMAT_REG3:
+            snprintf(buffer, size, "%s %s, %s, %s", info->name, rd, rs, rt);
+            break;
+        case FORMAT_REG2_IMM:
+            snprintf(buffer, size, "%s %s, %s, %s", info->name, rd, rs, imm);
+            break;
+        case FORMAT_REG_IMM:
+            snprintf(buffer, size, "%s %s, %s", info->name, rd, imm);
+            break;
+        case FORMAT_LOAD:
+            snprintf(buffer, size, "%s %s, %s(%s)", info->name, rd, imm, rs);
+            break;
+        case FORMAT_STORE:
+            snprintf(buffer, size, "%s %s, %s(%s)", info->name, rt, imm, rs);
+            break;
+        case FORMAT_BRANCH:
+            snprintf(buffer, size, "%s %s, %s, %s", info->name, rs, rt, instr->symbol);
+            break;
+        case FORMAT_JUMP:
+            snprintf(buffer, size, "%s %s", info->name, instr->symbol);
+            break;
+        case FORMAT_JUMP_REG:
+            snprintf(buffer, size, "%s %s", info->name, rs);
+            break;
+        case FORMAT_MOVE:
+            snprintf(buffer, size, "%s %s, %s", info->name, rd, rs);
+            break;
+    }
+}
+
+int getInstrDef(const Instr* instr) {
+    if (instr->op == INSTR_JAL) return 1;
+    return instr->rd > 0 ? instr->rd : -1;
+}
+
+int getInstrUses(const Instr* instr, int uses[2]) {
+    int num = 0;
+    if (instr->op == INSTR_LABEL || instr->op == INSTR_DIRECTIVE || instr->op == INSTR_UNKNOWN) return 0;
+    if (instr->rs > 0) uses[num++] = instr->rs;
+    if (instr->rt > 0 && instr->rt != instr->rs) uses[num++] = instr->rt;
+    return num;
+}
+
+bool hasDelaySlot(const Instr* instr) {
+    return instr->op == INSTR_BEQ || instr->op == INSTR_BNE || instr->op == INSTR_J ||
+           instr->op == INSTR_JAL || instr->op == INSTR_JR;
+}
+
+bool isLoadInstr(const Instr* instr) {
+    return instr->op == INSTR_LW || instr->op == INSTR_LH || instr->op == INSTR_LBU;
+}
+
+bool isStoreInstr(const Instr* instr) {
+    return instr->op == INSTR_SW || instr->op == INSTR_SH || instr->op == INSTR_SB;
+}
+
+bool isMemoryInstr(const Instr* instr) {
+    return isLoadInstr(instr) || isStoreInstr(instr);
+}
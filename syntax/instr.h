@@ -0,0 +1,87 @@
+#ifndef INSTR_H
+#define INSTR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 汇编指令的结构化形式
+ * AsmContainer 中连续存放 Instr：操作码、寄存器号、立即数和符号引用。代码生成仍可以按文本写入一行
+ * （见 newAsm），写入时解析一次；窥孔优化和延迟槽填充直接读写 Instr，文本只在 writeAssembly 中生成一次。
+ * 符号字符串存放在 SymbolPool 中，相同的字符串只存一份，所以两个符号引用可以直接比较指针。
+ * Minisys 流水线的约定（与 generateASM 中填充 nop 的方式一致）：
+ * - beq、bne、j、jal、jr 之后有一个延迟槽，槽中的指令总会执行
+ * - lw、lh、lbu 的结果在之后的 LOAD_DELAY 条指令中还不能读
+ */
+#define LOAD_DELAY 2
+
+typedef enum InstrOp {
+    // rd = rs op rt
+    INSTR_ADD, INSTR_ADDU, INSTR_SUB, INSTR_SUBU, INSTR_AND, INSTR_OR, INSTR_XOR, INSTR_NOR,
+    INSTR_SLT, INSTR_SLTU, INSTR_SLLV, INSTR_SRLV, INSTR_SRAV,
+    // rd = rs op imm，移位量也放在 imm 中
+    INSTR_SLL, INSTR_SRL, INSTR_SRA,
+    INSTR_ADDI, INSTR_ADDIU, INSTR_ANDI, INSTR_ORI, INSTR_XORI, INSTR_SLTI, INSTR_SLTIU,
+    INSTR_LUI,      // rd = imm << 16
+    INSTR_LW,       // rd = mem[rs + imm]
+    INSTR_LH,       // 半字，符号扩展
+    INSTR_LBU,      // 字节，零扩展
+    INSTR_SW,       // mem[rs + imm] = rt
+    INSTR_SH,
+    INSTR_SB,
+    INSTR_BEQ,      // rs == rt 时转到 symbol
+    INSTR_BNE,
+    INSTR_J,
+    INSTR_JAL,      // 写 ra
+    INSTR_JR,       // 转到 rs
+    INSTR_MV,       // rd = rs，写作 mv 或 move
+    INSTR_NOP,
+    INSTR_LABEL,    // symbol 为标号名
+    INSTR_DIRECTIVE,// 以 . 开头的伪指令和 .data 中的数据定义，symbol 为整行
+    INSTR_UNKNOWN,  // 无法解析的行，symbol 为整行
+} InstrOp;
+
+typedef struct Instr {
+    InstrOp op;
+    int rd;         // 目的寄存器，没有时为 -1
+    int rs;         // 第一个源寄存器或基址寄存器，没有时为 -1
+    int rt;         // 第二个源寄存器或 sw 存储的寄存器，没有时为 -1
+    int imm;        // 立即数、移位量或偏移
+    const char* symbol; // 跳转目标、代替立即数或偏移的全局变量名，没有时为 NULL。指向 SymbolPool
+} Instr;
+
+// 符号字符串池：开放定址的哈希表，字符串按块分配，整个池一起释放
+typedef struct SymbolPool {
+    const char** table;
+    unsigned int tableSize;     // 2 的幂
+    unsigned int count;
+    char** blocks;
+    unsigned int blockNum;
+    size_t blockUsed;           // 最后一块已用的字节数
+} SymbolPool;
+
+#define SYMBOL_BLOCK_SIZE 4096
+
+void initSymbolPool(SymbolPool* pool);
+void freeSymbolPool(SymbolPool* pool);
+// 返回池中与 text 相同的字符串，没有时复制一份
+const char* internSymbol(SymbolPool* pool, const char* text);
+
+// 寄存器名（x5、a0、sp 等）对应的编号，不是寄存器时返回 -1
+int parseRegister(const char* name);
+
+// 解析一行汇编，失败时 op 为 INSTR_UNKNOWN，整行作为 symbol
+void parseInstr(const char* line, Instr* instr, SymbolPool* pool);
+// 按 generateASM 的写法生成一行汇编
+void formatInstr(const Instr* instr, char* buffer, size_t size);
+
+// 写的寄存器，没有时（或写 zero 时）返回 -1
+int getInstrDef(const Instr* instr);
+// 读的寄存器写入 uses，返回个数（最多 2 个，不含 zero）
+int getInstrUses(const Instr* instr, int uses[2]);
+
+bool hasDelaySlot(const Instr* instr);    // beq、bne、j、jal、jr
+bool isLoadInstr(const Instr* instr);     // lw、lh、lbu
+bool isStoreInstr(const Instr* instr);    // sw、sh、sb
+bool isMemoryInstr(const Instr* instr);
+
+#endif // INSTR_H
@@ -0,0 +1,231 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+
+/* loop-invariant code motion (Dragon Book 9.5.5).
+ * natural loops are found from the back edges of the CFG, see findLoops(). a TAC x = y op z in loop L is moved to a preheader if
+ * - y and z are constants, or are defined only outside L, or only by one TAC already chosen,
+ * - op has no side effect: =$ reads a device and is never moved, =* only when L stores to no
+ *   array, and reads of globals only when L has no call or $=,
+ * - x is a local scalar written only by this TAC in L and not live at the header,
+ * - the block of the TAC dominates every exit of L, or x is dead after L. moving a TAC that the
+ *   loop may not run is only done for operations that cannot fault, so =*, / and % need the
+ *   dominance condition.
+ * the preheader is a new label placed before the header label. jumps from outside the loop are
+ * redirected to it, back edges still go to the header. innermost loops are handled first, and
+ * the CFG is rebuilt after every changed loop, so code can move out of a whole loop nest.
+ */
+typedef struct LoopContext {
+    CFG* cfg;
+    Liveness* liveness;
+    bool* local;
+    int* idom;
+    Loop* loops;
+    int loopNum;
+} LoopContext;
+
+static bool isPure(TACOpcode op) {
+    return op != TAC_CALL && op != TAC_READ_ADDR && op != TAC_WRITE_ADDR &&
+           op != TAC_STORE && op != TAC_STORE_ELEM && op != TAC_PARAM;
+}
+
+static bool mayFault(TACOpcode op) {
+    return op == TAC_LOAD || op == TAC_LOAD_ELEM || op == TAC_DIV || op == TAC_MOD;
+}
+
+typedef struct LoopInfo {
+    int* defNum;            // indexed by variable number: TACs in the loop writing it
+    TACList** hoisted;      // chosen TACs in the order they will be placed in the preheader
+    int hoistedNum;
+    bool* chosen;           // indexed by variable number: written by a chosen TAC
+    bool hasCall;           // call or $= in the loop
+    bool hasStore;          // *=, []=, $= or call in the loop
+} LoopInfo;
+
+static bool operandInvariant(LoopContext* ctx, LoopInfo* info, char* operand) {
+    if (operand == NULL || *operand == '\0' || isConstant(operand)) return true;
+    int num = isVariable(operand) ? getLivenessVar(ctx->liveness, operand) : -1;
+    if (num == -1) return true;
+    if (!ctx->local[num] && info->hasCall) return false;
+    return info->defNum[num] == 0 || info->chosen[num];
+}
+
+static bool dominatesExits(LoopContext* ctx, Loop* loop, int block) {
+    for (int b = 0; b < ctx->cfg->blockNum; ++b) {
+        if (!loop->body[b]) continue;
+        BasicBlock* cur = ctx->cfg->blocks[b];
+        for (int i = 0; i < cur->succNum; ++i) {
+            BasicBlock* succ = cur->succs[i];
+            bool exits = succ == ctx->cfg->exit || !loop->body[succ->id];
+            if (exits && !dominates(ctx->idom, block, b)) return false;
+        }
+    }
+    return true;
+}
+
+static bool liveAfterLoop(LoopContext* ctx, Loop* loop, int num) {
+    for (int b = 0; b < ctx->cfg->blockNum; ++b) {
+        if (!loop->body[b]) continue;
+        BasicBlock* cur = ctx->cfg->blocks[b];
+        for (int i = 0; i < cur->succNum; ++i) {
+            BasicBlock* succ = cur->succs[i];
+            if (succ != ctx->cfg->exit && !loop->body[succ->id] && LIVE_SET_HAS(ctx->liveness->liveIn[succ->id], num)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// choose the TACs to move out of the loop, returns their number
+static int chooseInvariants(LoopContext* ctx, Loop* loop, LoopInfo* info) {
+    CFG* cfg = ctx->cfg;
+    int varNum = ctx->liveness->varNum;
+    info->defNum = (int*)calloc(varNum + 1, sizeof(int));
+    info->chosen = (bool*)calloc(varNum + 1, sizeof(bool));
+    info->hasCall = false;
+    info->hasStore = false;
+    int tacNum = 0;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        if (!loop->body[b]) continue;
+        TACList* cur = cfg->blocks[b]->first;
+        for (int i = 0; i < cfg->blocks[b]->tacNum; ++i, cur = cur->next) {
+            TAC* tac = cur->tac;
+            char* operands[3];
+            getTACVarOperands(tac, operands);
+            if (operands[2] != NULL && (getTACRoles(tac) & TAC_DEF_RES)) {
+                info->defNum[getLivenessVar(ctx->liveness, operands[2])]++;
+            }
+            if (tac->op == TAC_CALL || tac->op == TAC_WRITE_ADDR) {
+                info->hasCall = true;
+                info->hasStore = true;
+            } else if (tac->op == TAC_STORE || tac->op == TAC_STORE_ELEM) {
+                info->hasStore = true;
+            }
+            ++tacNum;
+        }
+    }
+    info->hoisted = (TACList**)malloc((tacNum + 1) * sizeof(TACList*));
+    info->hoistedNum = 0;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = 0; b < cfg->blockNum; ++b) {
+            if (!loop->body[b]) continue;
+            TACList* cur = cfg->blocks[b]->first;
+            for (int i = 0; i < cfg->blocks[b]->tacNum; ++i, cur = cur->next) {
+                TAC* tac = cur->tac;
+                int roles = getTACRoles(tac);
+                if (!(roles & TAC_DEF_RES) || !isPure(tac->op) || !isVariable(tac->res)) continue;
+                int num = getLivenessVar(ctx->liveness, tac->res);
+                if (info->chosen[num] || !ctx->local[num] || info->defNum[num] != 1) continue;
+                bool load = tac->op == TAC_LOAD || tac->op == TAC_LOAD_ELEM;
+                if (load && info->hasStore) continue;
+                if (!operandInvariant(ctx, info, tac->arg1) || !operandInvariant(ctx, info, tac->arg2)) continue;
+                if (LIVE_SET_HAS(ctx->liveness->liveIn[loop->header], num)) continue;
+                if (!dominatesExits(ctx, loop, b) && (mayFault(tac->op) || liveAfterLoop(ctx, loop, num))) continue;
+                info->chosen[num] = true;
+                info->hoisted[info->hoistedNum++] = cur;
+                changed = true;
+            }
+        }
+    }
+    return info->hoistedNum;
+}
+
+static bool isHoisted(LoopInfo* info, TACList* node) {
+    for (int i = 0; i < info->hoistedNum; ++i) {
+        if (info->hoisted[i] == node) return true;
+    }
+    return false;
+}
+
+TACList* insertPreheader(CFG* cfg, Loop* loop) {
+    BasicBlock* header = cfg->blocks[loop->header];
+    char* headerLabel = getBlockLabel(header);
+    char* preheaderLabel = generateLabel();
+
+    // entries from outside the loop go through the preheader, back edges still go to the header
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        if (loop->body[b]) continue;
+        TAC* last = cfg->blocks[b]->last->tac;
+        bool jump = last->op == TAC_GOTO || last->op == TAC_IF_GOTO || last->op == TAC_IF_FALSE_GOTO;
+        if (jump && strcmp(last->res, headerLabel) == 0) {
+            last->res = preheaderLabel;
+        }
+    }
+    // a block of the loop placed right before the header must not fall into the preheader
+    bool fallsIn = false;
+    if (loop->header > 0 && loop->body[loop->header - 1]) {
+        TACOpcode op = cfg->blocks[loop->header - 1]->last->tac->op;
+        fallsIn = op != TAC_GOTO && op != TAC_RETURN;
+    }
+    TACList* prev = loop->header == 0 ? cfg->funcLabel : cfg->blocks[loop->header - 1]->last;
+    if (fallsIn) {
+        prev = insertTACAfter(prev, createTAC(TAC_GOTO, NULL, NULL, headerLabel));
+    }
+    return insertTACAfter(prev, createTAC(TAC_LABEL, preheaderLabel, NULL, NULL));
+}
+
+// create the preheader and move the chosen TACs into it
+static void moveInvariants(LoopContext* ctx, Loop* loop, LoopInfo* info) {
+    CFG* cfg = ctx->cfg;
+    TAC** moved = (TAC**)malloc((info->hoistedNum + 1) * sizeof(TAC*));
+    for (int i = 0; i < info->hoistedNum; ++i) {
+        TAC* tac = info->hoisted[i]->tac;
+        moved[i] = createTAC(tac->op, tac->arg1, tac->arg2, tac->res);
+    }
+    // the nodes of the CFG are still valid here, the originals are removed afterwards
+    TACList* preheader = insertPreheader(cfg, loop);
+    TACList* prev = cfg->funcLabel;
+    TACList* cur = cfg->funcLabel->next;
+    while (cur != cfg->endLabel) {
+        TACList* next = cur->next;
+        if (isHoisted(info, cur)) {
+            removeTAC(prev, cur);
+        } else {
+            prev = cur;
+        }
+        cur = next;
+    }
+    for (int i = 0; i < info->hoistedNum; ++i) {
+        preheader = insertTACAfter(preheader, moved[i]);
+    }
+    free(moved);
+}
+
+void hoistLoopInvariants(CFG* cfg, FILE* report) {
+    TACList* funcLabel = cfg->funcLabel;
+    int hoisted = 0, preheaders = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        LoopContext ctx;
+        ctx.cfg = buildCFG(funcLabel);
+        ctx.liveness = computeLiveness(ctx.cfg);
+        ctx.local = findLocalScalars(ctx.cfg, ctx.liveness);
+        ctx.idom = computeDominators(ctx.cfg);
+        ctx.loops = findLoops(ctx.cfg, ctx.idom, &ctx.loopNum);
+        for (int i = 0; i < ctx.loopNum && !changed; ++i) {
+            Loop* loop = &ctx.loops[i];
+            if (getBlockLabel(ctx.cfg->blocks[loop->header]) == NULL) continue;
+            LoopInfo info;
+            if (chooseInvariants(&ctx, loop, &info) > 0) {
+                moveInvariants(&ctx, loop, &info);
+                hoisted += info.hoistedNum;
+                ++preheaders;
+                changed = true;
+            }
+            free(info.defNum);
+            free(info.chosen);
+            free(info.hoisted);
+        }
+        freeLoops(ctx.loops, ctx.loopNum);
+        free(ctx.idom);
+        free(ctx.local);
+        freeLiveness(ctx.liveness);
+        freeCFG(ctx.cfg);
+    }
+    fprintf(report, "%s: %d TACs hoisted into %d preheaders\n", cfg->funcName, hoisted, preheaders);
+}
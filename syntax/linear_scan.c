@@ -0,0 +1,225 @@
+#include "regalloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include "symbol_table.h"
+
+/* 线性扫描寄存器分配（Poletto & Sarkar, 1999）
+ * 活跃区间用四元式下标表示：从变量第一次出现到最后一次出现，并用基本块的 liveIn/liveOut 扩展到
+ * 整个块，这样循环中活跃的变量会覆盖整个循环体。按区间起点扫描，寄存器不够时溢出结束得最晚的区间。
+ */
+typedef struct LiveInterval {
+    int location;       // RegAssignment.locations 的下标
+    int start;
+    int end;
+    bool crossesCall;   // 区间内有 call，优先使用被调用者保存寄存器
+    int reg;
+} LiveInterval;
+
+static void extendInterval(LiveInterval* interval, int index) {
+    if (interval->start == -1 || index < interval->start) interval->start = index;
+    if (index > interval->end) interval->end = index;
+}
+
+static int compareStart(const void* a, const void* b) {
+    const LiveInterval* x = *(const LiveInterval* const*)a;
+    const LiveInterval* y = *(const LiveInterval* const*)b;
+    if (x->start != y->start) return x->start - y->start;
+    return x->end - y->end;
+}
+
+static bool isCalleeSaved(int reg) {
+    for (int i = 0; i < CALLEE_SAVED_REG_NUM; ++i) {
+        if (calleeSavedRegs[i] == reg) return true;
+    }
+    return false;
+}
+
+static int takeFreeCallerSaved(bool* freeRegs) {
+    for (int i = 0; i < CALLER_SAVED_REG_NUM; ++i) {
+        if (freeRegs[callerSavedRegs[i]]) {
+            freeRegs[callerSavedRegs[i]] = false;
+            return callerSavedRegs[i];
+        }
+    }
+    return -1;
+}
+
+// 取一个空闲寄存器，不跨调用的区间优先使用调用者保存寄存器。跨调用的区间没有空闲的被调用者保存寄存器时
+// 也可以使用调用者保存寄存器，代码生成在它活跃跨过的调用前后保存，这比溢出整个区间便宜
+static int takeFreeReg(bool* freeRegs, bool crossesCall) {
+    if (!crossesCall) {
+        int reg = takeFreeCallerSaved(freeRegs);
+        if (reg != -1) return reg;
+    }
+    for (int i = 0; i < CALLEE_SAVED_REG_NUM; ++i) {
+        if (freeRegs[calleeSavedRegs[i]]) {
+            freeRegs[calleeSavedRegs[i]] = false;
+            return calleeSavedRegs[i];
+        }
+    }
+    return crossesCall ? takeFreeCallerSaved(freeRegs) : -1;
+}
+
+static void spillInterval(RegAssignment* assignment, LiveInterval* interval) {
+    interval->reg = -1;
+    assignment->locations[interval->location].reg = -1;
+    allocateSpillSlot(assignment, &assignment->locations[interval->location]);
+    assignment->spillNum++;
+}
+
+void linearScan(RegAssignment* assignment, CFG* cfg, Liveness* liveness) {
+    // 1. 为每个需要分配的变量建立区间
+    LiveInterval* intervals = (LiveInterval*)malloc((liveness->varNum + 1) * sizeof(LiveInterval));
+    int* intervalOf = (int*)malloc((liveness->varNum + 1) * sizeof(int)); // 变量编号 -> 区间下标
+    int intervalNum = 0;
+    for (int i = 0; i < liveness->varNum; ++i) {
+        VarLocation* location = findVarLocation(assignment, liveness->vars[i]);
+        if (location == NULL || location->isLocalArray) {
+            intervalOf[i] = -1; // 全局变量、字符常量和局部数组不分配寄存器
+            continue;
+        }
+        LiveInterval* interval = &intervals[intervalNum];
+        interval->location = (int)(location - assignment->locations);
+        interval->start = -1;
+        interval->end = -1;
+        interval->crossesCall = false;
+        interval->reg = -1;
+        intervalOf[i] = intervalNum++;
+    }
+
+    // 2. 计算区间，同时记录所有 call 的位置
+    int funcStart = cfg->funcLabel->tac->index;
+    int callCapacity = 16;
+    int callNum = 0;
+    int* calls = (int*)malloc(callCapacity * sizeof(int));
+    int pendingParams[MAX_CALL_ARGS];
+    int pendingParamNum = 0;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        BasicBlock* block = cfg->blocks[b];
+        TACList* cur = block->first;
+        for (int j = 0; j < block->tacNum; ++j, cur = cur->next) {
+            TAC* tac = cur->tac;
+            char* operands[3];
+            getTACVarOperands(tac, operands);
+            for (int k = 0; k < 3; ++k) {
+                if (operands[k] == NULL) continue;
+                int num = intervalOf[getLivenessVar(liveness, operands[k])];
+                if (num == -1) continue;
+                extendInterval(&intervals[num], tac->index);
+                // 实参在 call 时才传递，要活跃到 call
+                if (tac->op == TAC_PARAM && pendingParamNum < MAX_CALL_ARGS) {
+                    pendingParams[pendingParamNum++] = num;
+                }
+            }
+            if (tac->op == TAC_CALL) {
+                for (int k = 0; k < pendingParamNum; ++k) {
+                    extendInterval(&intervals[pendingParams[k]], tac->index);
+                }
+                pendingParamNum = 0;
+                // 尾调用不会返回，之后没有活跃的值，不影响寄存器的选择
+                if (isTailCall(assignment, tac)) continue;
+                if (callNum >= callCapacity) {
+                    callCapacity *= 2;
+                    calls = (int*)realloc(calls, callCapacity * sizeof(int));
+                }
+                calls[callNum++] = tac->index;
+            }
+        }
+        for (int i = 0; i < liveness->varNum; ++i) {
+            if (intervalOf[i] == -1) continue;
+            if (LIVE_SET_HAS(liveness->liveIn[b], i)) {
+                extendInterval(&intervals[intervalOf[i]], block->first->tac->index);
+            }
+            if (LIVE_SET_HAS(liveness->liveOut[b], i)) {
+                extendInterval(&intervals[intervalOf[i]], block->last->tac->index);
+            }
+        }
+    }
+    // 参数在函数入口定义
+    SymbolTableEntry* func = findSymbol(assignment->funcName);
+    for (int i = 0; func != NULL && i < func->paramNum; ++i) {
+        int num = getLivenessVar(liveness, func->params[i]->id);
+        if (num != -1 && intervalOf[num] != -1) {
+            extendInterval(&intervals[intervalOf[num]], funcStart);
+        }
+    }
+    for (int i = 0; i < intervalNum; ++i) {
+        for (int c = 0; c < callNum; ++c) {
+            if (intervals[i].start < calls[c] && calls[c] < intervals[i].end) {
+                intervals[i].crossesCall = true;
+                break;
+            }
+        }
+    }
+
+    // 3. 按起点扫描。active 按终点升序排列
+    LiveInterval** sorted = (LiveInterval**)malloc((intervalNum + 1) * sizeof(LiveInterval*));
+    LiveInterval** active = (LiveInterval**)malloc((intervalNum + 1) * sizeof(LiveInterval*));
+    int activeNum = 0;
+    for (int i = 0; i < intervalNum; ++i) {
+        sorted[i] = &intervals[i];
+    }
+    qsort(sorted, intervalNum, sizeof(LiveInterval*), compareStart);
+    bool freeRegs[32] = { false };
+    for (int i = 0; i < CALLER_SAVED_REG_NUM; ++i) freeRegs[callerSavedRegs[i]] = true;
+    for (int i = 0; i < CALLEE_SAVED_REG_NUM; ++i) freeRegs[calleeSavedRegs[i]] = true;
+
+    for (int i = 0; i < intervalNum; ++i) {
+        LiveInterval* cur = sorted[i];
+        // 释放已经结束的区间。结束于 cur 起点的区间也可以释放：同一条四元式先读操作数再写结果
+        int kept = 0;
+        for (int j = 0; j < activeNum; ++j) {
+            if (active[j]->end <= cur->start) {
+                freeRegs[active[j]->reg] = true;
+            } else {
+                active[kept++] = active[j];
+            }
+        }
+        activeNum = kept;
+
+        cur->reg = takeFreeReg(freeRegs, cur->crossesCall);
+        if (cur->reg == -1) {
+            // 溢出结束最晚的区间，它的寄存器必须满足 cur 的要求
+            int victim = -1;
+            for (int j = activeNum - 1; j >= 0; --j) {
+                if (!cur->crossesCall || isCalleeSaved(active[j]->reg)) {
+                    victim = j;
+                    break;
+                }
+            }
+            if (victim != -1 && active[victim]->end > cur->end) {
+                cur->reg = active[victim]->reg;
+                spillInterval(assignment, active[victim]);
+                for (int j = victim; j < activeNum - 1; ++j) {
+                    active[j] = active[j + 1];
+                }
+                activeNum--;
+            } else {
+                spillInterval(assignment, cur);
+                continue;
+            }
+        }
+
+        assignment->locations[cur->location].reg = cur->reg;
+        int pos = activeNum++;
+        while (pos > 0 && active[pos - 1]->end > cur->end) {
+            active[pos] = active[pos - 1];
+            pos--;
+        }
+        active[pos] = cur;
+    }
+
+    // 4. 统计
+    assignment->candidateNum = intervalNum;
+    for (int i = 0; i < intervalNum; ++i) {
+        if (intervals[i].reg != -1) {
+            markRegisterUsed(assignment, intervals[i].reg);
+        }
+    }
+
+    free(sorted);
+    free(active);
+    free(calls);
+    free(intervalOf);
+    free(intervals);
+}
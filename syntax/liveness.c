@@ -0,0 +1,382 @@
+#include "liveness.h"
+#include <string.h>
+#include "cfg.h"
+
+// every variable that appears in the code has one entry in this table
+typedef struct VarInfo {
+    char* name;
+    int nextUse;    // next-use info at the current position of the scan
+    int block;      // the first block that refers to the variable
+    int multiBlock; // =1 if the variable is referred in more than one block
+    struct VarInfo* next;
+} VarInfo;
+
+#define VAR_TABLE_INITIAL_SIZE 256
+static VarInfo** varTable = NULL;
+static unsigned int varTableSize = 0;
+static unsigned int varNum = 0;
+
+static unsigned int hashVar(const char* name) {
+    unsigned int hash = 5381;
+    while (*name) {
+        hash = (hash << 5) + hash + (unsigned char)*name;
+        name++;
+    }
+    return hash;
+}
+
+static VarInfo* findVar(const char* name) {
+    if (varTable == NULL) return NULL;
+    VarInfo* cur = varTable[hashVar(name) & (varTableSize - 1)];
+    while (cur) {
+        if (strcmp(cur->name, name) == 0) {
+            return cur;
+        }
+        cur = cur->next;
+    }
+    return NULL;
+}
+
+static void growVarTable() {
+    unsigned int newSize = varTableSize * 2;
+    VarInfo** newTable = (VarInfo**)calloc(newSize, sizeof(VarInfo*));
+    if (newTable == NULL) {
+        fprintf(stderr, "Failed to allocate memory for next-use table.\n");
+        exit(1);
+    }
+    for (unsigned int i = 0; i < varTableSize; ++i) {
+        VarInfo* cur = varTable[i];
+        while (cur) {
+            VarInfo* next = cur->next;
+            unsigned int index = hashVar(cur->name) & (newSize - 1);
+            cur->next = newTable[index];
+            newTable[index] = cur;
+            cur = next;
+        }
+    }
+    free(varTable);
+    varTable = newTable;
+    varTableSize = newSize;
+}
+
+static VarInfo* internVar(char* name, int block) {
+    VarInfo* info = findVar(name);
+    if (info != NULL) {
+        if (info->block != block) {
+            info->multiBlock = 1;
+        }
+        return info;
+    }
+    if (varTable == NULL) {
+        varTableSize = VAR_TABLE_INITIAL_SIZE;
+        varTable = (VarInfo**)calloc(varTableSize, sizeof(VarInfo*));
+    } else if (varNum * 4 >= varTableSize * 3) {
+        growVarTable();
+    }
+    info = (VarInfo*)malloc(sizeof(VarInfo));
+    if (varTable == NULL || info == NULL) {
+        fprintf(stderr, "Failed to allocate memory for next-use table.\n");
+        exit(1);
+    }
+    info->name = name;
+    info->nextUse = NEXT_USE_EXIT;
+    info->block = block;
+    info->multiBlock = 0;
+    unsigned int index = hashVar(name) & (varTableSize - 1);
+    info->next = varTable[index];
+    varTable[index] = info;
+    ++varNum;
+    return info;
+}
+
+// user variables may be read by other blocks or functions, while temps are only
+// live on exit if another block refers to them (e.g. the condition of a for statement)
+static int initialNextUse(VarInfo* info) {
+    if (!isTemp(info->name) || info->multiBlock) {
+        return NEXT_USE_EXIT;
+    }
+    return NEXT_USE_DEAD;
+}
+
+// scan one basic block tacs[0..num) backwards
+static void computeBlockNextUse(TAC** tacs, int num) {
+    for (int i = 0; i < num; ++i) {
+        char* operands[3];
+        getTACVarOperands(tacs[i], operands);
+        for (int j = 0; j < 3; ++j) {
+            if (operands[j] != NULL) {
+                VarInfo* info = findVar(operands[j]);
+                info->nextUse = initialNextUse(info);
+            }
+        }
+    }
+
+    for (int i = num - 1; i >= 0; --i) {
+        TAC* tac = tacs[i];
+        int roles = getTACRoles(tac);
+        char* operands[3];
+        getTACVarOperands(tac, operands);
+        VarInfo* arg1 = operands[0] ? findVar(operands[0]) : NULL;
+        VarInfo* arg2 = operands[1] ? findVar(operands[1]) : NULL;
+        VarInfo* res = operands[2] ? findVar(operands[2]) : NULL;
+
+        // 1. attach the current info to the tac
+        tac->arg1NextUse = arg1 ? arg1->nextUse : NEXT_USE_DEAD;
+        tac->arg2NextUse = arg2 ? arg2->nextUse : NEXT_USE_DEAD;
+        tac->resNextUse = res ? res->nextUse : NEXT_USE_DEAD;
+        // 2. the result is dead before this tac
+        if (res && (roles & TAC_DEF_RES)) {
+            res->nextUse = NEXT_USE_DEAD;
+        }
+        // 3. the arguments are used by this tac
+        if (arg1) arg1->nextUse = tac->index;
+        if (arg2) arg2->nextUse = tac->index;
+        if (res && (roles & TAC_USE_RES)) res->nextUse = tac->index;
+    }
+}
+
+void computeNextUse() {
+    freeNextUse();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+
+    // intern all variables. block ids are numbered across functions
+    int blockBase = 0;
+    int maxTacNum = 0;
+    for (int i = 0; i < cfgNum; ++i) {
+        for (int j = 0; j < cfgs[i]->blockNum; ++j) {
+            BasicBlock* block = cfgs[i]->blocks[j];
+            TACList* cur = block->first;
+            for (int k = 0; k < block->tacNum; ++k, cur = cur->next) {
+                char* operands[3];
+                getTACVarOperands(cur->tac, operands);
+                for (int l = 0; l < 3; ++l) {
+                    if (operands[l] != NULL) {
+                        internVar(operands[l], blockBase + j);
+                    }
+                }
+            }
+            if (block->tacNum > maxTacNum) {
+                maxTacNum = block->tacNum;
+            }
+        }
+        blockBase += cfgs[i]->blockNum;
+    }
+
+    TAC** tacs = (TAC**)malloc((maxTacNum + 1) * sizeof(TAC*));
+    if (tacs == NULL) {
+        fprintf(stderr, "Failed to allocate memory for next-use table.\n");
+        exit(1);
+    }
+    for (int i = 0; i < cfgNum; ++i) {
+        for (int j = 0; j < cfgs[i]->blockNum; ++j) {
+            BasicBlock* block = cfgs[i]->blocks[j];
+            TACList* cur = block->first;
+            for (int k = 0; k < block->tacNum; ++k, cur = cur->next) {
+                tacs[k] = cur->tac;
+            }
+            computeBlockNextUse(tacs, block->tacNum);
+        }
+    }
+
+    // the code generator starts from the first tac
+    for (unsigned int i = 0; i < varTableSize; ++i) {
+        for (VarInfo* cur = varTable[i]; cur; cur = cur->next) {
+            cur->nextUse = NEXT_USE_EXIT;
+        }
+    }
+
+    free(tacs);
+    freeCFGs(cfgs, cfgNum);
+}
+
+void advanceNextUse(TAC* tac) {
+    char* operands[3];
+    int nextUse[3] = {tac->arg1NextUse, tac->arg2NextUse, tac->resNextUse};
+    getTACVarOperands(tac, operands);
+    for (int j = 0; j < 3; ++j) {
+        VarInfo* info = operands[j] ? findVar(operands[j]) : NULL;
+        if (info) {
+            info->nextUse = nextUse[j];
+        }
+    }
+}
+
+int getNextUse(const char* var) {
+    if (var == NULL || *var == '\0') return NEXT_USE_DEAD;
+    VarInfo* info = findVar(var);
+    return info ? info->nextUse : NEXT_USE_EXIT;
+}
+
+bool isLiveAfter(const char* var) {
+    return getNextUse(var) != NEXT_USE_DEAD;
+}
+
+void freeNextUse() {
+    for (unsigned int i = 0; i < varTableSize; ++i) {
+        VarInfo* cur = varTable[i];
+        while (cur) {
+            VarInfo* next = cur->next;
+            free(cur);
+            cur = next;
+        }
+    }
+    free(varTable);
+    varTable = NULL;
+    varTableSize = 0;
+    varNum = 0;
+}
+
+static unsigned int* createLiveSet(Liveness* liveness) {
+    unsigned int* set = (unsigned int*)calloc(liveness->setWords, sizeof(unsigned int));
+    if (set == NULL) {
+        fprintf(stderr, "Failed to allocate memory for liveness.\n");
+        exit(1);
+    }
+    return set;
+}
+
+int getLivenessVar(Liveness* liveness, const char* var) {
+    if (var == NULL || liveness->varTableSize == 0) return -1;
+    unsigned int index = hashVar(var) & (liveness->varTableSize - 1);
+    while (liveness->varTable[index] != -1) {
+        if (strcmp(liveness->vars[liveness->varTable[index]], var) == 0) {
+            return liveness->varTable[index];
+        }
+        index = (index + 1) & (liveness->varTableSize - 1);
+    }
+    return -1;
+}
+
+static int addLivenessVar(Liveness* liveness, char* var, int* capacity) {
+    int num = getLivenessVar(liveness, var);
+    if (num != -1) return num;
+    if (liveness->varNum >= *capacity) {
+        *capacity *= 2;
+        liveness->vars = (char**)realloc(liveness->vars, *capacity * sizeof(char*));
+    }
+    num = liveness->varNum++;
+    liveness->vars[num] = var;
+    unsigned int index = hashVar(var) & (liveness->varTableSize - 1);
+    while (liveness->varTable[index] != -1) {
+        index = (index + 1) & (liveness->varTableSize - 1);
+    }
+    liveness->varTable[index] = num;
+    return num;
+}
+
+Liveness* computeLiveness(CFG* cfg) {
+    Liveness* liveness = (Liveness*)calloc(1, sizeof(Liveness));
+    if (liveness == NULL) {
+        fprintf(stderr, "Failed to allocate memory for liveness.\n");
+        exit(1);
+    }
+    liveness->cfg = cfg;
+
+    // 1. number the variables. there are at most 3 per tac
+    int tacNum = 0;
+    for (int i = 0; i < cfg->blockNum; ++i) {
+        tacNum += cfg->blocks[i]->tacNum;
+    }
+    liveness->varTableSize = 16;
+    while (liveness->varTableSize < (unsigned int)tacNum * 6) {
+        liveness->varTableSize *= 2;
+    }
+    liveness->varTable = (int*)malloc(liveness->varTableSize * sizeof(int));
+    for (unsigned int i = 0; i < liveness->varTableSize; ++i) {
+        liveness->varTable[i] = -1;
+    }
+    int capacity = 16;
+    liveness->vars = (char**)malloc(capacity * sizeof(char*));
+    for (int i = 0; i < cfg->blockNum; ++i) {
+        TACList* cur = cfg->blocks[i]->first;
+        for (int j = 0; j < cfg->blocks[i]->tacNum; ++j, cur = cur->next) {
+            char* operands[3];
+            getTACVarOperands(cur->tac, operands);
+            for (int k = 0; k < 3; ++k) {
+                if (operands[k] != NULL) {
+                    addLivenessVar(liveness, operands[k], &capacity);
+                }
+            }
+        }
+    }
+    liveness->setWords = (liveness->varNum + 31) / 32 + 1;
+
+    // 2. use and def of every block
+    int blockNum = cfg->blockNum;
+    liveness->use = (unsigned int**)malloc((blockNum + 1) * sizeof(unsigned int*));
+    liveness->def = (unsigned int**)malloc((blockNum + 1) * sizeof(unsigned int*));
+    liveness->liveIn = (unsigned int**)malloc((blockNum + 1) * sizeof(unsigned int*));
+    liveness->liveOut = (unsigned int**)malloc((blockNum + 1) * sizeof(unsigned int*));
+    for (int i = 0; i < blockNum; ++i) {
+        BasicBlock* block = cfg->blocks[i];
+        unsigned int* use = liveness->use[i] = createLiveSet(liveness);
+        unsigned int* def = liveness->def[i] = createLiveSet(liveness);
+        liveness->liveIn[i] = createLiveSet(liveness);
+        liveness->liveOut[i] = createLiveSet(liveness);
+        TACList* cur = block->first;
+        for (int j = 0; j < block->tacNum; ++j, cur = cur->next) {
+            int roles = getTACRoles(cur->tac);
+            char* operands[3];
+            getTACVarOperands(cur->tac, operands);
+            for (int k = 0; k < 3; ++k) {
+                if (operands[k] == NULL || (k == 2 && !(roles & TAC_USE_RES))) continue;
+                int num = getLivenessVar(liveness, operands[k]);
+                if (!LIVE_SET_HAS(def, num)) {
+                    LIVE_SET_ADD(use, num);
+                }
+            }
+            if (operands[2] != NULL && (roles & TAC_DEF_RES)) {
+                LIVE_SET_ADD(def, getLivenessVar(liveness, operands[2]));
+            }
+        }
+    }
+
+    // 3. iterate backwards until nothing changes.
+    // IN[B] = use[B] U (OUT[B] - def[B]), OUT[B] = U IN[S] for the successors S
+    int orderNum = 0;
+    BasicBlock** order = getReversePostorder(cfg, &orderNum);
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = orderNum - 1; i >= 0; --i) {
+            BasicBlock* block = order[i];
+            unsigned int* out = liveness->liveOut[block->id];
+            unsigned int* in = liveness->liveIn[block->id];
+            for (int j = 0; j < block->succNum; ++j) {
+                if (block->succs[j] == cfg->exit) continue;
+                unsigned int* succIn = liveness->liveIn[block->succs[j]->id];
+                for (int w = 0; w < liveness->setWords; ++w) {
+                    out[w] |= succIn[w];
+                }
+            }
+            for (int w = 0; w < liveness->setWords; ++w) {
+                unsigned int newIn = liveness->use[block->id][w] | (out[w] & ~liveness->def[block->id][w]);
+                if (newIn != in[w]) {
+                    in[w] = newIn;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    free(order);
+
+    return liveness;
+}
+
+void freeLiveness(Liveness* liveness) {
+    for (int i = 0; i < liveness->cfg->blockNum; ++i) {
+        free(liveness->use[i]);
+        free(liveness->def[i]);
+        free(liveness->liveIn[i]);
+        free(liveness->liveOut[i]);
+    }
+    free(liveness->use);
+    free(liveness->def);
+    free(liveness->liveIn);
+    free(liveness->liveOut);
+    free(liveness->vars);
+    free(liveness->varTable);
+    free(liveness);
+}
@@ -0,0 +1,60 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <stdbool.h>
+#include "tac.h"
+#include "cfg.h"
+
+/* next-use info (Dragon Book 8.4.2).
+ * computeNextUse() scans every basic block backwards once and stores, for each operand of a TAC,
+ * the index of the next TAC in the same block that reads it. instead of an index, the value can be
+ * one of the markers below.
+ */
+#define NEXT_USE_DEAD (-1) // not live after the TAC
+#define NEXT_USE_EXIT (-2) // live on exit of the block, but not read again inside it
+
+// compute next-use info for all TACs. indices should be assigned by generateIndex() first.
+void computeNextUse();
+
+// record the next-use info of the operands of tac.
+// the code generator calls this for every TAC in order, before allocating registers for it.
+void advanceNextUse(TAC* tac);
+
+// returns the next use of var after the last TAC passed to advanceNextUse().
+// variables that never appear in the code are considered live on exit.
+int getNextUse(const char* var);
+
+// returns whether var may be read after the last TAC passed to advanceNextUse()
+bool isLiveAfter(const char* var);
+
+void freeNextUse();
+
+/* live variables of a function (Dragon Book 9.2.5).
+ * the variables of the function are numbered from 0, and every set is a bitset of these numbers.
+ */
+typedef struct Liveness {
+    CFG* cfg;
+    char** vars;               // number -> name
+    int varNum;
+    int setWords;              // words of one bitset
+    unsigned int** use;        // indexed by block id: variables read before written in the block
+    unsigned int** def;        // indexed by block id: variables written in the block
+    unsigned int** liveIn;     // indexed by block id
+    unsigned int** liveOut;    // indexed by block id
+    int* varTable;             // hash table from names to numbers, see getLivenessVar()
+    unsigned int varTableSize;
+} Liveness;
+
+#define LIVE_SET_HAS(set, i) (((set)[(i) >> 5] >> ((i) & 31)) & 1u)
+#define LIVE_SET_ADD(set, i) ((set)[(i) >> 5] |= 1u << ((i) & 31))
+#define LIVE_SET_DELETE(set, i) ((set)[(i) >> 5] &= ~(1u << ((i) & 31)))
+
+// solve liveness of the function by iterating until the sets no longer change
+Liveness* computeLiveness(CFG* cfg);
+
+// returns the number of the variable, or -1 if the function does not use it
+int getLivenessVar(Liveness* liveness, const char* var);
+
+void freeLiveness(Liveness* liveness);
+
+#endif
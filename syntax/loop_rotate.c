@@ -0,0 +1,135 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+
+/* loop rotation. minic.y lays out while and for loops as
+ *   (label, Lc) <condition> (goto, , , Lx) (label, Lb) <body> (goto, , , Lc) (label, Lx)
+ * where the condition jumps to Lb when it is true, so every iteration runs its conditional jump
+ * and the goto back. the condition is copied in front of the loop as a guard of the first
+ * iteration and the original moves to the bottom in place of the goto:
+ *   <copy of condition> (label, Lb) <body> (label, Lc) <condition> (goto, , , Lx) (label, Lx)
+ * dead code elimination removes the goto before Lx and compare-and-branch fusion turns the
+ * condition into one conditional jump back to Lb. continue still jumps to Lc. the labels and temps
+ * written in the copy are renamed, so the copy is a separate condition for the later passes.
+ * conditions longer than MAX_ROTATE_CONDITION TACs are not copied.
+ */
+typedef struct Renaming {
+    char* from[MAX_ROTATE_CONDITION];
+    char* to[MAX_ROTATE_CONDITION];
+    int num;
+} Renaming;
+
+static char* renameOperand(Renaming* renaming, char* name) {
+    if (name == NULL) return NULL;
+    for (int i = 0; i < renaming->num; ++i) {
+        if (strcmp(renaming->from[i], name) == 0) return renaming->to[i];
+    }
+    return name;
+}
+
+static void addRename(Renaming* renaming, char* name) {
+    if (renameOperand(renaming, name) != name) return;
+    renaming->from[renaming->num++] = name;
+}
+
+static bool isJump(TAC* tac) {
+    return tac->op == TAC_GOTO || tac->op == TAC_IF_GOTO ||
+           tac->op == TAC_IF_FALSE_GOTO || isCompareBranch(tac);
+}
+
+// the label node named label between the function label and end, NULL if there is none
+static TACList* findLabelBefore(CFG* cfg, char* label, TACList* end, TACList** prev) {
+    *prev = cfg->funcLabel;
+    for (TACList* cur = cfg->funcLabel->next; cur != NULL && cur != end; *prev = cur, cur = cur->next) {
+        if (cur->tac->op == TAC_LABEL && strcmp(cur->tac->arg1, label) == 0) return cur;
+    }
+    return NULL;
+}
+
+// the labels inside the condition are only reached from the condition itself
+static bool labelsPrivate(CFG* cfg, TACList* first, TACList* last, Renaming* labels) {
+    bool inside = false;
+    for (TACList* cur = cfg->funcLabel->next; cur != NULL && cur != cfg->endLabel; cur = cur->next) {
+        if (cur == first) inside = true;
+        if (!inside && isJump(cur->tac) && renameOperand(labels, cur->tac->res) != cur->tac->res) return false;
+        if (cur == last) inside = false;
+    }
+    return true;
+}
+
+// back is the goto to the condition at the end of the body, followed by the exit label. returns
+// the node before the exit label after the rotation, NULL if the loop is kept
+static TACList* rotateLoop(CFG* cfg, TACList* prevBack, TACList* back) {
+    char* exitLabel = back->next->tac->arg1;
+    TACList* prevCond;
+    TACList* condLabel = findLabelBefore(cfg, back->tac->res, back, &prevCond);
+    if (condLabel == NULL) return NULL;
+
+    // the condition ends with the goto to the exit, followed by the label of the body
+    Renaming labels = { .num = 0 };
+    Renaming temps = { .num = 0 };
+    TACList* last = condLabel->next;
+    for (int length = 1; ; ++length, last = last->next) {
+        if (last == back || length > MAX_ROTATE_CONDITION) return NULL;
+        TAC* tac = last->tac;
+        if (tac->op == TAC_RETURN) return NULL;
+        if (tac->op == TAC_LABEL) addRename(&labels, tac->arg1);
+        if ((getTACRoles(tac) & TAC_DEF_RES) && isTemp(tac->res)) addRename(&temps, tac->res);
+        if (tac->op == TAC_GOTO && tac->res != NULL && strcmp(tac->res, exitLabel) == 0 &&
+            last->next->tac->op == TAC_LABEL) break;
+    }
+    char* bodyLabel = last->next->tac->arg1;
+    for (TACList* cur = condLabel->next; ; cur = cur->next) {
+        if (isJump(cur->tac)) {
+            char* target = cur->tac->res;
+            if (target == NULL) return NULL;
+            bool known = renameOperand(&labels, target) != target || strcmp(target, bodyLabel) == 0 ||
+                         strcmp(target, exitLabel) == 0;
+            if (!known) return NULL;
+        }
+        if (cur == last) break;
+    }
+    if (!labelsPrivate(cfg, condLabel->next, last, &labels)) return NULL;
+
+    // 1. the copy in front of the loop
+    for (int i = 0; i < labels.num; ++i) labels.to[i] = generateLabel();
+    for (int i = 0; i < temps.num; ++i) temps.to[i] = generateTemp();
+    TACList* pos = prevCond;
+    for (TACList* cur = condLabel->next; ; cur = cur->next) {
+        TAC* tac = cur->tac;
+        TAC* copy = createTAC(tac->op, renameOperand(&temps, tac->arg1), renameOperand(&temps, tac->arg2),
+                              renameOperand(&temps, tac->res));
+        if (tac->op == TAC_LABEL) copy->arg1 = renameOperand(&labels, tac->arg1);
+        if (isJump(tac)) copy->res = renameOperand(&labels, tac->res);
+        pos = insertTACAfter(pos, copy);
+        if (cur == last) break;
+    }
+
+    // 2. the condition replaces the goto back
+    pos->next = last->next;
+    prevBack->next = condLabel;
+    last->next = back->next;
+    return last;
+}
+
+void rotateLoops(CFG* cfg, FILE* report) {
+    int rotated = 0;
+    TACList* prev = cfg->funcLabel;
+    TACList* cur = prev->next;
+    while (cur != NULL && cur != cfg->endLabel) {
+        TACList* next = cur->next;
+        TAC* tac = cur->tac;
+        // a goto that was never backpatched has no target
+        bool backJump = tac->op == TAC_GOTO && tac->res != NULL && next != NULL && next->tac->op == TAC_LABEL;
+        TACList* last = backJump ? rotateLoop(cfg, prev, cur) : NULL;
+        if (last != NULL) {
+            // cur has been unlinked, the exit label follows the moved condition
+            ++rotated;
+            prev = last;
+        } else {
+            prev = cur;
+        }
+        cur = next;
+    }
+    fprintf(report, "%s: %d loops rotated\n", cfg->funcName, rotated);
+}
@@ -3,6 +3,17 @@
 #include "symbol_table.h"
 #include "tac.h"
 #include "asm.h"
+#include "liveness.h"
+#include "regalloc.h"
+#include "opt.h"
+#include "muldiv.h"
+#include "schedule.h"
+#include "peephole.h"
+#include "encode.h"
+#include "arena.h"
+
+// the .ir and .asm files are written line by line through a buffer this large
+#define OUTPUT_BUFFER_SIZE (1 << 20)
 
 extern FILE *yyin;
 extern int yyparse();
@@ -11,12 +22,55 @@ extern struct TACList* tacHead;
 void getFilename(const char* path, char* filename);
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
+    char* inputFile = NULL;
+    int rallocGiven = 0;
+    int writeBinary = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-ralloc=local") == 0) {
+            regAllocMode = REG_ALLOC_LOCAL;
+            rallocGiven = 1;
+        } else if (strcmp(argv[i], "-ralloc=linear") == 0) {
+            regAllocMode = REG_ALLOC_LINEAR;
+            rallocGiven = 1;
+        } else if (strcmp(argv[i], "-ralloc=color") == 0) {
+            regAllocMode = REG_ALLOC_COLOR;
+            rallocGiven = 1;
+        } else if (strcmp(argv[i], "-muldiv=speed") == 0) {
+            mulDivMode = MUL_DIV_SPEED;
+        } else if (strcmp(argv[i], "-muldiv=size") == 0) {
+            mulDivMode = MUL_DIV_SIZE;
+        } else if (strcmp(argv[i], "-bin") == 0) {
+            writeBinary = 1;
+        } else if (strncmp(argv[i], "-inline=", 8) == 0) {
+            inlineThreshold = atoi(argv[i] + 8);
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            optLevel = 0;
+        } else if (strcmp(argv[i], "-O1") == 0) {
+            optLevel = 1;
+        } else if (strcmp(argv[i], "-O2") == 0) {
+            optLevel = 2;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        } else {
+            inputFile = argv[i];
+        }
+    }
+    if (inputFile == NULL) {
+        fprintf(stderr, "Usage: %s [-O0|-O1|-O2] [-ralloc=local|linear|color] [-muldiv=speed|size] [-inline=<TACs>] [-bin] <input_file>\n", argv[0]);
+        return 1;
+    }
+    // -O1 uses linear scan and -O2 graph coloring unless -ralloc says otherwise.
+    // the optimized IR contains &[], =* and *=, which only the global allocators generate code for
+    if (optLevel >= 1 && !rallocGiven) {
+        regAllocMode = optLevel >= 2 ? REG_ALLOC_COLOR : REG_ALLOC_LINEAR;
+    }
+    if (optLevel >= 1 && regAllocMode == REG_ALLOC_LOCAL) {
+        fprintf(stderr, "-O%d cannot be used with -ralloc=local\n", optLevel);
         return 1;
     }
 
-    yyin = fopen(argv[1], "r");
+    yyin = fopen(inputFile, "r");
     if (!yyin) {
         perror("Error opening file.\n");
         return 1;
@@ -31,31 +85,52 @@ int main(int argc, char *argv[]) {
     yyparse();
 
     fclose(yyin);
+    // only the TACs are used after parsing
+    freeArena(&astArena);
 
     generateIndex();
     // printTAC();
+    optimizeTAC(stdout);
+    computeNextUse();
 
     // generate assembly code
     AsmContainer* container = (AsmContainer*)malloc(sizeof(AsmContainer));
     initAsmContainer(container);
     initAsm();
     calcFrameInfo(container);
+    if (regAllocMode != REG_ALLOC_LOCAL) {
+        allocateRegisters();
+    }
     newAsm(container, ".data");
     initializeGlobalVars(container);
     newAsm(container, ".text");
+    if (writeBinary) {
+        emitStartup(container);
+    }
     generateASM(container);
-    char* assembly = toAssembly(container);
+    emitMulDivRuntime(container);
+    if (optLevel >= 1) {
+        optimizePeephole(container, stdout);
+        scheduleDelaySlots(container, stdout);
+    }
+    if (regAllocMode != REG_ALLOC_LOCAL) {
+        printRegAllocReport(stdout);
+        printFrameReport(stdout);
+        freeRegAssignments();
+    }
+    printMulDivReport(stdout);
     // printAsm(container);
 
     // write to file
-    char* filename = (char*)malloc((strlen(argv[1])+4)*sizeof(char));
-    getFilename(argv[1], filename);
+    char* filename = (char*)malloc((strlen(inputFile)+4)*sizeof(char));
+    getFilename(inputFile, filename);
     strcat(filename, ".ir");
     FILE* icOutput = fopen(filename, "w");
     if (icOutput == NULL) {
         perror("Error opening file.\n");
         return 1;
     }
+    setvbuf(icOutput, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
 
     fprintf(icOutput, "[FUNCTIONS]\n");
     for (int i=0;i<SYMBOL_TABLE_SIZE;++i) {
@@ -91,31 +166,42 @@ int main(int argc, char *argv[]) {
     }
 
     fprintf(icOutput, "\n[CODE]\n");
-    TACList* temp = tacHead;
-    while (temp) {
-        fprintf(icOutput, "(%s,%s,%s,%s)\n",temp->tac->op, temp->tac->arg1, temp->tac->arg2, temp->tac->res);
-        temp = temp->next;
-    }
+    writeTACList(icOutput);
 
     fclose(icOutput);
+    // the assembly has been generated, the TACs are no longer needed
+    tacHead = NULL;
+    tacTail = NULL;
+    freeArena(&irArena);
 
     // printSymbolTable(scopeStack[0]);
     destroySymbolTable(scopeStack[0]);
 
     // generate assembly code
-    char* asmFilename = (char*)malloc((strlen(argv[1])+4)*sizeof(char));
-    getFilename(argv[1], asmFilename);
+    char* asmFilename = (char*)malloc((strlen(inputFile)+4)*sizeof(char));
+    getFilename(inputFile, asmFilename);
     strcat(asmFilename, ".asm");
     FILE* asmOutput = fopen(asmFilename, "w");
     if (asmOutput == NULL) {
         perror("Error opening file.\n");
         return 1;
     }
+    setvbuf(asmOutput, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
 
-    fprintf(asmOutput, "%s\n", assembly);
+    writeAssembly(container, asmOutput);
+    fputc('\n', asmOutput);
 
     fclose(asmOutput);
 
+    // ROM and RAM images
+    if (writeBinary) {
+        char* baseName = (char*)malloc((strlen(inputFile)+1)*sizeof(char));
+        getFilename(inputFile, baseName);
+        writeMachineCode(container, baseName, stdout);
+        free(baseName);
+    }
+    freeArena(&backendArena);
+
 
 
 
@@ -184,8 +270,8 @@ int main(int argc, char *argv[]) {
     //             "        addi    sp,sp,32\n"
     //             "        jr      ra\n";
 
-    // char* asmFilename = (char*)malloc((strlen(argv[1])+4)*sizeof(char));
-    // getFilename(argv[1], asmFilename);
+    // char* asmFilename = (char*)malloc((strlen(inputFile)+4)*sizeof(char));
+    // getFilename(inputFile, asmFilename);
     // strcat(asmFilename, ".asm");
     // FILE* asmOutput = fopen(asmFilename, "w");
     // if (asmOutput == NULL) {
@@ -198,8 +284,8 @@ int main(int argc, char *argv[]) {
     // fclose(asmOutput);
 
 
-    // char* asmShow = (char*)malloc((strlen(argv[1])+4)*sizeof(char));
-    // getFilename(argv[1], asmShow);
+    // char* asmShow = (char*)malloc((strlen(inputFile)+4)*sizeof(char));
+    // getFilename(inputFile, asmShow);
     // strcat(asmShow, "_.asm");
     // FILE* asmShowOutput = fopen(asmShow, "w");
     // if (asmShowOutput == NULL) {
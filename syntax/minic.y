@@ -33,18 +33,29 @@ int arrElementNum = 0;
 #define BACKPATCHING_BUF_MAX 64
 TACList* bpBuf[BACKPATCHING_BUF_MAX];
 int bpNum = 0;
-int breakContinueCnt = 0;
 
-// stores the num of break/continue statements in the current if-block.
-#define IF_BREAK_CONTINUE_STACK_MAX 256
-int ifBreakContinueNumStack[IF_BREAK_CONTINUE_STACK_MAX] = {0};
-int curIfScope = -1;
+// stores the break/continue statements of the enclosing loops, innermost last.
+// loopJumpStart[d] is the first one that belongs to the loop at depth d
+#define LOOP_JUMP_MAX 256
+#define LOOP_DEPTH_MAX 64
+TACList* loopJumps[LOOP_JUMP_MAX];
+int loopJumpNum = 0;
+int loopJumpStart[LOOP_DEPTH_MAX];
 
 // the increment part of for statement
 TACList* forInc = NULL;
 
-// whether the current statement is in a loop block(if, while, for)
+// the depth of loops (while, for) around the current statement
 int inLoop = 0;
+
+// short-circuit evaluation of && and ||, see the functions at the end of this file
+static int dropValueCode(ASTNode* expr, char** trueLabel, char** falseLabel);
+static void retargetJumps(TACList* first, char* from, char* to);
+static ASTNode* startShortCircuit(ASTNode* left, int isAnd);
+static void endShortCircuit(ASTNode* expr, ASTNode* mark, ASTNode* right, int isAnd);
+static void appendConditionJumps(ASTNode* cond);
+static void enterLoop();
+static void leaveLoop(char* breakLabel, char* continueLabel);
 %}
 
 %union {
@@ -124,19 +135,17 @@ declaration:
         // ALLOC/ALLOC_GLOBAL id(type, size);
         TAC* code = NULL;
         if (scopeStackTop == 1) {
-            char* val = (char*)malloc(countDigits($1->int_val)*sizeof(char));
-            itoa($1->int_val, val, 10);
-            code = createTAC("alloc_global", $1->id, val, $2->id);
+            char* val = intToString($1->int_val);
+            code = createTAC(TAC_ALLOC_GLOBAL, $1->id, val, $2->id);
         } else {
-            char* val = (char*)malloc(countDigits($1->int_val)*sizeof(char));
-            itoa($1->int_val, val, 10);
-            code = createTAC("alloc", $1->id, val, $2->id);
+            char* val = intToString($1->int_val);
+            code = createTAC(TAC_ALLOC, $1->id, val, $2->id);
         }
         appendTAC(code);
         // add assignment stmt
         if ($3 != NULL) {
             // id = t1;
-            TAC* code2 = createTAC("=", $3->symbol, NULL, $2->id);
+            TAC* code2 = createTAC(TAC_ASSIGN, $3->symbol, NULL, $2->id);
             appendTAC(code2);
         }
     }
@@ -183,19 +192,17 @@ declaration:
         // ALLOC/ALLOC_GLOBAL id(type, size);
         TAC* code = NULL;
         if (scopeStackTop == 1) {
-            char* val = (char*)malloc(countDigits($2->int_val)*sizeof(char));
-            itoa($2->int_val, val, 10);
-            code = createTAC("alloc_global", $2->id, val, $3->id);
+            char* val = intToString($2->int_val);
+            code = createTAC(TAC_ALLOC_GLOBAL, $2->id, val, $3->id);
         } else {
-            char* val = (char*)malloc(countDigits($2->int_val)*sizeof(char));
-            itoa($2->int_val, val, 10);
-            code = createTAC("alloc", $2->id, val, $3->id);
+            char* val = intToString($2->int_val);
+            code = createTAC(TAC_ALLOC, $2->id, val, $3->id);
         }
         appendTAC(code);
         // add assignment stmt
         if ($4 != NULL) {
             // id = t1;
-            TAC* code2 = createTAC("=", $4->symbol, NULL, $3->id);
+            TAC* code2 = createTAC(TAC_ASSIGN, $4->symbol, NULL, $3->id);
             appendTAC(code2);
         }
       }
@@ -226,19 +233,17 @@ declaration:
         // ALLOC/ALLOC_GLOBAL id(type, size);
         TAC* code = NULL;
         if (scopeStackTop == 1) {
-            char* val = (char*)malloc(countDigits($1->int_val)*sizeof(char));
-            itoa($1->int_val, val, 10);
-            code = createTAC("alloc_global", $1->id, val, $2->id);
+            char* val = intToString($1->int_val);
+            code = createTAC(TAC_ALLOC_GLOBAL, $1->id, val, $2->id);
         } else {
-            char* val = (char*)malloc(countDigits($1->int_val*$2->int_val)*sizeof(char));
-            itoa($1->int_val*$2->int_val, val, 10);
-            code = createTAC("alloc", $1->id, val, $2->id);
+            char* val = intToString($1->int_val*$2->int_val);
+            code = createTAC(TAC_ALLOC, $1->id, val, $2->id);
         }
         appendTAC(code);
         if ($3 != NULL) {
             for (int i=0;i<arrElementNum;++i) {
                 // arr[i] = e;
-                TAC* code2 = createTAC("=", arrayBuf[i], NULL, $2->id);
+                TAC* code2 = createTAC(TAC_ASSIGN, arrayBuf[i], NULL, $2->id);
                 appendTAC(code2);
             }
             // clear buffer
@@ -290,19 +295,17 @@ declaration:
         // ALLOC/ALLOC_GLOBAL id(type, size);
         TAC* code = NULL;
         if (scopeStackTop == 1) {
-            char* val = (char*)malloc(countDigits($3->int_val*$2->int_val)*sizeof(char));
-            itoa($3->int_val*$2->int_val, val, 10);
-            code = createTAC("alloc_global", $2->id, val, $3->id);
+            char* val = intToString($3->int_val*$2->int_val);
+            code = createTAC(TAC_ALLOC_GLOBAL, $2->id, val, $3->id);
         } else {
-            char* val = (char*)malloc(countDigits($3->int_val*$2->int_val)*sizeof(char));
-            itoa($3->int_val*$2->int_val, val, 10);
-            code = createTAC("alloc", $2->id, val, $3->id);
+            char* val = intToString($3->int_val*$2->int_val);
+            code = createTAC(TAC_ALLOC, $2->id, val, $3->id);
         }
         appendTAC(code);
         if ($4 != NULL) {
             for (int i=0;i<arrElementNum;++i) {
                 // arr[i] = e;
-                TAC* code2 = createTAC("=", arrayBuf[i], NULL, $3->id);
+                TAC* code2 = createTAC(TAC_ASSIGN, arrayBuf[i], NULL, $3->id);
                 appendTAC(code2);
             }
             // clear buffer
@@ -313,8 +316,7 @@ declaration:
         funcName = NULL; // this means we are not in the scope of this function
         $$ = createASTNode("DECLARATION", 2, $1, $2);
 
-        // delete temp label
-        deleteTAC(tempTAC);
+        // drop temp label, its memory goes with irArena
         tempTAC = NULL;
     }
     | func_head add_label LBRACE enter_scope statements leave_scope RBRACE    {
@@ -324,7 +326,7 @@ declaration:
         entry->isDefined = 1;
         // end label of func.
         $$ = NULL;
-        TAC* code = createTAC("label", "end_func", NULL, NULL);
+        TAC* code = createTAC(TAC_LABEL, "end_func", NULL, NULL);
         appendTAC(code);
     }
     ;
@@ -371,7 +373,7 @@ array_assignment:
         // parse all characters into buffer
         char* ptr = $2->id;
         while (*ptr != '\0') {
-            arrayBuf[arrElementNum++] = charToString(*ptr);
+            arrayBuf[arrElementNum++] = intToString((unsigned char)*ptr);
             ptr++;
         }
     }
@@ -446,7 +448,7 @@ func_head:
         char* prefix = "func_";
         strcpy(funcLabel, prefix);
         strcat(funcLabel, $2->id);
-        tempTAC = createTAC("label", funcLabel, NULL, NULL);
+        tempTAC = createTAC(TAC_LABEL, funcLabel, NULL, NULL);
     }
     ;
 
@@ -509,7 +511,7 @@ array:
         // t1 = arr[expr]
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("=[]", $1->id, $3->symbol, res);
+        TAC* code = createTAC(TAC_LOAD_ELEM, $1->id, $3->symbol, res);
         appendTAC(code);
     }
     ;
@@ -527,10 +529,9 @@ array_element:
         // if const, parse the value
         if ($3->isConst == 1) {
             if (strcmp($3->id, "CHAR") == 0) {
-                arrayBuf[arrElementNum++] = charToString($3->char_val);
+                arrayBuf[arrElementNum++] = intToString((unsigned char)$3->char_val);
             } else {
-                char* val = (char*)malloc(countDigits($3->int_val)*sizeof(char));
-                itoa($3->int_val, val, 10);
+                char* val = intToString($3->int_val);
                 arrayBuf[arrElementNum++] = val;
             }
         } else {
@@ -549,10 +550,9 @@ array_element:
         // if const, parse the value
         if ($1->isConst == 1) {
             if (strcmp($1->id, "CHAR") == 0) {
-                arrayBuf[arrElementNum++] = charToString($1->char_val);
+                arrayBuf[arrElementNum++] = intToString((unsigned char)$1->char_val);
             } else {
-                char* val = (char*)malloc(countDigits($1->int_val)*sizeof(char));
-                itoa($1->int_val, val, 10);
+                char* val = intToString($1->int_val);
                 arrayBuf[arrElementNum++] = val;
             }
         } else {
@@ -603,7 +603,7 @@ arg_list:
         // we currently consider all arguments non-const
         $$->isConst = 0;
         // param id;
-        TAC* code = createTAC("param", $3->symbol, NULL, NULL);
+        TAC* code = createTAC(TAC_PARAM, $3->symbol, NULL, NULL);
         appendTAC(code);
     }
     | expression                    {
@@ -612,7 +612,7 @@ arg_list:
         // we currently consider all arguments non-const
         $$->isConst = 0;
         // param id;
-        TAC* code = createTAC("param", $1->symbol, NULL, NULL);
+        TAC* code = createTAC(TAC_PARAM, $1->symbol, NULL, NULL);
         appendTAC(code);
     }
     ;
@@ -656,7 +656,7 @@ expression_stmt:
 
         $$ = createASTNode("EXPR_STMT", 4, $1, $2, $3, $4);
         // id = expr(temp symbol);
-        TAC* code = createTAC("=", $3->symbol, NULL, $1->id);
+        TAC* code = createTAC(TAC_ASSIGN, $3->symbol, NULL, $1->id);
         appendTAC(code);
     }
     | array ASSIGN_OP expression SEMICOLON                  {
@@ -679,8 +679,17 @@ expression_stmt:
         }
 
         $$ = createASTNode("EXPR_STMT", 4, $1, $2, $3, $4);
-        // arr(temp symbol) = expr(temp symbol);
-        TAC* code = createTAC("=", $3->symbol, NULL, $1->symbol);
+        // the array rule has emitted t1 = arr[index] for the left side, replace the load with a store
+        TACList* prev = NULL;
+        TACList* load = tacHead;
+        while (load != NULL && load->tac->res != $1->symbol) {
+            prev = load;
+            load = load->next;
+        }
+        char* index = load->tac->arg2;
+        removeTAC(prev, load);
+        // arr[index] = expr(temp symbol);
+        TAC* code = createTAC(TAC_STORE_ELEM, index, $3->symbol, $1->id);
         appendTAC(code);
     }
     | ADDR_OP expression ASSIGN_OP expression SEMICOLON     {
@@ -691,7 +700,7 @@ expression_stmt:
 
         $$ = createASTNode("EXPR_STMT", 5, $1, $2, $3, $4, $5);
         // $expr1(temp symbol) = expr2(temp symbol)
-        TAC* code = createTAC("$=", $2->symbol, NULL, $4->symbol);
+        TAC* code = createTAC(TAC_WRITE_ADDR, $2->symbol, NULL, $4->symbol);
         appendTAC(code);
     }
     | expression SEMICOLON                                  {
@@ -705,6 +714,7 @@ expression_stmt:
             }
         }
         $$->symbol = $1->symbol;
+        $$->jumpCode = $1->jumpCode;
     }
     | SEMICOLON                                             { $$ = createASTNode("EXPR_STMT", 1, $1); }
     ;
@@ -722,17 +732,7 @@ if_condition:
     LPAREN expression RPAREN    {
         $$ = createASTNode("IF_CONDITION", 3, $1, $2, $3);
         // generate the if statements
-        char* label = generateLabel();
-        TAC* code1 = createTAC("ifGoto", $2->symbol, NULL, label);
-        TAC* code2 = createTAC("goto", NULL, NULL, NULL);
-        TAC* code3 = createTAC("label", label, NULL, NULL);
-        appendTAC(code1);
-        appendTAC(code2);
-        // store the pointers to buffer for backpatching
-        bpBuf[bpNum++] = tacTail;
-        appendTAC(code3);
-        // enter scope
-        ++curIfScope;
+        appendConditionJumps($2);
     }
     ;
 
@@ -741,34 +741,10 @@ if_block_end:
         $$ = NULL;
         // backpatching
         char* label = generateLabel();
-        TAC* code = createTAC("label", label, NULL, NULL);
+        TAC* code = createTAC(TAC_LABEL, label, NULL, NULL);
         // current top: the goto stmt when condition is false
-        // skip the break/continue stmts
-        bpBuf[bpNum-1-ifBreakContinueNumStack[curIfScope]]->tac->res = label;
+        bpBuf[--bpNum]->tac->res = label;
         appendTAC(code);
-        // for(int i=0;i<bpNum;++i) {
-        //     printf("%s, %s, %s, %s\n", bpBuf[i]->tac->op, bpBuf[i]->tac->arg1, bpBuf[i]->tac->arg2, bpBuf[i]->tac->res);
-        // }
-        // printf("------------------------------------------\n");
-        // shift left to remove the goto stmt
-        for (int i=bpNum-1-ifBreakContinueNumStack[curIfScope];i<bpNum;++i) {
-            bpBuf[i] = bpBuf[i+1];
-        }
-        --bpNum;
-        // if have nested if-block, add the cnt to the outer scope, otherwise add it to the global cnt
-        if (curIfScope > 0) {
-            ifBreakContinueNumStack[curIfScope-1] += ifBreakContinueNumStack[curIfScope];
-        } else {
-            breakContinueCnt += ifBreakContinueNumStack[curIfScope];
-        }
-        // leave scope
-        ifBreakContinueNumStack[curIfScope] = 0;
-        --curIfScope;
-
-        // for(int i=0;i<bpNum;++i) {
-        //     printf("%s, %s, %s, %s\n", bpBuf[i]->tac->op, bpBuf[i]->tac->arg1, bpBuf[i]->tac->arg2, bpBuf[i]->tac->res);
-        // }
-        // printf("==========================================\n");
     }
     ;
 
@@ -778,31 +754,19 @@ while_stmt:
         // backpatching
         char* label = generateLabel();
         // this label is AFTER the loop statement(goto condition)
-        TAC* code2 = createTAC("label", label, NULL, NULL);
+        TAC* code2 = createTAC(TAC_LABEL, label, NULL, NULL);
 
         // condition
-        char* conditionLabel = bpBuf[bpNum-2-breakContinueCnt]->tac->arg1;
-        // backpatch the break and continue statements
-        for (int i=0;i<breakContinueCnt;++i) {
-            TACList* code = bpBuf[--bpNum];
-            if (strcmp(code->tac->arg1, "break") == 0) {
-                code->tac->arg1 = NULL;
-                code->tac->res = label;
-            } else if (strcmp(code->tac->arg1, "continue") == 0) {
-                code->tac->arg1 = NULL;
-                code->tac->res = conditionLabel;
-            }
-        }
+        char* conditionLabel = bpBuf[bpNum-2]->tac->arg1;
+        leaveLoop(label, conditionLabel);
 
         // current top: the goto stmt when condition is false
         bpBuf[--bpNum]->tac->res = label;
         // current top: the label of the condition
-        TAC* code1 = createTAC("goto", NULL, NULL, bpBuf[--bpNum]->tac->arg1);
+        TAC* code1 = createTAC(TAC_GOTO, NULL, NULL, bpBuf[--bpNum]->tac->arg1);
 
         appendTAC(code1);
         appendTAC(code2);
-        --inLoop;
-        breakContinueCnt = 0;
     }
     ;
 
@@ -810,15 +774,8 @@ while_condition:
     LPAREN condition_start expression RPAREN {
         $$ = createASTNode("WHILE_CONDITION", 3, $1, $3, $4);
         // generate while statement
-        char* label = generateLabel();
-        TAC* code1 = createTAC("ifGoto", $3->symbol, NULL, label);
-        TAC* code2 = createTAC("goto", NULL, NULL, NULL);
-        TAC* code3 = createTAC("label", label, NULL, NULL);
-        appendTAC(code1);
-        appendTAC(code2);
-        bpBuf[bpNum++] = tacTail;
-        appendTAC(code3);
-        ++inLoop;
+        appendConditionJumps($3);
+        enterLoop();
     }
     ;
 
@@ -829,7 +786,7 @@ condition_start:
         // in while/for statements, there will be a goto statement that returns to this label
         // after finishing the whole block.
         char* label = generateLabel();
-        TAC* code = createTAC("label", label, NULL, NULL);
+        TAC* code = createTAC(TAC_LABEL, label, NULL, NULL);
         appendTAC(code);
         bpBuf[bpNum++] = tacTail;
     }
@@ -839,12 +796,12 @@ return_stmt:
       RETURN expression SEMICOLON       {
         $$ = createASTNode("RETURN_STMT", 3, $1, $2, $3);
         // return expr(temp symbol);
-        TAC *code = createTAC("return", NULL, NULL, $2->symbol);
+        TAC *code = createTAC(TAC_RETURN, NULL, NULL, $2->symbol);
         appendTAC(code);
     }
     | RETURN SEMICOLON                  {
         $$ = createASTNode("RETURN_STMT", 2, $1, $2);
-        TAC *code = createTAC("return", NULL, NULL, NULL);
+        TAC *code = createTAC(TAC_RETURN, NULL, NULL, NULL);
         appendTAC(code);
     }
     ;
@@ -857,15 +814,9 @@ break_stmt:
         }
         $$ = createASTNode("BREAK_STMT", 2, $1, $2);
         // goto 0; arg1 is used to distinguish the statement from continue
-        TAC* code = createTAC("goto", "break", NULL, NULL);
+        TAC* code = createTAC(TAC_GOTO, "break", NULL, NULL);
         appendTAC(code);
-        bpBuf[bpNum++] = tacTail;
-        // in if blocks, add the count to buffer. otherwise, add to global cnt
-        if (curIfScope >= 0) {
-            ++ifBreakContinueNumStack[curIfScope];
-        } else {
-            ++breakContinueCnt;
-        }
+        loopJumps[loopJumpNum++] = tacTail;
     }
     ;
 
@@ -877,15 +828,9 @@ continue_stmt:
         }
         $$ = createASTNode("CONTINUE_STMT", 2, $1, $2);
         // goto 0;
-        TAC* code = createTAC("goto", "continue", NULL, NULL);
+        TAC* code = createTAC(TAC_GOTO, "continue", NULL, NULL);
         appendTAC(code);
-        bpBuf[bpNum++] = tacTail;
-        // in if blocks, add the count to buffer. otherwise, add to global cnt
-        if (curIfScope >= 0) {
-            ++ifBreakContinueNumStack[curIfScope];
-        } else {
-            ++breakContinueCnt;
-        }
+        loopJumps[loopJumpNum++] = tacTail;
     }
     ;
 
@@ -893,35 +838,24 @@ for_stmt:
       FOR for_condition statement {
         $$ = createASTNode("FOR_STMT", 3, $1, $2, $3);
         // insert inc part
-        tacTail->next = forInc;
+        TACList* inc = $2->jumpCode;
+        tacTail->next = inc;
         while (tacTail != NULL && tacTail->next != NULL) {
             tacTail = tacTail->next;
         }
         // backpatching
         char* label = generateLabel();
         // this label is AFTER the loop statement(goto condition)
-        TAC* code2 = createTAC("label", label, NULL, NULL);
-
-        // backpatch the break and continue statements
-        for (int i=0;i<breakContinueCnt;++i) {
-            TACList* code = bpBuf[--bpNum];
-            if (strcmp(code->tac->arg1, "break") == 0) {
-                code->tac->arg1 = NULL;
-                code->tac->res = label;
-            } else if (strcmp(code->tac->arg1, "continue") == 0) {
-                code->tac->arg1 = NULL;
-                code->tac->res = forInc->tac->arg1;
-            }
-        }
+        TAC* code2 = createTAC(TAC_LABEL, label, NULL, NULL);
+
+        leaveLoop(label, inc->tac->arg1);
         // current top: the goto stmt when condition is false
         bpBuf[--bpNum]->tac->res = label;
         // current top: the label of the condition
-        TAC* code1 = createTAC("goto", NULL, NULL, bpBuf[--bpNum]->tac->arg1);
+        TAC* code1 = createTAC(TAC_GOTO, NULL, NULL, bpBuf[--bpNum]->tac->arg1);
 
         appendTAC(code1);
         appendTAC(code2);
-        --inLoop;
-        breakContinueCnt = 0;
       }
     ;
 
@@ -929,15 +863,10 @@ for_condition:
     LPAREN expression_stmt condition_start expression_stmt for_inc_start expression for_inc_end RPAREN    {
         $$ = createASTNode("FOR_STMT", 5, $1, $2, $4, $6, $8);
         // generate for statement
-        char* label = generateLabel();
-        TAC* code1 = createTAC("ifGoto", $4->symbol, NULL, label);
-        TAC* code2 = createTAC("goto", NULL, NULL, NULL);
-        TAC* code3 = createTAC("label", label, NULL, NULL);
-        appendTAC(code1);
-        appendTAC(code2);
-        bpBuf[bpNum++] = tacTail;
-        appendTAC(code3);
-        ++inLoop;
+        appendConditionJumps($4);
+        // the increment, appended at the end of the body. an inner for statement replaces forInc
+        $$->jumpCode = forInc;
+        enterLoop();
     }
     ;
 
@@ -948,7 +877,7 @@ for_inc_start:
         // so we will delete it from code at for_inc_end, and put it at the end of for block.
         // note that forInc is now the statement BEFORE increment
         forInc = tacTail;
-        TAC* code = createTAC("label", generateLabel(), NULL, NULL);
+        TAC* code = createTAC(TAC_LABEL, generateLabel(), NULL, NULL);
         appendTAC(code);
     }
     ;
@@ -991,7 +920,7 @@ expression:
         }
         // res = 0 - x;
         char* res = generateTemp();
-        TAC* code = createTAC("-", 0, $2->symbol, res);
+        TAC* code = createTAC(TAC_SUB, 0, $2->symbol, res);
         appendTAC(code);
         $$->symbol = res;
     }
@@ -1014,8 +943,8 @@ expression:
         // x = x + 1;
         // t1 = x;
         char* res = generateTemp();
-        TAC* code1 = createTAC("+", $2->id, "1", $2->id);
-        TAC* code2 = createTAC("=", $2->id, NULL, res);
+        TAC* code1 = createTAC(TAC_ADD, $2->id, "1", $2->id);
+        TAC* code2 = createTAC(TAC_ASSIGN, $2->id, NULL, res);
         appendTAC(code1);
         appendTAC(code2);
         $$->symbol = res;
@@ -1039,8 +968,8 @@ expression:
         // t1 = x;
         // x = x + 1;
         char* res = generateTemp();
-        TAC* code1 = createTAC("=", $1->id, NULL, res);
-        TAC* code2 = createTAC("+", $1->id, "1", $1->id);
+        TAC* code1 = createTAC(TAC_ASSIGN, $1->id, NULL, res);
+        TAC* code2 = createTAC(TAC_ADD, $1->id, "1", $1->id);
         appendTAC(code1);
         appendTAC(code2);
         $$->symbol = res;
@@ -1064,8 +993,8 @@ expression:
         // x = x - 1;
         // t1 = x;
         char* res = generateTemp();
-        TAC* code1 = createTAC("-", $2->id, "1", $2->id);
-        TAC* code2 = createTAC("=", $2->id, NULL, res);
+        TAC* code1 = createTAC(TAC_SUB, $2->id, "1", $2->id);
+        TAC* code2 = createTAC(TAC_ASSIGN, $2->id, NULL, res);
         appendTAC(code1);
         appendTAC(code2);
         $$->symbol = res;
@@ -1089,8 +1018,8 @@ expression:
         // t1 = x;
         // x = x - 1;
         char* res = generateTemp();
-        TAC* code1 = createTAC("=", $1->id, NULL, res);
-        TAC* code2 = createTAC("-", $1->id, "1", $1->id);
+        TAC* code1 = createTAC(TAC_ASSIGN, $1->id, NULL, res);
+        TAC* code2 = createTAC(TAC_SUB, $1->id, "1", $1->id);
         appendTAC(code1);
         appendTAC(code2);
         $$->symbol = res;
@@ -1114,8 +1043,8 @@ expression:
         // x = x + 1;
         // t1 = x;
         char* res = generateTemp();
-        TAC* code1 = createTAC("+", $2->id, "1", $2->id);
-        TAC* code2 = createTAC("=", $2->id, NULL, res);
+        TAC* code1 = createTAC(TAC_ADD, $2->id, "1", $2->id);
+        TAC* code2 = createTAC(TAC_ASSIGN, $2->id, NULL, res);
         appendTAC(code1);
         appendTAC(code2);
         $$->symbol = res;
@@ -1139,8 +1068,8 @@ expression:
         // t1 = x;
         // x = x + 1;
         char* res = generateTemp();
-        TAC* code1 = createTAC("=", $1->id, NULL, res);
-        TAC* code2 = createTAC("+", $1->id, "1", $1->id);
+        TAC* code1 = createTAC(TAC_ASSIGN, $1->id, NULL, res);
+        TAC* code2 = createTAC(TAC_ADD, $1->id, "1", $1->id);
         appendTAC(code1);
         appendTAC(code2);
         $$->symbol = res;
@@ -1164,8 +1093,8 @@ expression:
         // x = x - 1;
         // t1 = x;
         char* res = generateTemp();
-        TAC* code1 = createTAC("-", $2->id, "1", $2->id);
-        TAC* code2 = createTAC("=", $2->id, NULL, res);
+        TAC* code1 = createTAC(TAC_SUB, $2->id, "1", $2->id);
+        TAC* code2 = createTAC(TAC_ASSIGN, $2->id, NULL, res);
         appendTAC(code1);
         appendTAC(code2);
         $$->symbol = res;
@@ -1189,8 +1118,8 @@ expression:
         // t1 = x;
         // x = x - 1;
         char* res = generateTemp();
-        TAC* code1 = createTAC("=", $1->id, NULL, res);
-        TAC* code2 = createTAC("-", $1->id, "1", $1->id);
+        TAC* code1 = createTAC(TAC_ASSIGN, $1->id, NULL, res);
+        TAC* code2 = createTAC(TAC_SUB, $1->id, "1", $1->id);
         appendTAC(code1);
         appendTAC(code2);
         $$->symbol = res;
@@ -1213,7 +1142,7 @@ expression:
         // t1 = !x;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("!", $2->symbol, NULL, res);
+        TAC* code = createTAC(TAC_NOT, $2->symbol, NULL, res);
         appendTAC(code);
     }
     | BITINV_OP expression                  {
@@ -1234,7 +1163,7 @@ expression:
         // t1 = ~x;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("~", $2->symbol, NULL, res);
+        TAC* code = createTAC(TAC_BIT_NOT, $2->symbol, NULL, res);
         appendTAC(code);
     }
     | ADDR_OP expression                    {
@@ -1249,7 +1178,7 @@ expression:
         // t1 = $x;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("=$", $2->symbol, NULL, res);
+        TAC* code = createTAC(TAC_READ_ADDR, $2->symbol, NULL, res);
         appendTAC(code);
     }
     | expression MUL_OP expression          {
@@ -1266,7 +1195,7 @@ expression:
         // t1 = x1 * x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("*", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_MUL, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression DIV_OP expression          {
@@ -1283,7 +1212,7 @@ expression:
         // t1 = x1 / x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("/", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_DIV, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression MOD_OP expression          {
@@ -1300,7 +1229,7 @@ expression:
         // t1 = x1 % x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("%", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_MOD, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression ADD_OP expression          {
@@ -1317,7 +1246,7 @@ expression:
         // t1 = x1 + x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("+", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_ADD, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression SUB_OP expression          {
@@ -1334,7 +1263,7 @@ expression:
         // t1 = x1 - x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("-", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_SUB, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | IDENTIFIER LEFT_OP expression         {
@@ -1356,7 +1285,7 @@ expression:
         // t1 = x1 << x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("<<", $1->id, $3->symbol, res);
+        TAC* code = createTAC(TAC_SHL, $1->id, $3->symbol, res);
         appendTAC(code);
     }
     | IDENTIFIER RIGHT_OP expression        {
@@ -1378,7 +1307,7 @@ expression:
         // t1 = x1 >> x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC(">>", $1->id, $3->symbol, res);
+        TAC* code = createTAC(TAC_SHR, $1->id, $3->symbol, res);
         appendTAC(code);
     }
     | array LEFT_OP expression              {
@@ -1400,7 +1329,7 @@ expression:
         // t1 = x1 << x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("<<", $1->id, $3->symbol, res);
+        TAC* code = createTAC(TAC_SHL, $1->id, $3->symbol, res);
         appendTAC(code);
     }
     | array RIGHT_OP expression             {
@@ -1422,7 +1351,7 @@ expression:
         // t1 = x1 >> x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC(">>", $1->id, $3->symbol, res);
+        TAC* code = createTAC(TAC_SHR, $1->id, $3->symbol, res);
         appendTAC(code);
     }
     | expression GT_OP expression           {
@@ -1439,7 +1368,7 @@ expression:
         // t1 = x1 > x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC(">", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_GT, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression LT_OP expression           {
@@ -1456,7 +1385,7 @@ expression:
         // t1 = x1 < x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("<", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_LT, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression GE_OP expression           {
@@ -1473,7 +1402,7 @@ expression:
         // t1 = x1 >= x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC(">=", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_GE, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression LE_OP expression           {
@@ -1490,7 +1419,7 @@ expression:
         // t1 = x1 <= x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("<=", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_LE, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression EQ_OP expression           {
@@ -1507,7 +1436,7 @@ expression:
         // t1 = x1 == x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("==", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_EQ, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression NE_OP expression           {
@@ -1524,7 +1453,7 @@ expression:
         // t1 = x1 != x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("!=", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_NE, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression BITAND_OP expression       {
@@ -1545,7 +1474,7 @@ expression:
         // t1 = x1 & x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("&", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_BIT_AND, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression BITXOR_OP expression       {
@@ -1566,7 +1495,7 @@ expression:
         // t1 = x1 ^ x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("^", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_BIT_XOR, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
     | expression BITOR_OP expression        {
@@ -1587,42 +1516,42 @@ expression:
         // t1 = x1 | x2;
         char* res = generateTemp();
         $$->symbol = res;
-        TAC* code = createTAC("|", $1->symbol, $3->symbol, res);
+        TAC* code = createTAC(TAC_BIT_OR, $1->symbol, $3->symbol, res);
         appendTAC(code);
     }
-    | expression AND_OP expression          {
+    | expression AND_OP {
+        // x2 is only evaluated when x1 is true
+        $<node>$ = startShortCircuit($1, 1);
+    } expression                            {
         // type check
-        if (!isCompatible($1->id, $3->id)) {
+        if (!isCompatible($1->id, $4->id)) {
             yyerror("Incompatible type for && operator.\n");
         }
-        $$ = createASTNode("INT", 3, $1, $2, $3);
-        $$->isConst = $1->isConst && $3->isConst;
+        $$ = createASTNode("INT", 3, $1, $2, $4);
+        $$->isConst = $1->isConst && $4->isConst;
         // parse value if isConst
         if ($$->isConst == 1) {
-            $$->int_val = $1->int_val && $3->int_val;
+            $$->int_val = $1->int_val && $4->int_val;
         }
-        // t1 = x1 && x2;
-        char* res = generateTemp();
-        $$->symbol = res;
-        TAC* code = createTAC("&&", $1->symbol, $3->symbol, res);
-        appendTAC(code);
+        // t1 = x1 && x2 with jumps;
+        endShortCircuit($$, $<node>3, $4, 1);
     }
-    | expression OR_OP expression           {
+    | expression OR_OP {
+        // x2 is only evaluated when x1 is false
+        $<node>$ = startShortCircuit($1, 0);
+    } expression                            {
         // type check
-        if (!isCompatible($1->id, $3->id)) {
+        if (!isCompatible($1->id, $4->id)) {
             yyerror("Incompatible type for || operator.\n");
         }
-        $$ = createASTNode("INT", 3, $1, $2, $3);
-        $$->isConst = $1->isConst && $3->isConst;
+        $$ = createASTNode("INT", 3, $1, $2, $4);
+        $$->isConst = $1->isConst && $4->isConst;
         // parse value if isConst
         if ($$->isConst == 1) {
-            $$->int_val = $1->int_val || $3->int_val;
+            $$->int_val = $1->int_val || $4->int_val;
         }
-        // t1 = x1 || x2;
-        char* res = generateTemp();
-        $$->symbol = res;
-        TAC* code = createTAC("||", $1->symbol, $3->symbol, res);
-        appendTAC(code);
+        // t1 = x1 || x2 with jumps;
+        endShortCircuit($$, $<node>3, $4, 0);
     }
     | LPAREN expression RPAREN              {
         $$ = createASTNode($2->id, 3, $1, $2, $3);
@@ -1635,6 +1564,7 @@ expression:
             }
         }
         $$->symbol = $2->symbol;
+        $$->jumpCode = $2->jumpCode;
     }
     | IDENTIFIER                            {
         // check if the identifier is defined
@@ -1683,13 +1613,13 @@ expression:
 
         if ($1->id == "VOID") {
             // call func;
-            TAC* code = createTAC("call", $1->symbol, NULL, NULL);
+            TAC* code = createTAC(TAC_CALL, $1->symbol, NULL, NULL);
             appendTAC(code);
         } else {
             // t1 = call func;
             char* res = generateTemp();
             $$->symbol = res;
-            TAC* code = createTAC("call", $1->symbol, NULL, res);
+            TAC* code = createTAC(TAC_CALL, $1->symbol, NULL, res);
             appendTAC(code);
         }
     }
@@ -1697,13 +1627,13 @@ expression:
         $$ = createASTNode("INT", 1, $1);
         $$->int_val = $1->int_val;
         // parse value as symbol name
-        $$->symbol = (char*)malloc(countDigits($$->int_val)*sizeof(char));
-        itoa($$->int_val, $$->symbol, 10);
+        $$->symbol = intToString($$->int_val);
     }
     | CHAR_CONSTANT                         {
         $$ = createASTNode("CHAR", 1, $1);
         $$->char_val = $1->char_val;
-        $$->symbol = charToString($1->char_val);
+        // operands hold char constants as their value, so 'a' cannot be mistaken for the variable a
+        $$->symbol = intToString((unsigned char)$1->char_val);
     }
     | STRING_LITERAL                        {
         $$ = createASTNode("STRING", 1, $1);
@@ -1730,6 +1660,132 @@ int yywrap(){
     return 1;
 }
 
+/* short-circuit evaluation. x1 && x2 and x1 || x2 are compiled into jumps: every operand that is
+ * not && / || itself is tested with (ifGoto, x, , Lt) (goto, , , Lf), and the jumps of an operand
+ * that is && / || go to its own labels. the code ends with the value in a new temp:
+ *   (label, Lt) (=, 1, , t) (goto, , , Lend) (label, Lf) (=, 0, , t) (label, Lend)
+ * an && / || operand, and a condition of if, while and for, drops these six TACs and continues at
+ * Lt or Lf directly, so 0/1 is only stored when the value is used.
+ */
+
+// if the code of expr ends with the TACs storing the value of && / ||, remove them and return
+// the labels its jumps go to when expr is true and when it is false
+static int dropValueCode(ASTNode* expr, char** trueLabel, char** falseLabel) {
+    if (expr->jumpCode == NULL) return 0;
+    // find the node before the last six TACs
+    TACList* prev = expr->jumpCode;
+    TACList* last = prev;
+    for (int i = 0; i < 6 && last != NULL; ++i) {
+        last = last->next;
+    }
+    while (last != NULL && last != tacTail) {
+        prev = prev->next;
+        last = last->next;
+    }
+    if (last == NULL) return 0;
+    TAC* value = prev->next->next->tac;
+    if (prev->next->tac->op != TAC_LABEL || value->op != TAC_ASSIGN ||
+        strcmp(value->res, expr->symbol) != 0) return 0;
+    *trueLabel = prev->next->tac->arg1;
+    *falseLabel = prev->next->next->next->next->tac->arg1;
+    while (prev->next != NULL) {
+        removeTAC(prev, prev->next);
+    }
+    return 1;
+}
+
+// jumps from first to the end of the list going to label from go to label to instead
+static void retargetJumps(TACList* first, char* from, char* to) {
+    for (TACList* cur = first; cur != NULL; cur = cur->next) {
+        TAC* tac = cur->tac;
+        int jump = tac->op == TAC_GOTO || tac->op == TAC_IF_GOTO || tac->op == TAC_IF_FALSE_GOTO;
+        if (jump && tac->res != NULL && strcmp(tac->res, from) == 0) {
+            tac->res = to;
+        }
+    }
+}
+
+// called after the code of the left operand. returns a node recording the jumps leaving the
+// expression early: symbol is the label they go to, or NULL for one jump waiting in bpBuf
+static ASTNode* startShortCircuit(ASTNode* left, int isAnd) {
+    ASTNode* mark = createASTNode("SHORT_CIRCUIT", 0);
+    char* trueLabel;
+    char* falseLabel;
+    if (dropValueCode(left, &trueLabel, &falseLabel)) {
+        // the right operand starts where left continues, the other label leaves the expression
+        appendTAC(createTAC(TAC_LABEL, isAnd ? trueLabel : falseLabel, NULL, NULL));
+        mark->jumpCode = left->jumpCode;
+        mark->symbol = isAnd ? falseLabel : trueLabel;
+    } else {
+        appendTAC(createTAC(isAnd ? TAC_IF_FALSE_GOTO : TAC_IF_GOTO, left->symbol, NULL, NULL));
+        // backpatched with the label of the result
+        bpBuf[bpNum++] = tacTail;
+        mark->jumpCode = tacTail;
+    }
+    return mark;
+}
+
+// called after the code of the right operand
+static void endShortCircuit(ASTNode* expr, ASTNode* mark, ASTNode* right, int isAnd) {
+    char* trueLabel;
+    char* falseLabel;
+    if (!dropValueCode(right, &trueLabel, &falseLabel)) {
+        trueLabel = generateLabel();
+        falseLabel = generateLabel();
+        appendTAC(createTAC(TAC_IF_GOTO, right->symbol, NULL, trueLabel));
+        appendTAC(createTAC(TAC_GOTO, NULL, NULL, falseLabel));
+    }
+    char* exitLabel = isAnd ? falseLabel : trueLabel;
+    if (mark->symbol == NULL) {
+        bpBuf[--bpNum]->tac->res = exitLabel;
+    } else {
+        retargetJumps(mark->jumpCode, mark->symbol, exitLabel);
+    }
+
+    char* res = generateTemp();
+    char* endLabel = generateLabel();
+    appendTAC(createTAC(TAC_LABEL, trueLabel, NULL, NULL));
+    appendTAC(createTAC(TAC_ASSIGN, "1", NULL, res));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, endLabel));
+    appendTAC(createTAC(TAC_LABEL, falseLabel, NULL, NULL));
+    appendTAC(createTAC(TAC_ASSIGN, "0", NULL, res));
+    appendTAC(createTAC(TAC_LABEL, endLabel, NULL, NULL));
+    expr->symbol = res;
+    expr->jumpCode = mark->jumpCode;
+}
+
+// jumps of the condition of if, while and for: true goes to the label after them, false to a
+// goto backpatched at the end of the statement
+static void appendConditionJumps(ASTNode* cond) {
+    char* trueLabel;
+    char* falseLabel;
+    if (dropValueCode(cond, &trueLabel, &falseLabel)) {
+        appendTAC(createTAC(TAC_LABEL, falseLabel, NULL, NULL));
+    } else {
+        trueLabel = generateLabel();
+        appendTAC(createTAC(TAC_IF_GOTO, cond->symbol, NULL, trueLabel));
+    }
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, NULL));
+    // store the pointers to buffer for backpatching
+    bpBuf[bpNum++] = tacTail;
+    appendTAC(createTAC(TAC_LABEL, trueLabel, NULL, NULL));
+}
+
+// the break and continue statements from here on belong to a new innermost loop
+static void enterLoop() {
+    loopJumpStart[inLoop++] = loopJumpNum;
+}
+
+// backpatch the break and continue statements of the innermost loop
+static void leaveLoop(char* breakLabel, char* continueLabel) {
+    --inLoop;
+    while (loopJumpNum > loopJumpStart[inLoop]) {
+        TAC* tac = loopJumps[--loopJumpNum]->tac;
+        tac->res = strcmp(tac->arg1, "break") == 0 ? breakLabel : continueLabel;
+        tac->arg1 = NULL;
+    }
+}
+
 /*
 int main()
 {
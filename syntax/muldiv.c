@@ -0,0 +1,376 @@
+#include "muldiv.h"
+#include <string.h>
+
+MulDivMode mulDivMode = MUL_DIV_SPEED;
+
+static bool usesMul = false;
+static bool usesDivMod = false;
+// 统计信息
+static int constMuls = 0;
+static int constDivs = 0;
+static int runtimeCalls = 0;
+
+#define MUL_DIV_TEMP "x31"
+#define CALL_SEQUENCE_LENGTH 7 // 调用子程序时调用处的指令数
+
+bool isMulDivOp(TACOpcode op) {
+    return op == TAC_MUL || op == TAC_DIV || op == TAC_MOD;
+}
+
+// 2^k 返回 k，否则返回 -1
+static int exactLog2(unsigned int value) {
+    if (value == 0 || (value & (value - 1)) != 0) return -1;
+    int k = 0;
+    while ((value >> k) != 1) ++k;
+    return k;
+}
+
+// value 的非相邻形式，digits[i] 为 -1、0 或 1，返回位数。value 不超过 2^31 时最高位不超过 31
+static int toNAF(unsigned int value, int digits[33]) {
+    long long n = value;
+    int length = 0;
+    while (n != 0) {
+        if (n & 1) {
+            digits[length] = 2 - (int)(n & 3); // n % 4 == 1 取 1，n % 4 == 3 取 -1
+            n -= digits[length];
+        } else {
+            digits[length] = 0;
+        }
+        n >>= 1;
+        ++length;
+    }
+    return length;
+}
+
+// regX = regY * value：从最高位开始，acc = (acc << 间隔) ± regY
+static bool emitMulConst(AsmContainer* asmContainer, const char* regX, const char* regY, int value) {
+    char buffer[100];
+    if (value == 0) {
+        snprintf(buffer, sizeof(buffer), "mv %s, zero", regX);
+        newAsm(asmContainer, buffer);
+        return true;
+    }
+    bool negative = value < 0;
+    unsigned int magnitude = negative ? 0u - (unsigned int)value : (unsigned int)value;
+    if (magnitude == 1) {
+        snprintf(buffer, sizeof(buffer), negative ? "sub %s, zero, %s" : "mv %s, %s", regX, regY);
+        newAsm(asmContainer, buffer);
+        constMuls++;
+        return true;
+    }
+    int digits[33];
+    int length = toNAF(magnitude, digits);
+
+    // regX 和 regY 相同时在 x31 中累加，最后再写回
+    const char* acc = strcmp(regX, regY) == 0 ? MUL_DIV_TEMP : regX;
+    int instructions = digits[0] == 0 ? 1 : 0;
+    for (int i = 0; i < length - 1; ++i) {
+        if (digits[i] != 0) instructions += 2;
+    }
+    if (negative || acc != regX) instructions++;
+    if (mulDivMode == MUL_DIV_SIZE && instructions > CALL_SEQUENCE_LENGTH) return false;
+
+    const char* src = regY; // acc 还没有写入时从 regY 开始
+    int gap = 0;
+    for (int i = length - 2; i >= 0; --i) {
+        ++gap;
+        if (digits[i] == 0) continue;
+        snprintf(buffer, sizeof(buffer), "sll %s, %s, %d", acc, src, gap);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "%s %s, %s, %s", digits[i] > 0 ? "add" : "sub", acc, acc, regY);
+        newAsm(asmContainer, buffer);
+        src = acc;
+        gap = 0;
+    }
+    if (gap > 0) {
+        snprintf(buffer, sizeof(buffer), "sll %s, %s, %d", acc, src, gap);
+        newAsm(asmContainer, buffer);
+    }
+    if (negative) {
+        snprintf(buffer, sizeof(buffer), "sub %s, zero, %s", regX, acc);
+        newAsm(asmContainer, buffer);
+    } else if (acc != regX) {
+        snprintf(buffer, sizeof(buffer), "mv %s, %s", regX, acc);
+        newAsm(asmContainer, buffer);
+    }
+    constMuls++;
+    return true;
+}
+
+// regX = regY / ±2^k 或 regY % ±2^k，C 语言的商向零取整，余数和被除数同号
+static bool emitDivConst(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY, int value) {
+    char buffer[100];
+    bool negative = value < 0;
+    int k = exactLog2(negative ? 0u - (unsigned int)value : (unsigned int)value);
+    if (k == -1) return false;
+    bool isDiv = op == TAC_DIV;
+
+    if (k == 0) {
+        if (!isDiv) {
+            snprintf(buffer, sizeof(buffer), "mv %s, zero", regX);
+        } else if (negative) {
+            snprintf(buffer, sizeof(buffer), "sub %s, zero, %s", regX, regY);
+        } else {
+            snprintf(buffer, sizeof(buffer), "mv %s, %s", regX, regY);
+        }
+        newAsm(asmContainer, buffer);
+        constDivs++;
+        return true;
+    }
+
+    // 负数加上偏置 2^k-1：取符号位扩展后的低 k 位
+    if (k == 1) {
+        snprintf(buffer, sizeof(buffer), "srl %s, %s, 31", MUL_DIV_TEMP, regY);
+        newAsm(asmContainer, buffer);
+    } else {
+        snprintf(buffer, sizeof(buffer), "sra %s, %s, 31", MUL_DIV_TEMP, regY);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "srl %s, %s, %d", MUL_DIV_TEMP, MUL_DIV_TEMP, 32 - k);
+        newAsm(asmContainer, buffer);
+    }
+    snprintf(buffer, sizeof(buffer), "add %s, %s, %s", MUL_DIV_TEMP, regY, MUL_DIV_TEMP);
+    newAsm(asmContainer, buffer);
+    if (isDiv) {
+        snprintf(buffer, sizeof(buffer), "sra %s, %s, %d", regX, MUL_DIV_TEMP, k);
+        newAsm(asmContainer, buffer);
+        if (negative) {
+            snprintf(buffer, sizeof(buffer), "sub %s, zero, %s", regX, regX);
+            newAsm(asmContainer, buffer);
+        }
+    } else {
+        // 余数 = regY - 商 * 2^k，除数的符号不影响余数
+        snprintf(buffer, sizeof(buffer), "srl %s, %s, %d", MUL_DIV_TEMP, MUL_DIV_TEMP, k);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "sll %s, %s, %d", MUL_DIV_TEMP, MUL_DIV_TEMP, k);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", regX, regY, MUL_DIV_TEMP);
+        newAsm(asmContainer, buffer);
+    }
+    constDivs++;
+    return true;
+}
+
+bool emitMulDivConst(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY, int value) {
+    if (op == TAC_MUL) {
+        return emitMulConst(asmContainer, regX, regY, value);
+    }
+    return emitDivConst(asmContainer, op, regX, regY, value);
+}
+
+void emitMulDivCall(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY, const char* regZ) {
+    char buffer[100];
+    bool isMul = op == TAC_MUL;
+    snprintf(buffer, sizeof(buffer), "mv a0, %s", regY);
+    newAsm(asmContainer, buffer);
+    snprintf(buffer, sizeof(buffer), "mv a1, %s", regZ);
+    newAsm(asmContainer, buffer);
+    newAsm(asmContainer, "mv a7, ra");
+    newAsm(asmContainer, isMul ? "jal __mul" : "jal __divmod");
+    newAsm(asmContainer, "nop"); // delay-slot
+    newAsm(asmContainer, "mv ra, a7");
+    snprintf(buffer, sizeof(buffer), "mv %s, %s", regX, op == TAC_MOD ? "a1" : "a0");
+    newAsm(asmContainer, buffer);
+    if (isMul) {
+        usesMul = true;
+    } else {
+        usesDivMod = true;
+    }
+    runtimeCalls++;
+}
+
+// a0 = a0 * a1：逐位移位相加，乘数逻辑右移，32 次以内结束
+static const char* mulSize[] = {
+    "__mul:",
+    "mv a2, a0",
+    "mv a0, zero",
+    "__mul_loop:",
+    "beq a1, zero, __mul_end",
+    "nop",
+    "andi a3, a1, 1",
+    "beq a3, zero, __mul_next",
+    "nop",
+    "add a0, a0, a2",
+    "__mul_next:",
+    "sll a2, a2, 1",
+    "srl a1, a1, 1",
+    "j __mul_loop",
+    "nop",
+    "__mul_end:",
+    "jr ra",
+    "nop",
+    NULL
+};
+
+// 较小的操作数作乘数，每轮无分支地处理 4 位
+static const char* mulSpeed[] = {
+    "__mul:",
+    "sltu a3, a0, a1",
+    "beq a3, zero, __mul_start",
+    "nop",
+    "mv a3, a0",
+    "mv a0, a1",
+    "mv a1, a3",
+    "__mul_start:",
+    "mv a2, a0",
+    "mv a0, zero",
+    "__mul_loop:",
+    "beq a1, zero, __mul_end",
+    "nop",
+    "andi a3, a1, 1",
+    "sub a3, zero, a3",
+    "and a3, a3, a2",
+    "add a0, a0, a3",
+    "sll a2, a2, 1",
+    "srl a1, a1, 1",
+    "andi a3, a1, 1",
+    "sub a3, zero, a3",
+    "and a3, a3, a2",
+    "add a0, a0, a3",
+    "sll a2, a2, 1",
+    "srl a1, a1, 1",
+    "andi a3, a1, 1",
+    "sub a3, zero, a3",
+    "and a3, a3, a2",
+    "add a0, a0, a3",
+    "sll a2, a2, 1",
+    "srl a1, a1, 1",
+    "andi a3, a1, 1",
+    "sub a3, zero, a3",
+    "and a3, a3, a2",
+    "add a0, a0, a3",
+    "sll a2, a2, 1",
+    "srl a1, a1, 1",
+    "j __mul_loop",
+    "nop",
+    "__mul_end:",
+    "jr ra",
+    "nop",
+    NULL
+};
+
+// a0 = a0 / a1，a1 = a0 % a1：先取绝对值做无符号恢复除法，再按 C 的规则恢复符号
+// a2 为部分余数，a3 为剩余位数，a5 的符号位是商的符号，a6 的符号位是余数的符号
+static const char* divModSize[] = {
+    "__divmod:",
+    "xor a5, a0, a1",
+    "mv a6, a0",
+    "sra a4, a0, 31",
+    "xor a0, a0, a4",
+    "sub a0, a0, a4",
+    "sra a4, a1, 31",
+    "xor a1, a1, a4",
+    "sub a1, a1, a4",
+    "mv a2, zero",
+    "addi a3, zero, 32",
+    "__divmod_loop:",
+    "srl a4, a0, 31",
+    "sll a2, a2, 1",
+    "or a2, a2, a4",
+    "sll a0, a0, 1",
+    "sltu a4, a2, a1",
+    "bne a4, zero, __divmod_next",
+    "nop",
+    "sub a2, a2, a1",
+    "ori a0, a0, 1",
+    "__divmod_next:",
+    "addi a3, a3, -1",
+    "bne a3, zero, __divmod_loop",
+    "nop",
+    "sra a4, a5, 31",
+    "xor a0, a0, a4",
+    "sub a0, a0, a4",
+    "sra a4, a6, 31",
+    "xor a1, a2, a4",
+    "sub a1, a1, a4",
+    "jr ra",
+    "nop",
+    NULL
+};
+
+// 被除数较小时商为 0；否则跳过被除数高位的零字节，每轮处理 2 位
+static const char* divModSpeed[] = {
+    "__divmod:",
+    "xor a5, a0, a1",
+    "mv a6, a0",
+    "sra a4, a0, 31",
+    "xor a0, a0, a4",
+    "sub a0, a0, a4",
+    "sra a4, a1, 31",
+    "xor a1, a1, a4",
+    "sub a1, a1, a4",
+    "sltu a4, a0, a1",
+    "beq a4, zero, __divmod_start",
+    "nop",
+    "mv a2, a0",
+    "mv a0, zero",
+    "j __divmod_sign",
+    "nop",
+    "__divmod_start:",
+    "mv a2, zero",
+    "addi a3, zero, 32",
+    "__divmod_skip:",
+    "srl a4, a0, 24",
+    "bne a4, zero, __divmod_loop",
+    "nop",
+    "slti a4, a3, 9",
+    "bne a4, zero, __divmod_loop",
+    "nop",
+    "sll a0, a0, 8",
+    "addi a3, a3, -8",
+    "j __divmod_skip",
+    "nop",
+    "__divmod_loop:",
+    "srl a4, a0, 31",
+    "sll a2, a2, 1",
+    "or a2, a2, a4",
+    "sll a0, a0, 1",
+    "sltu a4, a2, a1",
+    "bne a4, zero, __divmod_next1",
+    "nop",
+    "sub a2, a2, a1",
+    "ori a0, a0, 1",
+    "__divmod_next1:",
+    "srl a4, a0, 31",
+    "sll a2, a2, 1",
+    "or a2, a2, a4",
+    "sll a0, a0, 1",
+    "sltu a4, a2, a1",
+    "bne a4, zero, __divmod_next2",
+    "nop",
+    "sub a2, a2, a1",
+    "ori a0, a0, 1",
+    "__divmod_next2:",
+    "addi a3, a3, -2",
+    "bne a3, zero, __divmod_loop",
+    "nop",
+    "__divmod_sign:",
+    "sra a4, a5, 31",
+    "xor a0, a0, a4",
+    "sub a0, a0, a4",
+    "sra a4, a6, 31",
+    "xor a1, a2, a4",
+    "sub a1, a1, a4",
+    "jr ra",
+    "nop",
+    NULL
+};
+
+static void emitRoutine(AsmContainer* asmContainer, const char** lines) {
+    for (int i = 0; lines[i] != NULL; ++i) {
+        newAsm(asmContainer, lines[i]);
+    }
+}
+
+void emitMulDivRuntime(AsmContainer* asmContainer) {
+    if (usesMul) {
+        emitRoutine(asmContainer, mulDivMode == MUL_DIV_SIZE ? mulSize : mulSpeed);
+    }
+    if (usesDivMod) {
+        emitRoutine(asmContainer, mulDivMode == MUL_DIV_SIZE ? divModSize : divModSpeed);
+    }
+}
+
+void printMulDivReport(FILE* output) {
+    fprintf(output, "[MUL/DIV] %s: %d constant multiplications, %d constant divisions, %d runtime calls\n",
+            mulDivMode == MUL_DIV_SIZE ? "size" : "speed", constMuls, constDivs, runtimeCalls);
+}
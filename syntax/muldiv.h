@@ -0,0 +1,39 @@
+#ifndef MULDIV_H
+#define MULDIV_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "asm.h"
+
+/* 乘法、除法和求模的转换
+ * 指令集没有乘除法指令（见 docs/quaternary.md），*、/、% 在生成目标代码时转换为：
+ * - 乘常数：把常数写成非相邻形式（NAF），用 Horner 规则生成移位和加减
+ * - 除以或对 2 的幂求模：移位，负的被除数先加上 2^k-1，保证商向零取整
+ * - 其他情况：调用运行时子程序 __mul 或 __divmod，用到的子程序在 .text 末尾生成一次
+ * 子程序的约定：操作数在 a0、a1，积或商在 a0，余数在 a1，只改写 a0-a6。
+ * 调用处把 ra 暂存在 a7 中，所以调用乘除法的函数仍然可以是叶函数。
+ * a0-a7 只在传参时使用，寄存器分配器不会把变量放在其中。
+ */
+typedef enum MulDivMode {
+    MUL_DIV_SPEED,      // 子程序展开循环、跳过前导零；常数乘法总是展开
+    MUL_DIV_SIZE,       // 子程序使用最短的循环；常数乘法比调用更长时改为调用
+} MulDivMode;
+
+extern MulDivMode mulDivMode;
+
+// op 为 TAC_MUL、TAC_DIV 或 TAC_MOD
+bool isMulDivOp(TACOpcode op);
+
+// regX = regY op value，regY 不能是 x31。不适合展开时不生成代码并返回 false
+bool emitMulDivConst(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY, int value);
+
+// regX = regY op regZ，调用运行时子程序
+void emitMulDivCall(AsmContainer* asmContainer, TACOpcode op, const char* regX, const char* regY, const char* regZ);
+
+// 在 .text 末尾生成用到的运行时子程序
+void emitMulDivRuntime(AsmContainer* asmContainer);
+
+// 输出常数转换和子程序调用的统计
+void printMulDivReport(FILE* output);
+
+#endif // MULDIV_H
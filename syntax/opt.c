@@ -0,0 +1,63 @@
+#include "opt.h"
+#include <string.h>
+#include "symbol_table.h"
+
+int optLevel = 0;
+
+bool* findLocalScalars(CFG* cfg, Liveness* liveness) {
+    bool* local = (bool*)calloc(liveness->varNum + 1, sizeof(bool));
+    for (int i = 0; i < liveness->varNum; ++i) {
+        local[i] = isTemp(liveness->vars[i]);
+    }
+    SymbolTableEntry* func = findSymbol(cfg->funcName);
+    for (int i = 0; func != NULL && i < func->paramNum; ++i) {
+        int num = getLivenessVar(liveness, func->params[i]->id);
+        if (num != -1 && !func->params[i]->isArray) local[num] = true;
+    }
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        TACList* cur = cfg->blocks[b]->first;
+        for (int i = 0; i < cfg->blocks[b]->tacNum; ++i, cur = cur->next) {
+            TAC* tac = cur->tac;
+            if (tac->op != TAC_ALLOC) continue;
+            int num = getLivenessVar(liveness, tac->res);
+            if (num == -1) continue;
+            int typeSize = strcmp(tac->arg1, "CHAR") == 0 ? 1 : strcmp(tac->arg1, "SHORT") == 0 ? 2 : 4;
+            // arrays are allocated with the size of all elements
+            local[num] = atoi(tac->arg2) <= typeSize;
+        }
+    }
+    return local;
+}
+
+typedef void (*FunctionPass)(CFG* cfg, FILE* report);
+
+static void runPass(const char* name, FunctionPass pass, FILE* report) {
+    fprintf(report, "[OPTIMIZATION] %s\n", name);
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    for (int i = 0; i < cfgNum; ++i) {
+        pass(cfgs[i], report);
+    }
+    freeCFGs(cfgs, cfgNum);
+}
+
+void optimizeTAC(FILE* report) {
+    if (optLevel < 1) return;
+    if (inlineThreshold > 0) {
+        inlineCalls(report);
+    }
+    runPass("tail recursion", eliminateSelfTailCalls, report);
+    runPass("loop rotation", rotateLoops, report);
+    runPass("array lowering", lowerArrayAccesses, report);
+    runPass("constant propagation", propagateConstants, report);
+    if (optLevel >= 2) {
+        runPass("global value numbering", numberValuesGlobal, report);
+    } else {
+        runPass("local value numbering", numberValuesLocal, report);
+    }
+    runPass("loop-invariant code motion", hoistLoopInvariants, report);
+    runPass("induction variables", reduceInductionVariables, report);
+    runPass("dead code elimination", eliminateDeadCode, report);
+    runPass("compare-and-branch fusion", fuseCompareBranches, report);
+    generateIndex();
+}
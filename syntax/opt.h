@@ -0,0 +1,70 @@
+#ifndef OPT_H
+#define OPT_H
+
+#include <stdio.h>
+#include "tac.h"
+#include "cfg.h"
+#include "liveness.h"
+
+/* machine-independent optimizations on the TAC list.
+ * optimizeTAC() runs between generateIndex() and the code generator. every pass works on the CFG
+ * of one function at a time and edits the global list in place, so the CFGs are rebuilt before
+ * the next pass. each pass prints one line per function to the report.
+ */
+extern int optLevel; // 0: no optimization, 1: IR passes (-O1), 2: global IR passes and graph coloring (-O2)
+extern int inlineThreshold; // largest callee inlined, in TACs. 0 disables inlining
+
+// call sites inside loops inline callees this many times larger
+#define INLINE_LOOP_FACTOR 3
+#define MAX_INLINE_ARGS 32
+
+// longest loop condition, in TACs, that loop rotation copies in front of the loop
+#define MAX_ROTATE_CONDITION 24
+
+// run the passes enabled by optLevel on all functions, then renumber the TACs
+void optimizeTAC(FILE* report);
+
+// returns a flag for every variable numbered by liveness: true for temps, scalar locals and
+// scalar parameters, whose values only change through the TACs of the function. globals and
+// arrays are false. the caller should free the array.
+bool* findLocalScalars(CFG* cfg, Liveness* liveness);
+
+// inline calls to small non-recursive functions and remove the functions no longer called,
+// see inline.c. works on the whole program instead of one CFG
+void inlineCalls(FILE* report);
+
+// self tail calls to jumps to the start of the function, see tail_call.c
+void eliminateSelfTailCalls(CFG* cfg, FILE* report);
+
+// move the conditions of while and for loops to the bottom, see loop_rotate.c
+void rotateLoops(CFG* cfg, FILE* report);
+
+// rewrite =[] and []= into &[] and =* / *=, see array_lower.c
+void lowerArrayAccesses(CFG* cfg, FILE* report);
+
+// sparse conditional constant propagation (Wegman & Zadeck), see const_prop.c
+void propagateConstants(CFG* cfg, FILE* report);
+
+// value numbering inside every basic block, see value_numbering.c
+void numberValuesLocal(CFG* cfg, FILE* report);
+
+// value numbering over the dominator tree, see value_numbering.c
+void numberValuesGlobal(CFG* cfg, FILE* report);
+
+// loop-invariant code motion into loop preheaders, see licm.c
+void hoistLoopInvariants(CFG* cfg, FILE* report);
+
+// insert a new label before the header of the loop and redirect the jumps entering the loop to
+// it. TACs inserted after the returned node run once before the loop. the nodes of cfg stay valid.
+TACList* insertPreheader(CFG* cfg, Loop* loop);
+
+// strength reduction of array addresses and linear function test replacement, see induction.c
+void reduceInductionVariables(CFG* cfg, FILE* report);
+
+// merge relational TACs into the conditional jumps reading them, see branch_fuse.c
+void fuseCompareBranches(CFG* cfg, FILE* report);
+
+// remove unreachable blocks, redundant jumps and labels, dead TACs and unused locals, see dce.c
+void eliminateDeadCode(CFG* cfg, FILE* report);
+
+#endif
@@ -0,0 +1,167 @@
+#include "peephole.h"
+#include <stdlib.h>
+#include <string.h>
+#include "instr.h"
+
+// 正在优化的指令序列
+typedef struct PeepholeCode {
+    Instr* instrs;
+    bool* removed;      // 已删除的指令
+    int num;
+} PeepholeCode;
+
+// 从第 i 条指令开始匹配，命中时改写 code 并返回 true
+typedef bool (*PeepholeApply)(PeepholeCode* code, int i);
+
+typedef struct PeepholeRule {
+    const char* name;
+    PeepholeApply apply;
+    int hits;
+} PeepholeRule;
+
+// i 之后第一条没有删除的指令，没有时返回 -1
+static int nextInstr(PeepholeCode* code, int i) {
+    for (int j = i + 1; j < code->num; ++j) {
+        if (!code->removed[j]) return j;
+    }
+    return -1;
+}
+
+static bool isOp(PeepholeCode* code, int i, InstrOp op) {
+    return i != -1 && code->instrs[i].op == op;
+}
+
+// 从 i 开始连续的标号中是否有 label
+static bool labelFollows(PeepholeCode* code, int i, const char* label) {
+    for (; isOp(code, i, INSTR_LABEL); i = nextInstr(code, i)) {
+        if (code->instrs[i].symbol == label) return true;
+    }
+    return false;
+}
+
+static void removeInstr(PeepholeCode* code, int i) {
+    code->removed[i] = true;
+}
+
+// sw x, off(b); lw y, off(b) => sw x, off(b); mv y, x（y 与 x 相同时删除 lw）
+static bool storeThenLoad(PeepholeCode* code, int i) {
+    int j = nextInstr(code, i);
+    if (!isOp(code, i, INSTR_SW) || !isOp(code, j, INSTR_LW)) return false;
+    Instr* store = &code->instrs[i];
+    Instr* load = &code->instrs[j];
+    if (store->rs != load->rs || store->imm != load->imm || store->symbol != load->symbol) return false;
+    if (load->rd == store->rt) {
+        removeInstr(code, j);
+        return true;
+    }
+    load->op = INSTR_MV;
+    load->rs = store->rt;
+    load->imm = 0;
+    load->symbol = NULL;
+    return true;
+}
+
+// mv a, a
+static bool moveToItself(PeepholeCode* code, int i) {
+    if (!isOp(code, i, INSTR_MV) || code->instrs[i].rd != code->instrs[i].rs) return false;
+    removeInstr(code, i);
+    return true;
+}
+
+// mv a, b; mv b, a => mv a, b
+static bool moveBack(PeepholeCode* code, int i) {
+    int j = nextInstr(code, i);
+    if (!isOp(code, i, INSTR_MV) || !isOp(code, j, INSTR_MV)) return false;
+    if (code->instrs[j].rd != code->instrs[i].rs || code->instrs[j].rs != code->instrs[i].rd) return false;
+    removeInstr(code, j);
+    return true;
+}
+
+// addi r, r, 0
+static bool addZero(PeepholeCode* code, int i) {
+    Instr* instr = &code->instrs[i];
+    if (!isOp(code, i, INSTR_ADDI) && !isOp(code, i, INSTR_ADDIU)) return false;
+    if (instr->rd != instr->rs || instr->imm != 0 || instr->symbol != NULL) return false;
+    removeInstr(code, i);
+    return true;
+}
+
+// j L 或 beq/bne ..., L，延迟槽之后紧接着 L:。槽中的指令在两条路径上都执行，只删除 nop
+static bool jumpToNextLabel(PeepholeCode* code, int i) {
+    if (!isOp(code, i, INSTR_J) && !isOp(code, i, INSTR_BEQ) && !isOp(code, i, INSTR_BNE)) return false;
+    int slot = nextInstr(code, i);
+    if (slot == -1 || !labelFollows(code, nextInstr(code, slot), code->instrs[i].symbol)) return false;
+    removeInstr(code, i);
+    if (isOp(code, slot, INSTR_NOP)) removeInstr(code, slot);
+    return true;
+}
+
+// bne a, b, L1; nop; j L2; nop; L1: => beq a, b, L2; nop; L1:
+static bool branchOverJump(PeepholeCode* code, int i) {
+    if (!isOp(code, i, INSTR_BEQ) && !isOp(code, i, INSTR_BNE)) return false;
+    int slot1 = nextInstr(code, i);
+    int jump = nextInstr(code, slot1);
+    int slot2 = nextInstr(code, jump);
+    if (!isOp(code, slot1, INSTR_NOP) || !isOp(code, jump, INSTR_J) || !isOp(code, slot2, INSTR_NOP)) return false;
+    Instr* branch = &code->instrs[i];
+    if (!labelFollows(code, nextInstr(code, slot2), branch->symbol)) return false;
+    branch->op = branch->op == INSTR_BEQ ? INSTR_BNE : INSTR_BEQ;
+    branch->symbol = code->instrs[jump].symbol;
+    removeInstr(code, jump);
+    removeInstr(code, slot2);
+    return true;
+}
+
+// 新规则加在表的末尾
+static PeepholeRule peepholeRules[] = {
+    {"store then load of the same slot", storeThenLoad, 0},
+    {"move to itself", moveToItself, 0},
+    {"move back", moveBack, 0},
+    {"add zero to itself", addZero, 0},
+    {"jump to the next label", jumpToNextLabel, 0},
+    {"branch over jump", branchOverJump, 0},
+};
+
+#define PEEPHOLE_RULE_NUM ((int)(sizeof(peepholeRules) / sizeof(peepholeRules[0])))
+
+void optimizePeephole(AsmContainer* container, FILE* report) {
+    PeepholeCode code;
+    code.num = (int)container->size;
+    code.instrs = container->instrs;
+    code.removed = (bool*)calloc(code.num + 1, sizeof(bool));
+    if (code.removed == NULL) {
+        fprintf(stderr, "Failed to allocate memory for peephole optimization\n");
+        exit(1);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        bool inText = false;
+        for (int i = 0; i < code.num; ++i) {
+            // .data 中的行不参与匹配
+            Instr* instr = &code.instrs[i];
+            if (instr->op == INSTR_DIRECTIVE && strncmp(instr->symbol, ".text", 5) == 0) inText = true;
+            if (instr->op == INSTR_DIRECTIVE && strncmp(instr->symbol, ".data", 5) == 0) inText = false;
+            for (int r = 0; r < PEEPHOLE_RULE_NUM && inText && !code.removed[i]; ++r) {
+                if (peepholeRules[r].apply(&code, i)) {
+                    peepholeRules[r].hits++;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // 删除的指令从数组中去掉
+    unsigned int kept = 0;
+    for (int i = 0; i < code.num; ++i) {
+        if (!code.removed[i]) container->instrs[kept++] = code.instrs[i];
+    }
+    container->size = kept;
+    free(code.removed);
+
+    fprintf(report, "[PEEPHOLE]\n");
+    for (int r = 0; r < PEEPHOLE_RULE_NUM; ++r) {
+        fprintf(report, "%s: %d hits\n", peepholeRules[r].name, peepholeRules[r].hits);
+    }
+}
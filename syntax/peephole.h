@@ -0,0 +1,15 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdio.h>
+#include "asm.h"
+
+/* 窥孔优化
+ * 在 writeAssembly 之前扫描 .text 中的结构化指令（见 instr.h），按规则表匹配相邻的指令并原地改写。
+ * 规则只在同一个基本块内匹配（标号会打断窗口），反复扫描直到没有规则命中。
+ * 每条规则的命中次数写入 report。
+ * 延迟槽填充之前运行，这时每条分支之后的延迟槽都还是 nop。
+ */
+void optimizePeephole(AsmContainer* container, FILE* report);
+
+#endif // PEEPHOLE_H
@@ -0,0 +1,951 @@
+#include "regalloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include "symbol_table.h"
+#include "muldiv.h"
+
+RegAllocMode regAllocMode = REG_ALLOC_LOCAL;
+
+const int callerSavedRegs[CALLER_SAVED_REG_NUM] = { 5, 6, 7, 28, 29 };
+const int calleeSavedRegs[CALLEE_SAVED_REG_NUM] = { 8, 9, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 };
+
+extern const char* all_regs[];
+
+static RegAssignment* assignments[MAX_FUNCTIONS];
+static int assignmentNum = 0;
+
+// 代码生成时的状态
+static RegAssignment* currentAssignment = NULL;
+static StackFrameInfo* currentFrame = NULL;
+static char* pendingArgs[MAX_CALL_ARGS]; // param 收集的实参，在 call 时统一传递
+static int pendingArgNum = 0;
+static bool lastWasReturn = false;
+static bool afterTailCall = false; // 尾调用之后的 return 不再生成代码
+
+static void* regAllocAlloc(size_t size) {
+    void* ptr = calloc(1, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Failed to allocate memory for register allocation.\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static unsigned int hashLocation(const char* var) {
+    unsigned int hash = 5381;
+    while (*var) {
+        hash = (hash << 5) + hash + (unsigned char)*var;
+        var++;
+    }
+    return hash;
+}
+
+static void insertLocationIndex(RegAssignment* assignment, int num) {
+    unsigned int index = hashLocation(assignment->locations[num].var) & (assignment->locationTableSize - 1);
+    while (assignment->locationTable[index] != -1) {
+        index = (index + 1) & (assignment->locationTableSize - 1);
+    }
+    assignment->locationTable[index] = num;
+}
+
+static void growLocationTable(RegAssignment* assignment) {
+    free(assignment->locationTable);
+    assignment->locationTableSize = assignment->locationTableSize == 0 ? 16 : assignment->locationTableSize * 2;
+    assignment->locationTable = (int*)malloc(assignment->locationTableSize * sizeof(int));
+    for (unsigned int i = 0; i < assignment->locationTableSize; ++i) {
+        assignment->locationTable[i] = -1;
+    }
+    for (int i = 0; i < assignment->locationNum; ++i) {
+        insertLocationIndex(assignment, i);
+    }
+}
+
+VarLocation* findVarLocation(RegAssignment* assignment, const char* var) {
+    if (assignment == NULL || var == NULL || assignment->locationTableSize == 0) return NULL;
+    unsigned int index = hashLocation(var) & (assignment->locationTableSize - 1);
+    while (assignment->locationTable[index] != -1) {
+        VarLocation* location = &assignment->locations[assignment->locationTable[index]];
+        if (strcmp(location->var, var) == 0) {
+            return location;
+        }
+        index = (index + 1) & (assignment->locationTableSize - 1);
+    }
+    return NULL;
+}
+
+static VarLocation* addVarLocation(RegAssignment* assignment, char* var) {
+    VarLocation* location = findVarLocation(assignment, var);
+    if (location != NULL) return location;
+    if (assignment->locationNum >= assignment->locationCapacity) {
+        assignment->locationCapacity = assignment->locationCapacity == 0 ? 16 : assignment->locationCapacity * 2;
+        assignment->locations = (VarLocation*)realloc(assignment->locations, assignment->locationCapacity * sizeof(VarLocation));
+    }
+    location = &assignment->locations[assignment->locationNum++];
+    location->var = var;
+    location->reg = -1;
+    location->slot = -1;
+    location->size = WORD_LENGTH_BYTE;
+    location->offset = 0;
+    location->isLocalArray = false;
+    location->isArrayParam = false;
+    // 装载因子不超过 1/2
+    if ((unsigned int)assignment->locationNum * 2 > assignment->locationTableSize) {
+        growLocationTable(assignment);
+    } else {
+        insertLocationIndex(assignment, assignment->locationNum - 1);
+    }
+    return location;
+}
+
+int allocateSpillSlot(RegAssignment* assignment, VarLocation* location) {
+    if (location->slot == -1) {
+        location->slot = assignment->slotNum++;
+    }
+    return location->slot;
+}
+
+void markRegisterUsed(RegAssignment* assignment, int reg) {
+    for (int i = 0; i < CALLEE_SAVED_REG_NUM; ++i) {
+        if (calleeSavedRegs[i] == reg && !(assignment->calleeSavedMask & (1u << i))) {
+            assignment->calleeSavedMask |= 1u << i;
+            assignment->numCalleeSaved++;
+        }
+    }
+}
+
+RegAssignment* createRegAssignment(CFG* cfg) {
+    RegAssignment* assignment = (RegAssignment*)regAllocAlloc(sizeof(RegAssignment));
+    assignment->funcName = cfg->funcName;
+
+    SymbolTableEntry* func = findSymbol(cfg->funcName);
+    if (func != NULL) {
+        for (int i = 0; i < func->paramNum; ++i) {
+            VarLocation* location = addVarLocation(assignment, func->params[i]->id);
+            location->isArrayParam = func->params[i]->isArray == 1;
+            if (!location->isArrayParam) {
+                location->size = getTypeSize(func->params[i]->type);
+            }
+        }
+    }
+
+    for (TACList* cur = cfg->funcLabel->next; cur != NULL && cur != cfg->endLabel; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_ALLOC) {
+            VarLocation* location = addVarLocation(assignment, tac->res);
+            int typeSize = getTypeSize(tac->arg1);
+            int size = atoi(tac->arg2);
+            if (size > typeSize) {
+                // 局部数组直接放在溢出区，元素按字寻址，每个元素占一个字
+                location->isLocalArray = true;
+                location->size = size / typeSize * WORD_LENGTH_BYTE;
+                allocateSpillSlot(assignment, location);
+            } else {
+                location->size = typeSize;
+            }
+        }
+        char* operands[3];
+        getTACVarOperands(tac, operands);
+        for (int i = 0; i < 3; ++i) {
+            if (operands[i] != NULL && isTemp(operands[i])) {
+                addVarLocation(assignment, operands[i]);
+            }
+        }
+    }
+    return assignment;
+}
+
+// 给溢出位置排列字节偏移。合并到同一位置的变量大小可能不同，位置按其中最大的计算，
+// 这些变量都用这个大小访问
+static void layoutSpillArea(RegAssignment* assignment) {
+    FrameSlot* slots = (FrameSlot*)regAllocAlloc((assignment->slotNum + 1) * sizeof(FrameSlot));
+    for (int i = 0; i < assignment->locationNum; ++i) {
+        VarLocation* location = &assignment->locations[i];
+        if (location->reg != -1 || location->slot == -1) continue;
+        FrameSlot* slot = &slots[location->slot];
+        if (location->size > slot->size) {
+            slot->var = location->var;
+            slot->size = location->size;
+        }
+    }
+    assignment->spillSlots = layoutFrameSlots(slots, assignment->slotNum) / WORD_LENGTH_BYTE;
+    for (int i = 0; i < assignment->locationNum; ++i) {
+        VarLocation* location = &assignment->locations[i];
+        if (location->reg != -1 || location->slot == -1) continue;
+        location->offset = slots[location->slot].offset;
+        location->size = slots[location->slot].size;
+    }
+    free(slots);
+    // 调用者保存寄存器的保存区在溢出区末尾，每个寄存器一个字
+    assignment->callerSaveBase = assignment->spillSlots;
+    for (int i = 0; i < CALLER_SAVED_REG_NUM; ++i) {
+        if (assignment->callerSaveMask & (1u << i)) assignment->spillSlots++;
+    }
+}
+
+static int callerSavedIndex(int reg) {
+    for (int i = 0; i < CALLER_SAVED_REG_NUM; ++i) {
+        if (callerSavedRegs[i] == reg) return i;
+    }
+    return -1;
+}
+
+// 找出每个 call 之后仍然活跃、并且在调用者保存寄存器中的变量。call 的结果在调用之后才定义，不用保存
+static void findCallerSaves(RegAssignment* assignment, CFG* cfg, Liveness* liveness) {
+    unsigned int* live = (unsigned int*)regAllocAlloc(liveness->setWords * sizeof(unsigned int));
+    int capacity = 0;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        BasicBlock* block = cfg->blocks[b];
+        memcpy(live, liveness->liveOut[b], liveness->setWords * sizeof(unsigned int));
+        TAC** tacs = (TAC**)regAllocAlloc((block->tacNum + 1) * sizeof(TAC*));
+        TACList* cur = block->first;
+        for (int j = 0; j < block->tacNum; ++j, cur = cur->next) {
+            tacs[j] = cur->tac;
+        }
+        for (int j = block->tacNum - 1; j >= 0; --j) {
+            TAC* tac = tacs[j];
+            int roles = getTACRoles(tac);
+            char* operands[3];
+            getTACVarOperands(tac, operands);
+            int defVar = operands[2] != NULL && (roles & TAC_DEF_RES) ? getLivenessVar(liveness, operands[2]) : -1;
+            if (tac->op == TAC_CALL) {
+                unsigned int mask = 0;
+                for (int v = 0; v < liveness->varNum; ++v) {
+                    if (!LIVE_SET_HAS(live, v) || v == defVar) continue;
+                    VarLocation* location = findVarLocation(assignment, liveness->vars[v]);
+                    int index = location == NULL ? -1 : callerSavedIndex(location->reg);
+                    if (index != -1) mask |= 1u << index;
+                }
+                if (mask != 0) {
+                    if (assignment->saveCallNum >= capacity) {
+                        capacity = capacity == 0 ? 8 : capacity * 2;
+                        assignment->saveCalls = (TAC**)realloc(assignment->saveCalls, capacity * sizeof(TAC*));
+                        assignment->saveCallMasks = (unsigned int*)realloc(assignment->saveCallMasks, capacity * sizeof(unsigned int));
+                    }
+                    assignment->saveCalls[assignment->saveCallNum] = tac;
+                    assignment->saveCallMasks[assignment->saveCallNum++] = mask;
+                    assignment->callerSaveMask |= mask;
+                }
+            }
+            if (defVar != -1) {
+                LIVE_SET_DELETE(live, defVar);
+            }
+            for (int k = 0; k < 3; ++k) {
+                if (operands[k] == NULL || (k == 2 && !(roles & TAC_USE_RES))) continue;
+                int num = getLivenessVar(liveness, operands[k]);
+                if (num != -1) LIVE_SET_ADD(live, num);
+            }
+        }
+        free(tacs);
+    }
+    free(live);
+}
+
+static bool isCalleeSaved(int reg) {
+    for (int i = 0; i < CALLEE_SAVED_REG_NUM; ++i) {
+        if (calleeSavedRegs[i] == reg) return true;
+    }
+    return false;
+}
+
+// 变量在 s 寄存器或栈中时，用到它的基本块需要先保存寄存器、分配栈帧
+static bool needsFrame(RegAssignment* assignment, const char* var) {
+    VarLocation* location = findVarLocation(assignment, var);
+    if (location == NULL) return false;
+    return location->reg == -1 ? location->slot != -1 : isCalleeSaved(location->reg);
+}
+
+bool isTailCall(RegAssignment* assignment, TAC* tac) {
+    for (int i = 0; i < assignment->tailCallNum; ++i) {
+        if (assignment->tailCalls[i] == tac) return true;
+    }
+    return false;
+}
+
+// 尾调用之后的 return 不会执行，被调用者直接返回到调用者的调用者
+static bool returnsAfterTailCall(RegAssignment* assignment, BasicBlock* block) {
+    return block->last->tac->op == TAC_RETURN && block->predNum == 1 && block->preds[0]->id == block->id - 1 &&
+           isTailCall(assignment, block->preds[0]->last->tac);
+}
+
+// 尾调用用 j 跳到被调用者，不改写 ra，本身不需要栈帧
+static bool blockNeedsFrame(RegAssignment* assignment, CFG* cfg, BasicBlock* block) {
+    if (returnsAfterTailCall(assignment, block)) return false;
+    if (block->id == 0) {
+        // 函数入口把参数移到分配的位置，第 9 个以后的参数从调用者的栈帧中读
+        SymbolTableEntry* func = findSymbol(cfg->funcName);
+        for (int i = 0; func != NULL && i < func->paramNum; ++i) {
+            VarLocation* location = findVarLocation(assignment, func->params[i]->id);
+            if (location == NULL || (location->reg == -1 && location->slot == -1)) continue;
+            if (i >= ARG_REG_NUM || needsFrame(assignment, location->var)) return true;
+        }
+    }
+    TACList* cur = block->first;
+    for (int i = 0; i < block->tacNum; ++i, cur = cur->next) {
+        if (cur->tac->op == TAC_CALL) {
+            if (isTailCall(assignment, cur->tac)) continue;
+            return true;
+        }
+        char* operands[3];
+        getTACVarOperands(cur->tac, operands);
+        for (int k = 0; k < 3; ++k) {
+            if (operands[k] != NULL && needsFrame(assignment, operands[k])) return true;
+        }
+    }
+    return false;
+}
+
+static void markReachable(BasicBlock* block, bool* reachable) {
+    if (block->first == NULL || reachable[block->id]) return;
+    reachable[block->id] = true;
+    for (int i = 0; i < block->succNum; ++i) {
+        markReachable(block->succs[i], reachable);
+    }
+}
+
+// 收缩包装：保存点取所有需要栈帧的基本块的最近公共支配者，在循环中时移到循环之前。
+// 每个返回要么被保存点支配（恢复后返回），要么从保存点到不了（直接返回），否则保存点退回函数入口
+static void placeFrameSetup(RegAssignment* assignment, CFG* cfg) {
+    int* idom = computeDominators(cfg);
+    int saveBlock = -1;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        if (b != 0 && idom[b] == -1) continue; // 到不了的基本块
+        if (!blockNeedsFrame(assignment, cfg, cfg->blocks[b])) continue;
+        if (saveBlock == -1) {
+            saveBlock = b;
+        }
+        while (!dominates(idom, saveBlock, b)) {
+            saveBlock = idom[saveBlock];
+        }
+    }
+
+    if (saveBlock > 0) {
+        int loopNum = 0;
+        Loop* loops = findLoops(cfg, idom, &loopNum);
+        bool moved = true;
+        while (moved && saveBlock > 0) {
+            moved = false;
+            for (int l = 0; l < loopNum; ++l) {
+                if (loops[l].body[saveBlock]) {
+                    saveBlock = idom[loops[l].header] == -1 ? 0 : idom[loops[l].header];
+                    moved = true;
+                    break;
+                }
+            }
+        }
+        freeLoops(loops, loopNum);
+    }
+
+    // 到不了保存点的尾调用和 return 一样不释放栈帧
+    assignment->bareReturns = (TAC**)regAllocAlloc((2 * cfg->exit->predNum + 1) * sizeof(TAC*));
+    if (saveBlock > 0) {
+        bool* reachable = (bool*)regAllocAlloc(cfg->blockNum * sizeof(bool));
+        markReachable(cfg->blocks[saveBlock], reachable);
+        for (int i = 0; i < cfg->exit->predNum; ++i) {
+            BasicBlock* block = cfg->exit->preds[i];
+            if (dominates(idom, saveBlock, block->id)) continue;
+            if (reachable[block->id]) {
+                saveBlock = 0;
+                assignment->bareReturnNum = 0;
+                assignment->bareEnd = false;
+                break;
+            }
+            if (returnsAfterTailCall(assignment, block)) {
+                assignment->bareReturns[assignment->bareReturnNum++] = block->preds[0]->last->tac;
+            }
+            if (block->last->tac->op == TAC_RETURN || isTailCall(assignment, block->last->tac)) {
+                assignment->bareReturns[assignment->bareReturnNum++] = block->last->tac;
+            } else {
+                assignment->bareEnd = true;
+            }
+        }
+        free(reachable);
+    }
+    assignment->saveBlock = saveBlock;
+    if (saveBlock > 0) {
+        assignment->saveLabel = getBlockLabel(cfg->blocks[saveBlock]);
+        assignment->saveAt = cfg->blocks[saveBlock]->first->tac;
+    }
+    free(idom);
+}
+
+// 找出尾调用。参数超过 a0-a7 时要用调用者的出栈参数区，不能在调用前释放栈帧
+static void findTailCalls(RegAssignment* assignment, CFG* cfg) {
+    int argNum = 0;
+    int capacity = 0;
+    for (TACList* cur = cfg->funcLabel->next; cur != NULL && cur != cfg->endLabel; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_PARAM) {
+            argNum++;
+            continue;
+        }
+        if (tac->op != TAC_CALL) continue;
+        int args = argNum;
+        argNum = 0;
+        TAC* next = cur->next->tac;
+        bool returnsResult = next->op == TAC_RETURN &&
+            (next->res == NULL || *next->res == '\0' || (tac->res != NULL && strcmp(next->res, tac->res) == 0));
+        if (args > ARG_REG_NUM || (!returnsResult && cur->next != cfg->endLabel)) continue;
+        if (assignment->tailCallNum >= capacity) {
+            capacity = capacity == 0 ? 4 : capacity * 2;
+            assignment->tailCalls = (TAC**)realloc(assignment->tailCalls, capacity * sizeof(TAC*));
+        }
+        assignment->tailCalls[assignment->tailCallNum++] = tac;
+    }
+}
+
+// 根据分配结果重新计算栈帧，全局分配时局部变量都在寄存器或溢出区中，不再需要 localData
+static void updateFrameInfo(RegAssignment* assignment, CallGraphNode* node) {
+    int index = mapStackInfo(assignment->funcName);
+    if (index == -1) {
+        fprintf(stderr, "Cannot find the stack frame info for function: %s\n", assignment->funcName);
+        return;
+    }
+    StackFrameInfo* frameInfo = &stackFrameInfos[index];
+    // 只有尾调用的函数不改写 ra，和叶函数一样不保存它
+    frameInfo->isLeaf = node->isLeaf || node->callSiteNum == assignment->tailCallNum;
+    frameInfo->outgoingSlots = node->maxArgs > ARG_REG_NUM ? node->maxArgs - ARG_REG_NUM : 0;
+    frameInfo->localData = 0;
+    frameInfo->spillSlots = assignment->spillSlots;
+    bool isMain = strcmp(assignment->funcName, "main") == 0;
+    frameInfo->numGPRs2Save = isMain ? 0 : assignment->numCalleeSaved;
+    frameInfo->savedRegMask = isMain ? 0 : assignment->calleeSavedMask;
+    frameInfo->numReturnAdd = frameInfo->isLeaf ? 0 : 1;
+    int wordSize = frameInfo->numReturnAdd + frameInfo->outgoingSlots + frameInfo->spillSlots + frameInfo->numGPRs2Save;
+    if (wordSize % 2 != 0) wordSize++; // padding
+    frameInfo->wordSize = wordSize;
+}
+
+void allocateRegisters() {
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CallGraph* callGraph = buildCallGraph();
+    for (int i = 0; i < cfgNum; ++i) {
+        if (assignmentNum >= MAX_FUNCTIONS) {
+            fprintf(stderr, "Too many functions for register allocation.\n");
+            break;
+        }
+        RegAssignment* assignment = createRegAssignment(cfgs[i]);
+        findTailCalls(assignment, cfgs[i]);
+        Liveness* liveness = computeLiveness(cfgs[i]);
+        if (regAllocMode == REG_ALLOC_COLOR) {
+            colorGraph(assignment, cfgs[i], liveness);
+        } else {
+            linearScan(assignment, cfgs[i], liveness);
+        }
+        findCallerSaves(assignment, cfgs[i], liveness);
+        freeLiveness(liveness);
+        layoutSpillArea(assignment);
+        placeFrameSetup(assignment, cfgs[i]);
+        updateFrameInfo(assignment, &callGraph->nodes[findCallGraphNode(callGraph, cfgs[i]->funcName)]);
+        assignments[assignmentNum++] = assignment;
+    }
+    freeCallGraph(callGraph);
+    freeCFGs(cfgs, cfgNum);
+}
+
+static RegAssignment* findRegAssignment(const char* funcName) {
+    for (int i = 0; i < assignmentNum; ++i) {
+        if (strcmp(assignments[i]->funcName, funcName) == 0) {
+            return assignments[i];
+        }
+    }
+    return NULL;
+}
+
+/**************************************************************************/
+// 全局分配模式下的代码生成
+
+static int slotOffset(VarLocation* location) {
+    return WORD_LENGTH_BYTE * currentFrame->outgoingSlots + location->offset;
+}
+
+// 全局标量或全局数组，局部变量同名时优先局部变量
+static SymbolTableEntry* findGlobalVar(const char* operand) {
+    SymbolTableEntry* entry = findSymbol((char*)operand);
+    return entry != NULL && entry->isFunction == 0 ? entry : NULL;
+}
+
+// 取操作数的值：在寄存器中的变量直接返回其寄存器，否则加载到 scratch 中。常量 0 使用 zero
+static const char* useOperand(AsmContainer* asmContainer, const char* operand, const char* scratch) {
+    char buffer[100];
+    VarLocation* location = findVarLocation(currentAssignment, operand);
+    if (location != NULL) {
+        if (location->isLocalArray) {
+            snprintf(buffer, sizeof(buffer), "addi %s, sp, %d", scratch, slotOffset(location));
+            newAsm(asmContainer, buffer);
+            return scratch;
+        }
+        if (location->reg != -1) {
+            return all_regs[location->reg];
+        }
+        snprintf(buffer, sizeof(buffer), "%s %s, %d(sp)", getLoadOp(location->size), scratch, slotOffset(location));
+        emitLoad(asmContainer, buffer);
+        currentAssignment->spillLoads++;
+        return scratch;
+    }
+
+    SymbolTableEntry* global = isConstant(operand) ? NULL : findGlobalVar(operand);
+    if (global != NULL) {
+        if (global->isArray) {
+            snprintf(buffer, sizeof(buffer), "addi %s, zero, %s", scratch, operand);
+            newAsm(asmContainer, buffer);
+        } else {
+            snprintf(buffer, sizeof(buffer), "lw %s, %s(zero)", scratch, operand);
+            emitLoad(asmContainer, buffer);
+        }
+        return scratch;
+    }
+
+    // 常量：整数，字符常量也写成整数
+    if (!isConstant(operand)) {
+        fprintf(stderr, "Unknown operand %s in function %s\n", operand, funcName);
+        exit(1);
+    }
+    int value = (int)strtol(operand, NULL, 0);
+    if (value == 0) {
+        return "zero";
+    }
+    emitLoadImmediate(asmContainer, scratch, value);
+    return scratch;
+}
+
+// 操作数是常数时取出它的值
+static bool constantValue(const char* operand, int* value) {
+    if (findVarLocation(currentAssignment, operand) != NULL) return false;
+    if (!isConstant(operand)) return false;
+    *value = (int)strtol(operand, NULL, 0);
+    return true;
+}
+
+// 把操作数的值放到指定的寄存器中
+static void loadOperand(AsmContainer* asmContainer, const char* operand, const char* regX) {
+    const char* reg = useOperand(asmContainer, operand, regX);
+    if (strcmp(reg, regX) != 0) {
+        char buffer[100];
+        snprintf(buffer, sizeof(buffer), "mv %s, %s", regX, reg);
+        newAsm(asmContainer, buffer);
+    }
+}
+
+// 结果写到哪个寄存器：在寄存器中的变量直接写，否则先写到 scratch，再由 storeResult 写回内存
+static const char* resultReg(const char* res, const char* scratch) {
+    VarLocation* location = findVarLocation(currentAssignment, res);
+    if (location != NULL && location->reg != -1) {
+        return all_regs[location->reg];
+    }
+    return scratch;
+}
+
+static void storeResult(AsmContainer* asmContainer, const char* res, const char* reg) {
+    char buffer[100];
+    VarLocation* location = findVarLocation(currentAssignment, res);
+    if (location != NULL) {
+        if (location->reg == -1 && !location->isLocalArray) {
+            snprintf(buffer, sizeof(buffer), "%s %s, %d(sp)", getStoreOp(location->size), reg, slotOffset(location));
+            newAsm(asmContainer, buffer);
+            currentAssignment->spillStores++;
+        }
+        return;
+    }
+    if (findGlobalVar(res) != NULL) {
+        snprintf(buffer, sizeof(buffer), "sw %s, %s(zero)", reg, res);
+        newAsm(asmContainer, buffer);
+    }
+}
+
+// 乘除法：有常数操作数时尽量用移位和加减，否则调用运行时子程序，见 muldiv.c
+static void emitMulDiv(AsmContainer* asmContainer, TAC* tac) {
+    const char* regX = resultReg(tac->res, SCRATCH_REG1);
+    const char* var = tac->arg1;
+    int value;
+    bool constant = constantValue(tac->arg2, &value);
+    if (!constant && tac->op == TAC_MUL && constantValue(tac->arg1, &value)) {
+        var = tac->arg2;
+        constant = true;
+    }
+    if (constant) {
+        // 变量放在 x30 中，x31 留给转换后的指令序列
+        const char* regY = useOperand(asmContainer, var, SCRATCH_REG1);
+        if (!emitMulDivConst(asmContainer, tac->op, regX, regY, value)) {
+            // 展开比调用更长，只有乘法会这样，交换操作数不影响结果
+            const char* regZ = useOperand(asmContainer, var == tac->arg1 ? tac->arg2 : tac->arg1, SCRATCH_REG2);
+            emitMulDivCall(asmContainer, tac->op, regX, regY, regZ);
+        }
+        storeResult(asmContainer, tac->res, regX);
+        return;
+    }
+    const char* regY = useOperand(asmContainer, tac->arg1, SCRATCH_REG1);
+    const char* regZ = useOperand(asmContainer, tac->arg2, SCRATCH_REG2);
+    emitMulDivCall(asmContainer, tac->op, regX, regY, regZ);
+    storeResult(asmContainer, tac->res, regX);
+}
+
+static bool isArrayVar(const char* var) {
+    VarLocation* location = findVarLocation(currentAssignment, var);
+    if (location != NULL) {
+        return location->isLocalArray;
+    }
+    SymbolTableEntry* global = findGlobalVar(var);
+    return global != NULL && global->isArray;
+}
+
+// 计算 arr[idx] 的地址，把访存操作数（如 8(x31)）写入 memLoc。会用到两个临时寄存器
+static void emitElementAddress(AsmContainer* asmContainer, const char* arr, const char* idx, char* memLoc, size_t size) {
+    char buffer[100];
+    const char* regIdx = useOperand(asmContainer, idx, SCRATCH_REG2);
+    snprintf(buffer, sizeof(buffer), "sll %s, %s, 2", SCRATCH_REG2, regIdx);
+    newAsm(asmContainer, buffer);
+
+    VarLocation* location = findVarLocation(currentAssignment, arr);
+    if (location != NULL && location->isLocalArray) {
+        snprintf(buffer, sizeof(buffer), "add %s, %s, sp", SCRATCH_REG2, SCRATCH_REG2);
+        newAsm(asmContainer, buffer);
+        snprintf(memLoc, size, "%d(%s)", slotOffset(location), SCRATCH_REG2);
+    } else if (location != NULL) {
+        // 数组参数，变量的值是数组首地址
+        const char* regBase = useOperand(asmContainer, arr, SCRATCH_REG1);
+        snprintf(buffer, sizeof(buffer), "add %s, %s, %s", SCRATCH_REG2, SCRATCH_REG2, regBase);
+        newAsm(asmContainer, buffer);
+        snprintf(memLoc, size, "0(%s)", SCRATCH_REG2);
+    } else {
+        snprintf(memLoc, size, "%s(%s)", arr, SCRATCH_REG2);
+    }
+}
+
+// (&[], arr, idx, res)：res = arr 的首地址 + idx * 4
+static void emitElementPointer(AsmContainer* asmContainer, TAC* tac) {
+    char buffer[100];
+    const char* regX = resultReg(tac->res, SCRATCH_REG1);
+    const char* regIdx = useOperand(asmContainer, tac->arg2, SCRATCH_REG2);
+    snprintf(buffer, sizeof(buffer), "sll %s, %s, 2", SCRATCH_REG2, regIdx);
+    newAsm(asmContainer, buffer);
+
+    VarLocation* location = findVarLocation(currentAssignment, tac->arg1);
+    if (location != NULL && location->isLocalArray) {
+        snprintf(buffer, sizeof(buffer), "add %s, %s, sp", regX, SCRATCH_REG2);
+        newAsm(asmContainer, buffer);
+        snprintf(buffer, sizeof(buffer), "addi %s, %s, %d", regX, regX, slotOffset(location));
+    } else if (location != NULL) {
+        // 数组参数，变量的值是数组首地址
+        const char* regBase = useOperand(asmContainer, tac->arg1, SCRATCH_REG1);
+        snprintf(buffer, sizeof(buffer), "add %s, %s, %s", regX, SCRATCH_REG2, regBase);
+    } else {
+        snprintf(buffer, sizeof(buffer), "addi %s, %s, %s", regX, SCRATCH_REG2, tac->arg1);
+    }
+    newAsm(asmContainer, buffer);
+    storeResult(asmContainer, tac->res, regX);
+}
+
+// 函数入口：把参数从 a0-a3 或调用者的出栈参数区移到分配的位置
+static void moveParams(AsmContainer* asmContainer, const char* funcName) {
+    char buffer[100];
+    SymbolTableEntry* func = findSymbol((char*)funcName);
+    if (func == NULL) return;
+    for (int i = 0; i < func->paramNum; ++i) {
+        VarLocation* location = findVarLocation(currentAssignment, func->params[i]->id);
+        if (location == NULL || (location->reg == -1 && location->slot == -1)) continue; // 没有用到的参数
+        if (i < ARG_REG_NUM) {
+            if (location->reg != -1) {
+                snprintf(buffer, sizeof(buffer), "mv %s, a%d", all_regs[location->reg], i);
+            } else {
+                snprintf(buffer, sizeof(buffer), "%s a%d, %d(sp)", getStoreOp(location->size), i, slotOffset(location));
+                currentAssignment->spillStores++;
+            }
+            newAsm(asmContainer, buffer);
+        } else {
+            const char* regX = resultReg(location->var, SCRATCH_REG1);
+            snprintf(buffer, sizeof(buffer), "lw %s, %d(sp)", regX, WORD_LENGTH_BYTE * (currentFrame->wordSize + i - ARG_REG_NUM));
+            emitLoad(asmContainer, buffer);
+            storeResult(asmContainer, location->var, regX);
+        }
+    }
+}
+
+// 调用前后保存和恢复调用之后仍然需要的调用者保存寄存器，每个寄存器在保存区中有固定的字
+static void emitCallerSaves(AsmContainer* asmContainer, TAC* tac, bool save) {
+    unsigned int mask = 0;
+    for (int i = 0; i < currentAssignment->saveCallNum; ++i) {
+        if (currentAssignment->saveCalls[i] == tac) mask = currentAssignment->saveCallMasks[i];
+    }
+    char buffer[100];
+    int word = currentAssignment->callerSaveBase;
+    for (int i = 0; i < CALLER_SAVED_REG_NUM; ++i) {
+        if (!(currentAssignment->callerSaveMask & (1u << i))) continue;
+        if (mask & (1u << i)) {
+            snprintf(buffer, sizeof(buffer), "%s %s, %d(sp)", save ? "sw" : "lw", all_regs[callerSavedRegs[i]],
+                     WORD_LENGTH_BYTE * (currentFrame->outgoingSlots + word));
+            if (save) {
+                newAsm(asmContainer, buffer);
+                currentAssignment->callerSaves++;
+            } else {
+                emitLoad(asmContainer, buffer);
+            }
+        }
+        word++;
+    }
+}
+
+// 返回和尾调用时使用的栈帧：从保存点到不了的返回没有栈帧，直接 jr ra
+static StackFrameInfo* returnFrame(TAC* tac) {
+    static StackFrameInfo noFrame = { .isLeaf = true };
+    if (currentAssignment->saveBlock == -1) return &noFrame;
+    if (tac == NULL) return currentAssignment->bareEnd ? &noFrame : currentFrame;
+    for (int i = 0; i < currentAssignment->bareReturnNum; ++i) {
+        if (currentAssignment->bareReturns[i] == tac) return &noFrame;
+    }
+    return currentFrame;
+}
+
+static void emitCall(AsmContainer* asmContainer, TAC* tac) {
+    char buffer[100];
+    bool tailCall = isTailCall(currentAssignment, tac);
+    if (!tailCall) {
+        emitCallerSaves(asmContainer, tac, true);
+    }
+    // 先把多出的参数写到出栈参数区，再把前 8 个参数放到 a0-a7 中
+    for (int i = ARG_REG_NUM; i < pendingArgNum; ++i) {
+        const char* reg = useOperand(asmContainer, pendingArgs[i], SCRATCH_REG1);
+        snprintf(buffer, sizeof(buffer), "sw %s, %d(sp)", reg, WORD_LENGTH_BYTE * (i - ARG_REG_NUM));
+        newAsm(asmContainer, buffer);
+    }
+    for (int i = 0; i < pendingArgNum && i < ARG_REG_NUM; ++i) {
+        char argReg[4];
+        snprintf(argReg, sizeof(argReg), "a%d", i);
+        loadOperand(asmContainer, pendingArgs[i], argReg);
+    }
+    pendingArgNum = 0;
+
+    if (tailCall) {
+        // 调用之后没有要做的事，被调用者的返回值就是自己的返回值
+        emitTailCall(asmContainer, returnFrame(tac), tac->arg1);
+        afterTailCall = true;
+        return;
+    }
+    snprintf(buffer, sizeof(buffer), "jal %s", tac->arg1);
+    newAsm(asmContainer, buffer);
+    newAsm(asmContainer, "nop");
+    emitCallerSaves(asmContainer, tac, false);
+
+    if (tac->res != NULL && *tac->res != '\0') {
+        const char* regX = resultReg(tac->res, SCRATCH_REG1);
+        snprintf(buffer, sizeof(buffer), "mv %s, a0", regX);
+        newAsm(asmContainer, buffer);
+        storeResult(asmContainer, tac->res, regX);
+    }
+}
+
+static void emitLabel(AsmContainer* asmContainer, TAC* tac) {
+    char buffer[100];
+    if (strncmp(tac->arg1, "func_", 5) == 0) {
+        char* funcName = tac->arg1 + 5;
+        currentAssignment = findRegAssignment(funcName);
+        currentFrame = &stackFrameInfos[mapStackInfo(funcName)];
+        snprintf(buffer, sizeof(buffer), "%s:", funcName);
+        newAsm(asmContainer, buffer);
+        if (currentAssignment->saveBlock == 0) {
+            emitPrologue(asmContainer, currentFrame);
+        }
+        moveParams(asmContainer, funcName);
+    } else if (strcmp(tac->arg1, "end_func") == 0) {
+        // 没有 return 的函数在结尾返回
+        if (!lastWasReturn) {
+            emitEpilogue(asmContainer, returnFrame(NULL));
+        }
+        currentAssignment = NULL;
+    } else {
+        snprintf(buffer, sizeof(buffer), "%s:", tac->arg1);
+        newAsm(asmContainer, buffer);
+    }
+}
+
+void generateTACGlobal(AsmContainer* asmContainer, TAC* tac) {
+    // 数组元素的访存要放下指令名、寄存器和整个 memLoc
+    char buffer[128];
+    TACOpcode op = tac->op;
+    char* arg1 = tac->arg1;
+    char* arg2 = tac->arg2;
+    char* res = tac->res;
+    bool hasArg1 = arg1 != NULL && *arg1 != '\0';
+    bool hasArg2 = arg2 != NULL && *arg2 != '\0';
+    // 收缩包装的保存点在基本块开头的标号之后
+    bool atSavePoint = currentAssignment != NULL && currentAssignment->saveBlock > 0 && tac == currentAssignment->saveAt;
+    if (atSavePoint && op != TAC_LABEL) {
+        emitPrologue(asmContainer, currentFrame);
+    }
+
+    switch (op) {
+    case TAC_LABEL:
+        emitLabel(asmContainer, tac);
+        if (atSavePoint) {
+            emitPrologue(asmContainer, currentFrame);
+        }
+        break;
+    case TAC_ALLOC:
+    case TAC_ALLOC_GLOBAL:
+        // 位置在分配时已经确定
+        break;
+    case TAC_PARAM:
+        if (pendingArgNum >= MAX_CALL_ARGS) {
+            fprintf(stderr, "Too many arguments in a call.\n");
+            exit(1);
+        }
+        pendingArgs[pendingArgNum++] = arg1;
+        break;
+    case TAC_CALL:
+        emitCall(asmContainer, tac);
+        break;
+    case TAC_RETURN:
+        if (afterTailCall) {
+            // 尾调用已经返回
+            break;
+        }
+        if (res != NULL && *res != '\0') {
+            loadOperand(asmContainer, res, "a0");
+        }
+        emitEpilogue(asmContainer, returnFrame(tac));
+        break;
+    case TAC_GOTO:
+        snprintf(buffer, sizeof(buffer), "j %s", res);
+        newAsm(asmContainer, buffer);
+        newAsm(asmContainer, "nop"); // delay-slot
+        break;
+    case TAC_IF_GOTO:
+    case TAC_IF_FALSE_GOTO: {
+        const char* regY = useOperand(asmContainer, arg1, SCRATCH_REG1);
+        snprintf(buffer, sizeof(buffer), "%s %s, zero, %s", op == TAC_IF_GOTO ? "bne" : "beq", regY, res);
+        newAsm(asmContainer, buffer);
+        newAsm(asmContainer, "nop"); // delay-slot
+        break;
+    }
+    case TAC_IF_EQ: case TAC_IF_NE: case TAC_IF_LT: case TAC_IF_LE: case TAC_IF_GT: case TAC_IF_GE: {
+        const char* regY = useOperand(asmContainer, arg1, SCRATCH_REG1);
+        const char* regZ = useOperand(asmContainer, arg2, SCRATCH_REG2);
+        emitCompareBranch(asmContainer, op, regY, regZ, SCRATCH_REG1, res);
+        break;
+    }
+    case TAC_ASSIGN: {
+        if (isArrayVar(res)) {
+            // 数组初始化的赋值还没有按元素生成，忽略
+            return;
+        }
+        const char* regX = resultReg(res, SCRATCH_REG1);
+        if (strcmp(regX, SCRATCH_REG1) == 0) {
+            // 结果在内存中，直接写回源操作数所在的寄存器
+            regX = useOperand(asmContainer, arg1, SCRATCH_REG1);
+        } else {
+            loadOperand(asmContainer, arg1, regX);
+        }
+        storeResult(asmContainer, res, regX);
+        break;
+    }
+    case TAC_READ_ADDR:
+    case TAC_LOAD: {
+        const char* regY = useOperand(asmContainer, arg1, SCRATCH_REG2);
+        const char* regX = resultReg(res, SCRATCH_REG1);
+        snprintf(buffer, sizeof(buffer), "lw %s, 0(%s)", regX, regY);
+        emitLoad(asmContainer, buffer);
+        storeResult(asmContainer, res, regX);
+        break;
+    }
+    case TAC_WRITE_ADDR:
+    case TAC_STORE: {
+        const char* regY = useOperand(asmContainer, arg1, SCRATCH_REG1);
+        const char* regZ = useOperand(asmContainer, res, SCRATCH_REG2);
+        snprintf(buffer, sizeof(buffer), "sw %s, 0(%s)", regZ, regY);
+        newAsm(asmContainer, buffer);
+        break;
+    }
+    case TAC_LOAD_ELEM: {
+        char memLoc[100];
+        emitElementAddress(asmContainer, arg1, arg2, memLoc, sizeof(memLoc));
+        const char* regX = resultReg(res, SCRATCH_REG1);
+        snprintf(buffer, sizeof(buffer), "lw %s, %s", regX, memLoc);
+        emitLoad(asmContainer, buffer);
+        storeResult(asmContainer, res, regX);
+        break;
+    }
+    case TAC_ELEM_ADDR:
+        emitElementPointer(asmContainer, tac);
+        break;
+    case TAC_STORE_ELEM: {
+        char memLoc[100];
+        emitElementAddress(asmContainer, res, arg1, memLoc, sizeof(memLoc));
+        const char* regZ = useOperand(asmContainer, arg2, SCRATCH_REG1);
+        snprintf(buffer, sizeof(buffer), "sw %s, %s", regZ, memLoc);
+        newAsm(asmContainer, buffer);
+        break;
+    }
+    default:
+        if (hasArg1 && hasArg2 && isMulDivOp(op)) {
+            emitMulDiv(asmContainer, tac);
+        } else if (hasArg1 && hasArg2) {
+            const char* regY = useOperand(asmContainer, arg1, SCRATCH_REG1);
+            const char* regZ = useOperand(asmContainer, arg2, SCRATCH_REG2);
+            const char* regX = resultReg(res, SCRATCH_REG1);
+            emitBinaryOp(asmContainer, op, regX, regY, regZ);
+            storeResult(asmContainer, res, regX);
+        } else if (hasArg1 || hasArg2) {
+            // 一元运算，负号的操作数在 arg2 中
+            const char* regY = useOperand(asmContainer, hasArg1 ? arg1 : arg2, SCRATCH_REG1);
+            const char* regX = resultReg(res, SCRATCH_REG1);
+            emitUnaryOp(asmContainer, op, regX, regY);
+            storeResult(asmContainer, res, regX);
+        } else {
+            fprintf(stderr, "Unknown TAC: ");
+            writeTAC(stderr, tac);
+            fputc('\n', stderr);
+        }
+    }
+    lastWasReturn = op == TAC_RETURN || afterTailCall;
+    afterTailCall = afterTailCall && op == TAC_CALL;
+}
+
+void printRegAllocReport(FILE* output) {
+    fprintf(output, "[REGISTER ALLOCATION] %s\n", regAllocMode == REG_ALLOC_COLOR ? "graph coloring" : "linear scan");
+    for (int i = 0; i < assignmentNum; ++i) {
+        RegAssignment* assignment = assignments[i];
+        fprintf(output, "%s: %d variables, %d spilled, %d spill loads, %d spill stores, %d callee-saved registers, %d caller-saved registers saved around calls",
+                assignment->funcName, assignment->candidateNum, assignment->spillNum,
+                assignment->spillLoads, assignment->spillStores, assignment->numCalleeSaved, assignment->callerSaves);
+        if (regAllocMode == REG_ALLOC_COLOR) {
+            fprintf(output, ", %d moves coalesced", assignment->coalescedMoves);
+        }
+        fprintf(output, "\n");
+    }
+}
+
+void printFrameReport(FILE* output) {
+    fprintf(output, "[FRAMES]\n");
+    for (int i = 0; i < assignmentNum; ++i) {
+        RegAssignment* assignment = assignments[i];
+        StackFrameInfo* frameInfo = &stackFrameInfos[mapStackInfo(assignment->funcName)];
+        fprintf(output, "%s: %d bytes, %s, %d registers saved, %d tail calls, ", assignment->funcName,
+                WORD_LENGTH_BYTE * frameInfo->wordSize, frameInfo->isLeaf ? "leaf" : "non-leaf", frameInfo->numGPRs2Save,
+                assignment->tailCallNum);
+        if (assignment->saveBlock == -1) {
+            fprintf(output, "no frame\n");
+        } else if (assignment->saveBlock == 0) {
+            fprintf(output, "frame set up at entry\n");
+        } else if (assignment->saveLabel != NULL) {
+            fprintf(output, "frame set up at %s, %d bare returns\n", assignment->saveLabel,
+                    assignment->bareReturnNum + (assignment->bareEnd ? 1 : 0));
+        } else {
+            fprintf(output, "frame set up at block %d, %d bare returns\n", assignment->saveBlock,
+                    assignment->bareReturnNum + (assignment->bareEnd ? 1 : 0));
+        }
+    }
+}
+
+void freeRegAssignments() {
+    for (int i = 0; i < assignmentNum; ++i) {
+        free(assignments[i]->bareReturns);
+        free(assignments[i]->saveCalls);
+        free(assignments[i]->tailCalls);
+        free(assignments[i]->saveCallMasks);
+        free(assignments[i]->locations);
+        free(assignments[i]->locationTable);
+        free(assignments[i]);
+        assignments[i] = NULL;
+    }
+    assignmentNum = 0;
+}
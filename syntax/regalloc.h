@@ -0,0 +1,111 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "tac.h"
+#include "cfg.h"
+#include "liveness.h"
+#include "callgraph.h"
+#include "asm.h"
+
+/* 全局寄存器分配
+ * 默认的 REG_ALLOC_LOCAL 使用 asm.c 中的 allocateReg（龙书8.6），寄存器只在基本块内有效。
+ * 全局分配器按函数进行：函数中的每个临时变量、局部变量和参数在整个函数内固定在一个寄存器里，
+ * 或者被溢出到栈帧的溢出区。全局变量始终在内存中。
+ */
+typedef enum RegAllocMode {
+    REG_ALLOC_LOCAL,    // asm.c 中的逐语句分配
+    REG_ALLOC_LINEAR,   // 线性扫描（Poletto & Sarkar），见 linear_scan.c
+    REG_ALLOC_COLOR,    // 图着色和迭代合并（George & Appel），见 graph_color.c
+} RegAllocMode;
+
+extern RegAllocMode regAllocMode;
+
+// 变量在函数中的位置
+typedef struct VarLocation {
+    char* var;
+    int reg;              // 分配到的寄存器号 x%d，-1 表示不在寄存器中
+    int slot;             // 溢出位置的编号，-1 表示没有栈位置。合并的变量共用一个编号
+    int size;             // 在栈中占用的字节数，见 FrameSlot
+    int offset;           // 在溢出区中的字节偏移，分配结束后由 layoutSpillArea 计算
+    bool isLocalArray;    // 局部数组：只在溢出区，没有寄存器
+    bool isArrayParam;    // 数组参数：变量的值是数组首地址
+} VarLocation;
+
+// 一个函数的分配结果，两种全局分配器都产生这个结构
+typedef struct RegAssignment {
+    char* funcName;
+    VarLocation* locations;
+    int locationNum;
+    int locationCapacity;
+    int* locationTable;           // 变量名到 locations 下标的哈希表，见 findVarLocation()
+    unsigned int locationTableSize;
+    int slotNum;                  // 溢出位置的个数（溢出的变量和局部数组）
+    int spillSlots;               // 排列后溢出区的字数
+    unsigned int calleeSavedMask; // 用到的被调用者保存寄存器，第 i 位对应 calleeSavedRegs[i]
+    int numCalleeSaved;           // calleeSavedMask 中的寄存器个数
+    // 收缩包装（shrink-wrapping）：栈帧的分配和 ra、s 寄存器的保存放在 saveBlock 的开头，
+    // 它支配所有用到栈或 s 寄存器、以及含有调用的基本块，并且不在循环中
+    int saveBlock;                // 基本块编号，-1 表示什么都不需要保存，0 为函数入口
+    char* saveLabel;              // saveBlock 开头的标号，没有时为 NULL
+    TAC* saveAt;                  // saveBlock 的第一条四元式
+    TAC** bareReturns;            // 从 saveBlock 到不了的 return，返回时不恢复也不释放栈帧
+    int bareReturnNum;
+    bool bareEnd;                 // 没有 return 的函数结尾也到不了 saveBlock
+    // 放在调用者保存寄存器中、调用之后仍然活跃的变量，在 call 前后保存和恢复
+    TAC** saveCalls;              // 需要保存寄存器的 call
+    unsigned int* saveCallMasks;  // 对应的寄存器，第 i 位对应 callerSavedRegs[i]
+    int saveCallNum;
+    unsigned int callerSaveMask;  // saveCallMasks 的并集，每个寄存器在溢出区末尾有一个字
+    int callerSaveBase;           // 保存区在溢出区中的字偏移
+    // 尾调用：call 之后紧接着返回它的结果，或者函数结束。先释放栈帧再 j 到被调用者
+    TAC** tailCalls;
+    int tailCallNum;
+    // 统计信息
+    int candidateNum;             // 参与分配的变量个数
+    int spillNum;                 // 被溢出的变量个数
+    int spillLoads;               // 生成代码时产生的溢出加载指令条数
+    int spillStores;              // 生成代码时产生的溢出存储指令条数
+    int coalescedMoves;           // 图着色时合并掉的复制（=）个数
+    int callerSaves;              // 调用前保存调用者保存寄存器的指令条数
+} RegAssignment;
+
+// 可分配的寄存器，调用约定见 asm.h
+#define CALLER_SAVED_REG_NUM 5
+#define CALLEE_SAVED_REG_NUM 12
+extern const int callerSavedRegs[CALLER_SAVED_REG_NUM]; // t0-t4
+extern const int calleeSavedRegs[CALLEE_SAVED_REG_NUM]; // s0-s11
+// 溢出变量和常量的临时寄存器，不参与分配
+#define SCRATCH_REG1 "x30"
+#define SCRATCH_REG2 "x31"
+
+#define MAX_CALL_ARGS 32
+
+// 对所有函数进行全局寄存器分配，并更新 stackFrameInfos（需在 calcFrameInfo 之后调用）
+void allocateRegisters();
+// 全局分配模式下为一条四元式生成代码，由 generateASM 调用
+void generateTACGlobal(AsmContainer* asmContainer, TAC* tac);
+// 输出每个函数的溢出统计
+void printRegAllocReport(FILE* output);
+// 输出每个函数的栈帧大小和保存寄存器的位置
+void printFrameReport(FILE* output);
+void freeRegAssignments();
+
+// 登记函数的参数、局部变量和临时变量，位置都还没有分配
+RegAssignment* createRegAssignment(CFG* cfg);
+VarLocation* findVarLocation(RegAssignment* assignment, const char* var);
+// call 之后紧接着返回它的结果：释放栈帧后 j 到被调用者，不再返回到这里
+bool isTailCall(RegAssignment* assignment, TAC* tac);
+// 为溢出的变量分配一个溢出位置，返回其编号。字节偏移在分配结束后统一排列
+int allocateSpillSlot(RegAssignment* assignment, VarLocation* location);
+// 标记寄存器 reg 已被使用，用于计算需要保存的 s 寄存器
+void markRegisterUsed(RegAssignment* assignment, int reg);
+
+// 线性扫描，结果写入 assignment 中已登记的变量位置
+void linearScan(RegAssignment* assignment, CFG* cfg, Liveness* liveness);
+
+// 迭代合并的图着色，结果写入 assignment 中已登记的变量位置
+void colorGraph(RegAssignment* assignment, CFG* cfg, Liveness* liveness);
+
+#endif // REGALLOC_H
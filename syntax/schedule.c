@@ -0,0 +1,275 @@
+#include "schedule.h"
+#include <stdlib.h>
+#include <string.h>
+#include "instr.h"
+#include "symbol_table.h"
+
+// 一个函数中填充和没有填充的槽数
+typedef struct SlotStats {
+    int branchFilled;
+    int branchEmpty;
+    int loadFilled;
+    int loadEmpty;
+} SlotStats;
+
+// 正在收集的基本块，nop 不放入块中
+typedef struct Block {
+    Instr** instrs;         // 块内的指令，以分支结束时最后一条是分支
+    int num;
+    int capacity;
+    bool endsWithBranch;
+    Instr* slot;            // 分支之后原有的非 nop 指令，这个延迟槽不再填充
+} Block;
+
+static void addToBlock(Block* block, Instr* instr) {
+    if (block->num >= block->capacity) {
+        block->capacity = block->capacity == 0 ? 16 : block->capacity * 2;
+        block->instrs = (Instr**)realloc(block->instrs, block->capacity * sizeof(Instr*));
+        if (block->instrs == NULL) {
+            fprintf(stderr, "Failed to allocate memory for basic block\n");
+            exit(1);
+        }
+    }
+    block->instrs[block->num] = instr;
+    block->num++;
+}
+
+static bool usesReg(const Instr* instr, int reg) {
+    int uses[2];
+    int useNum = getInstrUses(instr, uses);
+    for (int i = 0; i < useNum; ++i) {
+        if (uses[i] == reg) return true;
+    }
+    return false;
+}
+
+// first 在 second 之前时，second 至少要晚几条指令执行，0 表示两者无关
+static int dependence(const Instr* first, const Instr* second) {
+    int def1 = getInstrDef(first);
+    int def2 = getInstrDef(second);
+    if (def1 != -1 && usesReg(second, def1)) {
+        return isLoadInstr(first) ? LOAD_DELAY + 1 : 1;
+    }
+    if (def2 != -1 && (usesReg(first, def2) || def1 == def2)) return 1;
+    if (isMemoryInstr(first) && isMemoryInstr(second) && (isStoreInstr(first) || isStoreInstr(second))) {
+        return 1;
+    }
+    return 0;
+}
+
+// 选一条可以移到分支之后的指令，没有时返回 -1
+static int chooseSlotFiller(Block* block, int* latency) {
+    int num = block->num;
+    int branch = num - 1;
+    for (int i = branch - 1; i >= 0; --i) {
+        if (isLoadInstr(block->instrs[i])) continue;
+        bool movable = dependence(block->instrs[i], block->instrs[branch]) == 0;
+        for (int j = i + 1; j < branch && movable; ++j) {
+            movable = latency[i * num + j] == 0;
+        }
+        if (movable) return i;
+    }
+    return -1;
+}
+
+// order 中的 NULL 为 nop
+static void countLoadSlots(Instr** order, int orderNum, SlotStats* stats) {
+    for (int p = 0; p < orderNum; ++p) {
+        if (order[p] == NULL || !isLoadInstr(order[p])) continue;
+        for (int k = p + 1; k <= p + LOAD_DELAY && k < orderNum; ++k) {
+            if (order[k] == NULL) {
+                stats->loadEmpty++;
+            } else {
+                stats->loadFilled++;
+            }
+        }
+    }
+}
+
+// 排列块内的指令并写入 output
+static void flushBlock(Block* block, AsmContainer* output, SlotStats* stats) {
+    int num = block->num;
+    if (num == 0) return;
+    int* latency = (int*)calloc(num * num, sizeof(int));
+    for (int i = 0; i < num; ++i) {
+        for (int j = i + 1; j < num; ++j) {
+            latency[i * num + j] = dependence(block->instrs[i], block->instrs[j]);
+        }
+    }
+    int branch = block->endsWithBranch ? num - 1 : -1;
+    int filler = -1;
+    if (branch != -1 && block->slot == NULL) {
+        filler = chooseSlotFiller(block, latency);
+    }
+    if (branch != -1) {
+        // 分支总是块内最后一条。延迟槽紧跟分支执行，槽中指令读的 lw 结果要求分支在 lw 之后至少 LOAD_DELAY 条
+        Instr* slot = filler != -1 ? block->instrs[filler] : block->slot;
+        for (int i = 0; i < branch; ++i) {
+            if (latency[i * num + branch] == 0) latency[i * num + branch] = 1;
+            if (slot != NULL && i != filler && isLoadInstr(block->instrs[i]) &&
+                usesReg(slot, getInstrDef(block->instrs[i])) && latency[i * num + branch] < LOAD_DELAY) {
+                latency[i * num + branch] = LOAD_DELAY;
+            }
+        }
+    }
+
+    // 到块末尾的最长路径，作为调度的优先级
+    int* height = (int*)calloc(num, sizeof(int));
+    for (int i = num - 1; i >= 0; --i) {
+        height[i] = 1;
+        for (int j = i + 1; j < num; ++j) {
+            if (latency[i * num + j] > 0 && j != filler && latency[i * num + j] + height[j] > height[i]) {
+                height[i] = latency[i * num + j] + height[j];
+            }
+        }
+    }
+
+    // 最坏情况下每条指令前后各有 LOAD_DELAY 个 nop
+    int maxOrder = num * (LOAD_DELAY + 1) + LOAD_DELAY + 2;
+    Instr** order = (Instr**)malloc(maxOrder * sizeof(Instr*));
+    int* position = (int*)malloc(num * sizeof(int));
+    bool* done = (bool*)calloc(num, sizeof(bool));
+    int orderNum = 0;
+    int remaining = num - (filler != -1 ? 1 : 0);
+    if (filler != -1) done[filler] = true;
+    while (remaining > 0) {
+        int best = -1;
+        for (int j = 0; j < num; ++j) {
+            if (done[j]) continue;
+            bool ready = true;
+            for (int i = 0; i < j && ready; ++i) {
+                int lat = latency[i * num + j];
+                if (lat == 0 || i == filler) continue;
+                ready = done[i] && position[i] + lat <= orderNum;
+            }
+            if (ready && (best == -1 || height[j] > height[best])) best = j;
+        }
+        if (best == -1) {
+            order[orderNum++] = NULL;
+            continue;
+        }
+        done[best] = true;
+        position[best] = orderNum;
+        order[orderNum++] = block->instrs[best];
+        remaining--;
+    }
+
+    if (branch != -1) {
+        Instr* slot = filler != -1 ? block->instrs[filler] : block->slot;
+        order[orderNum++] = slot;
+        if (slot != NULL) {
+            stats->branchFilled++;
+        } else {
+            stats->branchEmpty++;
+        }
+    } else {
+        // 直接落入下一个块时，块内的 lw 要在块结束前完成
+        int need = 0;
+        for (int p = 0; p < orderNum; ++p) {
+            if (order[p] != NULL && isLoadInstr(order[p]) && p + LOAD_DELAY + 1 > need) {
+                need = p + LOAD_DELAY + 1;
+            }
+        }
+        while (orderNum < need) {
+            order[orderNum++] = NULL;
+        }
+    }
+    countLoadSlots(order, orderNum, stats);
+    Instr nop = {INSTR_NOP, -1, -1, -1, 0, NULL};
+    for (int p = 0; p < orderNum; ++p) {
+        newInstr(output, order[p] != NULL ? order[p] : &nop);
+    }
+
+    free(order);
+    free(position);
+    free(done);
+    free(height);
+    free(latency);
+    block->num = 0;
+    block->endsWithBranch = false;
+    block->slot = NULL;
+}
+
+static bool isFunctionLabel(const char* label, Instr* instrs, unsigned int instrNum) {
+    SymbolTableEntry* entry = findSymbol((char*)label);
+    if (entry != NULL && entry->isFunction) return true;
+    // 运行时子程序不在符号表中，按被 jal 调用判断
+    for (unsigned int i = 0; i < instrNum; ++i) {
+        if (instrs[i].op == INSTR_JAL && instrs[i].symbol == label) return true;
+    }
+    return false;
+}
+
+static void printSlotStats(FILE* report, const char* funcName, SlotStats* stats) {
+    if (funcName == NULL) return;
+    fprintf(report, "%s: %d branch delay slots filled, %d unfilled; %d load delay slots filled, %d unfilled\n",
+            funcName, stats->branchFilled, stats->branchEmpty, stats->loadFilled, stats->loadEmpty);
+}
+
+void scheduleDelaySlots(AsmContainer* container, FILE* report) {
+    fprintf(report, "[SCHEDULING] delay slots\n");
+    // 指令按新的顺序写回 container，原来的指令先复制一份
+    unsigned int instrNum = container->size;
+    Instr* instrs = (Instr*)malloc((instrNum + 1) * sizeof(Instr));
+    if (instrs == NULL) {
+        fprintf(stderr, "Failed to allocate memory for scheduling\n");
+        exit(1);
+    }
+    memcpy(instrs, container->instrs, instrNum * sizeof(Instr));
+    container->size = 0;
+
+    Block block = {NULL, 0, 0, false, NULL};
+    SlotStats stats = {0, 0, 0, 0};
+    const char* funcName = NULL;
+    bool inText = false;
+    for (unsigned int i = 0; i < instrNum; ++i) {
+        Instr* instr = &instrs[i];
+        if (instr->op == INSTR_DIRECTIVE && (strncmp(instr->symbol, ".text", 5) == 0 || strncmp(instr->symbol, ".data", 5) == 0)) {
+            flushBlock(&block, container, &stats);
+            inText = strncmp(instr->symbol, ".text", 5) == 0;
+            newInstr(container, instr);
+            continue;
+        }
+        if (!inText) {
+            newInstr(container, instr);
+            continue;
+        }
+        switch (instr->op) {
+            case INSTR_NOP:
+                break;
+            case INSTR_LABEL:
+                flushBlock(&block, container, &stats);
+                if (isFunctionLabel(instr->symbol, instrs, instrNum)) {
+                    printSlotStats(report, funcName, &stats);
+                    funcName = instr->symbol;
+                    memset(&stats, 0, sizeof(stats));
+                }
+                newInstr(container, instr);
+                break;
+            case INSTR_DIRECTIVE:
+            case INSTR_UNKNOWN:
+                flushBlock(&block, container, &stats);
+                newInstr(container, instr);
+                break;
+            default:
+                addToBlock(&block, instr);
+                if (!hasDelaySlot(instr)) break;
+                block.endsWithBranch = true;
+                if (i + 1 < instrNum) {
+                    Instr* next = &instrs[i + 1];
+                    if (next->op == INSTR_NOP) {
+                        ++i;
+                    } else if (next->op < INSTR_NOP && !hasDelaySlot(next)) {
+                        block.slot = &instrs[++i];
+                    }
+                }
+                flushBlock(&block, container, &stats);
+                break;
+        }
+    }
+    flushBlock(&block, container, &stats);
+    printSlotStats(report, funcName, &stats);
+
+    free(block.instrs);
+    free(instrs);
+}
@@ -0,0 +1,18 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdio.h>
+#include "asm.h"
+
+/* 延迟槽填充
+ * generateASM 在每条分支和跳转之后放一个 nop，在一部分 lw 之后放两个 nop。全部代码发射之后，
+ * 这一遍在每个基本块内删掉这些 nop，按指令之间的依赖重新排列（表调度，关键路径长的指令优先）：
+ * - 块内一条与分支无关、之后也没有指令依赖它的指令移入分支的延迟槽，lw 不放入延迟槽。
+ *   槽中的指令读块内 lw 的结果时，分支至少排在这条 lw 之后 LOAD_DELAY 条
+ * - lw 之后的 LOAD_DELAY 条指令不读它的结果，这些位置用无关的指令填充
+ * 没有可以移动的指令时才放 nop。基本块从标号开始，到分支和它的延迟槽结束，指令不跨块移动。
+ * 每个函数填充和没有填充的槽数写入 report。
+ */
+void scheduleDelaySlots(AsmContainer* container, FILE* report);
+
+#endif // SCHEDULE_H
@@ -1,4 +1,7 @@
 #include "tac.h"
+#include "arena.h"
+#include <string.h>
+#include <ctype.h>
 
 int tempCnt = 0;
 int labelCnt = 0;
@@ -6,27 +9,26 @@ struct TACList* tacHead = NULL;
 struct TACList* tacTail = NULL;
 
 char* generateTemp() {
-    char* tempVar = (char*)malloc(6 * sizeof(char));
-    sprintf(tempVar, "t%d", tempCnt++);
-    return tempVar;
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "t%d", tempCnt++);
+    return arenaStrdup(&irArena, buffer);
 }
 
-TAC* createTAC(char* op, char* arg1, char* arg2, char* res) {
-    TAC* tac = (TAC*)malloc(sizeof(TAC));
+TAC* createTAC(TACOpcode op, char* arg1, char* arg2, char* res) {
+    TAC* tac = (TAC*)arenaAlloc(&irArena, sizeof(TAC));
     tac->op = op;
     tac->arg1 = arg1;
     tac->arg2 = arg2;
     tac->res = res;
     tac->index = 0;
+    tac->arg1NextUse = 0;
+    tac->arg2NextUse = 0;
+    tac->resNextUse = 0;
     return tac;
 }
 
-void deleteTAC(TAC* tac) {
-    free(tac);
-}
-
 void appendTAC(TAC* tac) {
-    TACList* newNode = (TACList*)malloc(sizeof(TACList));
+    TACList* newNode = (TACList*)arenaAlloc(&irArena, sizeof(TACList));
     newNode->tac = tac;
     newNode->next = NULL;
     
@@ -38,25 +40,78 @@ void appendTAC(TAC* tac) {
     tacTail = newNode;
 }
 
+TACList* insertTACAfter(TACList* pos, TAC* tac) {
+    TACList* newNode = (TACList*)arenaAlloc(&irArena, sizeof(TACList));
+    newNode->tac = tac;
+    newNode->next = pos->next;
+    pos->next = newNode;
+    if (tacTail == pos) {
+        tacTail = newNode;
+    }
+    return newNode;
+}
+
+void removeTAC(TACList* prev, TACList* node) {
+    if (prev == NULL) {
+        tacHead = node->next;
+    } else {
+        prev->next = node->next;
+    }
+    if (tacTail == node) {
+        tacTail = prev;
+    }
+}
+
 void printTAC() {
     TACList* temp = tacHead;
     while (temp) {
-        printf("%d: (%s,%s,%s,%s)\n", temp->tac->index, temp->tac->op, temp->tac->arg1, temp->tac->arg2, temp->tac->res);
+        printf("%d: ", temp->tac->index);
+        writeTAC(stdout, temp->tac);
+        putchar('\n');
         temp = temp->next;
     }
 }
 
-char* charToString(char c) {
-    char* res = (char*)malloc(2*sizeof(char));
-    res[0] = c;
-    res[1] = '\0';
-    return res;
+static const char* tacOpNames[TAC_OP_NUM] = {
+    [TAC_LABEL] = "label", [TAC_GOTO] = "goto", [TAC_IF_GOTO] = "ifGoto", [TAC_IF_FALSE_GOTO] = "ifFalseGoto",
+    [TAC_IF_EQ] = "if==", [TAC_IF_NE] = "if!=", [TAC_IF_LT] = "if<",
+    [TAC_IF_LE] = "if<=", [TAC_IF_GT] = "if>", [TAC_IF_GE] = "if>=",
+    [TAC_PARAM] = "param", [TAC_CALL] = "call", [TAC_RETURN] = "return",
+    [TAC_ALLOC] = "alloc", [TAC_ALLOC_GLOBAL] = "alloc_global", [TAC_ASSIGN] = "=",
+    [TAC_ADD] = "+", [TAC_SUB] = "-", [TAC_MUL] = "*", [TAC_DIV] = "/", [TAC_MOD] = "%",
+    [TAC_SHL] = "<<", [TAC_SHR] = ">>", [TAC_BIT_AND] = "&", [TAC_BIT_OR] = "|", [TAC_BIT_XOR] = "^",
+    [TAC_BIT_NOT] = "~", [TAC_NOT] = "!", [TAC_AND] = "&&", [TAC_OR] = "||",
+    [TAC_EQ] = "==", [TAC_NE] = "!=", [TAC_LT] = "<", [TAC_LE] = "<=", [TAC_GT] = ">", [TAC_GE] = ">=",
+    [TAC_READ_ADDR] = "=$", [TAC_WRITE_ADDR] = "$=", [TAC_LOAD_ELEM] = "=[]", [TAC_STORE_ELEM] = "[]=",
+    [TAC_ELEM_ADDR] = "&[]", [TAC_LOAD] = "=*", [TAC_STORE] = "*=",
+};
+
+const char* getTACOpName(TACOpcode op) {
+    return op >= 0 && op < TAC_OP_NUM ? tacOpNames[op] : "?";
+}
+
+void writeTAC(FILE* output, const TAC* tac) {
+    fprintf(output, "(%s,%s,%s,%s)", getTACOpName(tac->op), tac->arg1 ? tac->arg1 : "",
+            tac->arg2 ? tac->arg2 : "", tac->res ? tac->res : "");
+}
+
+void writeTACList(FILE* output) {
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        writeTAC(output, cur->tac);
+        fputc('\n', output);
+    }
 }
 
 char* generateLabel() {
-    char* tempLabel = (char*)malloc(10 * sizeof(char));
-    sprintf(tempLabel, "label%d", labelCnt++);
-    return tempLabel;
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "label%d", labelCnt++);
+    return arenaStrdup(&irArena, buffer);
+}
+
+char* intToString(int value) {
+    char buffer[12];
+    snprintf(buffer, sizeof(buffer), "%d", value);
+    return arenaStrdup(&irArena, buffer);
 }
 
 int countDigits(int num) {
@@ -85,3 +140,64 @@ int generateIndex() {
     }
     return num;
 }
+
+int getTACRoles(TAC* tac) {
+    switch (tac->op) {
+    case TAC_LABEL: case TAC_GOTO: case TAC_ALLOC: case TAC_ALLOC_GLOBAL:
+        return 0;
+    case TAC_IF_GOTO: case TAC_IF_FALSE_GOTO: case TAC_PARAM:
+        return TAC_USE_ARG1;
+    case TAC_IF_EQ: case TAC_IF_NE: case TAC_IF_LT: case TAC_IF_LE: case TAC_IF_GT: case TAC_IF_GE:
+        return TAC_USE_ARG1 | TAC_USE_ARG2;
+    case TAC_CALL:
+        // arg1 is the name of the function
+        return TAC_DEF_RES;
+    case TAC_RETURN:
+        return TAC_USE_RES;
+    case TAC_WRITE_ADDR: case TAC_STORE: case TAC_STORE_ELEM:
+        // ($=, addr, , val), (*=, addr, , val) and ([]=, index, val, arr) write memory, not a variable
+        return TAC_USE_ARG1 | TAC_USE_ARG2 | TAC_USE_RES;
+    default:
+        // arithmetic, logical, =, =$, =[], &[] and =*
+        return TAC_USE_ARG1 | TAC_USE_ARG2 | TAC_DEF_RES;
+    }
+}
+
+void getTACVarOperands(TAC* tac, char* out[3]) {
+    int roles = getTACRoles(tac);
+    out[0] = (roles & TAC_USE_ARG1) && isVariable(tac->arg1) ? tac->arg1 : NULL;
+    out[1] = (roles & TAC_USE_ARG2) && isVariable(tac->arg2) ? tac->arg2 : NULL;
+    out[2] = (roles & (TAC_USE_RES | TAC_DEF_RES)) && isVariable(tac->res) ? tac->res : NULL;
+}
+
+int isVariable(char* operand) {
+    if (operand == NULL || *operand == '\0') return 0;
+    // constants are integers printed by intToString (char constants too) and string literals keep their quotes
+    return !(isdigit((unsigned char)operand[0]) || operand[0] == '-' || operand[0] == '"');
+}
+
+int isConstant(const char* operand) {
+    return operand != NULL && (isdigit((unsigned char)operand[0]) ||
+                               (operand[0] == '-' && isdigit((unsigned char)operand[1])));
+}
+
+int isTemp(char* operand) {
+    if (operand == NULL || operand[0] != 't' || operand[1] == '\0') return 0;
+    for (char* p = operand + 1; *p != '\0'; ++p) {
+        if (!isdigit((unsigned char)*p)) return 0;
+    }
+    return 1;
+}
+
+int startsBlock(TAC* tac) {
+    return tac->op == TAC_LABEL;
+}
+
+int endsBlock(TAC* tac) {
+    return tac->op == TAC_GOTO || tac->op == TAC_IF_GOTO || tac->op == TAC_IF_FALSE_GOTO ||
+           tac->op == TAC_CALL || tac->op == TAC_RETURN || isCompareBranch(tac);
+}
+
+int isCompareBranch(TAC* tac) {
+    return tac->op >= TAC_IF_EQ && tac->op <= TAC_IF_GE;
+}
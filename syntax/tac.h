@@ -4,13 +4,48 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// operators of the TAC, see docs/quaternary.md. getTACOpName() returns the form written to the .ir file
+typedef enum TACOpcode {
+    TAC_LABEL,          // label
+    TAC_GOTO,           // goto
+    TAC_IF_GOTO,        // ifGoto
+    TAC_IF_FALSE_GOTO,  // ifFalseGoto
+    // fused compare-and-branch: if==, if!=, if<, if<=, if>, if>=
+    TAC_IF_EQ, TAC_IF_NE, TAC_IF_LT, TAC_IF_LE, TAC_IF_GT, TAC_IF_GE,
+    TAC_PARAM,          // param
+    TAC_CALL,           // call
+    TAC_RETURN,         // return
+    TAC_ALLOC,          // alloc
+    TAC_ALLOC_GLOBAL,   // alloc_global
+    TAC_ASSIGN,         // =
+    TAC_ADD, TAC_SUB, TAC_MUL, TAC_DIV, TAC_MOD,    // + - * / %, + and - are also unary
+    TAC_SHL, TAC_SHR,                               // << >>
+    TAC_BIT_AND, TAC_BIT_OR, TAC_BIT_XOR,           // & | ^
+    TAC_BIT_NOT, TAC_NOT,                           // ~ !
+    TAC_AND, TAC_OR,                                // && ||
+    TAC_EQ, TAC_NE, TAC_LT, TAC_LE, TAC_GT, TAC_GE, // == != < <= > >=
+    TAC_READ_ADDR,      // =$
+    TAC_WRITE_ADDR,     // $=
+    TAC_LOAD_ELEM,      // =[]
+    TAC_STORE_ELEM,     // []=
+    TAC_ELEM_ADDR,      // &[]
+    TAC_LOAD,           // =*
+    TAC_STORE,          // *=
+    TAC_OP_NUM,
+} TACOpcode;
+
 typedef struct TAC {
-    char* op;
+    TACOpcode op;
     char* arg1;
     char* arg2;
     char* res;
     // we currently assign the index after genereting ALL the intermediate code
     int index;
+    // next-use info of arg1/arg2/res inside the basic block, filled by computeNextUse().
+    // see liveness.h for the meaning of the values.
+    int arg1NextUse;
+    int arg2NextUse;
+    int resNextUse;
 } TAC;
 
 typedef struct TACList {
@@ -18,25 +53,75 @@ typedef struct TACList {
     struct TACList* next;
 } TACList;
 
+/* TACs, list nodes and the strings made by generateTemp(), generateLabel() and
+ * intToString() are allocated from irArena (see arena.h) and released together with it.
+ */
 char* generateTemp();
 
-TAC* createTAC(char* op, char* arg1, char* arg2, char* res);
-
-void deleteTAC(TAC* tac);
+TAC* createTAC(TACOpcode op, char* arg1, char* arg2, char* res);
 
 void appendTAC(TAC* tac);
 
+// insert tac into the global list after pos and return the new node
+TACList* insertTACAfter(TACList* pos, TAC* tac);
+
+// unlink node from the global list. prev is the node before it (NULL for tacHead)
+void removeTAC(TACList* prev, TACList* node);
+
 void printTAC();
 
-char* charToString(char c);
+// the operator as written in the .ir file and docs/quaternary.md
+const char* getTACOpName(TACOpcode op);
+
+// write tac as (op,arg1,arg2,res), empty operands are left empty. operands are written as they
+// are, however long
+void writeTAC(FILE* output, const TAC* tac);
+
+// write the [CODE] section of the .ir file, one TAC per line
+void writeTACList(FILE* output);
+
 
 char* generateLabel();
 
+// returns a new string holding value in decimal, the form the parser uses for int constants
+char* intToString(int value);
+
 // returns the number of TACs
 int generateIndex();
 
 int countDigits(int num);
 
+// roles of the operands of a TAC (see docs/quaternary.md)
+#define TAC_USE_ARG1 0x1
+#define TAC_USE_ARG2 0x2
+#define TAC_USE_RES 0x4
+#define TAC_DEF_RES 0x8
+
+// returns which operands of the tac are read and which one is written
+int getTACRoles(TAC* tac);
+
+// fill out[] with arg1/arg2/res if the operand is a variable read or written by the tac, NULL otherwise
+void getTACVarOperands(TAC* tac, char* out[3]);
+
+// returns 1 if the operand names a variable (temp or identifier), 0 for constants and empty operands
+int isVariable(char* operand);
+
+// returns 1 if the operand is an integer constant. char constants are written as their value, so
+// this covers them too
+int isConstant(const char* operand);
+
+// returns 1 if the operand is a temp generated by generateTemp()
+int isTemp(char* operand);
+
+// returns 1 if the tac starts a basic block (label)
+int startsBlock(TAC* tac);
+
+// returns 1 if the tac ends a basic block (jumps, call and return)
+int endsBlock(TAC* tac);
+
+// returns 1 for the fused compare-and-branch TACs (if==, if<, ..., a, b, label)
+int isCompareBranch(TAC* tac);
+
 extern int tempCnt;
 extern int labelCnt;
 extern struct TACList* tacHead;
@@ -0,0 +1,69 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+#include "symbol_table.h"
+
+/* self tail calls to jumps.
+ * a call of the function itself followed by the return of its result (or by the end of the
+ * function) is replaced with an assignment of the arguments to the parameters and a jump to a
+ * new label at the start of the function:
+ *   (param, a1) ... (param, an) (call, f, , t) (return, , , t)
+ * becomes
+ *   (=, a1, , t1') ... (=, an, , tn') (=, t1', , p1) ... (=, tn', , pn) (goto, , , entry)
+ * the arguments go through new temps first, since they may read the parameters. the return
+ * left behind is unreachable and removed by dead code elimination. the recursion becomes a loop
+ * that the later passes optimize like any other. tail calls of other functions are handled by
+ * the code generator, which releases the frame before jumping to the callee (see regalloc.c).
+ */
+static bool isEndLabel(TAC* tac) {
+    return tac->op == TAC_LABEL && strcmp(tac->arg1, "end_func") == 0;
+}
+
+void eliminateSelfTailCalls(CFG* cfg, FILE* report) {
+    SymbolTableEntry* func = findSymbol(cfg->funcName);
+    int paramNum = func == NULL ? 0 : func->paramNum;
+    TAC** params = (TAC**)malloc((paramNum + 1) * sizeof(TAC*));
+    char* entry = NULL;
+    int replaced = 0;
+    int argNum = 0;
+    TACList* prev = cfg->funcLabel;
+    for (TACList* cur = prev->next; cur != NULL && !isEndLabel(cur->tac); prev = cur, cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_PARAM) {
+            if (argNum < paramNum) params[argNum] = tac;
+            argNum++;
+            continue;
+        }
+        if (tac->op != TAC_CALL) continue;
+        int args = argNum;
+        argNum = 0;
+        TAC* next = cur->next->tac;
+        bool returnsResult = next->op == TAC_RETURN &&
+            (next->res == NULL || *next->res == '\0' || (tac->res != NULL && strcmp(next->res, tac->res) == 0));
+        if (func == NULL || strcmp(tac->arg1, cfg->funcName) != 0 || args != paramNum) continue;
+        if (!returnsResult && !isEndLabel(next)) continue;
+
+        if (entry == NULL) {
+            entry = generateLabel();
+            TACList* label = insertTACAfter(cfg->funcLabel, createTAC(TAC_LABEL, entry, NULL, NULL));
+            if (prev == cfg->funcLabel) prev = label;
+        }
+        char** temps = (char**)malloc((paramNum + 1) * sizeof(char*));
+        for (int i = 0; i < paramNum; ++i) {
+            temps[i] = generateTemp();
+            params[i]->op = TAC_ASSIGN;
+            params[i]->res = temps[i];
+        }
+        TACList* pos = cur;
+        for (int i = 0; i < paramNum; ++i) {
+            pos = insertTACAfter(pos, createTAC(TAC_ASSIGN, temps[i], NULL, func->params[i]->id));
+        }
+        pos = insertTACAfter(pos, createTAC(TAC_GOTO, NULL, NULL, entry));
+        removeTAC(prev, cur);
+        cur = pos;
+        free(temps);
+        replaced++;
+    }
+    free(params);
+    fprintf(report, "%s: %d self tail calls turned into jumps\n", cfg->funcName, replaced);
+}
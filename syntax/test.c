@@ -1,5 +1,19 @@
 #include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "symbol_table.h"
+#include "tac.h"
+#include "cfg.h"
+#include "callgraph.h"
+#include "schedule.h"
+#include "opt.h"
+#include "regalloc.h"
+#include "muldiv.h"
+#include "peephole.h"
+#include "encode.h"
+
+extern FILE* yyin;
+extern int yyparse();
 
 void testCreateAndDestroySymbolTable() {
     SymbolTable* symbolTable = createSymbolTable();
@@ -168,6 +182,1087 @@ void testCreateConstSymbol() {
     assert(constEntry->constValue.intVal == 5);
 }
 
+void testBuildCFG() {
+    // while (i < 15) { i = i + 1; } return i;
+    appendTAC(createTAC(TAC_LABEL, "func_loop", NULL, NULL));
+    appendTAC(createTAC(TAC_LABEL, "label0", NULL, NULL));
+    appendTAC(createTAC(TAC_LT, "i", "15", "t0"));
+    appendTAC(createTAC(TAC_IF_GOTO, "t0", NULL, "label1"));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label2"));
+    appendTAC(createTAC(TAC_LABEL, "label1", NULL, NULL));
+    appendTAC(createTAC(TAC_ADD, "i", "1", "i"));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label0"));
+    appendTAC(createTAC(TAC_LABEL, "label2", NULL, NULL));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "i"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    assert(cfgNum == 1);
+    CFG* cfg = cfgs[0];
+    assert(strcmp(cfg->funcName, "loop") == 0);
+    assert(cfg->blockNum == 4);
+    BasicBlock* cond = findBlockByLabel(cfg, "label0");
+    BasicBlock* body = findBlockByLabel(cfg, "label1");
+    BasicBlock* exit = findBlockByLabel(cfg, "label2");
+    assert(cond == cfg->blocks[0] && cond->tacNum == 3);
+    assert(cond->succNum == 2 && cond->succs[0] == body && cond->succs[1] == cfg->blocks[1]);
+    assert(cfg->blocks[1]->succNum == 1 && cfg->blocks[1]->succs[0] == exit);
+    assert(body->succNum == 1 && body->succs[0] == cond);
+    assert(cond->predNum == 1 && cond->preds[0] == body);
+    assert(exit->succNum == 1 && exit->succs[0] == cfg->exit);
+    freeCFGs(cfgs, cfgNum);
+}
+
+void testDominators() {
+    // if (c) { a = 1; } else { a = 2; } while (a < 5) { a = a + 1; } return a;
+    appendTAC(createTAC(TAC_LABEL, "func_dom", NULL, NULL));
+    appendTAC(createTAC(TAC_IF_GOTO, "c", NULL, "label3"));
+    appendTAC(createTAC(TAC_ASSIGN, "2", NULL, "a"));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label4"));
+    appendTAC(createTAC(TAC_LABEL, "label3", NULL, NULL));
+    appendTAC(createTAC(TAC_ASSIGN, "1", NULL, "a"));
+    appendTAC(createTAC(TAC_LABEL, "label4", NULL, NULL));
+    appendTAC(createTAC(TAC_LT, "a", "5", "t1"));
+    appendTAC(createTAC(TAC_IF_FALSE_GOTO, "t1", NULL, "label5"));
+    appendTAC(createTAC(TAC_ADD, "a", "1", "a"));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label4"));
+    appendTAC(createTAC(TAC_LABEL, "label5", NULL, NULL));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "a"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CFG* cfg = cfgs[cfgNum - 1];
+    assert(strcmp(cfg->funcName, "dom") == 0);
+    int* idom = computeDominators(cfg);
+    BasicBlock* thenBlock = findBlockByLabel(cfg, "label3");
+    BasicBlock* cond = findBlockByLabel(cfg, "label4");
+    BasicBlock* body = cfg->blocks[cond->id + 1];
+    BasicBlock* exit = findBlockByLabel(cfg, "label5");
+    assert(idom[0] == -1);
+    assert(idom[1] == 0 && idom[thenBlock->id] == 0);
+    // the join point is dominated by the entry only
+    assert(idom[cond->id] == 0);
+    assert(idom[body->id] == cond->id && idom[exit->id] == cond->id);
+    assert(dominates(idom, cond->id, body->id) && !dominates(idom, thenBlock->id, cond->id));
+    // the while loop: body -> cond is the only back edge
+    int loopNum = 0;
+    Loop* loops = findLoops(cfg, idom, &loopNum);
+    assert(loopNum == 1 && loops[0].header == cond->id && loops[0].blockNum == 2);
+    assert(loops[0].body[body->id] && !loops[0].body[exit->id] && !loops[0].body[thenBlock->id]);
+    freeLoops(loops, loopNum);
+    free(idom);
+    freeCFGs(cfgs, cfgNum);
+}
+
+void testCallGraph() {
+    // int callee(int x, int y) { return x; } int caller() { return callee(1, 2) + callee(3, 4); }
+    appendTAC(createTAC(TAC_LABEL, "func_callee", NULL, NULL));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "x"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    appendTAC(createTAC(TAC_LABEL, "func_caller", NULL, NULL));
+    appendTAC(createTAC(TAC_PARAM, "1", NULL, NULL));
+    appendTAC(createTAC(TAC_PARAM, "2", NULL, NULL));
+    appendTAC(createTAC(TAC_CALL, "callee", NULL, "t2"));
+    appendTAC(createTAC(TAC_PARAM, "3", NULL, NULL));
+    appendTAC(createTAC(TAC_PARAM, "4", NULL, NULL));
+    appendTAC(createTAC(TAC_CALL, "callee", NULL, "t3"));
+    appendTAC(createTAC(TAC_ADD, "t2", "t3", "t4"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t4"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    CallGraph* graph = buildCallGraph();
+    int callee = findCallGraphNode(graph, "callee");
+    int caller = findCallGraphNode(graph, "caller");
+    assert(callee != -1 && caller != -1 && findCallGraphNode(graph, "missing") == -1);
+    assert(graph->nodes[callee].isLeaf && graph->nodes[callee].calleeNum == 0);
+    // two call sites, one edge
+    assert(!graph->nodes[caller].isLeaf && graph->nodes[caller].callSiteNum == 2);
+    assert(graph->nodes[caller].calleeNum == 1 && graph->nodes[caller].callees[0] == callee);
+    assert(graph->nodes[caller].maxArgs == 2);
+    freeCallGraph(graph);
+}
+
+void testInlineHiddenGlobal() {
+    // int g; int get() { return g; } int hide() { int g; g = 5; return g + get(); } int other() { return get(); }
+    char* names[] = {"g", "get", "hide", "other"};
+    for (int i = 0; i < 4; ++i) {
+        insertSymbol(scopeStack[0], createSymbolTableEntry(names[i], "int", 4, 1, 0, i != 0, 1, 0, 0, NULL));
+    }
+    appendTAC(createTAC(TAC_LABEL, "func_get", NULL, NULL));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "g"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    appendTAC(createTAC(TAC_LABEL, "func_hide", NULL, NULL));
+    appendTAC(createTAC(TAC_ALLOC, "INT", "4", "g"));
+    appendTAC(createTAC(TAC_ASSIGN, "5", NULL, "g"));
+    appendTAC(createTAC(TAC_CALL, "get", NULL, "t5"));
+    appendTAC(createTAC(TAC_ADD, "g", "t5", "t6"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t6"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    appendTAC(createTAC(TAC_LABEL, "func_other", NULL, NULL));
+    appendTAC(createTAC(TAC_CALL, "get", NULL, "t7"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t7"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    FILE* report = tmpfile();
+    inlineCalls(report);
+    fclose(report);
+    // the local g of hide would replace the global g in the copy of get, so the call stays
+    int hideCalls = 0, otherCalls = 0;
+    char* func = NULL;
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_LABEL && strncmp(tac->arg1, "func_", 5) == 0) func = tac->arg1 + 5;
+        if (tac->op != TAC_CALL || strcmp(tac->arg1, "get") != 0) continue;
+        if (strcmp(func, "hide") == 0) hideCalls++;
+        if (strcmp(func, "other") == 0) otherCalls++;
+    }
+    assert(hideCalls == 1 && otherCalls == 0);
+}
+
+// no instruction in the LOAD_DELAY slots after a load reads its result
+static void assertNoLoadUse(AsmContainer* container) {
+    for (unsigned int i = 0; i < container->size; ++i) {
+        Instr* load = &container->instrs[i];
+        if (!isLoadInstr(load)) continue;
+        for (unsigned int k = i + 1; k <= i + LOAD_DELAY && k < container->size; ++k) {
+            int uses[2];
+            int useNum = getInstrUses(&container->instrs[k], uses);
+            for (int u = 0; u < useNum; ++u) {
+                assert(uses[u] != load->rd);
+            }
+        }
+    }
+}
+
+void testDelaySlotAfterLoad() {
+    AsmContainer container;
+    initAsmContainer(&container);
+    newAsm(&container, ".text");
+    // the add is moved into the branch delay slot, one instruction after the beq
+    newAsm(&container, "label13:");
+    newAsm(&container, "lw x28, 0(x28)");
+    newAsm(&container, "add x6, x6, x28");
+    newAsm(&container, "beq x30, zero, label14");
+    newAsm(&container, "nop");
+    // the mv already is in the delay slot of the jal
+    newAsm(&container, "label14:");
+    newAsm(&container, "lw x5, 0(x5)");
+    newAsm(&container, "jal f0");
+    newAsm(&container, "mv a0, x5");
+    newAsm(&container, "jr ra");
+    newAsm(&container, "nop");
+    FILE* report = tmpfile();
+    scheduleDelaySlots(&container, report);
+    fclose(report);
+    assertNoLoadUse(&container);
+    // both slots stay filled
+    assert(container.instrs[container.size - 4].op == INSTR_JAL && container.instrs[container.size - 3].op == INSTR_MV);
+    int beq = 0;
+    while (container.instrs[beq].op != INSTR_BEQ) ++beq;
+    assert(container.instrs[beq + 1].op == INSTR_ADD);
+    freeAsmContainer(&container);
+}
+
+void testColorArgAcrossBlocks() {
+    // return f(t8, v || w); the second argument is computed after the first param, in its own blocks
+    appendTAC(createTAC(TAC_LABEL, "func_scarg", NULL, NULL));
+    appendTAC(createTAC(TAC_ADD, "v", "1", "t8"));
+    appendTAC(createTAC(TAC_PARAM, "t8", NULL, NULL));
+    appendTAC(createTAC(TAC_IF_GOTO, "v", NULL, "label6"));
+    appendTAC(createTAC(TAC_ASSIGN, "w", NULL, "t9"));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label7"));
+    appendTAC(createTAC(TAC_LABEL, "label6", NULL, NULL));
+    appendTAC(createTAC(TAC_ASSIGN, "1", NULL, "t9"));
+    appendTAC(createTAC(TAC_LABEL, "label7", NULL, NULL));
+    appendTAC(createTAC(TAC_PARAM, "t9", NULL, NULL));
+    appendTAC(createTAC(TAC_CALL, "f", NULL, "t10"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t10"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CFG* cfg = cfgs[cfgNum - 1];
+    assert(strcmp(cfg->funcName, "scarg") == 0 && cfg->blockNum == 5);
+    RegAssignment* assignment = createRegAssignment(cfg);
+    Liveness* liveness = computeLiveness(cfg);
+    colorGraph(assignment, cfg, liveness);
+    // t8 is passed at the call, so it is still live where t9 is defined
+    VarLocation* first = findVarLocation(assignment, "t8");
+    VarLocation* second = findVarLocation(assignment, "t9");
+    assert(first->reg != -1 && second->reg != -1 && first->reg != second->reg);
+    freeLiveness(liveness);
+    freeCFGs(cfgs, cfgNum);
+}
+
+void testColorCoalesce() {
+    // t12 = t11; the copy is removed, and t12 lives across the call in an s register
+    appendTAC(createTAC(TAC_LABEL, "func_coalesce", NULL, NULL));
+    appendTAC(createTAC(TAC_ADD, "v", "1", "t11"));
+    appendTAC(createTAC(TAC_ASSIGN, "t11", NULL, "t12"));
+    appendTAC(createTAC(TAC_CALL, "g", NULL, "t13"));
+    appendTAC(createTAC(TAC_ADD, "t12", "t13", "t14"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t14"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CFG* cfg = cfgs[cfgNum - 1];
+    assert(strcmp(cfg->funcName, "coalesce") == 0);
+    RegAssignment* assignment = createRegAssignment(cfg);
+    Liveness* liveness = computeLiveness(cfg);
+    colorGraph(assignment, cfg, liveness);
+    VarLocation* src = findVarLocation(assignment, "t11");
+    VarLocation* dst = findVarLocation(assignment, "t12");
+    assert(assignment->coalescedMoves == 1 && assignment->spillNum == 0);
+    assert(src->reg != -1 && src->reg == dst->reg);
+    bool calleeSaved = false;
+    for (int i = 0; i < CALLEE_SAVED_REG_NUM; ++i) {
+        if (calleeSavedRegs[i] == dst->reg) calleeSaved = true;
+    }
+    assert(calleeSaved && assignment->numCalleeSaved == 1);
+    freeLiveness(liveness);
+    freeCFGs(cfgs, cfgNum);
+}
+
+void testColorSpill() {
+    // more values live at once than there are registers: x0 = v + 0; ... x17 = v + 17; return x0 + ... + x17;
+    enum { VALUE_NUM = CALLER_SAVED_REG_NUM + CALLEE_SAVED_REG_NUM + 1 };
+    char* values[VALUE_NUM];
+    appendTAC(createTAC(TAC_LABEL, "func_spill", NULL, NULL));
+    for (int i = 0; i < VALUE_NUM; ++i) {
+        values[i] = generateTemp();
+        appendTAC(createTAC(TAC_ADD, "v", intToString(i), values[i]));
+    }
+    char* sum = values[0];
+    for (int i = 1; i < VALUE_NUM; ++i) {
+        char* next = generateTemp();
+        appendTAC(createTAC(TAC_ADD, sum, values[i], next));
+        sum = next;
+    }
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, sum));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CFG* cfg = cfgs[cfgNum - 1];
+    assert(strcmp(cfg->funcName, "spill") == 0);
+    RegAssignment* assignment = createRegAssignment(cfg);
+    Liveness* liveness = computeLiveness(cfg);
+    colorGraph(assignment, cfg, liveness);
+    // the values all interfere: each one is spilled or has a register of its own
+    int spilled = 0;
+    for (int i = 0; i < VALUE_NUM; ++i) {
+        VarLocation* location = findVarLocation(assignment, values[i]);
+        if (location->reg == -1) {
+            assert(location->slot != -1);
+            spilled++;
+            continue;
+        }
+        for (int k = 0; k < i; ++k) {
+            assert(findVarLocation(assignment, values[k])->reg != location->reg);
+        }
+    }
+    assert(spilled >= 1 && assignment->spillNum == spilled);
+    freeLiveness(liveness);
+    freeCFGs(cfgs, cfgNum);
+}
+
+// the first TAC of the function with this op and result, NULL if there is none
+static TAC* findTAC(const char* func, TACOpcode op, const char* res) {
+    bool inFunc = false;
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_LABEL && strncmp(tac->arg1, "func_", 5) == 0) inFunc = strcmp(tac->arg1 + 5, func) == 0;
+        if (!inFunc || tac->op != op) continue;
+        if (res == NULL || (tac->res != NULL && strcmp(tac->res, res) == 0)) return tac;
+    }
+    return NULL;
+}
+
+static int countTACs(const char* func, TACOpcode op) {
+    int count = 0;
+    bool inFunc = false;
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_LABEL && strncmp(tac->arg1, "func_", 5) == 0) inFunc = strcmp(tac->arg1 + 5, func) == 0;
+        if (inFunc && tac->op == op) count++;
+    }
+    return count;
+}
+
+void testConstBranch() {
+    // int x; x = 1; if (x < 2) { t16 = 5; } else { t16 = 7; } return t16 + 1;
+    appendTAC(createTAC(TAC_LABEL, "func_sccp", NULL, NULL));
+    appendTAC(createTAC(TAC_ALLOC, "INT", "4", "x"));
+    appendTAC(createTAC(TAC_ASSIGN, "1", NULL, "x"));
+    appendTAC(createTAC(TAC_LT, "x", "2", "t15"));
+    appendTAC(createTAC(TAC_IF_FALSE_GOTO, "t15", NULL, "label8"));
+    appendTAC(createTAC(TAC_ASSIGN, "5", NULL, "t16"));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label9"));
+    appendTAC(createTAC(TAC_LABEL, "label8", NULL, NULL));
+    appendTAC(createTAC(TAC_ASSIGN, "7", NULL, "t16"));
+    appendTAC(createTAC(TAC_LABEL, "label9", NULL, NULL));
+    appendTAC(createTAC(TAC_ADD, "t16", "1", "t17"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t17"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CFG* cfg = cfgs[cfgNum - 1];
+    assert(strcmp(cfg->funcName, "sccp") == 0);
+    FILE* report = tmpfile();
+    propagateConstants(cfg, report);
+    fclose(report);
+    freeCFGs(cfgs, cfgNum);
+    // the branch is never taken, so the 7 of the else arm does not reach the merge
+    assert(countTACs("sccp", TAC_IF_FALSE_GOTO) == 0);
+    TAC* sum = findTAC("sccp", TAC_ASSIGN, "t17");
+    assert(sum != NULL && strcmp(sum->arg1, "6") == 0);
+    assert(strcmp(findTAC("sccp", TAC_RETURN, NULL)->res, "6") == 0);
+    // the unreachable arm is left to the dead code pass
+    assert(countTACs("sccp", TAC_LABEL) == 4);
+}
+
+void testConstMerge() {
+    // if (c) { t18 = 3; t20 = 1; } else { t18 = 3; t20 = 2; } return t18 * 2 + t20 + 1;
+    appendTAC(createTAC(TAC_LABEL, "func_merge", NULL, NULL));
+    appendTAC(createTAC(TAC_IF_GOTO, "c", NULL, "label10"));
+    appendTAC(createTAC(TAC_ASSIGN, "3", NULL, "t18"));
+    appendTAC(createTAC(TAC_ASSIGN, "2", NULL, "t20"));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label11"));
+    appendTAC(createTAC(TAC_LABEL, "label10", NULL, NULL));
+    appendTAC(createTAC(TAC_ASSIGN, "3", NULL, "t18"));
+    appendTAC(createTAC(TAC_ASSIGN, "1", NULL, "t20"));
+    appendTAC(createTAC(TAC_LABEL, "label11", NULL, NULL));
+    appendTAC(createTAC(TAC_MUL, "t18", "2", "t19"));
+    appendTAC(createTAC(TAC_ADD, "t20", "1", "t21"));
+    appendTAC(createTAC(TAC_ADD, "t19", "t21", "t22"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t22"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CFG* cfg = cfgs[cfgNum - 1];
+    assert(strcmp(cfg->funcName, "merge") == 0);
+    FILE* report = tmpfile();
+    propagateConstants(cfg, report);
+    fclose(report);
+    freeCFGs(cfgs, cfgNum);
+    // both arms give t18 the same constant, the merge keeps it
+    TAC* product = findTAC("merge", TAC_ASSIGN, "t19");
+    assert(product != NULL && strcmp(product->arg1, "6") == 0);
+    // but not t20, whose values differ
+    TAC* inc = findTAC("merge", TAC_ADD, "t21");
+    assert(inc != NULL && strcmp(inc->arg1, "t20") == 0);
+    TAC* total = findTAC("merge", TAC_ADD, "t22");
+    assert(total != NULL && strcmp(total->arg1, "6") == 0 && strcmp(total->arg2, "t21") == 0);
+    assert(countTACs("merge", TAC_IF_GOTO) == 1);
+}
+
+void testDeadCode() {
+    // int y; y = 4; y = 5; if (c) goto label12; return y; y = 9;
+    // label12: goto label13; label14: return 0; label13: goto label14;
+    appendTAC(createTAC(TAC_LABEL, "func_dce", NULL, NULL));
+    appendTAC(createTAC(TAC_ALLOC, "INT", "4", "y"));
+    appendTAC(createTAC(TAC_ASSIGN, "4", NULL, "y"));
+    appendTAC(createTAC(TAC_ASSIGN, "5", NULL, "y"));
+    appendTAC(createTAC(TAC_IF_GOTO, "c", NULL, "label12"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "y"));
+    appendTAC(createTAC(TAC_ASSIGN, "9", NULL, "y"));
+    appendTAC(createTAC(TAC_LABEL, "label12", NULL, NULL));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label13"));
+    appendTAC(createTAC(TAC_LABEL, "label14", NULL, NULL));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "0"));
+    appendTAC(createTAC(TAC_LABEL, "label13", NULL, NULL));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label14"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CFG* cfg = cfgs[cfgNum - 1];
+    assert(strcmp(cfg->funcName, "dce") == 0);
+    FILE* report = tmpfile();
+    eliminateDeadCode(cfg, report);
+    fclose(report);
+    freeCFGs(cfgs, cfgNum);
+    // the branch goes to the end of the goto chain, and the chain is no longer reachable
+    TAC* branch = findTAC("dce", TAC_IF_GOTO, NULL);
+    assert(branch != NULL && strcmp(branch->res, "label14") == 0);
+    assert(countTACs("dce", TAC_GOTO) == 0 && countTACs("dce", TAC_LABEL) == 3);
+    // y = 4 is overwritten before it is read, y = 9 follows a return
+    TAC* assign = findTAC("dce", TAC_ASSIGN, "y");
+    assert(countTACs("dce", TAC_ASSIGN) == 1 && strcmp(assign->arg1, "5") == 0);
+    assert(countTACs("dce", TAC_RETURN) == 2 && countTACs("dce", TAC_ALLOC) == 1);
+}
+
+static unsigned int findAsmLabel(AsmContainer* container, const char* label) {
+    for (unsigned int i = 0; i < container->size; ++i) {
+        Instr* instr = &container->instrs[i];
+        if (instr->op == INSTR_LABEL && strcmp(instr->symbol, label) == 0) return i;
+    }
+    assert(false);
+    return 0;
+}
+
+#define ASM_MEMORY_WORDS 256
+
+// runs the instructions of the container from the start to the end. a taken jump runs its delay
+// slot first. memory holds ASM_MEMORY_WORDS words from address 0, NULL if the code has no lw/sw
+static void runAsm(AsmContainer* container, unsigned int regs[32], unsigned int* memory) {
+    unsigned int pc = 0;
+    int steps = 0;
+    bool delayed = false;
+    unsigned int delayedTarget = 0;
+    while (pc < container->size) {
+        assert(++steps < 100000);
+        Instr* instr = &container->instrs[pc];
+        unsigned int rs = instr->rs == -1 ? 0 : regs[instr->rs];
+        unsigned int rt = instr->rt == -1 ? 0 : regs[instr->rt];
+        unsigned int imm = (unsigned int)instr->imm;
+        unsigned int value = 0;
+        bool jump = false;
+        unsigned int target = 0;
+        switch (instr->op) {
+            case INSTR_ADD: value = rs + rt; break;
+            case INSTR_SUB: value = rs - rt; break;
+            case INSTR_AND: value = rs & rt; break;
+            case INSTR_OR: value = rs | rt; break;
+            case INSTR_XOR: value = rs ^ rt; break;
+            case INSTR_SLT: value = (int)rs < (int)rt; break;
+            case INSTR_SLTU: value = rs < rt; break;
+            case INSTR_SLL: value = rs << imm; break;
+            case INSTR_SRL: value = rs >> imm; break;
+            case INSTR_SRA: value = (unsigned int)((int)rs >> imm); break;
+            case INSTR_ADDI: value = rs + imm; break;
+            case INSTR_ANDI: value = rs & imm; break;
+            case INSTR_ORI: value = rs | imm; break;
+            case INSTR_SLTI: value = (int)rs < (int)imm; break;
+            case INSTR_MV: value = rs; break;
+            case INSTR_LW:
+                assert(memory != NULL && (rs + imm) % 4 == 0 && (rs + imm) / 4 < ASM_MEMORY_WORDS);
+                value = memory[(rs + imm) / 4];
+                break;
+            case INSTR_SW:
+                assert(memory != NULL && (rs + imm) % 4 == 0 && (rs + imm) / 4 < ASM_MEMORY_WORDS);
+                memory[(rs + imm) / 4] = rt;
+                break;
+            case INSTR_BEQ: jump = rs == rt; break;
+            case INSTR_BNE: jump = rs != rt; break;
+            case INSTR_J: jump = true; break;
+            case INSTR_JAL: jump = true; value = pc + 2; break;
+            case INSTR_JR: jump = true; target = rs; break;
+            case INSTR_NOP: case INSTR_LABEL: case INSTR_DIRECTIVE: break;
+            default: assert(false);
+        }
+        int def = getInstrDef(instr);
+        if (def != -1) regs[def] = value;
+        unsigned int next = pc + 1;
+        if (delayed) {
+            assert(!jump);
+            next = delayedTarget;
+            delayed = false;
+        }
+        if (jump) {
+            delayed = true;
+            delayedTarget = instr->op == INSTR_JR ? target : findAsmLabel(container, instr->symbol);
+        }
+        pc = next;
+    }
+}
+
+// x6 = x5 op x7 through the runtime routine, or x6 = x5 op value when value is a constant the
+// lowering handles inline
+static int runMulDiv(TACOpcode op, int y, int z, bool constant) {
+    AsmContainer container;
+    initAsmContainer(&container);
+    newAsm(&container, ".text");
+    if (!constant || !emitMulDivConst(&container, op, "x6", "x5", z)) {
+        emitMulDivCall(&container, op, "x6", "x5", "x7");
+        newAsm(&container, "j __test_end");
+        newAsm(&container, "nop");
+        emitMulDivRuntime(&container);
+        newAsm(&container, "__test_end:");
+    }
+    unsigned int regs[32] = {0};
+    regs[1] = 77;
+    regs[5] = (unsigned int)y;
+    regs[7] = (unsigned int)z;
+    runAsm(&container, regs, NULL);
+    assert(regs[0] == 0 && regs[1] == 77 && regs[5] == (unsigned int)y);
+    freeAsmContainer(&container);
+    return (int)regs[6];
+}
+
+void testMulDivLowering() {
+    int operands[][2] = {
+        {-7, 2}, {7, -2}, {-7, -2}, {0, 5}, {0, -3}, {-13, 4}, {13, -4}, {-1, 1}, {-100, 7}, {100, -7}, {-45, -9},
+    };
+    MulDivMode modes[] = {MUL_DIV_SPEED, MUL_DIV_SIZE};
+    for (int m = 0; m < 2; ++m) {
+        mulDivMode = modes[m];
+        for (size_t i = 0; i < sizeof(operands) / sizeof(operands[0]); ++i) {
+            int y = operands[i][0], z = operands[i][1];
+            for (int constant = 0; constant < 2; ++constant) {
+                assert(runMulDiv(TAC_MUL, y, z, constant) == y * z);
+                assert(runMulDiv(TAC_DIV, y, z, constant) == y / z);
+                assert(runMulDiv(TAC_MOD, y, z, constant) == y % z);
+            }
+        }
+    }
+    mulDivMode = MUL_DIV_SPEED;
+    // the quotient rounds toward zero and the remainder takes the sign of the dividend
+    assert(runMulDiv(TAC_DIV, -7, 4, true) == -1 && runMulDiv(TAC_MOD, -7, 4, true) == -3);
+    assert(runMulDiv(TAC_DIV, 7, -4, false) == -1 && runMulDiv(TAC_MOD, 7, -4, false) == 3);
+}
+
+// the instructions of the container, one line each, are the expected lines up to NULL
+static void assertAsm(AsmContainer* container, const char** expected) {
+    char line[256];
+    unsigned int i = 0;
+    for (; expected[i] != NULL; ++i) {
+        assert(i < container->size);
+        formatInstr(&container->instrs[i], line, sizeof(line));
+        assert(strcmp(line, expected[i]) == 0);
+    }
+    assert(i == container->size);
+}
+
+void testPeephole() {
+    const char* input[] = {
+        ".text",
+        "sw x5, 4(sp)",         // store then load of the same slot
+        "lw x6, 4(sp)",
+        "sw x7, 8(sp)",         // ... into the stored register
+        "lw x7, 8(sp)",
+        "sw x5, 12(sp)",        // another slot, not rewritten
+        "lw x6, 16(sp)",
+        "mv x8, x8",            // move to itself
+        "mv x9, x18",           // move back
+        "mv x18, x9",
+        "addi x19, x19, 0",     // add zero to itself
+        "addi x19, x20, 0",
+        "j label15",            // jump to the next label
+        "nop",
+        "label15:",
+        "bne x5, x6, label16",  // branch over jump
+        "nop",
+        "j label17",
+        "nop",
+        "label16:",
+        "beq x5, x6, label17",  // jump to the next label, the delay slot still runs
+        "mv x7, x8",
+        "label17:",
+        "jr ra",
+        "nop",
+        NULL
+    };
+    const char* expected[] = {
+        ".text",
+        "sw x5, 4(sp)",
+        "mv x6, x5",
+        "sw x7, 8(sp)",
+        "sw x5, 12(sp)",
+        "lw x6, 16(sp)",
+        "mv x9, x18",
+        "addi x19, x20, 0",
+        "label15:",
+        "beq x5, x6, label17",
+        "nop",
+        "label16:",
+        "mv x7, x8",
+        "label17:",
+        "jr ra",
+        "nop",
+        NULL
+    };
+    AsmContainer container;
+    initAsmContainer(&container);
+    for (int i = 0; input[i] != NULL; ++i) {
+        newAsm(&container, input[i]);
+    }
+    FILE* report = tmpfile();
+    optimizePeephole(&container, report);
+    fclose(report);
+    assertAsm(&container, expected);
+    freeAsmContainer(&container);
+}
+
+// encodes the lines as .text and returns the first wordNum words of the ROM image
+static void encodeLines(const char** lines, unsigned int* words, int wordNum) {
+    AsmContainer container;
+    initAsmContainer(&container);
+    newAsm(&container, ".text");
+    for (int i = 0; lines[i] != NULL; ++i) {
+        newAsm(&container, lines[i]);
+    }
+    FILE* report = tmpfile();
+    writeMachineCode(&container, "test_encode", report);
+    fclose(report);
+    freeAsmContainer(&container);
+
+    FILE* bin = fopen("test_encode_rom.bin", "rb");
+    assert(bin != NULL);
+    for (int i = 0; i < wordNum; ++i) {
+        unsigned char bytes[4];
+        assert(fread(bytes, 1, sizeof(bytes), bin) == sizeof(bytes));
+        words[i] = (unsigned int)bytes[0] << 24 | (unsigned int)bytes[1] << 16 | (unsigned int)bytes[2] << 8 | bytes[3];
+    }
+    fclose(bin);
+    const char* suffixes[] = {"_rom.bin", "_rom.coe", "_rom.mif", "_ram.bin", "_ram.coe", "_ram.mif"};
+    for (int i = 0; i < 6; ++i) {
+        char filename[64];
+        snprintf(filename, sizeof(filename), "test_encode%s", suffixes[i]);
+        remove(filename);
+    }
+}
+
+// the encoder exits on an error, so the line is encoded in a child process
+static bool encodingFails(const char* line) {
+    fflush(stdout);
+    pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        freopen("/dev/null", "w", stderr);
+        const char* lines[] = {line, NULL};
+        unsigned int word;
+        encodeLines(lines, &word, 1);
+        exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 1;
+}
+
+void testEncode() {
+    const char* lines[] = {
+        "loop:",
+        "add x5, x6, x7",
+        "addi x5, x6, -1",
+        "lw x5, 8(sp)",
+        "sll x5, x6, 3",
+        "beq x5, zero, loop",
+        "nop",
+        "jal callee",
+        "nop",
+        "mv x5, x6",
+        "callee:",
+        "jr ra",
+        "ori x5, x6, 65535",
+        NULL
+    };
+    unsigned int expected[] = {
+        0x00c72820, // add: rs 6, rt 7, rd 5, funct 0x20
+        0x20c5ffff, // addi: the immediate is sign extended
+        0x8c450008, // lw: base sp (2)
+        0x000628c0, // sll: the shift amount is in shamt
+        0x10a0fffb, // beq: 5 words back from the delay slot
+        0x00000000,
+        0x0c000009, // jal: the word address of callee
+        0x00000000,
+        0x00c02821, // mv: addu rd, rs, zero
+        0x03e00008, // jr: ra is $31 in Minisys
+        0x34c5ffff, // ori: the immediate is zero extended
+    };
+    int wordNum = (int)(sizeof(expected) / sizeof(expected[0]));
+    unsigned int words[sizeof(expected) / sizeof(expected[0])];
+    encodeLines(lines, words, wordNum);
+    for (int i = 0; i < wordNum; ++i) {
+        assert(words[i] == expected[i]);
+    }
+    assert(!encodingFails("addi x5, x6, 32767") && !encodingFails("andi x5, x6, 65535"));
+    assert(encodingFails("addi x5, x6, 32768") && encodingFails("addi x5, x6, -32769"));
+    assert(encodingFails("andi x5, x6, -1") && encodingFails("lw x5, 40000(sp)"));
+}
+
+void testSelfTailCall() {
+    // int gcd(int a, int b) { if (b) return gcd(b, a % b); return a; }
+    // int fact(int n) { return n * fact(n - 1); }
+    static FuncParam* gcdParams[2];
+    static FuncParam* factParams[1];
+    gcdParams[0] = createFuncParam("int", "a", 4, 0);
+    gcdParams[1] = createFuncParam("int", "b", 4, 0);
+    factParams[0] = createFuncParam("int", "n", 4, 0);
+    insertSymbol(scopeStack[0], createSymbolTableEntry("gcd", "int", 4, 1, 0, 1, 1, 0, 2, gcdParams));
+    insertSymbol(scopeStack[0], createSymbolTableEntry("fact", "int", 4, 1, 0, 1, 1, 0, 1, factParams));
+    appendTAC(createTAC(TAC_LABEL, "func_gcd", NULL, NULL));
+    appendTAC(createTAC(TAC_IF_FALSE_GOTO, "b", NULL, "label19"));
+    appendTAC(createTAC(TAC_MOD, "a", "b", "t23"));
+    appendTAC(createTAC(TAC_PARAM, "b", NULL, NULL));
+    appendTAC(createTAC(TAC_PARAM, "t23", NULL, NULL));
+    appendTAC(createTAC(TAC_CALL, "gcd", NULL, "t24"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t24"));
+    appendTAC(createTAC(TAC_LABEL, "label19", NULL, NULL));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "a"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    appendTAC(createTAC(TAC_LABEL, "func_fact", NULL, NULL));
+    appendTAC(createTAC(TAC_SUB, "n", "1", "t25"));
+    appendTAC(createTAC(TAC_PARAM, "t25", NULL, NULL));
+    appendTAC(createTAC(TAC_CALL, "fact", NULL, "t26"));
+    appendTAC(createTAC(TAC_MUL, "n", "t26", "t27"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "t27"));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    assert(strcmp(cfgs[cfgNum - 2]->funcName, "gcd") == 0 && strcmp(cfgs[cfgNum - 1]->funcName, "fact") == 0);
+    FILE* report = tmpfile();
+    eliminateSelfTailCalls(cfgs[cfgNum - 2], report);
+    eliminateSelfTailCalls(cfgs[cfgNum - 1], report);
+    fclose(report);
+    TACList* gcd = cfgs[cfgNum - 2]->funcLabel;
+    freeCFGs(cfgs, cfgNum);
+
+    // (=, b, , t) (=, t23, , u) (=, t, , a) (=, u, , b) (goto, , , entry) in place of the call
+    assert(countTACs("gcd", TAC_CALL) == 0 && countTACs("gcd", TAC_PARAM) == 0);
+    char* entry = gcd->next->tac->arg1;
+    assert(gcd->next->tac->op == TAC_LABEL && findTAC("gcd", TAC_GOTO, entry) != NULL);
+    TAC* first = findTAC("gcd", TAC_ASSIGN, "a");
+    TAC* second = findTAC("gcd", TAC_ASSIGN, "b");
+    assert(first != NULL && second != NULL);
+    assert(strcmp(findTAC("gcd", TAC_ASSIGN, first->arg1)->arg1, "b") == 0);
+    assert(strcmp(findTAC("gcd", TAC_ASSIGN, second->arg1)->arg1, "t23") == 0);
+    // the result of fact(n - 1) is multiplied before the return, so the call stays
+    assert(countTACs("fact", TAC_CALL) == 1 && countTACs("fact", TAC_GOTO) == 0);
+}
+
+void testFuseCompareBranch() {
+    // if (a < b) return 1; if (a == 0) return 2; t = a > b; if (t) return 3; return t;
+    char* less = generateTemp();
+    char* equal = generateTemp();
+    char* greater = generateTemp();
+    appendTAC(createTAC(TAC_LABEL, "func_fuse", NULL, NULL));
+    appendTAC(createTAC(TAC_LT, "a", "b", less));
+    appendTAC(createTAC(TAC_IF_GOTO, less, NULL, "label20"));
+    appendTAC(createTAC(TAC_GOTO, NULL, NULL, "label21"));
+    appendTAC(createTAC(TAC_LABEL, "label20", NULL, NULL));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "1"));
+    appendTAC(createTAC(TAC_LABEL, "label21", NULL, NULL));
+    appendTAC(createTAC(TAC_EQ, "a", "0", equal));
+    appendTAC(createTAC(TAC_IF_FALSE_GOTO, equal, NULL, "label22"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "2"));
+    appendTAC(createTAC(TAC_LABEL, "label22", NULL, NULL));
+    appendTAC(createTAC(TAC_GT, "a", "b", greater));
+    appendTAC(createTAC(TAC_IF_FALSE_GOTO, greater, NULL, "label23"));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, "3"));
+    appendTAC(createTAC(TAC_LABEL, "label23", NULL, NULL));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, greater));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    CFG* cfg = cfgs[cfgNum - 1];
+    assert(strcmp(cfg->funcName, "fuse") == 0);
+    FILE* report = tmpfile();
+    fuseCompareBranches(cfg, report);
+    fclose(report);
+    freeCFGs(cfgs, cfgNum);
+    // the jump over the goto is inverted into (if>=, a, b, label21), label20 is no longer needed
+    TAC* ge = findTAC("fuse", TAC_IF_GE, "label21");
+    assert(ge != NULL && strcmp(ge->arg1, "a") == 0 && strcmp(ge->arg2, "b") == 0);
+    assert(countTACs("fuse", TAC_GOTO) == 0 && countTACs("fuse", TAC_LT) == 0);
+    // ifFalseGoto on a == 0 jumps if a != 0
+    TAC* ne = findTAC("fuse", TAC_IF_NE, "label22");
+    assert(ne != NULL && strcmp(ne->arg1, "a") == 0 && strcmp(ne->arg2, "0") == 0);
+    assert(countTACs("fuse", TAC_EQ) == 0);
+    // the result of a > b is also returned, so it is still computed
+    assert(findTAC("fuse", TAC_GT, greater) != NULL && countTACs("fuse", TAC_IF_FALSE_GOTO) == 1);
+    assert(countTACs("fuse", TAC_LABEL) == 5);
+}
+
+// the value of a + - or comparison TAC, or of the condition of a compare-and-branch TAC
+static int evaluateTAC(TACOpcode op, int a, int b) {
+    switch (op) {
+        case TAC_ADD: return a + b;
+        case TAC_SUB: return a - b;
+        case TAC_EQ: case TAC_IF_EQ: return a == b;
+        case TAC_NE: case TAC_IF_NE: return a != b;
+        case TAC_LT: case TAC_IF_LT: return a < b;
+        case TAC_LE: case TAC_IF_LE: return a <= b;
+        case TAC_GT: case TAC_IF_GT: return a > b;
+        case TAC_GE: case TAC_IF_GE: return a >= b;
+        default: assert(false);
+    }
+    return 0;
+}
+
+// runs the function with the given values of its variables. it may use labels, jumps, copies,
+// + -, comparisons, allocs and return
+static int runTACs(const char* func, const char** names, const int* values, int num) {
+    const char* vars[32];
+    int varValues[32];
+    int varNum = num;
+    for (int i = 0; i < num; ++i) {
+        vars[i] = names[i];
+        varValues[i] = values[i];
+    }
+    TACList* start = tacHead;
+    while (start != NULL && !(start->tac->op == TAC_LABEL && strncmp(start->tac->arg1, "func_", 5) == 0 &&
+                              strcmp(start->tac->arg1 + 5, func) == 0)) {
+        start = start->next;
+    }
+    assert(start != NULL);
+    TACList* cur = start->next;
+    for (int steps = 0; steps < 10000; ++steps) {
+        TAC* tac = cur->tac;
+        int roles = getTACRoles(tac);
+        char* operands[3] = {tac->arg1, tac->arg2, tac->res};
+        int args[3] = {0, 0, 0};
+        for (int i = 0; i < 3; ++i) {
+            if (!(roles & (1 << i)) || operands[i] == NULL) continue;
+            int k = 0;
+            while (k < varNum && strcmp(vars[k], operands[i]) != 0) ++k;
+            assert(k < varNum || isConstant(operands[i]));
+            args[i] = k < varNum ? varValues[k] : atoi(operands[i]);
+        }
+        bool jump = false;
+        int result = 0;
+        switch (tac->op) {
+            case TAC_LABEL:
+                assert(strcmp(tac->arg1, "end_func") != 0);
+                break;
+            case TAC_ALLOC:
+                break;
+            case TAC_GOTO: jump = true; break;
+            case TAC_IF_GOTO: jump = args[0] != 0; break;
+            case TAC_IF_FALSE_GOTO: jump = args[0] == 0; break;
+            case TAC_ASSIGN: result = args[0]; break;
+            case TAC_RETURN: return args[2];
+            default:
+                if (isCompareBranch(tac)) {
+                    jump = evaluateTAC(tac->op, args[0], args[1]);
+                } else {
+                    result = evaluateTAC(tac->op, args[0], args[1]);
+                }
+        }
+        if (roles & TAC_DEF_RES) {
+            int k = 0;
+            while (k < varNum && strcmp(vars[k], tac->res) != 0) ++k;
+            assert(k < 32);
+            vars[k] = tac->res;
+            varValues[k] = result;
+            if (k == varNum) varNum++;
+        }
+        if (!jump) {
+            cur = cur->next;
+            continue;
+        }
+        assert(tac->res != NULL);
+        cur = start->next;
+        while (!(cur->tac->op == TAC_LABEL && strcmp(cur->tac->arg1, tac->res) == 0)) {
+            assert(cur->tac->op != TAC_LABEL || strcmp(cur->tac->arg1, "end_func") != 0);
+            cur = cur->next;
+        }
+    }
+    assert(false);
+    return 0;
+}
+
+void testShortCircuit() {
+    char source[] =
+        "int shortand(int a, int b, int c) {\n"
+        "    if ((a || b) && c) {\n"
+        "        return 1;\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n"
+        "int shortor(int a, int b, int c) {\n"
+        "    return a && b || c;\n"
+        "}\n"
+        "int shortright(int a, int b, int c) {\n"
+        "    return a && (b || c);\n"
+        "}\n";
+    yyin = fmemopen(source, strlen(source), "r");
+    assert(yyin != NULL);
+    yyparse();
+    fclose(yyin);
+    generateIndex();
+
+    const char* names[] = {"a", "b", "c"};
+    for (int i = 0; i < 8; ++i) {
+        int values[] = {i & 1, (i >> 1) & 1, (i >> 2) & 1};
+        assert(runTACs("shortand", names, values, 3) == ((values[0] || values[1]) && values[2]));
+        assert(runTACs("shortor", names, values, 3) == ((values[0] && values[1]) || values[2]));
+        assert(runTACs("shortright", names, values, 3) == (values[0] && (values[1] || values[2])));
+    }
+    // every operand is tested once. the condition jumps straight to the branches, the value is
+    // stored only after the whole expression
+    assert(countTACs("shortand", TAC_IF_GOTO) + countTACs("shortand", TAC_IF_FALSE_GOTO) == 3);
+    assert(countTACs("shortand", TAC_ASSIGN) == 0);
+    assert(countTACs("shortor", TAC_IF_GOTO) + countTACs("shortor", TAC_IF_FALSE_GOTO) == 3);
+    assert(countTACs("shortor", TAC_ASSIGN) == 2);
+    assert(countTACs("shortright", TAC_IF_GOTO) + countTACs("shortright", TAC_IF_FALSE_GOTO) == 3);
+    assert(countTACs("shortright", TAC_ASSIGN) == 2);
+}
+
+// jumps of the function to a label before them, split into gotos and conditional jumps
+static void countBackJumps(const char* func, int* gotos, int* branches) {
+    *gotos = *branches = 0;
+    bool inFunc = false;
+    const char* labels[64];
+    int labelNum = 0;
+    for (TACList* cur = tacHead; cur != NULL; cur = cur->next) {
+        TAC* tac = cur->tac;
+        if (tac->op == TAC_LABEL && strncmp(tac->arg1, "func_", 5) == 0) inFunc = strcmp(tac->arg1 + 5, func) == 0;
+        if (!inFunc) continue;
+        if (tac->op == TAC_LABEL) {
+            assert(labelNum < 64);
+            labels[labelNum++] = tac->arg1;
+        }
+        bool branch = tac->op == TAC_IF_GOTO || tac->op == TAC_IF_FALSE_GOTO || isCompareBranch(tac);
+        if (tac->op != TAC_GOTO && !branch) continue;
+        for (int i = 0; i < labelNum; ++i) {
+            if (strcmp(labels[i], tac->res) != 0) continue;
+            if (branch) ++*branches; else ++*gotos;
+        }
+    }
+}
+
+void testRotateLoops() {
+    char source[] =
+        "int rotwhile(int n) {\n"
+        "    int s;\n"
+        "    int i;\n"
+        "    s = 0;\n"
+        "    i = 0;\n"
+        "    while (i < n) {\n"
+        "        s = s + i;\n"
+        "        i++;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n"
+        "int rotfor(int n) {\n"
+        "    int s;\n"
+        "    int i;\n"
+        "    s = 0;\n"
+        "    for (i = 0; i < n && s < 8; i++) {\n"
+        "        if (i == 2) {\n"
+        "            continue;\n"
+        "        }\n"
+        "        s = s + i;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n";
+    yyin = fmemopen(source, strlen(source), "r");
+    assert(yyin != NULL);
+    yyparse();
+    fclose(yyin);
+    generateIndex();
+
+    int cfgNum = 0;
+    CFG** cfgs = buildCFGs(&cfgNum);
+    assert(strcmp(cfgs[cfgNum - 2]->funcName, "rotwhile") == 0 && strcmp(cfgs[cfgNum - 1]->funcName, "rotfor") == 0);
+    int gotos, branches;
+    countBackJumps("rotwhile", &gotos, &branches);
+    assert(gotos == 1 && branches == 0);
+    FILE* report = tmpfile();
+    rotateLoops(cfgs[cfgNum - 2], report);
+    rotateLoops(cfgs[cfgNum - 1], report);
+    fclose(report);
+    freeCFGs(cfgs, cfgNum);
+
+    // the goto back to the condition is replaced by the condition, which jumps back to the body.
+    // the copy in front of the loop computes its own temp
+    countBackJumps("rotwhile", &gotos, &branches);
+    assert(gotos == 0 && branches == 1 && countTACs("rotwhile", TAC_LT) == 2);
+    countBackJumps("rotfor", &gotos, &branches);
+    assert(gotos == 0 && branches >= 1);
+    const char* names[] = {"n"};
+    for (int n = 0; n < 8; ++n) {
+        int whileSum = 0, forSum = 0;
+        for (int i = 0; i < n; ++i) whileSum += i;
+        for (int i = 0; i < n && forSum < 8; i++) {
+            if (i == 2) continue;
+            forSum += i;
+        }
+        assert(runTACs("rotwhile", names, &n, 1) == whileSum);
+        assert(runTACs("rotfor", names, &n, 1) == forSum);
+    }
+}
+
+void testLocalStackArgs() {
+    // int weigh(int p0, ..., int p9) { t = p0; t = t + t + p1; ... return t; }
+    // int pass(int x) { return weigh(x + 0, x + 1, ..., x + 9); }
+    // p8 and p9 are passed on the stack. -O0 with the per-statement allocator
+    enum { ARG_NUM = 10 };
+    static char names[ARG_NUM][4];
+    static FuncParam* weighParams[ARG_NUM];
+    static FuncParam* passParams[1];
+    for (int i = 0; i < ARG_NUM; ++i) {
+        snprintf(names[i], sizeof(names[i]), "p%d", i);
+        weighParams[i] = createFuncParam("int", names[i], 4, 0);
+    }
+    passParams[0] = createFuncParam("int", "x", 4, 0);
+    insertSymbol(scopeStack[0], createSymbolTableEntry("weigh", "int", 4, 1, 0, 1, 1, 0, ARG_NUM, weighParams));
+    insertSymbol(scopeStack[0], createSymbolTableEntry("pass", "int", 4, 1, 0, 1, 1, 0, 1, passParams));
+    // only these two functions are generated
+    tacHead = tacTail = NULL;
+    appendTAC(createTAC(TAC_LABEL, "func_weigh", NULL, NULL));
+    char* sum = names[0];
+    for (int i = 1; i < ARG_NUM; ++i) {
+        char* twice = generateTemp();
+        char* next = generateTemp();
+        appendTAC(createTAC(TAC_ADD, sum, sum, twice));
+        appendTAC(createTAC(TAC_ADD, twice, names[i], next));
+        sum = next;
+    }
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, sum));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    appendTAC(createTAC(TAC_LABEL, "func_pass", NULL, NULL));
+    for (int i = 0; i < ARG_NUM; ++i) {
+        char* arg = generateTemp();
+        appendTAC(createTAC(TAC_ADD, "x", intToString(i), arg));
+        appendTAC(createTAC(TAC_PARAM, arg, NULL, NULL));
+    }
+    char* result = generateTemp();
+    appendTAC(createTAC(TAC_CALL, "weigh", NULL, result));
+    appendTAC(createTAC(TAC_RETURN, NULL, NULL, result));
+    appendTAC(createTAC(TAC_LABEL, "end_func", NULL, NULL));
+    generateIndex();
+    computeNextUse();
+
+    RegAllocMode mode = regAllocMode;
+    regAllocMode = REG_ALLOC_LOCAL;
+    AsmContainer container;
+    initAsmContainer(&container);
+    initAsm();
+    calcFrameInfo(&container);
+    newAsm(&container, ".text");
+    newAsm(&container, "jal pass");
+    newAsm(&container, "nop");
+    newAsm(&container, "j __test_end");
+    newAsm(&container, "nop");
+    generateASM(&container);
+    newAsm(&container, "__test_end:");
+    regAllocMode = mode;
+    assertNoLoadUse(&container);
+
+    unsigned int memory[ASM_MEMORY_WORDS] = {0};
+    unsigned int regs[32] = {0};
+    regs[2] = sizeof(memory);
+    regs[10] = 3;
+    runAsm(&container, regs, memory);
+    unsigned int expected = 0;
+    for (int i = 0; i < ARG_NUM; ++i) {
+        expected = expected * 2 + 3 + i;
+    }
+    assert(regs[10] == expected && regs[2] == sizeof(memory));
+    freeAsmContainer(&container);
+}
+
 int main(){
     // initialize scopeStack
     scopeStack[0] = createSymbolTable();
@@ -193,6 +1288,44 @@ int main(){
     printf("scope stack test passed.\n");
     testCreateConstSymbol();
     printf("create const symbol passed.\n");
+    testBuildCFG();
+    printf("build cfg passed.\n");
+    testDominators();
+    printf("dominators passed.\n");
+    testCallGraph();
+    printf("call graph passed.\n");
+    testInlineHiddenGlobal();
+    printf("inline hidden global passed.\n");
+    testDelaySlotAfterLoad();
+    printf("delay slot after load passed.\n");
+    testColorArgAcrossBlocks();
+    printf("color arg across blocks passed.\n");
+    testColorCoalesce();
+    printf("color coalesce passed.\n");
+    testColorSpill();
+    printf("color spill passed.\n");
+    testConstBranch();
+    printf("const branch passed.\n");
+    testConstMerge();
+    printf("const merge passed.\n");
+    testDeadCode();
+    printf("dead code passed.\n");
+    testMulDivLowering();
+    printf("mul div lowering passed.\n");
+    testPeephole();
+    printf("peephole passed.\n");
+    testEncode();
+    printf("encode passed.\n");
+    testSelfTailCall();
+    printf("self tail call passed.\n");
+    testFuseCompareBranch();
+    printf("fuse compare branch passed.\n");
+    testShortCircuit();
+    printf("short circuit passed.\n");
+    testRotateLoops();
+    printf("rotate loops passed.\n");
+    testLocalStackArgs();
+    printf("local stack args passed.\n");
 
     printf("all test passed.\n");
 }
@@ -0,0 +1,394 @@
+#include "opt.h"
+#include <string.h>
+#include <stdbool.h>
+
+/* value numbering (Dragon Book 6.1.2, Briggs, Cooper & Simpson 1997).
+ * every value gets a number; variables map to the number of the value they hold and expressions
+ * (op, numbers of the operands) map to the number of their result and the variable that holds it.
+ * when an expression is computed again while its holder still holds the value, the TAC becomes a
+ * copy (=, holder, , res), which the register allocators usually coalesce away.
+ * loads through =* and =[] also take the version of array memory, which every store, $= and
+ * call changes. a store records the stored value, so a later load of the same address reuses it.
+ * calls and $= may change globals, so the numbers of globals are forgotten there.
+ *
+ * the local version starts every block with empty tables. the global version walks the
+ * dominator tree and starts a block with the tables of its immediate dominator; variables
+ * written, and memory changed, on some path from the dominator to the block are forgotten,
+ * since the code is not in SSA form.
+ */
+// the op of the entries of constants, after all operators
+#define CONSTANT_OP TAC_OP_NUM
+
+typedef struct ValueEntry {
+    TACOpcode op;            // CONSTANT_OP for constants
+    int vn1;                 // for constants: the value
+    int vn2;
+    int mem;                 // memory version for loads, -1 otherwise
+    int vn;
+    char* holder;            // variable or constant that held the value when it was computed
+    int next;                // next entry in the same bucket, -1 at the end
+} ValueEntry;
+
+typedef struct ValueNumbering {
+    CFG* cfg;
+    Liveness* liveness;
+    bool* local;             // indexed by variable number, see findLocalScalars()
+    int nextVN;
+    int* varVN;              // current value number of each variable, -1 if not numbered yet
+    int memVN;
+    ValueEntry* entries;     // in insertion order, so a scope is removed by truncating
+    int entryNum;
+    int entryCapacity;
+    int* buckets;
+    unsigned int bucketNum;
+    int reused;
+    int loadsReused;
+} ValueNumbering;
+
+static unsigned int hashEntry(TACOpcode op, int vn1, int vn2, int mem) {
+    unsigned int hash = 5381 + (unsigned int)op;
+    hash = hash * 31 + (unsigned int)vn1;
+    hash = hash * 31 + (unsigned int)vn2;
+    hash = hash * 31 + (unsigned int)mem;
+    return hash;
+}
+
+static ValueEntry* findEntry(ValueNumbering* vn, TACOpcode op, int vn1, int vn2, int mem) {
+    int index = vn->buckets[hashEntry(op, vn1, vn2, mem) & (vn->bucketNum - 1)];
+    while (index != -1) {
+        ValueEntry* entry = &vn->entries[index];
+        if (entry->vn1 == vn1 && entry->vn2 == vn2 && entry->mem == mem && entry->op == op) {
+            return entry;
+        }
+        index = entry->next;
+    }
+    return NULL;
+}
+
+// newer entries come first in their bucket, so they hide older ones with the same key
+static ValueEntry* addEntry(ValueNumbering* vn, TACOpcode op, int vn1, int vn2, int mem, int value, char* holder) {
+    if (vn->entryNum >= vn->entryCapacity) {
+        vn->entryCapacity *= 2;
+        vn->entries = (ValueEntry*)realloc(vn->entries, vn->entryCapacity * sizeof(ValueEntry));
+        if (vn->entries == NULL) {
+            fprintf(stderr, "Failed to allocate memory for value numbering.\n");
+            exit(1);
+        }
+    }
+    unsigned int bucket = hashEntry(op, vn1, vn2, mem) & (vn->bucketNum - 1);
+    ValueEntry* entry = &vn->entries[vn->entryNum];
+    entry->op = op;
+    entry->vn1 = vn1;
+    entry->vn2 = vn2;
+    entry->mem = mem;
+    entry->vn = value;
+    entry->holder = holder;
+    entry->next = vn->buckets[bucket];
+    vn->buckets[bucket] = vn->entryNum++;
+    return entry;
+}
+
+// remove the entries added after the first mark entries
+static void popEntries(ValueNumbering* vn, int mark) {
+    while (vn->entryNum > mark) {
+        ValueEntry* entry = &vn->entries[--vn->entryNum];
+        vn->buckets[hashEntry(entry->op, entry->vn1, entry->vn2, entry->mem) & (vn->bucketNum - 1)] = entry->next;
+    }
+}
+
+// returns the value number of an operand, -1 for empty operands
+static int operandVN(ValueNumbering* vn, char* operand) {
+    if (operand == NULL || *operand == '\0') return -1;
+    if (isConstant(operand)) {
+        int value = (int)strtol(operand, NULL, 10);
+        ValueEntry* entry = findEntry(vn, CONSTANT_OP, value, 0, -1);
+        if (entry == NULL) {
+            entry = addEntry(vn, CONSTANT_OP, value, 0, -1, vn->nextVN++, operand);
+        }
+        return entry->vn;
+    }
+    int num = isVariable(operand) ? getLivenessVar(vn->liveness, operand) : -1;
+    if (num == -1) {
+        return vn->nextVN++; // string literals are never equal
+    }
+    if (vn->varVN[num] == -1) {
+        vn->varVN[num] = vn->nextVN++;
+    }
+    return vn->varVN[num];
+}
+
+static void setVarVN(ValueNumbering* vn, char* var, int value) {
+    int num = isVariable(var) ? getLivenessVar(vn->liveness, var) : -1;
+    if (num != -1) {
+        vn->varVN[num] = value;
+    }
+}
+
+// a call or $= may write globals and any array
+static void clobberMemory(ValueNumbering* vn, bool globals) {
+    vn->memVN = vn->nextVN++;
+    if (!globals) return;
+    for (int i = 0; i < vn->liveness->varNum; ++i) {
+        if (!vn->local[i]) vn->varVN[i] = -1;
+    }
+}
+
+static bool holderValid(ValueNumbering* vn, ValueEntry* entry) {
+    return isConstant(entry->holder) || operandVN(vn, entry->holder) == entry->vn;
+}
+
+static bool isCommutative(TACOpcode op) {
+    switch (op) {
+    case TAC_ADD: case TAC_MUL: case TAC_BIT_AND: case TAC_BIT_OR: case TAC_BIT_XOR:
+    case TAC_EQ: case TAC_NE: case TAC_AND: case TAC_OR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void numberTAC(ValueNumbering* vn, TAC* tac) {
+    TACOpcode op = tac->op;
+    if (op == TAC_LABEL || op == TAC_GOTO || op == TAC_IF_GOTO ||
+        op == TAC_IF_FALSE_GOTO || op == TAC_PARAM || op == TAC_RETURN ||
+        op == TAC_ALLOC || op == TAC_ALLOC_GLOBAL) {
+        return;
+    }
+    if (op == TAC_CALL) {
+        clobberMemory(vn, true);
+        setVarVN(vn, tac->res, vn->nextVN++);
+        return;
+    }
+    if (op == TAC_WRITE_ADDR) {
+        clobberMemory(vn, true);
+        return;
+    }
+    if (op == TAC_READ_ADDR) {
+        setVarVN(vn, tac->res, vn->nextVN++); // device registers may change at any time
+        return;
+    }
+    if (op == TAC_STORE_ELEM) {
+        clobberMemory(vn, false);
+        return;
+    }
+    if (op == TAC_STORE) {
+        int addr = operandVN(vn, tac->arg1);
+        int value = operandVN(vn, tac->res);
+        clobberMemory(vn, false);
+        addEntry(vn, TAC_LOAD, addr, -1, vn->memVN, value, tac->res);
+        return;
+    }
+    if (op == TAC_ASSIGN) {
+        setVarVN(vn, tac->res, operandVN(vn, tac->arg1));
+        return;
+    }
+
+    // expressions, including &[] and the loads =* and =[]
+    int vn1 = operandVN(vn, tac->arg1);
+    int vn2 = operandVN(vn, tac->arg2);
+    if (isCommutative(op) && vn1 > vn2) {
+        int temp = vn1;
+        vn1 = vn2;
+        vn2 = temp;
+    }
+    bool load = op == TAC_LOAD || op == TAC_LOAD_ELEM;
+    int mem = load ? vn->memVN : -1;
+    ValueEntry* entry = findEntry(vn, op, vn1, vn2, mem);
+    if (entry != NULL && holderValid(vn, entry)) {
+        int value = entry->vn;
+        tac->op = TAC_ASSIGN;
+        tac->arg1 = entry->holder;
+        tac->arg2 = NULL;
+        setVarVN(vn, tac->res, value);
+        if (load) {
+            ++vn->loadsReused;
+        } else {
+            ++vn->reused;
+        }
+        return;
+    }
+    int value = vn->nextVN++;
+    setVarVN(vn, tac->res, value);
+    addEntry(vn, op, vn1, vn2, mem, value, tac->res);
+}
+
+static void numberBlock(ValueNumbering* vn, BasicBlock* block) {
+    TACList* cur = block->first;
+    for (int i = 0; i < block->tacNum; ++i, cur = cur->next) {
+        numberTAC(vn, cur->tac);
+    }
+}
+
+static void initValueNumbering(ValueNumbering* vn, CFG* cfg) {
+    vn->cfg = cfg;
+    vn->liveness = computeLiveness(cfg);
+    vn->local = findLocalScalars(cfg, vn->liveness);
+    vn->nextVN = 0;
+    vn->varVN = (int*)malloc((vn->liveness->varNum + 1) * sizeof(int));
+    vn->memVN = vn->nextVN++;
+    vn->entryCapacity = 64;
+    vn->entries = (ValueEntry*)malloc(vn->entryCapacity * sizeof(ValueEntry));
+    vn->entryNum = 0;
+    int tacNum = 0;
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        tacNum += cfg->blocks[b]->tacNum;
+    }
+    vn->bucketNum = 16;
+    while (vn->bucketNum < (unsigned int)tacNum * 2) {
+        vn->bucketNum *= 2;
+    }
+    vn->buckets = (int*)malloc(vn->bucketNum * sizeof(int));
+    for (unsigned int i = 0; i < vn->bucketNum; ++i) {
+        vn->buckets[i] = -1;
+    }
+    vn->reused = 0;
+    vn->loadsReused = 0;
+}
+
+static void freeValueNumbering(ValueNumbering* vn) {
+    free(vn->varVN);
+    free(vn->entries);
+    free(vn->buckets);
+    free(vn->local);
+    freeLiveness(vn->liveness);
+}
+
+void numberValuesLocal(CFG* cfg, FILE* report) {
+    ValueNumbering vn;
+    initValueNumbering(&vn, cfg);
+    for (int b = 0; b < cfg->blockNum; ++b) {
+        for (int i = 0; i < vn.liveness->varNum; ++i) {
+            vn.varVN[i] = -1;
+        }
+        clobberMemory(&vn, false);
+        popEntries(&vn, 0);
+        numberBlock(&vn, cfg->blocks[b]);
+    }
+    fprintf(report, "%s: %d expressions reused, %d loads reused\n", cfg->funcName, vn.reused, vn.loadsReused);
+    freeValueNumbering(&vn);
+}
+
+typedef struct DomTree {
+    int* idom;
+    int** children;
+    int* childNum;
+    bool* hasCall;           // indexed by block id: the block contains call or $=
+    bool* hasStore;          // the block contains call, $=, *= or []=
+    int* visitStamp;         // for the backward walks in forgetRegion()
+    int* stack;
+} DomTree;
+
+// forget what may change between the end of the immediate dominator and the start of block:
+// the variables written in, and the memory changed by, every block on such a path
+static void forgetRegion(ValueNumbering* vn, DomTree* tree, BasicBlock* block) {
+    int top = 0;
+    int dom = tree->idom[block->id];
+    for (int i = 0; i < block->predNum; ++i) {
+        int pred = block->preds[i]->id;
+        if (pred != dom && tree->visitStamp[pred] != block->id) {
+            tree->visitStamp[pred] = block->id;
+            tree->stack[top++] = pred;
+        }
+    }
+    bool globals = false, memory = false;
+    while (top > 0) {
+        BasicBlock* cur = vn->cfg->blocks[tree->stack[--top]];
+        unsigned int* def = vn->liveness->def[cur->id];
+        for (int i = 0; i < vn->liveness->varNum; ++i) {
+            if (LIVE_SET_HAS(def, i)) vn->varVN[i] = -1;
+        }
+        globals = globals || tree->hasCall[cur->id];
+        memory = memory || tree->hasStore[cur->id];
+        for (int i = 0; i < cur->predNum; ++i) {
+            int pred = cur->preds[i]->id;
+            if (pred != dom && tree->visitStamp[pred] != block->id) {
+                tree->visitStamp[pred] = block->id;
+                tree->stack[top++] = pred;
+            }
+        }
+    }
+    if (memory) clobberMemory(vn, globals);
+}
+
+static void numberDomSubtree(ValueNumbering* vn, DomTree* tree, BasicBlock* block) {
+    int varNum = vn->liveness->varNum;
+    int* savedVN = (int*)malloc((varNum + 1) * sizeof(int));
+    int savedMem = vn->memVN;
+    memcpy(savedVN, vn->varVN, varNum * sizeof(int));
+    int mark = vn->entryNum;
+
+    if (block->id != 0) {
+        forgetRegion(vn, tree, block);
+    }
+    numberBlock(vn, block);
+    int* exitVN = (int*)malloc((varNum + 1) * sizeof(int));
+    int exitMem = vn->memVN;
+    memcpy(exitVN, vn->varVN, varNum * sizeof(int));
+    for (int i = 0; i < tree->childNum[block->id]; ++i) {
+        memcpy(vn->varVN, exitVN, varNum * sizeof(int));
+        vn->memVN = exitMem;
+        numberDomSubtree(vn, tree, vn->cfg->blocks[tree->children[block->id][i]]);
+    }
+
+    popEntries(vn, mark);
+    memcpy(vn->varVN, savedVN, varNum * sizeof(int));
+    vn->memVN = savedMem;
+    free(exitVN);
+    free(savedVN);
+}
+
+void numberValuesGlobal(CFG* cfg, FILE* report) {
+    ValueNumbering vn;
+    initValueNumbering(&vn, cfg);
+    if (cfg->blockNum == 0) {
+        fprintf(report, "%s: %d expressions reused, %d loads reused\n", cfg->funcName, vn.reused, vn.loadsReused);
+        freeValueNumbering(&vn);
+        return;
+    }
+
+    DomTree tree;
+    int blockNum = cfg->blockNum;
+    tree.idom = computeDominators(cfg);
+    tree.children = (int**)calloc(blockNum, sizeof(int*));
+    tree.childNum = (int*)calloc(blockNum, sizeof(int));
+    tree.hasCall = (bool*)calloc(blockNum, sizeof(bool));
+    tree.hasStore = (bool*)calloc(blockNum, sizeof(bool));
+    tree.visitStamp = (int*)malloc(blockNum * sizeof(int));
+    tree.stack = (int*)malloc(blockNum * sizeof(int));
+    for (int b = 0; b < blockNum; ++b) {
+        tree.visitStamp[b] = -1;
+        int dom = tree.idom[b];
+        if (dom != -1) {
+            tree.children[dom] = (int*)realloc(tree.children[dom], (tree.childNum[dom] + 1) * sizeof(int));
+            tree.children[dom][tree.childNum[dom]++] = b;
+        }
+        TACList* cur = cfg->blocks[b]->first;
+        for (int i = 0; i < cfg->blocks[b]->tacNum; ++i, cur = cur->next) {
+            TACOpcode op = cur->tac->op;
+            if (op == TAC_CALL || op == TAC_WRITE_ADDR) {
+                tree.hasCall[b] = true;
+                tree.hasStore[b] = true;
+            } else if (op == TAC_STORE || op == TAC_STORE_ELEM) {
+                tree.hasStore[b] = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < vn.liveness->varNum; ++i) {
+        vn.varVN[i] = -1;
+    }
+    numberDomSubtree(&vn, &tree, cfg->blocks[0]);
+    fprintf(report, "%s: %d expressions reused, %d loads reused\n", cfg->funcName, vn.reused, vn.loadsReused);
+
+    for (int b = 0; b < blockNum; ++b) {
+        free(tree.children[b]);
+    }
+    free(tree.children);
+    free(tree.childNum);
+    free(tree.hasCall);
+    free(tree.hasStore);
+    free(tree.visitStamp);
+    free(tree.stack);
+    free(tree.idom);
+    freeValueNumbering(&vn);
+}